@@ -10,6 +10,7 @@
 param(
     [string]$CharsFile = "resources/chars_input.txt",
     [switch]$Clean,
+    [switch]$Compress,
     [switch]$Help
 )
 
@@ -166,6 +167,11 @@ try {
                     $args += $variant.Variation
                 }
                 
+                # Reading fonts dominate flash usage, store them RLE compressed on request
+                if ($Compress) {
+                    $args += "--compress"
+                }
+                
                 # Run generation
                 $output = & $PythonCmd @args 2>&1
                 
@@ -0,0 +1,170 @@
+"""Binary font container (.mrf) loaded at runtime from SD by SdFontFamily.
+
+See src/resources/fonts/SdFont.h for the layout. One file holds one family at
+one size with up to four style variants; writing a variant into an existing
+file replaces that style and keeps the others.
+"""
+
+import os
+import struct
+from typing import Dict, List, Optional, Tuple
+
+from .bitmap_utils import bytes_per_row, encode_glyph_rle, glyph_symbols
+from .kerning import kerning_to_glyph_indices
+
+MAGIC = b"MRFN"
+VERSION = 1
+HEADER_SIZE = 48
+VARIANT_ENTRY_SIZE = 24
+GLYPH_RECORD_SIZE = 16
+KERN_RECORD_SIZE = 6
+FAMILY_NAME_LENGTH = 32
+
+FLAG_GRAYSCALE = 0x01
+FLAG_RLE = 0x02
+
+STYLES = {"regular": 0, "bold": 1, "italic": 2, "bolditalic": 3}
+
+
+def _read_container(path: str) -> Tuple[str, int, Dict[int, Tuple[int, int, bytes, bytes, bytes]]]:
+    """Return (family, size, {style: (flags, yadvance, glyph_table, bitmap_data, kern_table)})."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER_SIZE or data[:4] != MAGIC:
+        raise ValueError(f"{path} is not a font container")
+    version, size, count = struct.unpack_from("<HBB", data, 4)
+    if version != VERSION:
+        raise ValueError(f"{path} has unsupported version {version}")
+    family = data[8 : 8 + FAMILY_NAME_LENGTH].split(b"\0", 1)[0].decode("utf-8")
+    variants = {}
+    for i in range(count):
+        style, flags, yadv, _, glyph_count, kern_count, table_off, bmp_off, bmp_size, kern_off = struct.unpack_from(
+            "<BBBBHHIIII", data, HEADER_SIZE + i * VARIANT_ENTRY_SIZE
+        )
+        table = data[table_off : table_off + glyph_count * GLYPH_RECORD_SIZE]
+        kern = data[kern_off : kern_off + kern_count * KERN_RECORD_SIZE]
+        variants[style] = (flags, yadv, table, data[bmp_off : bmp_off + bmp_size], kern)
+    return family, size, variants
+
+
+def _pack_variant(
+    chars: List[int],
+    glyphs: List[dict],
+    bitmap_all: List[int],
+    bitmap_lsb_all: List[int],
+    bitmap_msb_all: List[int],
+    grayscale: bool,
+    compress: bool,
+    kerning: Optional[List[Tuple[int, int, int]]],
+) -> Tuple[int, bytes, bytes, bytes]:
+    """Build (flags, glyph_table, bitmap_data, kern_table) for one variant."""
+    order = sorted(range(len(chars)), key=lambda i: chars[i])
+    table = bytearray()
+    bitmaps = bytearray()
+    for idx in order:
+        g = glyphs[idx]
+        start = g["bitmapOffset"]
+        size = bytes_per_row(g["width"]) * g["height"]
+        if compress:
+            symbols = glyph_symbols(
+                g["width"],
+                g["height"],
+                start,
+                bitmap_all,
+                bitmap_lsb_all if grayscale else [],
+                bitmap_msb_all if grayscale else [],
+            )
+            data = bytes(encode_glyph_rle(symbols))
+        else:
+            data = bytes(bitmap_all[start : start + size])
+            if grayscale:
+                data += bytes(bitmap_lsb_all[start : start + size])
+                data += bytes(bitmap_msb_all[start : start + size])
+        table += struct.pack(
+            "<IIBBBbb3x",
+            len(bitmaps),
+            chars[idx],
+            g["width"],
+            g["height"],
+            g["xAdvance"],
+            g["xOffset"],
+            g["yOffset"],
+        )
+        bitmaps += data
+    kern = bytearray()
+    for left, right, adjust in kerning_to_glyph_indices(chars, kerning or []):
+        kern += struct.pack("<HHbx", left, right, adjust)
+    flags = (FLAG_GRAYSCALE if grayscale else 0) | (FLAG_RLE if compress else 0)
+    return flags, bytes(table), bytes(bitmaps), bytes(kern)
+
+
+def write_font_container(
+    out_path: str,
+    family: str,
+    size: int,
+    style: str,
+    chars: List[int],
+    glyphs: List[dict],
+    bitmap_all: List[int],
+    bitmap_lsb_all: List[int],
+    bitmap_msb_all: List[int],
+    yadvance: int,
+    grayscale: bool = True,
+    compress: bool = False,
+    kerning: Optional[List[Tuple[int, int, int]]] = None,
+):
+    style_id = STYLES[style]
+    family_bytes = family.encode("utf-8")
+    if len(family_bytes) >= FAMILY_NAME_LENGTH:
+        raise ValueError(f"family name '{family}' is longer than {FAMILY_NAME_LENGTH - 1} bytes")
+
+    variants = {}
+    if os.path.isfile(out_path):
+        old_family, old_size, variants = _read_container(out_path)
+        if old_family != family or old_size != size:
+            raise ValueError(
+                f"{out_path} holds {old_family} {old_size}, refusing to add {family} {size}"
+            )
+
+    flags, table, bitmaps, kern = _pack_variant(
+        chars, glyphs, bitmap_all, bitmap_lsb_all, bitmap_msb_all, grayscale, compress, kerning
+    )
+    variants[style_id] = (flags, yadvance, table, bitmaps, kern)
+
+    # Header, variant table, then glyph table + bitmap data of each variant
+    styles = sorted(variants)
+    offset = HEADER_SIZE + len(styles) * VARIANT_ENTRY_SIZE
+    entries = bytearray()
+    body = bytearray()
+    for s in styles:
+        v_flags, v_yadv, v_table, v_bitmaps, v_kern = variants[s]
+        table_off = offset + len(body)
+        body += v_table
+        kern_off = offset + len(body)
+        body += v_kern
+        bmp_off = offset + len(body)
+        body += v_bitmaps
+        entries += struct.pack(
+            "<BBBBHHIIII",
+            s,
+            v_flags,
+            v_yadv,
+            0,
+            len(v_table) // GLYPH_RECORD_SIZE,
+            len(v_kern) // KERN_RECORD_SIZE,
+            table_off,
+            bmp_off,
+            len(v_bitmaps),
+            kern_off if v_kern else 0,
+        )
+
+    header = MAGIC + struct.pack("<HBB", VERSION, size, len(styles))
+    header += family_bytes.ljust(FAMILY_NAME_LENGTH, b"\0") + bytes(8)
+
+    os.makedirs(os.path.dirname(os.path.abspath(out_path)), exist_ok=True)
+    with open(out_path, "wb") as f:
+        f.write(header + entries + body)
+    print(
+        f"Wrote {out_path} ({family} {size} {style}, {len(table) // GLYPH_RECORD_SIZE} glyphs, "
+        f"{len(kern) // KERN_RECORD_SIZE} kerning pairs, {len(bitmaps)} bitmap bytes)"
+    )
@@ -36,3 +36,65 @@ def format_c_code_list(code_list: List[int]) -> str:
         for i in range(0, len(parts), per_line)
     ]
     return ",\n".join(lines)
+
+
+# Symbols of the RLE glyph format (see GlyphSymbol in src/rendering/SimpleFont.h)
+SYM_WHITE, SYM_LIGHT, SYM_GRAY, SYM_DARK, SYM_BLACK = range(5)
+
+RLE_MIN_RUN = 3
+RLE_MAX_RUN = 64
+
+
+def _plane_bit(plane: List[int], offset: int, width: int, x: int, y: int) -> int:
+    if not plane:
+        return 0
+    return (plane[offset + y * bytes_per_row(width) + x // 8] >> (7 - (x % 8))) & 1
+
+
+def glyph_symbols(
+    width: int,
+    height: int,
+    offset: int,
+    bitmap: List[int],
+    bitmap_lsb: List[int],
+    bitmap_msb: List[int],
+) -> List[int]:
+    """Combine the BW/LSB/MSB planes of one glyph into row-major RLE symbols."""
+    symbols = []
+    for y in range(height):
+        for x in range(width):
+            bw = _plane_bit(bitmap, offset, width, x, y)
+            lsb = _plane_bit(bitmap_lsb, offset, width, x, y)
+            msb = _plane_bit(bitmap_msb, offset, width, x, y)
+            if bw:
+                if msb:
+                    raise ValueError(f"unsupported pixel (bw=1, msb=1) at {x},{y}")
+                symbols.append(SYM_LIGHT if lsb else SYM_WHITE)
+            elif msb:
+                symbols.append(SYM_DARK if lsb else SYM_GRAY)
+            else:
+                if lsb:
+                    raise ValueError(f"unsupported pixel (bw=0, lsb=1, msb=0) at {x},{y}")
+                symbols.append(SYM_BLACK)
+    return symbols
+
+
+def encode_glyph_rle(symbols: List[int]) -> List[int]:
+    """Encode glyph symbols as white/black runs and packed literal triples."""
+    out = []
+    i = 0
+    n = len(symbols)
+    while i < n:
+        sym = symbols[i]
+        if sym in (SYM_WHITE, SYM_BLACK):
+            run = 1
+            while i + run < n and symbols[i + run] == sym and run < RLE_MAX_RUN:
+                run += 1
+            if run >= RLE_MIN_RUN:
+                out.append((0x00 if sym == SYM_WHITE else 0x40) | (run - 1))
+                i += run
+                continue
+        triple = symbols[i : i + 3] + [SYM_WHITE] * (3 - len(symbols[i : i + 3]))
+        out.append(0x80 + triple[0] * 25 + triple[1] * 5 + triple[2])
+        i += 3
+    return out
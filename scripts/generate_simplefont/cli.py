@@ -37,6 +37,8 @@ from scripts.generate_simplefont.render import (
     render_combined_preview,
 )
 from scripts.generate_simplefont.writer import generate_header, write_header_from_data
+from scripts.generate_simplefont.binary_writer import STYLES, write_font_container
+from scripts.generate_simplefont.kerning import extract_kerning
 from scripts.generate_simplefont.bitmap_utils import (
     bytes_per_row,
     gen_bitmap_bytes,
@@ -109,6 +111,36 @@ def main(argv=None):
         default=True,
         help="Disable grayscale output: do not generate the Bitmaps_lsb/Bitmaps_msb arrays (default: enabled)",
     )
+    p.add_argument(
+        "--compress",
+        action="store_true",
+        default=False,
+        help="Emit a run-length compressed font (GlyphFormat::RLE) decoded on the fly by the renderer",
+    )
+    p.add_argument(
+        "--no-kerning",
+        dest="kerning",
+        action="store_false",
+        default=True,
+        help="Do not export kerning pairs from the TTF (default: exported)",
+    )
+    p.add_argument(
+        "--bin-out",
+        help=(
+            "Also write a font container (.mrf) loadable from SD (/microreader/fonts). "
+            "An existing container of the same family and size gets this style added or replaced."
+        ),
+    )
+    p.add_argument(
+        "--family",
+        help="Family name stored in the font container (default: --name)",
+    )
+    p.add_argument(
+        "--style",
+        choices=sorted(STYLES),
+        default="regular",
+        help="Style of this variant in the font container (default: regular)",
+    )
 
     args = p.parse_args(argv)
 
@@ -314,6 +346,13 @@ def main(argv=None):
                         )
 
         yadvance = args.size + 2
+        kerning = (
+            extract_kerning(ttf_path, codes, args.size, variations)
+            if args.kerning
+            else []
+        )
+        if kerning:
+            print(f"Exported {len(kerning)} kerning pairs")
         write_header_from_data(
             args.name,
             args.out,
@@ -324,7 +363,25 @@ def main(argv=None):
             bitmap_msb_all,
             yadvance,
             grayscale=args.grayscale,
+            compress=args.compress,
+            kerning=kerning,
         )
+        if args.bin_out:
+            write_font_container(
+                args.bin_out,
+                args.family or args.name,
+                args.size,
+                args.style,
+                codes,
+                glyphs,
+                bitmap_all,
+                bitmap_lsb_all,
+                bitmap_msb_all,
+                yadvance,
+                grayscale=args.grayscale,
+                compress=args.compress,
+                kerning=kerning,
+            )
         # optional preview: render a combined image showing BW and grayscale side-by-side
         if args.preview_output:
             if args.grayscale:
@@ -442,7 +499,23 @@ def main(argv=None):
             bitmap_msb_all,
             yadvance,
             grayscale=args.grayscale,
+            compress=args.compress,
         )
+        if args.bin_out:
+            write_font_container(
+                args.bin_out,
+                args.family or args.name,
+                args.size,
+                args.style,
+                codes,
+                glyphs,
+                bitmap_all,
+                bitmap_lsb_all,
+                bitmap_msb_all,
+                yadvance,
+                grayscale=args.grayscale,
+                compress=args.compress,
+            )
 
         if args.preview_output:
             if args.grayscale:
@@ -0,0 +1,144 @@
+"""Kerning pair extraction for generate_simplefont.
+
+Reads horizontal kerning from the GPOS 'kern' feature (pair adjustment
+lookups, glyph and class based) or, if the font has none, from the legacy
+'kern' table. Values are scaled to pixels at the requested size and only
+pairs between exported characters that survive rounding are kept.
+"""
+
+from typing import Dict, List, Optional, Tuple
+
+from fontTools.ttLib import TTFont
+
+
+def _load_font(ttf_path: str, variations: Optional[Dict[str, float]]) -> TTFont:
+    font = TTFont(ttf_path)
+    if variations and "fvar" in font:
+        # Resolve variation deltas so kerning matches the rendered instance
+        from fontTools.varLib import instancer
+
+        font = instancer.instantiateVariableFont(font, dict(variations))
+    return font
+
+
+def _pair_lookups(gpos):
+    """Yield the PairPos subtables of all lookups referenced by the 'kern' feature."""
+    if not gpos.FeatureList or not gpos.LookupList:
+        return
+    lookup_ids = set()
+    for record in gpos.FeatureList.FeatureRecord:
+        if record.FeatureTag == "kern":
+            lookup_ids.update(record.Feature.LookupListIndex)
+    for lookup_id in sorted(lookup_ids):
+        lookup = gpos.LookupList.Lookup[lookup_id]
+        subtables = []
+        for sub in lookup.SubTable:
+            # Extension lookups (type 9) wrap the real subtable
+            if lookup.LookupType == 9:
+                sub = sub.ExtSubTable
+            if sub.LookupType == 2:
+                subtables.append(sub)
+        yield subtables
+
+
+def _x_advance(value) -> int:
+    if value is None:
+        return 0
+    return getattr(value, "XAdvance", 0) or 0
+
+
+def _gpos_pairs(font: TTFont, glyph_names: List[str]) -> Dict[Tuple[str, str], int]:
+    wanted = set(glyph_names)
+    pairs: Dict[Tuple[str, str], int] = {}
+    for subtables in _pair_lookups(font["GPOS"].table):
+        # Within one lookup the first subtable covering a pair wins
+        seen = set()
+        for sub in subtables:
+            coverage = sub.Coverage.glyphs
+            if sub.Format == 1:
+                for first, pair_set in zip(coverage, sub.PairSet):
+                    if first not in wanted:
+                        continue
+                    for rec in pair_set.PairValueRecord:
+                        key = (first, rec.SecondGlyph)
+                        if rec.SecondGlyph not in wanted or key in seen:
+                            continue
+                        seen.add(key)
+                        pairs[key] = pairs.get(key, 0) + _x_advance(rec.Value1)
+            elif sub.Format == 2:
+                class1 = sub.ClassDef1.classDefs if sub.ClassDef1 else {}
+                class2 = sub.ClassDef2.classDefs if sub.ClassDef2 else {}
+                for first in coverage:
+                    if first not in wanted:
+                        continue
+                    row = sub.Class1Record[class1.get(first, 0)].Class2Record
+                    for second in glyph_names:
+                        key = (first, second)
+                        if key in seen:
+                            continue
+                        seen.add(key)
+                        value = _x_advance(row[class2.get(second, 0)].Value1)
+                        if value:
+                            pairs[key] = pairs.get(key, 0) + value
+    return pairs
+
+
+def _legacy_pairs(font: TTFont, glyph_names: List[str]) -> Dict[Tuple[str, str], int]:
+    wanted = set(glyph_names)
+    pairs: Dict[Tuple[str, str], int] = {}
+    for sub in font["kern"].kernTables:
+        if getattr(sub, "format", 0) != 0:
+            continue
+        for (first, second), value in sub.kernTable.items():
+            if first in wanted and second in wanted:
+                pairs[(first, second)] = pairs.get((first, second), 0) + value
+    return pairs
+
+
+def extract_kerning(
+    ttf_path: str,
+    codes: List[int],
+    size: int,
+    variations: Optional[Dict[str, float]] = None,
+) -> List[Tuple[int, int, int]]:
+    """Return (left codepoint, right codepoint, pixel adjustment) for all non-zero pairs."""
+    font = _load_font(ttf_path, variations)
+    cmap = font.getBestCmap() or {}
+    name_to_code = {}
+    for code in codes:
+        name = cmap.get(code)
+        if name is not None and name not in name_to_code:
+            name_to_code[name] = code
+    glyph_names = list(name_to_code)
+
+    if "GPOS" in font:
+        raw = _gpos_pairs(font, glyph_names)
+    elif "kern" in font:
+        raw = _legacy_pairs(font, glyph_names)
+    else:
+        raw = {}
+
+    scale = size / font["head"].unitsPerEm
+    result = []
+    for (first, second), value in raw.items():
+        px = int(round(value * scale))
+        if px == 0:
+            continue
+        px = max(-128, min(127, px))
+        result.append((name_to_code[first], name_to_code[second], px))
+    result.sort()
+    return result
+
+
+def kerning_to_glyph_indices(
+    codes: List[int], pairs: List[Tuple[int, int, int]]
+) -> List[Tuple[int, int, int]]:
+    """Map codepoint pairs to glyph indices (position in the codepoint-sorted glyph table)."""
+    index = {code: i for i, code in enumerate(sorted(codes))}
+    mapped = [
+        (index[left], index[right], adjust)
+        for left, right, adjust in pairs
+        if left in index and right in index
+    ]
+    mapped.sort()
+    return mapped
@@ -1,13 +1,32 @@
 """Header generation for SimpleGFXfont from glyph and bitmap data."""
 
 import os
-from typing import List, Tuple
+from typing import List, Optional, Tuple
 from .bitmap_utils import (
     bytes_per_row,
+    encode_glyph_rle,
     format_c_byte_list,
     format_c_code_list,
     gen_bitmap_bytes,
+    glyph_symbols,
 )
+from .kerning import kerning_to_glyph_indices
+
+
+def _kerning_c(
+    font_name: str, chars: List[int], kerning: Optional[List[Tuple[int, int, int]]]
+) -> Tuple[str, str]:
+    """Return (kerning array definition, initializer fields) for the font struct."""
+    pairs = kerning_to_glyph_indices(chars, kerning or [])
+    if not pairs:
+        return "", "nullptr, 0"
+    entries = [f"{{{left}, {right}, {adjust}}}" for left, right, adjust in pairs]
+    lines = [
+        "    " + ", ".join(entries[i : i + 8]) for i in range(0, len(entries), 8)
+    ]
+    body = ",\n".join(lines)
+    array = f"\nconst SimpleGFXkernPair {font_name}Kerning[] PROGMEM = {{\n{body}\n}};\n\n"
+    return array, f"{font_name}Kerning, {len(pairs)}"
 
 
 def generate_header(
@@ -154,7 +173,24 @@ def write_header_from_data(
     bitmap_msb_all: List[int],
     yadvance: int,
     grayscale: bool = True,
+    compress: bool = False,
+    kerning: Optional[List[Tuple[int, int, int]]] = None,
 ):
+    if compress:
+        write_compressed_header_from_data(
+            font_name,
+            out_path,
+            chars,
+            glyphs,
+            bitmap_all,
+            bitmap_lsb_all if grayscale else [],
+            bitmap_msb_all if grayscale else [],
+            yadvance,
+            grayscale=grayscale,
+            kerning=kerning,
+        )
+        return
+
     bmp_lines = []
     bmp_lsb_lines = []
     bmp_msb_lines = []
@@ -210,15 +246,93 @@ const uint8_t {font_name}Bitmaps[] PROGMEM = {{
         f"\nconst SimpleGFXglyph {font_name}Glyphs[] PROGMEM = {{\n{glyphs_c}\n}};\n\n"
     )
 
+    # Kerning pairs (by glyph index) follow yAdvance in the font struct
+    kern_array, kern_init = _kerning_c(font_name, chars, kerning)
+    header += kern_array
+    metrics = f"{count}, {yadvance}" if not kern_array else f"{count}, {yadvance}, {kern_init}"
+
     if grayscale:
-        header += f"\nconst SimpleGFXfont {font_name} PROGMEM = {{{font_name}Bitmaps, {font_name}Bitmaps_lsb, {font_name}Bitmaps_msb, {font_name}Glyphs,\n    {count}, {yadvance}}};\n"
+        header += f"\nconst SimpleGFXfont {font_name} PROGMEM = {{{font_name}Bitmaps, {font_name}Bitmaps_lsb, {font_name}Bitmaps_msb, {font_name}Glyphs,\n    {metrics}}};\n"
     else:
         header += (
             f"\nconst SimpleGFXfont {font_name} PROGMEM = {{{font_name}Bitmaps, nullptr, nullptr, {font_name}Glyphs,\n"
-            f"    {count}, {yadvance}}};\n"
+            f"    {metrics}}};\n"
         )
 
     os.makedirs(os.path.dirname(out_path), exist_ok=True)
     with open(out_path, "w", encoding="utf-8", newline="\n") as f:
         f.write(header)
     print(f"Wrote {out_path}")
+
+
+def write_compressed_header_from_data(
+    font_name: str,
+    out_path: str,
+    chars: List[int],
+    glyphs: List[dict],
+    bitmap_all: List[int],
+    bitmap_lsb_all: List[int],
+    bitmap_msb_all: List[int],
+    yadvance: int,
+    grayscale: bool = True,
+    kerning: Optional[List[Tuple[int, int, int]]] = None,
+):
+    """Write a GlyphFormat::RLE header: one packed stream per glyph instead of three planes."""
+    bmp_lines = []
+    glyph_lines = []
+    offset = 0
+    planar_size = 0
+    for idx, ch in enumerate(chars):
+        g = glyphs[idx]
+        symbols = glyph_symbols(
+            g["width"],
+            g["height"],
+            g["bitmapOffset"],
+            bitmap_all,
+            bitmap_lsb_all,
+            bitmap_msb_all,
+        )
+        stream = encode_glyph_rle(symbols)
+        display = chr(ch)
+        comment = f"// 0x{ch:X} '{display}'"
+        if stream:
+            bmp_lines.append(f"    {comment}\n{format_c_byte_list(stream)}")
+        glyph_lines.append(
+            f"    {{{offset}, 0x{ch:X}, {g['width']}, {g['height']}, {g['xAdvance']}, {g['xOffset']}, {g['yOffset']}}}"
+        )
+        offset += len(stream)
+        planar_size += bytes_per_row(g["width"]) * g["height"] * (3 if grayscale else 1)
+
+    # Keep the array non-empty so the header compiles even for all-blank fonts
+    bmp_c = ",\n".join(bmp_lines) if bmp_lines else "    0x00"
+    glyphs_c = ",\n".join(glyph_lines)
+    count = len(chars)
+    gray_ptr = f"{font_name}Bitmaps" if grayscale else "nullptr"
+
+    header = f"""#pragma once
+#include <Arduino.h>
+#include "rendering/SimpleFont.h"
+
+// Generated by generate_simplefont.py
+// Font: {font_name}
+// RLE compressed: {offset} bytes (planar: {planar_size} bytes)
+
+const uint8_t {font_name}Bitmaps[] PROGMEM = {{
+{bmp_c}
+}};
+
+"""
+    header += (
+        f"\nconst SimpleGFXglyph {font_name}Glyphs[] PROGMEM = {{\n{glyphs_c}\n}};\n\n"
+    )
+    kern_array, kern_init = _kerning_c(font_name, chars, kerning)
+    header += kern_array
+    header += (
+        f"\nconst SimpleGFXfont {font_name} PROGMEM = {{{font_name}Bitmaps, {gray_ptr}, {gray_ptr}, {font_name}Glyphs,\n"
+        f"    {count}, {yadvance}, {kern_init}, GlyphFormat::RLE}};\n"
+    )
+
+    os.makedirs(os.path.dirname(out_path), exist_ok=True)
+    with open(out_path, "w", encoding="utf-8", newline="\n") as f:
+        f.write(header)
+    print(f"Wrote {out_path} (RLE {offset} bytes, planar {planar_size} bytes)")
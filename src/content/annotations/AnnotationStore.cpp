@@ -0,0 +1,335 @@
+#include "AnnotationStore.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "../../core/BufferedFileWriter.h"
+#include "../../lib/miniz.h"
+
+static const char STORE_MAGIC[] = "MRAN";
+static const uint8_t STORE_VERSION = 1;
+static const size_t CRC_SIZE = 4;
+static const size_t READ_RECORDS = 32;  // Records per read when streaming the file
+
+static void putU32(uint8_t* out, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    out[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+String AnnotationStore::pathFor(const String& bookPath) {
+  return bookPath + ".ann";
+}
+
+void AnnotationStore::open(const String& bookPath) {
+  close();
+  path_ = pathFor(bookPath);
+}
+
+void AnnotationStore::close() {
+  path_ = String("");
+  checked_ = false;
+  count_ = 0;
+  loadedChapter_ = -1;
+  chapter_.clear();
+  maxSpan_ = 0;
+}
+
+bool AnnotationStore::less(const Annotation& a, const Annotation& b) {
+  if (a.chapter != b.chapter)
+    return a.chapter < b.chapter;
+  if (a.start != b.start)
+    return a.start < b.start;
+  if (a.end != b.end)
+    return a.end < b.end;
+  return a.type < b.type;
+}
+
+bool AnnotationStore::same(const Annotation& a, const Annotation& b) {
+  return a.chapter == b.chapter && a.type == b.type && a.start == b.start && a.end == b.end;
+}
+
+void AnnotationStore::encode(const Annotation& a, uint8_t* out) {
+  out[0] = (uint8_t)a.chapter;
+  out[1] = (uint8_t)(a.chapter >> 8);
+  out[2] = a.type;
+  out[3] = 0;
+  putU32(out + 4, a.start);
+  putU32(out + 8, a.end);
+}
+
+void AnnotationStore::decode(const uint8_t* in, Annotation& a) {
+  a.chapter = (uint16_t)(in[0] | (in[1] << 8));
+  a.type = in[2];
+  a.start = getU32(in + 4);
+  a.end = getU32(in + 8);
+}
+
+bool AnnotationStore::isValidFile(const String& path, uint32_t& count) {
+  File in = SD.open(path.c_str());
+  if (!in)
+    return false;
+  uint8_t buf[READ_RECORDS * RECORD_SIZE];
+  bool ok = in.read(buf, HEADER_SIZE) == HEADER_SIZE && memcmp(buf, STORE_MAGIC, 4) == 0 && buf[4] == STORE_VERSION;
+  if (ok) {
+    count = getU32(buf + 8);
+    ok = (uint64_t)in.size() == HEADER_SIZE + (uint64_t)count * RECORD_SIZE + CRC_SIZE;
+  }
+  if (ok) {
+    mz_ulong crc = mz_crc32(MZ_CRC32_INIT, buf, HEADER_SIZE);
+    size_t remaining = (size_t)count * RECORD_SIZE;
+    while (ok && remaining > 0) {
+      size_t n = remaining < sizeof(buf) ? remaining : sizeof(buf);
+      ok = in.read(buf, n) == n;
+      crc = mz_crc32(crc, buf, n);
+      remaining -= n;
+    }
+    ok = ok && in.read(buf, CRC_SIZE) == CRC_SIZE && getU32(buf) == (uint32_t)crc;
+  }
+  in.close();
+  return ok;
+}
+
+bool AnnotationStore::ensureChecked() {
+  if (!isOpen())
+    return false;
+  if (checked_)
+    return true;
+  checked_ = true;
+  count_ = 0;
+
+  uint32_t count = 0;
+  if (isValidFile(path_, count)) {
+    count_ = count;
+    return true;
+  }
+
+  // Interrupted between removing the old file and renaming its replacement
+  String tmpPath = path_ + ".tmp";
+  if (isValidFile(tmpPath, count)) {
+    SD.remove(path_.c_str());
+    if (SD.rename(tmpPath.c_str(), path_.c_str())) {
+      Serial.printf("AnnotationStore: recovered %s\n", path_.c_str());
+      count_ = count;
+      return true;
+    }
+  }
+  if (SD.exists(path_.c_str()))
+    Serial.printf("AnnotationStore: ignoring damaged %s\n", path_.c_str());
+  return true;
+}
+
+bool AnnotationStore::loadChapter(int chapter) {
+  if (chapter == loadedChapter_)
+    return true;
+  loadedChapter_ = chapter;
+  chapter_.clear();
+  maxSpan_ = 0;
+  if (count_ == 0)
+    return true;
+
+  File in = SD.open(path_.c_str());
+  if (!in)
+    return false;
+
+  // First record of the chapter: the records have a fixed size, so the file is searched in place
+  uint8_t buf[READ_RECORDS * RECORD_SIZE];
+  Annotation a;
+  uint32_t lo = 0;
+  uint32_t hi = count_;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (!in.seek(HEADER_SIZE + (size_t)mid * RECORD_SIZE) || in.read(buf, RECORD_SIZE) != RECORD_SIZE) {
+      in.close();
+      return false;
+    }
+    decode(buf, a);
+    if (a.chapter < chapter)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  // Its records follow in order
+  bool ok = in.seek(HEADER_SIZE + (size_t)lo * RECORD_SIZE);
+  bool done = false;
+  while (ok && !done && lo < count_) {
+    size_t n = count_ - lo < READ_RECORDS ? count_ - lo : READ_RECORDS;
+    ok = in.read(buf, n * RECORD_SIZE) == n * RECORD_SIZE;
+    for (size_t i = 0; ok && i < n; i++) {
+      decode(buf + i * RECORD_SIZE, a);
+      if (a.chapter != chapter) {
+        done = true;
+        break;
+      }
+      chapter_.push_back(a);
+      if (a.end > a.start && a.end - a.start > maxSpan_)
+        maxSpan_ = a.end - a.start;
+    }
+    lo += n;
+  }
+  in.close();
+  return ok;
+}
+
+void AnnotationStore::query(int chapter, uint32_t from, uint32_t to, std::vector<Annotation>& out) {
+  if (chapter < 0 || chapter > 0xFFFF || !ensureChecked() || !loadChapter(chapter) || chapter_.empty())
+    return;
+
+  // No range starting before from - maxSpan reaches from
+  uint32_t first = from > maxSpan_ ? from - maxSpan_ : 0;
+  auto it = std::lower_bound(chapter_.begin(), chapter_.end(), first,
+                             [](const Annotation& a, uint32_t start) { return a.start < start; });
+  for (; it != chapter_.end() && it->start < to; ++it) {
+    uint32_t end = it->end > it->start ? it->end : it->start + 1;
+    if (end > from)
+      out.push_back(*it);
+  }
+}
+
+uint32_t AnnotationStore::getCount() {
+  ensureChecked();
+  return count_;
+}
+
+bool AnnotationStore::add(const Annotation& annotation) {
+  if (!ensureChecked() || !loadChapter(annotation.chapter))
+    return false;
+  auto it = std::lower_bound(chapter_.begin(), chapter_.end(), annotation, less);
+  if (it != chapter_.end() && same(*it, annotation))
+    return true;
+  return rewrite(&annotation, nullptr);
+}
+
+bool AnnotationStore::remove(const Annotation& annotation) {
+  if (!ensureChecked() || !loadChapter(annotation.chapter))
+    return false;
+  auto it = std::lower_bound(chapter_.begin(), chapter_.end(), annotation, less);
+  if (it == chapter_.end() || !same(*it, annotation))
+    return false;
+  return rewrite(nullptr, &annotation);
+}
+
+bool AnnotationStore::toggleBookmark(int chapter, uint32_t from, uint32_t to, bool& bookmarked) {
+  bookmarked = false;
+  if (chapter < 0 || chapter > 0xFFFF)
+    return false;
+  std::vector<Annotation> found;
+  query(chapter, from, to, found);
+  bool hadBookmark = false;
+  for (const Annotation& a : found) {
+    if (a.type != BOOKMARK)
+      continue;
+    hadBookmark = true;
+    if (!remove(a)) {
+      bookmarked = true;
+      return false;
+    }
+  }
+  if (hadBookmark)
+    return true;
+  Annotation bookmark = {(uint16_t)chapter, BOOKMARK, from, from};
+  bookmarked = add(bookmark);
+  return bookmarked;
+}
+
+bool AnnotationStore::rewrite(const Annotation* insert, const Annotation* erase) {
+  String tmpPath = path_ + ".tmp";
+  SD.remove(tmpPath.c_str());
+  File out = SD.open(tmpPath.c_str(), FILE_WRITE);
+  if (!out) {
+    Serial.printf("AnnotationStore: cannot create %s\n", tmpPath.c_str());
+    return false;
+  }
+
+  uint32_t count = count_ + (insert ? 1 : 0) - (erase ? 1 : 0);
+  bool ok;
+  {
+    BufferedFileWriter writer(out, BufferedFileWriter::SMALL_BLOCK_SIZE);
+    mz_ulong crc = MZ_CRC32_INIT;
+    auto emit = [&writer, &crc](const uint8_t* data, size_t length) {
+      writer.write((const char*)data, length);
+      crc = mz_crc32(crc, data, length);
+    };
+
+    uint8_t record[RECORD_SIZE];
+    uint8_t header[HEADER_SIZE] = {};
+    memcpy(header, STORE_MAGIC, 4);
+    header[4] = STORE_VERSION;
+    putU32(header + 8, count);
+    emit(header, HEADER_SIZE);
+
+    // Merge the change into the old records, which are already in order
+    bool inserted = insert == nullptr;
+    bool erased = erase == nullptr;
+    ok = true;
+    File in;
+    if (count_ > 0) {
+      in = SD.open(path_.c_str());
+      ok = in && in.seek(HEADER_SIZE);
+    }
+    uint8_t buf[READ_RECORDS * RECORD_SIZE];
+    for (uint32_t i = 0; ok && i < count_;) {
+      size_t n = count_ - i < READ_RECORDS ? count_ - i : READ_RECORDS;
+      ok = in.read(buf, n * RECORD_SIZE) == n * RECORD_SIZE;
+      for (size_t j = 0; ok && j < n; j++) {
+        Annotation a;
+        decode(buf + j * RECORD_SIZE, a);
+        if (!inserted && less(*insert, a)) {
+          encode(*insert, record);
+          emit(record, RECORD_SIZE);
+          inserted = true;
+        }
+        if (!erased && same(a, *erase)) {
+          erased = true;
+          continue;
+        }
+        emit(buf + j * RECORD_SIZE, RECORD_SIZE);
+      }
+      i += n;
+    }
+    if (in)
+      in.close();
+    if (!inserted) {
+      encode(*insert, record);
+      emit(record, RECORD_SIZE);
+    }
+
+    uint8_t trailer[CRC_SIZE];
+    putU32(trailer, (uint32_t)crc);
+    writer.write((const char*)trailer, CRC_SIZE);
+    ok = ok && erased && writer.flush();
+  }
+  out.close();
+
+  if (!ok) {
+    SD.remove(tmpPath.c_str());
+    return false;
+  }
+  SD.remove(path_.c_str());
+  if (!SD.rename(tmpPath.c_str(), path_.c_str())) {
+    Serial.printf("AnnotationStore: cannot rename %s\n", tmpPath.c_str());
+    return false;
+  }
+  count_ = count;
+
+  // Keep the loaded chapter in step with the file
+  const Annotation* changed = insert ? insert : erase;
+  if (changed->chapter == loadedChapter_) {
+    auto it = std::lower_bound(chapter_.begin(), chapter_.end(), *changed, less);
+    if (insert)
+      chapter_.insert(it, *insert);
+    else
+      chapter_.erase(it);
+    maxSpan_ = 0;
+    for (const Annotation& a : chapter_) {
+      if (a.end > a.start && a.end - a.start > maxSpan_)
+        maxSpan_ = a.end - a.start;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,99 @@
+#ifndef ANNOTATION_STORE_H
+#define ANNOTATION_STORE_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A bookmark or a highlighted range in one chapter, in provider positions (byte offsets in the chapter's text)
+struct Annotation {
+  uint16_t chapter;
+  uint8_t type;    // AnnotationStore::Type
+  uint32_t start;  // First position
+  uint32_t end;    // Position after the range; equal to start for bookmarks
+};
+
+/**
+ * AnnotationStore - per-book bookmarks and highlights on the SD card
+ *
+ * The annotations of a book live next to it as "<book>.ann", sorted by
+ * (chapter, start, end):
+ *
+ *   "MRAN" u8 version, 3 reserved, u32 count
+ *   count x { u16 chapter, u8 type, u8 reserved, u32 start, u32 end }
+ *   u32 CRC-32 of everything before it
+ *
+ * All values are little-endian. Nothing is read until the first query; then
+ * the file is checked once (size and CRC), and only the records of the
+ * chapter being read are kept in RAM, found with a binary search over the
+ * fixed-size records in the file. A query for the positions of a page is a
+ * binary search over that chapter's records, started maxSpan before the
+ * page so that ranges beginning on an earlier page are found too; page
+ * turns inside a chapter touch neither the card nor more than the
+ * overlapping records.
+ *
+ * Changes rewrite the file as "<book>.ann.tmp", then replace the old file
+ * with it, so that a reset or deep sleep at any point leaves either the old
+ * or the new file complete. When the old file was already removed but the
+ * rename did not happen, the next check adopts the temporary file.
+ */
+class AnnotationStore {
+ public:
+  enum Type : uint8_t { BOOKMARK = 0, HIGHLIGHT = 1, UNDERLINE = 2 };
+
+  static const size_t HEADER_SIZE = 12;
+  static const size_t RECORD_SIZE = 12;
+
+  AnnotationStore() {}
+
+  // Use the annotations of the book at bookPath; nothing is read yet
+  void open(const String& bookPath);
+  void close();
+  bool isOpen() const {
+    return path_.length() > 0;
+  }
+
+  // Append the annotations of chapter overlapping the positions [from, to) to out, sorted by start. A bookmark
+  // overlaps when its position is in the range.
+  void query(int chapter, uint32_t from, uint32_t to, std::vector<Annotation>& out);
+
+  // Add an annotation (an identical one is not added twice); false if the file cannot be written
+  bool add(const Annotation& annotation);
+  // Remove an identical annotation; false if there is none or the file cannot be written
+  bool remove(const Annotation& annotation);
+
+  // Remove the bookmarks of chapter in [from, to), or, if there are none, add one at from. bookmarked tells
+  // whether the range has a bookmark afterwards; false if the file cannot be written.
+  bool toggleBookmark(int chapter, uint32_t from, uint32_t to, bool& bookmarked);
+
+  // Annotations in the whole book
+  uint32_t getCount();
+
+  // Store file of the book at bookPath
+  static String pathFor(const String& bookPath);
+
+ private:
+  static bool less(const Annotation& a, const Annotation& b);
+  static bool same(const Annotation& a, const Annotation& b);
+  static void encode(const Annotation& a, uint8_t* out);
+  static void decode(const uint8_t* in, Annotation& a);
+
+  bool ensureChecked();
+  bool isValidFile(const String& path, uint32_t& count);
+  bool loadChapter(int chapter);
+  bool rewrite(const Annotation* insert, const Annotation* erase);
+
+  String path_;
+  bool checked_ = false;
+  uint32_t count_ = 0;
+
+  // Records of one chapter, sorted
+  int loadedChapter_ = -1;
+  std::vector<Annotation> chapter_;
+  uint32_t maxSpan_ = 0;  // Longest end - start in chapter_
+};
+
+#endif
@@ -6,6 +6,8 @@
 #include <filesystem>
 #endif
 
+#include "../../core/HeapTelemetry.h"
+#include "../../core/JournalStore.h"
 #include "../xml/SimpleXmlParser.h"
 
 // Helper function for case-insensitive string comparison
@@ -40,7 +42,9 @@ static void log_memory(const char* where) {
   uint32_t freeHeap = ESP.getFreeHeap();
   uint32_t heapSize = ESP.getHeapSize();
   uint32_t minFree = ESP.getMinFreeHeap();
-  Serial.printf("  [MEM] %s: Free=%u, Total=%u, MinFree=%u\n", where, freeHeap, heapSize, minFree);
+  uint32_t maxBlock = ESP.getMaxAllocHeap();
+  Serial.printf("  [MEM] %s: Free=%u, Total=%u, MinFree=%u, MaxBlock=%u\n", where, freeHeap, heapSize, minFree,
+                maxBlock);
 }
 
 // File handle for extraction callback
@@ -48,8 +52,15 @@ static File g_extract_file;
 
 // Metadata filename and current extract version. Update `CURRENT_EXTRACT_VERSION`
 // whenever conversion/extraction format changes to force a cache reset.
-static const char* EXTRACT_META_FILENAME = "epub_meta.txt";
-static const char* CURRENT_EXTRACT_VERSION = "11";
+static const char* EXTRACT_META_FILENAME = "epub_meta.jnl";  // JournalStore: version, filesize
+static const char* CURRENT_EXTRACT_VERSION = "12";
+
+// Parent of the per-book extract directories
+#ifdef TEST_BUILD
+static String g_extract_root = "test/output";
+#else
+static String g_extract_root = "/microreader";
+#endif
 
 // Callback to write extracted data to SD card file
 static int extract_to_file_callback(const void* data, size_t size, void* user_data) {
@@ -83,6 +94,7 @@ EpubReader::EpubReader(const char* epubPath, bool cleanCacheOnStart)
       spineCount_(0),
       cleanCacheOnStart_(cleanCacheOnStart),
       language_("en") {
+  HEAP_SUBSYSTEM(EPUB);
   Serial.printf("\n=== EpubReader: Opening %s ===\n", epubPath);
 
   // measure start time
@@ -104,24 +116,7 @@ EpubReader::EpubReader(const char* epubPath, bool cleanCacheOnStart)
   log_memory("constructor: after verify");
 
   // Create extraction directory based on EPUB filename
-  String epubFilename = String(epubPath);
-  int lastSlash = epubFilename.lastIndexOf('/');
-  if (lastSlash < 0) {
-    lastSlash = epubFilename.lastIndexOf('\\');
-  }
-  if (lastSlash >= 0) {
-    epubFilename = epubFilename.substring(lastSlash + 1);
-  }
-  int lastDot = epubFilename.lastIndexOf('.');
-  if (lastDot >= 0) {
-    epubFilename = epubFilename.substring(0, lastDot);
-  }
-
-#ifdef TEST_BUILD
-  extractDir_ = "test/output/epub_" + epubFilename;
-#else
-  extractDir_ = "/microreader/epub_" + epubFilename;
-#endif
+  extractDir_ = extractDirFor(epubPath);
   Serial.printf("  Extract directory: %s\n", extractDir_.c_str());
 
   // Clean cache if requested
@@ -186,6 +181,15 @@ EpubReader::EpubReader(const char* epubPath, bool cleanCacheOnStart)
   unsigned long initMs = millis() - startTime;
   Serial.printf("  EpubReader init took  %lu ms\n", initMs);
   Serial.println("EpubReader initialized successfully");
+  HEAP_CHECKPOINT("epub open");
+}
+
+void EpubReader::setExtractRoot(const char* root) {
+  g_extract_root = root;
+}
+
+const char* EpubReader::getExtractVersion() {
+  return CURRENT_EXTRACT_VERSION;
 }
 
 EpubReader::~EpubReader() {
@@ -248,111 +252,67 @@ bool EpubReader::ensureExtractDirExists() {
 bool EpubReader::checkAndUpdateExtractMeta() {
   String metaPath = getExtractedPath(EXTRACT_META_FILENAME);
 
-  // If meta exists, read version and compare
-  if (SD.exists(metaPath.c_str())) {
-    File f = SD.open(metaPath.c_str());
-    if (f) {
-      String contents = "";
-      while (f.available()) {
-        contents += (char)f.read();
-      }
-      f.close();
-
-      int pos = contents.indexOf("version=");
-      if (pos >= 0) {
-        int eol = contents.indexOf('\n', pos);
-        String ver;
-        if (eol >= 0)
-          ver = contents.substring(pos + 8, eol);
-        else
-          ver = contents.substring(pos + 8);
-        ver.trim();
-
-        // Parse filesize
-        bool filesizeMatches = false;
-        size_t metaFileSize = 0;
-        int posSize = contents.indexOf("filesize=");
-        if (posSize >= 0) {
-          int eolSize = contents.indexOf('\n', posSize);
-          String szStr;
-          if (eolSize >= 0)
-            szStr = contents.substring(posSize + 9, eolSize);
-          else
-            szStr = contents.substring(posSize + 9);
-          szStr.trim();
-          // Check if string is empty or invalid before parsing
-          if (szStr.length() > 0 && szStr.charAt(0) >= '0' && szStr.charAt(0) <= '9') {
-            metaFileSize = (size_t)szStr.toInt();
-            filesizeMatches = (metaFileSize == epubFileSize_);
-          } else {
-            Serial.println("  Extract meta has invalid 'filesize' value - clearing cache");
-          }
-        } else {
-          Serial.println("  Extract meta missing 'filesize' entry - clearing cache");
-        }
-
-        if (ver == CURRENT_EXTRACT_VERSION && filesizeMatches) {
-          // Meta matches; nothing to do
-          return true;
-        }
-        if (ver != CURRENT_EXTRACT_VERSION) {
-          Serial.printf("  Extract meta version mismatch: found=%s expected=%s - clearing cache\n", ver.c_str(),
-                        CURRENT_EXTRACT_VERSION);
-        } else {
-          Serial.printf("  Extract meta filesize mismatch: found=%u expected=%u - clearing cache\n",
-                        (unsigned)metaFileSize, (unsigned)epubFileSize_);
-        }
-        // Remove entire extract dir to ensure clean state
-        cleanExtractDir();
-        // Recreate directory
-        if (!SD.mkdir(extractDir_.c_str())) {
-          Serial.printf("ERROR: Failed to recreate extract directory %s after cleaning\n", extractDir_.c_str());
-          return false;
-        }
-      } else {
-        Serial.println("  Extract meta missing 'version' entry - clearing cache");
-        cleanExtractDir();
-        if (!SD.mkdir(extractDir_.c_str())) {
-          Serial.printf("ERROR: Failed to recreate extract directory %s after cleaning\n", extractDir_.c_str());
-          return false;
-        }
-      }
+  // If meta exists, compare its version and the EPUB size it was extracted from
+  {
+    JournalStore meta(metaPath);
+    String ver;
+    String size;
+    if (!meta.load()) {
+      // Meta file missing - clear cache to start fresh
+      Serial.printf("  Extract meta file not found (%s) - clearing cache\n", metaPath.c_str());
+    } else if (!meta.get("version", ver)) {
+      Serial.println("  Extract meta missing 'version' entry - clearing cache");
+    } else if (!meta.get("filesize", size)) {
+      Serial.println("  Extract meta missing 'filesize' entry - clearing cache");
+    } else if (size.length() == 0 || size.charAt(0) < '0' || size.charAt(0) > '9') {
+      Serial.println("  Extract meta has invalid 'filesize' value - clearing cache");
+    } else if (ver != CURRENT_EXTRACT_VERSION) {
+      Serial.printf("  Extract meta version mismatch: found=%s expected=%s - clearing cache\n", ver.c_str(),
+                    CURRENT_EXTRACT_VERSION);
+    } else if ((size_t)size.toInt() != epubFileSize_) {
+      Serial.printf("  Extract meta filesize mismatch: found=%s expected=%u - clearing cache\n", size.c_str(),
+                    (unsigned)epubFileSize_);
     } else {
-      Serial.printf("  WARNING: Could not open meta file %s for reading - clearing cache\n", metaPath.c_str());
-      // If we couldn't open the meta file, treat as missing and clear cache
-      cleanExtractDir();
-      if (!SD.mkdir(extractDir_.c_str())) {
-        Serial.printf("ERROR: Failed to recreate extract directory %s after cleaning\n", extractDir_.c_str());
-        return false;
-      }
-    }
-  } else {
-    // Meta file missing - clear cache to start fresh
-    Serial.printf("  Extract meta file not found (%s) - clearing cache\n", metaPath.c_str());
-    cleanExtractDir();
-    if (!SD.mkdir(extractDir_.c_str())) {
-      Serial.printf("ERROR: Failed to recreate extract directory %s after cleaning\n", extractDir_.c_str());
-      return false;
+      // Meta matches; nothing to do
+      return true;
     }
   }
 
-  // Write meta file with current version and filesize
-  File out = SD.open(metaPath.c_str(), FILE_WRITE);
-  if (!out) {
+  // Remove entire extract dir to ensure clean state, then recreate it
+  cleanExtractDir();
+  if (!SD.mkdir(extractDir_.c_str())) {
+    Serial.printf("ERROR: Failed to recreate extract directory %s after cleaning\n", extractDir_.c_str());
+    return false;
+  }
+
+  // Write meta with current version and filesize, committed together
+  JournalStore meta(metaPath);
+  meta.set("version", CURRENT_EXTRACT_VERSION);
+  meta.set("filesize", String((unsigned long)epubFileSize_, 10));
+  if (!meta.commit()) {
     Serial.printf("ERROR: Failed to write extract meta file %s\n", metaPath.c_str());
     return false;
   }
-  out.print("version=");
-  out.print(CURRENT_EXTRACT_VERSION);
-  out.print("\n");
-  out.print("filesize=");
-  out.print(epubFileSize_);
-  out.print("\n");
-  out.close();
   Serial.printf("  Wrote extract metadata: %s\n", metaPath.c_str());
   return true;
 }
 
+String EpubReader::extractDirFor(const char* epubPath) {
+  String name = String(epubPath);
+  int lastSlash = name.lastIndexOf('/');
+  if (lastSlash < 0) {
+    lastSlash = name.lastIndexOf('\\');
+  }
+  if (lastSlash >= 0) {
+    name = name.substring(lastSlash + 1);
+  }
+  int lastDot = name.lastIndexOf('.');
+  if (lastDot >= 0) {
+    name = name.substring(0, lastDot);
+  }
+  return g_extract_root + "/epub_" + name;
+}
+
 // Recursively remove a directory using SD/File API on embedded target
 static void removeDirRecursive(const String& path) {
   File dir = SD.open(path.c_str());
@@ -540,6 +500,15 @@ String EpubReader::getChapterNameForSpine(int spineIndex) const {
   return String("");
 }
 
+int EpubReader::getSpineIndexForHref(const String& href) const {
+  for (int i = 0; i < spineCount_; i++) {
+    if (spine_[i].href == href) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 bool EpubReader::parseContainer() {
   // measure time taken
   unsigned long startTime = millis();
@@ -634,6 +603,7 @@ bool EpubReader::parseContentOpf() {
   // First pass: collect spine idrefs and toc id only. This avoids building a huge manifest
   unsigned long manifestStart = millis();
   String tocId = "";
+  String coverId = "";  // EPUB 2 <meta name="cover" content="..."/>
   const size_t MAX_MANIFEST_ENTRIES = 100;  // Safety cap to limit RAM usage when manifest is huge
   std::vector<String> spineIdrefs;
   const size_t MAX_SPINE_ENTRIES = 100;  // Safety cap on spine idrefs too
@@ -645,6 +615,8 @@ bool EpubReader::parseContentOpf() {
     if (nodeType == SimpleXmlParser::Element) {
       if (strcasecmp_helper(name, "spine")) {
         tocId = parser->getAttribute("toc");
+      } else if (strcasecmp_helper(name, "meta") && parser->getAttribute("name") == "cover") {
+        coverId = parser->getAttribute("content");
       } else if (strcasecmp_helper(name, "itemref")) {
         String idref = parser->getAttribute("idref");
         if (!idref.isEmpty()) {
@@ -676,6 +648,8 @@ bool EpubReader::parseContentOpf() {
   // Second pass: reopen content.opf and collect only manifest entries referenced by the spine
   // (plus CSS files and the toc entry). This limits RAM usage for large manifests.
   std::vector<ManifestItem> manifest;
+  String coverHref = "";
+  bool coverExact = false;
   if (!spineIdrefs.empty() || !tocId.isEmpty()) {
     // Re-open parser and scan manifest items. Allocate a fresh parser since the
     // original one was closed and deleted above.
@@ -705,6 +679,19 @@ bool EpubReader::parseContentOpf() {
           String href = parser->getAttribute("href");
           String mediaType = parser->getAttribute("media-type");
 
+          // Cover image: the EPUB 3 property or the EPUB 2 meta win over an image merely named "cover"
+          if (mediaType.indexOf("image/") == 0 && !href.isEmpty()) {
+            String lowerId = id;
+            lowerId.toLowerCase();
+            if (parser->getAttribute("properties").indexOf("cover-image") >= 0 || (!id.isEmpty() && id == coverId)) {
+              coverHref = href;
+              coverExact = true;
+            } else if (!coverExact && coverHref.isEmpty() && lowerId.indexOf("cover") >= 0) {
+              coverHref = href;
+            }
+            continue;
+          }
+
           // Collect CSS files regardless (we want to parse styles)
           if (mediaType.indexOf("css") >= 0) {
             if (!href.isEmpty()) {
@@ -747,6 +734,13 @@ bool EpubReader::parseContentOpf() {
     }
   }
 
+  // Cover path inside the archive, like the spine hrefs resolved against the content.opf folder
+  if (!coverHref.isEmpty()) {
+    int slash = contentOpfPath_.lastIndexOf('/');
+    coverPath_ = slash >= 0 ? contentOpfPath_.substring(0, slash + 1) + coverHref : coverHref;
+    Serial.printf("    Found cover image: %s\n", coverPath_.c_str());
+  }
+
   // Build spine
   spineCount_ = spineIdrefs.size();
   Serial.printf("  [MEM] before spine allocation: Free=%u, spineCount=%d\n", ESP.getFreeHeap(), spineCount_);
@@ -903,6 +897,34 @@ bool EpubReader::extractAll() {
   return true;
 }
 
+// Text of a metadata element with entities decoded and whitespace trimmed
+static String readMetadataText(SimpleXmlParser& parser) {
+  String text;
+  while (parser.hasMoreTextChars()) {
+    char c = parser.readTextNodeCharForward();
+    if (c == '\0')
+      continue;
+    if (c != '&') {
+      text += (c == '\n' || c == '\r' || c == '\t') ? ' ' : c;
+      continue;
+    }
+    char entity[12];
+    size_t length = 0;
+    entity[length++] = '&';
+    while (parser.hasMoreTextChars() && length < sizeof(entity)) {
+      entity[length++] = parser.readTextNodeCharForward();
+      if (entity[length - 1] == ';')
+        break;
+    }
+    char decoded[4];
+    size_t n = SimpleXmlParser::decodeEntity(entity, length, decoded);
+    for (size_t i = 0; i < (n ? n : length); i++)
+      text += n ? decoded[i] : entity[i];
+  }
+  text.trim();
+  return text;
+}
+
 bool EpubReader::parseMetadata() {
   unsigned long startTime = millis();
 
@@ -920,7 +942,9 @@ bool EpubReader::parseMetadata() {
     return false;
   }
 
+  // First dc:title, dc:creator and dc:language inside <metadata>
   bool inMetadata = false;
+  bool haveTitle = false, haveAuthor = false, haveLanguage = false;
   while (parser->read()) {
     SimpleXmlParser::NodeType nodeType = parser->getNodeType();
     String name = parser->getName();
@@ -928,26 +952,34 @@ bool EpubReader::parseMetadata() {
     if (nodeType == SimpleXmlParser::Element) {
       if (strcasecmp_helper(name, "metadata")) {
         inMetadata = true;
-      } else if (inMetadata && (name.indexOf("language") >= 0)) {
-        // Found language element, read the text content
-        if (parser->read() && parser->getNodeType() == SimpleXmlParser::Text) {
-          String lang = "";
-          while (parser->hasMoreTextChars()) {
-            char c = parser->readTextNodeCharForward();
-            if (c != '\0') {
-              lang += c;
-            }
-          }
-          lang.trim();
-          if (!lang.isEmpty()) {
-            language_ = lang;
-            Serial.printf("    Found language: %s\n", language_.c_str());
-          }
+        continue;
+      }
+      if (!inMetadata || parser->isEmptyElement())
+        continue;
+      int colon = name.indexOf(':');
+      String local = colon >= 0 ? name.substring(colon + 1) : name;
+      String* target = nullptr;
+      if (!haveTitle && strcasecmp_helper(local, "title")) {
+        target = &title_;
+        haveTitle = true;
+      } else if (!haveAuthor && strcasecmp_helper(local, "creator")) {
+        target = &author_;
+        haveAuthor = true;
+      } else if (!haveLanguage && strcasecmp_helper(local, "language")) {
+        target = &language_;
+        haveLanguage = true;
+      }
+      if (target && parser->read() && parser->getNodeType() == SimpleXmlParser::Text) {
+        String text = readMetadataText(*parser);
+        if (!text.isEmpty()) {
+          *target = text;
+          Serial.printf("    Found %s: %s\n", local.c_str(), text.c_str());
         }
-        break;  // Found language, can stop
       }
+      if (haveTitle && haveAuthor && haveLanguage)
+        break;
     } else if (nodeType == SimpleXmlParser::EndElement && strcasecmp_helper(name, "metadata")) {
-      inMetadata = false;
+      break;
     }
   }
 
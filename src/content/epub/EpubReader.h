@@ -34,6 +34,14 @@ class EpubReader {
   EpubReader(const char* epubPath, bool cleanCacheOnStart = false);
   ~EpubReader();
 
+  // Directory the per-book extract directories are created in ("/microreader" on the device).
+  // Applies to readers constructed afterwards; host tools point it into a prepared SD card tree.
+  static void setExtractRoot(const char* root);
+  // Version stamp written to epub_meta.jnl; a cache with another version is discarded on open
+  static const char* getExtractVersion();
+  // Extract directory a reader constructed now would use for the book at epubPath
+  static String extractDirFor(const char* epubPath);
+
   bool isValid() const {
     return valid_;
   }
@@ -87,6 +95,12 @@ class EpubReader {
    */
   String getChapterNameForSpine(int spineIndex) const;
 
+  /**
+   * Get the spine index of an XHTML file (href relative to content.opf, as in TocItem::href)
+   * Returns -1 if the file is not in the spine
+   */
+  int getSpineIndexForHref(const String& href) const;
+
   /**
    * Get the uncompressed file size for a spine item
    * Returns 0 if index is out of bounds
@@ -131,6 +145,23 @@ class EpubReader {
     return language_;
   }
 
+  /**
+   * Get the title and first author (dc:title, dc:creator); empty if the package has none
+   */
+  String getTitle() const {
+    return title_;
+  }
+  String getAuthor() const {
+    return author_;
+  }
+
+  /**
+   * Get the archive path of the cover image (for startStreaming()); empty if the book declares none
+   */
+  String getCoverPath() const {
+    return coverPath_;
+  }
+
   /**
    * Get the underlying epub_reader handle (for debugging/testing)
    */
@@ -179,6 +210,9 @@ class EpubReader {
   std::vector<String> cssFiles_;  // List of CSS file paths (relative to content.opf)
   bool cleanCacheOnStart_ = false;
   String language_;      // Language of the EPUB
+  String title_;
+  String author_;
+  String coverPath_;
   size_t epubFileSize_;  // Size of the EPUB file for cache validation
 };
 
@@ -12,6 +12,7 @@
 #include <string.h>
 
 #include "../../core/EInkDisplay.h"
+#include "../../core/HeapTelemetry.h"
 #include "../../lib/miniz.h"
 
 extern EInkDisplay einkDisplay;
@@ -162,7 +163,7 @@ static int find_end_central_dir(FILE_HANDLE fp, zip_end_central_dir* eocd) {
 /* Read central directory and build file list */
 static epub_error read_central_directory(epub_reader* reader, zip_end_central_dir* eocd) {
   reader->file_count = eocd->total_entries;
-  reader->files = (file_entry*)calloc(reader->file_count, sizeof(file_entry));
+  reader->files = (file_entry*)HeapTelemetry::allocateZeroed(reader->file_count, sizeof(file_entry));
   if (!reader->files) {
     return EPUB_ERROR_OUT_OF_MEMORY;
   }
@@ -203,7 +204,7 @@ static epub_error read_central_directory(epub_reader* reader, zip_end_central_di
     }
 
     /* Read filename */
-    char* filename = (char*)malloc(entry.filename_len + 1);
+    char* filename = (char*)HeapTelemetry::allocate(entry.filename_len + 1);
     if (!filename) {
       return EPUB_ERROR_OUT_OF_MEMORY;
     }
@@ -233,7 +234,7 @@ static epub_error read_central_directory(epub_reader* reader, zip_end_central_di
     if (file_read_impl(filename, 1, entry.filename_len, reader->fp) != entry.filename_len)
 #endif
     {
-      free(filename);
+      HeapTelemetry::release(filename);
       return EPUB_ERROR_CORRUPTED;
     }
     filename[entry.filename_len] = '\0';
@@ -263,7 +264,7 @@ epub_error epub_open(const char* filepath, epub_reader** out_reader) {
     return EPUB_ERROR_INVALID_PARAM;
   }
 
-  epub_reader* reader = (epub_reader*)calloc(1, sizeof(epub_reader));
+  epub_reader* reader = (epub_reader*)HeapTelemetry::allocateZeroed(1, sizeof(epub_reader));
   if (!reader) {
     return EPUB_ERROR_OUT_OF_MEMORY;
   }
@@ -271,7 +272,7 @@ epub_error epub_open(const char* filepath, epub_reader** out_reader) {
 #ifdef USE_ARDUINO_FILE
   reader->file_handle = file_open_impl(filepath);
   if (!reader->file_handle) {
-    free(reader);
+    HeapTelemetry::release(reader);
     return EPUB_ERROR_FILE_NOT_FOUND;
   }
 
@@ -279,21 +280,21 @@ epub_error epub_open(const char* filepath, epub_reader** out_reader) {
   zip_end_central_dir eocd;
   if (!find_end_central_dir(reader->file_handle, &eocd)) {
     file_close_impl(reader->file_handle);
-    free(reader);
+    HeapTelemetry::release(reader);
     return EPUB_ERROR_NOT_AN_EPUB;
   }
 
   /* Read central directory */
   epub_error err = read_central_directory(reader, &eocd);
   if (err != EPUB_OK) {
-    file_close_impl(reader->file_handle);
-    free(reader);
+    /* Also frees the entries read before the directory turned out to be corrupt */
+    epub_close(reader);
     return err;
   }
 #else
   reader->fp = file_open_impl(filepath);
   if (!reader->fp) {
-    free(reader);
+    HeapTelemetry::release(reader);
     return EPUB_ERROR_FILE_NOT_FOUND;
   }
 
@@ -301,15 +302,15 @@ epub_error epub_open(const char* filepath, epub_reader** out_reader) {
   zip_end_central_dir eocd;
   if (!find_end_central_dir(reader->fp, &eocd)) {
     file_close_impl(reader->fp);
-    free(reader);
+    HeapTelemetry::release(reader);
     return EPUB_ERROR_NOT_AN_EPUB;
   }
 
   /* Read central directory */
   epub_error err = read_central_directory(reader, &eocd);
   if (err != EPUB_OK) {
-    file_close_impl(reader->fp);
-    free(reader);
+    /* Also frees the entries read before the directory turned out to be corrupt */
+    epub_close(reader);
     return err;
   }
 #endif
@@ -322,9 +323,9 @@ void epub_close(epub_reader* reader) {
   if (reader) {
     if (reader->files) {
       for (uint32_t i = 0; i < reader->file_count; i++) {
-        free(reader->files[i].filename);
+        HeapTelemetry::release(reader->files[i].filename);
       }
-      free(reader->files);
+      HeapTelemetry::release(reader->files);
     }
 #ifdef USE_ARDUINO_FILE
     if (reader->file_handle) {
@@ -335,7 +336,7 @@ void epub_close(epub_reader* reader) {
       file_close_impl(reader->fp);
     }
 #endif
-    free(reader);
+    HeapTelemetry::release(reader);
   }
 }
 
@@ -513,7 +514,7 @@ epub_stream_context* epub_start_streaming(epub_reader* reader, uint32_t file_ind
   file_entry* entry = &reader->files[file_index];
 
   /* Allocate context */
-  epub_stream_context* ctx = (epub_stream_context*)calloc(1, sizeof(epub_stream_context));
+  epub_stream_context* ctx = (epub_stream_context*)HeapTelemetry::allocateZeroed(1, sizeof(epub_stream_context));
   if (!ctx) {
     return NULL;
   }
@@ -535,7 +536,7 @@ epub_stream_context* epub_start_streaming(epub_reader* reader, uint32_t file_ind
 
   /* Only DEFLATE compression supported for streaming (stored files are simple enough to handle inline) */
   if (entry->compression != 8 && entry->compression != 0) {
-    free(ctx);
+    HeapTelemetry::release(ctx);
     return NULL;
   }
 
@@ -553,7 +554,7 @@ epub_stream_context* epub_start_streaming(epub_reader* reader, uint32_t file_ind
   uint16_t version_needed, flags, compression_method;
   file_read_impl(&sig, 4, 1, fp);
   if (sig != ZIP_LOCAL_HEADER_SIG) {
-    free(ctx);
+    HeapTelemetry::release(ctx);
     return NULL;
   }
 
@@ -744,7 +745,7 @@ int epub_read_chunk(epub_stream_context* ctx, void* buffer, size_t max_size) {
 
 void epub_end_streaming(epub_stream_context* ctx) {
   if (ctx) {
-    free(ctx);
+    HeapTelemetry::release(ctx);
   }
 }
 
@@ -0,0 +1,216 @@
+#include "CoverThumbnail.h"
+
+#include <SD.h>
+#include <string.h>
+
+#include "../../core/EInkDisplay.h"
+#include "../../core/HeapTelemetry.h"
+#include "../epub/EpubReader.h"
+#include "JpegDecoder.h"
+#include "PngDecoder.h"
+
+static const char THUMBNAIL_MAGIC[4] = {'M', 'R', 'C', 'V'};
+static const uint8_t THUMBNAIL_VERSION = 1;
+static const size_t HEADER_SIZE = 10;
+
+static int readStream(void* context, uint8_t* buffer, size_t size) {
+  return epub_read_chunk((epub_stream_context*)context, buffer, size);
+}
+
+CoverThumbnail::~CoverThumbnail() {
+  releaseScaler();
+  releasePlanes();
+}
+
+String CoverThumbnail::pathFor(const char* epubPath) {
+  return EpubReader::extractDirFor(epubPath) + "/cover.thm";
+}
+
+bool CoverThumbnail::build(EpubReader& reader, const char* path) {
+  String cover = reader.getCoverPath();
+  if (cover.isEmpty())
+    return false;
+  epub_stream_context* stream = reader.startStreaming(cover.c_str());
+  if (!stream)
+    return false;
+
+  unsigned long start = millis();
+  releasePlanes();
+  ImageSource in(readStream, stream);
+  int first = in.peek();
+  bool ok = false;
+  if (first == 0xFF) {
+    JpegDecoder* decoder = new JpegDecoder();
+    ok = decoder->decode(in, *this);
+    delete decoder;
+  } else if (first == 0x89) {
+    PngDecoder* decoder = new PngDecoder();
+    ok = decoder->decode(in, *this);
+    delete decoder;
+  } else {
+    Serial.printf("CoverThumbnail: %s is neither JPEG nor PNG\n", cover.c_str());
+  }
+  epub_end_streaming(stream);
+  releaseScaler();
+  if (!ok || !isLoaded()) {
+    releasePlanes();
+    return false;
+  }
+
+  // Header and planes in one file, written in one go
+  SD.remove(path);
+  File out = SD.open(path, FILE_WRITE);
+  if (!out)
+    return false;
+  uint8_t header[HEADER_SIZE];
+  memcpy(header, THUMBNAIL_MAGIC, 4);
+  header[4] = THUMBNAIL_VERSION;
+  header[5] = 0;
+  header[6] = (uint8_t)(width_ & 0xFF);
+  header[7] = (uint8_t)(width_ >> 8);
+  header[8] = (uint8_t)(height_ & 0xFF);
+  header[9] = (uint8_t)(height_ >> 8);
+  ok = out.write(header, HEADER_SIZE) == HEADER_SIZE && out.write(planes_, 3 * planeSize()) == 3 * planeSize();
+  out.close();
+  if (!ok)
+    SD.remove(path);
+  Serial.printf("CoverThumbnail: %dx%d from %dx%d %s in %lu ms\n", width_, height_, sourceWidth_, sourceHeight_,
+                cover.c_str(), millis() - start);
+  return ok;
+}
+
+bool CoverThumbnail::load(const char* path) {
+  releasePlanes();
+  File in = SD.open(path);
+  if (!in)
+    return false;
+  uint8_t header[HEADER_SIZE];
+  bool ok = in.read(header, HEADER_SIZE) == HEADER_SIZE && memcmp(header, THUMBNAIL_MAGIC, 4) == 0 &&
+            header[4] == THUMBNAIL_VERSION;
+  if (ok) {
+    width_ = header[6] | (header[7] << 8);
+    height_ = header[8] | (header[9] << 8);
+    ok = width_ > 0 && width_ <= MAX_WIDTH && height_ > 0 && height_ <= MAX_HEIGHT && height_ % 8 == 0 &&
+         in.size() == HEADER_SIZE + 3 * planeSize();
+  }
+  if (ok) {
+    planes_ = (uint8_t*)HeapTelemetry::allocate(3 * planeSize());
+    ok = planes_ != nullptr && in.read(planes_, 3 * planeSize()) == 3 * planeSize();
+  }
+  in.close();
+  if (!ok) {
+    releasePlanes();
+    return false;
+  }
+  rowsDone_ = height_;
+  return true;
+}
+
+void CoverThumbnail::draw(EInkDisplay& display, int x, int y, Plane plane) const {
+  if (!isLoaded())
+    return;
+  // Portrait (x, y) is native (y, 479 - x); the planes hold native rows, so they go in as they are
+  display.drawImage(planes_ + plane * planeSize(), (uint16_t)y, (uint16_t)(EInkDisplay::DISPLAY_HEIGHT - x - width_),
+                    (uint16_t)height_, (uint16_t)width_);
+}
+
+bool CoverThumbnail::begin(int width, int height) {
+  releaseScaler();
+  releasePlanes();
+  // Fit the box keeping the aspect ratio, never upscaling; the height is then cut to whole plane bytes
+  if ((long)width * MAX_HEIGHT > (long)height * MAX_WIDTH) {
+    width_ = width < MAX_WIDTH ? width : MAX_WIDTH;
+    height_ = (int)((long)height * width_ / width);
+  } else {
+    height_ = height < MAX_HEIGHT ? height : MAX_HEIGHT;
+    width_ = (int)((long)width * height_ / height);
+  }
+  height_ &= ~7;
+  if (width_ < 1 || height_ < 8)
+    return false;
+
+  sourceWidth_ = width;
+  sourceHeight_ = height;
+  sourceRow_ = 0;
+  rowsDone_ = 0;
+  planes_ = (uint8_t*)HeapTelemetry::allocateZeroed(3, planeSize());
+  columnOf_ = (uint8_t*)HeapTelemetry::allocate(width);
+  sums_ = (uint32_t*)HeapTelemetry::allocateZeroed(width_, sizeof(uint32_t));
+  counts_ = (uint16_t*)HeapTelemetry::allocateZeroed(width_, sizeof(uint16_t));
+  errors_ = (int16_t*)HeapTelemetry::allocateZeroed(2 * (width_ + 2), sizeof(int16_t));
+  if (!planes_ || !columnOf_ || !sums_ || !counts_ || !errors_)
+    return false;
+  for (int x = 0; x < width; x++)
+    columnOf_[x] = (uint8_t)((long)x * width_ / width);
+  return true;
+}
+
+bool CoverThumbnail::row(const uint8_t* luma) {
+  // Each thumbnail row averages the source rows that map onto it
+  int target = (int)((long)sourceRow_ * height_ / sourceHeight_);
+  if (target >= height_)
+    return false;  // Rows beyond the header's height
+  if (target > rowsDone_)
+    emitRow();
+  for (int x = 0; x < sourceWidth_; x++) {
+    sums_[columnOf_[x]] += luma[x];
+    counts_[columnOf_[x]]++;
+  }
+  if (++sourceRow_ == sourceHeight_)
+    emitRow();
+  return true;
+}
+
+void CoverThumbnail::emitRow() {
+  // Five tones, as the display shows them; BW bit 1 is white, gray 00 leaves the BW pixel as it is
+  static const int TONE[5] = {0, 50, 110, 170, 255};
+  static const uint8_t BW[5] = {0, 0, 0, 1, 1};
+  static const uint8_t GRAY[5] = {0, 3, 2, 1, 0};
+
+  int16_t* err = errors_ + (rowsDone_ & 1) * (width_ + 2) + 1;
+  int16_t* below = errors_ + ((rowsDone_ + 1) & 1) * (width_ + 2) + 1;
+  memset(below - 1, 0, (width_ + 2) * sizeof(int16_t));
+
+  size_t rowBytes = height_ / 8;
+  size_t plane = planeSize();
+  for (int x = 0; x < width_; x++) {
+    int v = (counts_[x] ? (int)(sums_[x] / counts_[x]) : 255) + err[x];
+    int t = v < 25 ? 0 : v < 80 ? 1 : v < 140 ? 2 : v < 213 ? 3 : 4;
+    int e = v - TONE[t];
+    err[x + 1] += (int16_t)(e * 7 / 16);
+    below[x - 1] += (int16_t)(e * 3 / 16);
+    below[x] += (int16_t)(e * 5 / 16);
+    below[x + 1] += (int16_t)(e / 16);
+    sums_[x] = 0;
+    counts_[x] = 0;
+
+    // Portrait (x, row) lands in native row width - 1 - x, native column row
+    size_t index = (size_t)(width_ - 1 - x) * rowBytes + rowsDone_ / 8;
+    uint8_t bit = 0x80 >> (rowsDone_ & 7);
+    if (BW[t])
+      planes_[index] |= bit;
+    if (GRAY[t] & 1)
+      planes_[plane + index] |= bit;
+    if (GRAY[t] & 2)
+      planes_[2 * plane + index] |= bit;
+  }
+  rowsDone_++;
+}
+
+void CoverThumbnail::releaseScaler() {
+  HeapTelemetry::release(columnOf_);
+  HeapTelemetry::release(sums_);
+  HeapTelemetry::release(counts_);
+  HeapTelemetry::release(errors_);
+  columnOf_ = nullptr;
+  sums_ = nullptr;
+  counts_ = nullptr;
+  errors_ = nullptr;
+}
+
+void CoverThumbnail::releasePlanes() {
+  HeapTelemetry::release(planes_);
+  planes_ = nullptr;
+  width_ = height_ = 0;
+  rowsDone_ = 0;
+}
@@ -0,0 +1,92 @@
+#ifndef COVER_THUMBNAIL_H
+#define COVER_THUMBNAIL_H
+
+#include <Arduino.h>
+
+#include <cstdint>
+
+#include "ImageSource.h"
+
+class EInkDisplay;
+class EpubReader;
+
+/**
+ * CoverThumbnail - downscaled, dithered book cover cached on the SD card
+ *
+ * build() streams the EPUB's cover image out of the archive through the
+ * JPEG or PNG decoder, area-averages it down to fit MAX_WIDTH x MAX_HEIGHT
+ * while the rows arrive, dithers it to the display's five tones (white,
+ * three grays, black) and writes the result next to the book's extract
+ * cache. The three 1-bit planes (black/white plus the two grayscale bits,
+ * encoded as in scripts/simple_convert_image.py) are stored already rotated
+ * to the panel's native landscape layout, so load() is one sequential read
+ * and draw() is a plain drawImage() per plane.
+ *
+ * File layout: "MRCV", version, reserved, width and height (uint16,
+ * little-endian, portrait pixels), then the BW, LSB and MSB planes of
+ * width * height / 8 bytes each.
+ */
+class CoverThumbnail : public ImageRowSink {
+ public:
+  static const int MAX_WIDTH = 112;   // Portrait pixels
+  static const int MAX_HEIGHT = 144;  // Portrait pixels; thumbnail heights are multiples of 8
+
+  enum Plane { PLANE_BW = 0, PLANE_GRAY_LSB = 1, PLANE_GRAY_MSB = 2 };
+
+  CoverThumbnail() {}
+  ~CoverThumbnail();
+
+  CoverThumbnail(const CoverThumbnail&) = delete;
+  CoverThumbnail& operator=(const CoverThumbnail&) = delete;
+
+  // Cache file of the book at epubPath (inside its extract directory)
+  static String pathFor(const char* epubPath);
+
+  // Decode the cover of reader's book and write the thumbnail to path. Streaming borrows the display's frame
+  // buffer (see epub_start_streaming()), so callers redraw the screen afterwards.
+  bool build(EpubReader& reader, const char* path);
+  // Read a thumbnail written by build(); false if the file is missing or not a thumbnail
+  bool load(const char* path);
+
+  bool isLoaded() const {
+    return planes_ != nullptr && rowsDone_ == height_;
+  }
+  int getWidth() const {
+    return width_;
+  }
+  int getHeight() const {
+    return height_;
+  }
+
+  // Copy one plane into the display's frame buffer with its top-left corner at portrait (x, y); y must be a
+  // multiple of 8
+  void draw(EInkDisplay& display, int x, int y, Plane plane) const;
+
+  // ImageRowSink: the decoders deliver the source image here
+  bool begin(int width, int height) override;
+  bool row(const uint8_t* luma) override;
+
+ private:
+  size_t planeSize() const {
+    return (size_t)width_ * height_ / 8;
+  }
+  void emitRow();
+  void releaseScaler();
+  void releasePlanes();
+
+  int width_ = 0;
+  int height_ = 0;
+  uint8_t* planes_ = nullptr;  // BW, LSB and MSB planes back to back
+
+  // Downscaling state, only while decoding
+  int sourceWidth_ = 0;
+  int sourceHeight_ = 0;
+  int sourceRow_ = 0;
+  int rowsDone_ = 0;             // Thumbnail rows finished
+  uint8_t* columnOf_ = nullptr;  // Thumbnail column of each source column
+  uint32_t* sums_ = nullptr;
+  uint16_t* counts_ = nullptr;
+  int16_t* errors_ = nullptr;  // Floyd-Steinberg error of this row and the next, with a guard column each side
+};
+
+#endif
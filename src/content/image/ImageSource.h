@@ -0,0 +1,114 @@
+#ifndef IMAGE_SOURCE_H
+#define IMAGE_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * ImageSource - buffered pull reader for encoded image bytes
+ *
+ * The decoders read the image one byte (or a few bytes) at a time through a
+ * 512-byte buffer that is refilled from a read callback, so an image can be
+ * decoded straight out of an EPUB stream (epub_read_chunk()) or an SD file
+ * without holding the file in memory.
+ */
+class ImageSource {
+ public:
+  // Fill buffer with up to size bytes; returns the number read, 0 at the end, -1 on error
+  typedef int (*ReadFn)(void* context, uint8_t* buffer, size_t size);
+
+  ImageSource(ReadFn read, void* context) : read_(read), context_(context) {}
+
+  // Next byte, or -1 at the end of the data
+  int next() {
+    if (pos_ < len_)
+      return buf_[pos_++];
+    return refill();
+  }
+
+  // Next byte without consuming it (format sniffing), or -1 at the end of the data
+  int peek() {
+    if (pos_ < len_)
+      return buf_[pos_];
+    int b = refill();
+    if (b >= 0)
+      pos_ = 0;
+    return b;
+  }
+
+  // Read exactly size bytes; false if the data ends first
+  bool read(uint8_t* out, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      int b = next();
+      if (b < 0)
+        return false;
+      out[i] = (uint8_t)b;
+    }
+    return true;
+  }
+
+  bool skip(size_t size) {
+    while (size > 0) {
+      if (pos_ >= len_) {
+        if (refill() < 0)
+          return false;
+        size--;  // refill() hands out the first byte of the new block
+        continue;
+      }
+      size_t n = len_ - pos_;
+      if (n > size)
+        n = size;
+      pos_ += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  // Big-endian 16/32-bit values (JPEG segment lengths, PNG chunk headers); -1 at the end
+  long readU16() {
+    int a = next();
+    int b = next();
+    return (a < 0 || b < 0) ? -1 : (long)((a << 8) | b);
+  }
+  long long readU32() {
+    long hi = readU16();
+    long lo = readU16();
+    return (hi < 0 || lo < 0) ? -1 : ((long long)hi << 16) | lo;
+  }
+
+ private:
+  int refill() {
+    if (ended_)
+      return -1;
+    int n = read_(context_, buf_, sizeof(buf_));
+    if (n <= 0) {
+      ended_ = true;
+      len_ = pos_ = 0;
+      return -1;
+    }
+    len_ = (size_t)n;
+    pos_ = 1;
+    return buf_[0];
+  }
+
+  ReadFn read_;
+  void* context_;
+  uint8_t buf_[512];
+  size_t len_ = 0;
+  size_t pos_ = 0;
+  bool ended_ = false;
+};
+
+/**
+ * ImageRowSink - receives decoded rows of 8-bit luma (0 = black, 255 = white), top to bottom
+ */
+class ImageRowSink {
+ public:
+  virtual ~ImageRowSink() {}
+  // Called once before the first row; return false to stop decoding
+  virtual bool begin(int width, int height) = 0;
+  // One row of width bytes; return false to stop decoding
+  virtual bool row(const uint8_t* luma) = 0;
+};
+
+#endif
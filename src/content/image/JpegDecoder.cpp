@@ -0,0 +1,486 @@
+#include "JpegDecoder.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "../../core/HeapTelemetry.h"
+
+// Natural (row-major) index of each zigzag position
+static const uint8_t ZIGZAG[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                   12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                   35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                   58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Largest MCU row buffer accepted (a 4096 pixel wide image with 2x vertical sampling)
+static const size_t MAX_ROW_BUFFER = 64 * 1024;
+
+static inline uint8_t clampPixel(int v) {
+  return v < 0 ? 0 : (v > 255 ? 255 : (uint8_t)v);
+}
+
+// Separable integer IDCT (the islow algorithm with 12-bit fixed-point constants). Columns first; a column with only
+// a DC term is filled directly. Writes 8x8 samples, level-shifted by 128, to out.
+#define FIX(x) ((int)((x) * 4096 + 0.5))
+#define IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7)                   \
+  int t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3;         \
+  p2 = s2;                                                        \
+  p3 = s6;                                                        \
+  p1 = (p2 + p3) * FIX(0.5411961f);                               \
+  t2 = p1 + p3 * FIX(-1.847759065f);                              \
+  t3 = p1 + p2 * FIX(0.765366865f);                               \
+  p2 = s0;                                                        \
+  p3 = s4;                                                        \
+  t0 = (p2 + p3) * 4096;                                          \
+  t1 = (p2 - p3) * 4096;                                          \
+  x0 = t0 + t3;                                                   \
+  x3 = t0 - t3;                                                   \
+  x1 = t1 + t2;                                                   \
+  x2 = t1 - t2;                                                   \
+  t0 = s7;                                                        \
+  t1 = s5;                                                        \
+  t2 = s3;                                                        \
+  t3 = s1;                                                        \
+  p3 = t0 + t2;                                                   \
+  p4 = t1 + t3;                                                   \
+  p1 = t0 + t3;                                                   \
+  p2 = t1 + t2;                                                   \
+  p5 = (p3 + p4) * FIX(1.175875602f);                             \
+  t0 = t0 * FIX(0.298631336f);                                    \
+  t1 = t1 * FIX(2.053119869f);                                    \
+  t2 = t2 * FIX(3.072711026f);                                    \
+  t3 = t3 * FIX(1.501321110f);                                    \
+  p1 = p5 + p1 * FIX(-0.899976223f);                              \
+  p2 = p5 + p2 * FIX(-2.562915447f);                              \
+  p3 = p3 * FIX(-1.961570560f);                                   \
+  p4 = p4 * FIX(-0.390180644f);                                   \
+  t3 += p1 + p4;                                                  \
+  t2 += p2 + p3;                                                  \
+  t1 += p2 + p4;                                                  \
+  t0 += p1 + p3;
+
+static void inverseDct(const int* in, uint8_t* out, int stride) {
+  int tmp[64];
+  for (int i = 0; i < 8; i++) {
+    const int* d = in + i;
+    int* v = tmp + i;
+    if (d[8] == 0 && d[16] == 0 && d[24] == 0 && d[32] == 0 && d[40] == 0 && d[48] == 0 && d[56] == 0) {
+      int dc = d[0] * 4;
+      v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dc;
+      continue;
+    }
+    IDCT_1D(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56])
+    x0 += 512;
+    x1 += 512;
+    x2 += 512;
+    x3 += 512;
+    v[0] = (x0 + t3) >> 10;
+    v[56] = (x0 - t3) >> 10;
+    v[8] = (x1 + t2) >> 10;
+    v[48] = (x1 - t2) >> 10;
+    v[16] = (x2 + t1) >> 10;
+    v[40] = (x2 - t1) >> 10;
+    v[24] = (x3 + t0) >> 10;
+    v[32] = (x3 - t0) >> 10;
+  }
+  for (int i = 0; i < 8; i++, out += stride) {
+    const int* v = tmp + i * 8;
+    IDCT_1D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7])
+    // Rounding and the +128 level shift folded into one bias
+    x0 += 65536 + (128 << 17);
+    x1 += 65536 + (128 << 17);
+    x2 += 65536 + (128 << 17);
+    x3 += 65536 + (128 << 17);
+    out[0] = clampPixel((x0 + t3) >> 17);
+    out[7] = clampPixel((x0 - t3) >> 17);
+    out[1] = clampPixel((x1 + t2) >> 17);
+    out[6] = clampPixel((x1 - t2) >> 17);
+    out[2] = clampPixel((x2 + t1) >> 17);
+    out[5] = clampPixel((x2 - t1) >> 17);
+    out[3] = clampPixel((x3 + t0) >> 17);
+    out[4] = clampPixel((x3 - t0) >> 17);
+  }
+}
+
+#undef IDCT_1D
+#undef FIX
+
+JpegDecoder::JpegDecoder() {
+  memset(quant_, 0, sizeof(quant_));
+  memset(dc_, 0, sizeof(dc_));
+  memset(ac_, 0, sizeof(ac_));
+}
+
+JpegDecoder::~JpegDecoder() {}
+
+bool JpegDecoder::decode(ImageSource& in, ImageRowSink& sink) {
+  in_ = &in;
+  bitBuffer_ = 0;
+  bitCount_ = 0;
+  marker_ = 0;
+  componentCount_ = 0;
+  width_ = height_ = 0;
+  restartInterval_ = 0;
+  for (int i = 0; i < 4; i++)
+    dc_[i].defined = ac_[i].defined = false;
+
+  if (in.next() != 0xFF || in.next() != 0xD8)
+    return false;
+
+  while (true) {
+    int b = in.next();
+    if (b < 0)
+      return false;
+    if (b != 0xFF)
+      continue;  // Padding between segments
+    int m = in.next();
+    while (m == 0xFF)
+      m = in.next();
+    if (m < 0 || m == 0xD9)
+      return false;  // No scan before the end
+    if (m == 0x01 || m == 0xD8 || (m >= 0xD0 && m <= 0xD7))
+      continue;  // Markers without a segment
+
+    long length = in.readU16();
+    if (length < 2)
+      return false;
+    length -= 2;
+    switch (m) {
+      case 0xC0:
+      case 0xC1:
+        if (!readFrame(length))
+          return false;
+        break;
+      case 0xC4:
+        if (!readHuffmanTables(length))
+          return false;
+        break;
+      case 0xDB:
+        if (!readQuantTables(length))
+          return false;
+        break;
+      case 0xDD:
+        if (length < 2)
+          return false;
+        restartInterval_ = (int)in.readU16();
+        if (!in.skip(length - 2))
+          return false;
+        break;
+      case 0xDA: {
+        int scanComponents = 0;
+        if (!readScan(length, scanComponents))
+          return false;
+        return decodeScan(sink, scanComponents);
+      }
+      default:
+        if (m >= 0xC2 && m <= 0xCF) {
+          Serial.printf("JpegDecoder: unsupported frame type 0x%02X (progressive or arithmetic)\n", m);
+          return false;
+        }
+        if (!in.skip(length))
+          return false;
+        break;
+    }
+  }
+}
+
+bool JpegDecoder::readQuantTables(long length) {
+  while (length > 0) {
+    int pq = in_->next();
+    if (pq < 0 || (pq & 15) > 3)
+      return false;
+    bool wide = (pq >> 4) != 0;
+    uint16_t* table = quant_[pq & 15];
+    for (int k = 0; k < 64; k++) {
+      long v = wide ? in_->readU16() : in_->next();
+      if (v < 0)
+        return false;
+      table[k] = (uint16_t)v;
+    }
+    length -= 1 + (wide ? 128 : 64);
+  }
+  return length == 0;
+}
+
+bool JpegDecoder::readHuffmanTables(long length) {
+  while (length > 0) {
+    int tc = in_->next();
+    if (tc < 0 || (tc & 15) > 3 || (tc >> 4) > 1)
+      return false;
+    Huffman& t = (tc >> 4) ? ac_[tc & 15] : dc_[tc & 15];
+    uint8_t counts[16];
+    if (!in_->read(counts, 16))
+      return false;
+    int total = 0;
+    for (int i = 0; i < 16; i++)
+      total += counts[i];
+    if (total > 256 || !in_->read(t.values, total))
+      return false;
+
+    // Canonical codes: consecutive values within a length, doubling between lengths
+    memset(t.fastLength, 0, sizeof(t.fastLength));
+    int code = 0;
+    int k = 0;
+    for (int len = 1; len <= 16; len++) {
+      t.valueOffset[len] = k - code;
+      for (int i = 0; i < counts[len - 1]; i++, code++, k++) {
+        if (len > 8)
+          continue;
+        int shift = 8 - len;
+        int first = code << shift;
+        if (first + (1 << shift) > 256)
+          return false;
+        for (int j = 0; j < (1 << shift); j++) {
+          t.fastLength[first + j] = (uint8_t)len;
+          t.fastValue[first + j] = t.values[k];
+        }
+      }
+      t.maxCode[len] = counts[len - 1] ? code - 1 : -1;
+      code <<= 1;
+    }
+    t.defined = true;
+    length -= 17 + total;
+  }
+  return length == 0;
+}
+
+bool JpegDecoder::readFrame(long length) {
+  int precision = in_->next();
+  height_ = (int)in_->readU16();
+  width_ = (int)in_->readU16();
+  componentCount_ = in_->next();
+  if (precision != 8 || width_ <= 0 || height_ <= 0 || (componentCount_ != 1 && componentCount_ != 3) ||
+      length != 6 + 3 * componentCount_) {
+    Serial.printf("JpegDecoder: unsupported frame (%d bit, %dx%d, %d components)\n", precision, width_, height_,
+                  componentCount_);
+    return false;
+  }
+  for (int i = 0; i < componentCount_; i++) {
+    Component& c = components_[i];
+    int id = in_->next();
+    int hv = in_->next();
+    int tq = in_->next();
+    if (id < 0 || hv < 0 || tq < 0 || tq > 3)
+      return false;
+    c.id = (uint8_t)id;
+    c.h = (uint8_t)(hv >> 4);
+    c.v = (uint8_t)(hv & 15);
+    c.quant = (uint8_t)tq;
+    if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4)
+      return false;
+  }
+  return true;
+}
+
+bool JpegDecoder::readScan(long length, int& scanComponents) {
+  int n = in_->next();
+  if (componentCount_ == 0 || n < 1 || n > componentCount_ || length != 4 + 2 * n)
+    return false;
+  for (int i = 0; i < n; i++) {
+    int id = in_->next();
+    int tables = in_->next();
+    int index = -1;
+    for (int j = 0; j < componentCount_; j++) {
+      if (components_[j].id == id)
+        index = j;
+    }
+    if (index < 0 || tables < 0 || (tables >> 4) > 3 || (tables & 15) > 3)
+      return false;
+    Component& c = components_[index];
+    c.dcTable = (uint8_t)(tables >> 4);
+    c.acTable = (uint8_t)(tables & 15);
+    c.dcPred = 0;
+    if (!dc_[c.dcTable].defined || !ac_[c.acTable].defined)
+      return false;
+    scanOrder_[i] = (uint8_t)index;
+  }
+  // Spectral selection and approximation: fixed for sequential JPEG
+  in_->skip(3);
+  scanComponents = n;
+  return true;
+}
+
+bool JpegDecoder::decodeScan(ImageRowSink& sink, int scanComponents) {
+  // Luma must be in this scan and carry the highest sampling, so one luma sample is one pixel
+  int hMax = 1, vMax = 1;
+  for (int i = 0; i < componentCount_; i++) {
+    hMax = components_[i].h > hMax ? components_[i].h : hMax;
+    vMax = components_[i].v > vMax ? components_[i].v : vMax;
+  }
+  Component& luma = components_[0];
+  bool interleaved = scanComponents > 1;
+  if ((!interleaved && scanOrder_[0] != 0) || luma.h != hMax || luma.v != vMax) {
+    Serial.println("JpegDecoder: unsupported scan layout");
+    return false;
+  }
+
+  // A non-interleaved scan has one block per MCU
+  int mcuWidth = interleaved ? 8 * hMax : 8;
+  int mcuHeight = interleaved ? 8 * vMax : 8;
+  int mcuColumns = (width_ + mcuWidth - 1) / mcuWidth;
+  int mcuRows = (height_ + mcuHeight - 1) / mcuHeight;
+  size_t stride = (size_t)mcuColumns * mcuWidth;
+  if (stride * mcuHeight > MAX_ROW_BUFFER) {
+    Serial.printf("JpegDecoder: %dx%d is too wide\n", width_, height_);
+    return false;
+  }
+  uint8_t* rows = (uint8_t*)HeapTelemetry::allocate(stride * mcuHeight);
+  if (!rows)
+    return false;
+  if (!sink.begin(width_, height_)) {
+    HeapTelemetry::release(rows);
+    return false;
+  }
+
+  int coefficients[64];
+  int untilRestart = restartInterval_;
+  bool ok = true;
+  for (int my = 0; my < mcuRows && ok; my++) {
+    for (int mx = 0; mx < mcuColumns && ok; mx++) {
+      if (restartInterval_) {
+        if (untilRestart == 0) {
+          ok = restart();
+          untilRestart = restartInterval_;
+        }
+        untilRestart--;
+      }
+      if (!interleaved) {
+        ok = ok && decodeBlock(luma, coefficients);
+        if (ok)
+          inverseDct(coefficients, rows + mx * 8, (int)stride);
+        continue;
+      }
+      for (int s = 0; s < scanComponents && ok; s++) {
+        Component& c = components_[scanOrder_[s]];
+        bool isLuma = scanOrder_[s] == 0;
+        for (int by = 0; by < c.v && ok; by++) {
+          for (int bx = 0; bx < c.h && ok; bx++) {
+            ok = decodeBlock(c, isLuma ? coefficients : nullptr);
+            if (ok && isLuma)
+              inverseDct(coefficients, rows + by * 8 * stride + mx * mcuWidth + bx * 8, (int)stride);
+          }
+        }
+      }
+    }
+    int count = height_ - my * mcuHeight < mcuHeight ? height_ - my * mcuHeight : mcuHeight;
+    for (int r = 0; r < count && ok; r++)
+      ok = sink.row(rows + r * stride);
+  }
+  HeapTelemetry::release(rows);
+  return ok;
+}
+
+bool JpegDecoder::decodeBlock(Component& c, int* coefficients) {
+  const uint16_t* q = quant_[c.quant];
+  int s = decodeHuffman(dc_[c.dcTable]);
+  if (s < 0 || s > 11)
+    return false;
+  if (s) {
+    int v = getBits(s);
+    c.dcPred += v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+  }
+  if (coefficients) {
+    memset(coefficients, 0, 64 * sizeof(int));
+    coefficients[0] = c.dcPred * q[0];
+  }
+  for (int k = 1; k < 64;) {
+    int rs = decodeHuffman(ac_[c.acTable]);
+    if (rs < 0)
+      return false;
+    int run = rs >> 4;
+    s = rs & 15;
+    if (s == 0) {
+      if (run != 15)
+        break;  // End of block
+      k += 16;
+      continue;
+    }
+    k += run;
+    if (k > 63)
+      return false;
+    int v = getBits(s);
+    if (coefficients)
+      coefficients[ZIGZAG[k]] = (v < (1 << (s - 1)) ? v - (1 << s) + 1 : v) * q[k];
+    k++;
+  }
+  return true;
+}
+
+bool JpegDecoder::restart() {
+  bitBuffer_ = 0;
+  bitCount_ = 0;
+  if (marker_ == 0) {
+    // Padding bits left before the marker: skip to it
+    int b;
+    while ((b = in_->next()) >= 0) {
+      if (b != 0xFF)
+        continue;
+      int m = in_->next();
+      while (m == 0xFF)
+        m = in_->next();
+      if (m != 0) {
+        marker_ = m < 0 ? 0xD9 : m;
+        break;
+      }
+    }
+  }
+  if (marker_ < 0xD0 || marker_ > 0xD7)
+    return false;
+  marker_ = 0;
+  for (int i = 0; i < componentCount_; i++)
+    components_[i].dcPred = 0;
+  return true;
+}
+
+void JpegDecoder::fillBits() {
+  while (bitCount_ <= 24) {
+    int b = 0;
+    if (marker_ == 0) {
+      b = in_->next();
+      if (b < 0) {
+        marker_ = 0xD9;  // Data ended: feed zeros
+        b = 0;
+      } else if (b == 0xFF) {
+        int next = in_->next();
+        while (next == 0xFF)
+          next = in_->next();
+        if (next != 0) {
+          marker_ = next < 0 ? 0xD9 : next;  // Marker: stop reading, feed zeros
+          b = 0;
+        }
+      }
+    }
+    bitBuffer_ |= (uint32_t)b << (24 - bitCount_);
+    bitCount_ += 8;
+  }
+}
+
+int JpegDecoder::getBits(int n) {
+  fillBits();
+  int v = (int)(bitBuffer_ >> (32 - n));
+  bitBuffer_ <<= n;
+  bitCount_ -= n;
+  return v;
+}
+
+int JpegDecoder::decodeHuffman(const Huffman& table) {
+  fillBits();
+  uint32_t peek = bitBuffer_ >> 24;
+  int len = table.fastLength[peek];
+  if (len) {
+    bitBuffer_ <<= len;
+    bitCount_ -= len;
+    return table.fastValue[peek];
+  }
+  for (len = 9; len <= 16; len++) {
+    int code = (int)(bitBuffer_ >> (32 - len));
+    if (code <= table.maxCode[len]) {
+      int index = table.valueOffset[len] + code;
+      if (index < 0 || index > 255)
+        return -1;
+      bitBuffer_ <<= len;
+      bitCount_ -= len;
+      return table.values[index];
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,86 @@
+#ifndef JPEG_DECODER_H
+#define JPEG_DECODER_H
+
+#include <cstdint>
+
+#include "ImageSource.h"
+
+/**
+ * JpegDecoder - streaming baseline JPEG decoder producing luma rows
+ *
+ * Decodes baseline and extended sequential Huffman JPEGs (SOF0/SOF1) with
+ * one or three components, any sampling factors up to 4x4 and restart
+ * intervals. Only the luma component is transformed: chroma blocks are
+ * entropy-decoded to stay in sync and then dropped, which is all a
+ * grayscale display needs and saves most of the IDCT work. Rows are handed
+ * to the sink one MCU row at a time, so memory is one MCU row of luma
+ * (image width x 8 or 16 bytes) plus the tables in this object (about 7 KB,
+ * allocate it on the heap). Progressive and arithmetic-coded files are
+ * rejected.
+ */
+class JpegDecoder {
+ public:
+  JpegDecoder();
+  ~JpegDecoder();
+
+  JpegDecoder(const JpegDecoder&) = delete;
+  JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+  // Decode the image from in, calling sink.begin() and then sink.row() for every row. False on unsupported or
+  // corrupt data (rows already delivered stay delivered).
+  bool decode(ImageSource& in, ImageRowSink& sink);
+
+  int getWidth() const {
+    return width_;
+  }
+  int getHeight() const {
+    return height_;
+  }
+
+ private:
+  struct Huffman {
+    bool defined;
+    uint8_t fastLength[256];  // Code length for codes of up to 8 bits, indexed by the next 8 bits; 0 if longer
+    uint8_t fastValue[256];
+    int32_t maxCode[18];  // Largest code of each length, -1 if none
+    int32_t valueOffset[17];
+    uint8_t values[256];
+  };
+
+  struct Component {
+    uint8_t id;
+    uint8_t h, v;  // Sampling factors
+    uint8_t quant;
+    uint8_t dcTable, acTable;
+    int dcPred;
+  };
+
+  bool readQuantTables(long length);
+  bool readHuffmanTables(long length);
+  bool readFrame(long length);
+  bool readScan(long length, int& scanComponents);
+  bool decodeScan(ImageRowSink& sink, int scanComponents);
+  bool decodeBlock(Component& c, int* coefficients);
+  bool restart();
+
+  void fillBits();
+  int getBits(int n);
+  int decodeHuffman(const Huffman& table);
+
+  ImageSource* in_ = nullptr;
+  uint32_t bitBuffer_ = 0;
+  int bitCount_ = 0;
+  int marker_ = 0;  // Marker met inside entropy-coded data, 0 if none
+
+  uint16_t quant_[4][64];  // Zigzag order
+  Huffman dc_[4];
+  Huffman ac_[4];
+  Component components_[3];
+  int componentCount_ = 0;
+  uint8_t scanOrder_[3];  // Components of the current scan, in scan order
+  int width_ = 0;
+  int height_ = 0;
+  int restartInterval_ = 0;
+};
+
+#endif
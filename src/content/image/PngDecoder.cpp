@@ -0,0 +1,285 @@
+#include "PngDecoder.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#include "../../core/HeapTelemetry.h"
+#include "../../lib/miniz.h"
+
+// Widest accepted image, so the two scanlines stay small next to the inflate window
+static const int MAX_WIDTH = 4096;
+
+static inline uint8_t lumaOf(int r, int g, int b) {
+  return (uint8_t)((77 * r + 150 * g + 29 * b) >> 8);
+}
+
+// Composite over white
+static inline uint8_t overWhite(int luma, int alpha) {
+  return (uint8_t)(255 - ((255 - luma) * alpha + 127) / 255);
+}
+
+static inline int paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  return pb <= pc ? b : c;
+}
+
+static bool unfilter(uint8_t filter, uint8_t* row, const uint8_t* prev, size_t length, size_t bpp) {
+  switch (filter) {
+    case 0:
+      return true;
+    case 1:
+      for (size_t i = bpp; i < length; i++)
+        row[i] += row[i - bpp];
+      return true;
+    case 2:
+      for (size_t i = 0; i < length; i++)
+        row[i] += prev[i];
+      return true;
+    case 3:
+      for (size_t i = 0; i < length; i++)
+        row[i] += (uint8_t)(((i >= bpp ? row[i - bpp] : 0) + prev[i]) >> 1);
+      return true;
+    case 4:
+      for (size_t i = 0; i < length; i++)
+        row[i] += (uint8_t)paeth(i >= bpp ? row[i - bpp] : 0, prev[i], i >= bpp ? prev[i - bpp] : 0);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool PngDecoder::decode(ImageSource& in, ImageRowSink& sink) {
+  static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  uint8_t signature[8];
+  if (!in.read(signature, 8) || memcmp(signature, SIGNATURE, 8) != 0)
+    return false;
+
+  width_ = height_ = 0;
+  paletteSize_ = 0;
+  for (int i = 0; i < 256; i++) {
+    paletteLuma_[i] = 0;
+    paletteAlpha_[i] = 255;
+  }
+
+  // Chunks up to the first IDAT
+  long long length;
+  uint8_t type[4];
+  while (true) {
+    length = in.readU32();
+    if (length < 0 || length > 0x7FFFFFFF || !in.read(type, 4))
+      return false;
+    if (memcmp(type, "IDAT", 4) == 0)
+      break;
+    if (memcmp(type, "IEND", 4) == 0)
+      return false;
+    bool ok;
+    if (memcmp(type, "IHDR", 4) == 0)
+      ok = readHeader(in, (long)length);
+    else if (memcmp(type, "PLTE", 4) == 0)
+      ok = readPalette(in, (long)length);
+    else if (memcmp(type, "tRNS", 4) == 0)
+      ok = readTransparency(in, (long)length);
+    else
+      ok = in.skip((size_t)length);
+    if (!ok || !in.skip(4))  // CRC
+      return false;
+  }
+  if (width_ == 0 || (colorType_ == 3 && paletteSize_ == 0))
+    return false;
+
+  // One block: inflate state, window, previous and current scanline (with the filter byte), luma row
+  size_t rowBytes = ((size_t)width_ * channels_ * bitDepth_ + 7) / 8;
+  size_t bpp = (channels_ * bitDepth_ + 7) / 8;
+  size_t total = sizeof(tinfl_decompressor) + TINFL_LZ_DICT_SIZE + 2 * (rowBytes + 1) + width_;
+  uint8_t* block = (uint8_t*)HeapTelemetry::allocate(total);
+  if (!block) {
+    Serial.printf("PngDecoder: cannot allocate %u bytes\n", (unsigned)total);
+    return false;
+  }
+  tinfl_decompressor* inflator = (tinfl_decompressor*)block;
+  uint8_t* dict = block + sizeof(tinfl_decompressor);
+  uint8_t* prev = dict + TINFL_LZ_DICT_SIZE;
+  uint8_t* cur = prev + rowBytes + 1;
+  uint8_t* luma = cur + rowBytes + 1;
+  memset(prev, 0, rowBytes + 1);
+  tinfl_init(inflator);
+
+  bool ok = sink.begin(width_, height_);
+  uint8_t input[256];
+  size_t inputPos = 0, inputLen = 0;
+  long long chunkRemaining = length;
+  bool inputEnded = false;
+  size_t dictOfs = 0;
+  size_t fill = 0;  // Bytes of cur filled so far
+  int rows = 0;
+  while (ok && rows < height_) {
+    // Refill from the IDAT chunks, which may split the stream anywhere
+    if (inputPos == inputLen && !inputEnded) {
+      while (chunkRemaining == 0 && !inputEnded) {
+        bool crc = in.skip(4);
+        length = in.readU32();
+        if (!crc || length < 0 || !in.read(type, 4) || memcmp(type, "IDAT", 4) != 0)
+          inputEnded = true;
+        else
+          chunkRemaining = length;
+      }
+      if (!inputEnded) {
+        inputLen = chunkRemaining < (long long)sizeof(input) ? (size_t)chunkRemaining : sizeof(input);
+        if (!in.read(input, inputLen)) {
+          ok = false;
+          break;
+        }
+        chunkRemaining -= inputLen;
+        inputPos = 0;
+      }
+    }
+
+    size_t inBytes = inputLen - inputPos;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - dictOfs;
+    mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER | (inputEnded ? 0 : TINFL_FLAG_HAS_MORE_INPUT);
+    tinfl_status status =
+        tinfl_decompress_raw(inflator, input + inputPos, &inBytes, dict, dict + dictOfs, &outBytes, flags);
+    inputPos += inBytes;
+
+    // Assemble scanlines from the new output
+    const uint8_t* out = dict + dictOfs;
+    dictOfs = (dictOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+    while (outBytes > 0 && ok && rows < height_) {
+      size_t n = rowBytes + 1 - fill;
+      if (n > outBytes)
+        n = outBytes;
+      memcpy(cur + fill, out, n);
+      fill += n;
+      out += n;
+      outBytes -= n;
+      if (fill == rowBytes + 1) {
+        ok = unfilter(cur[0], cur + 1, prev + 1, rowBytes, bpp);
+        if (ok) {
+          toLuma(cur + 1, luma);
+          ok = sink.row(luma);
+          rows++;
+        }
+        uint8_t* t = prev;
+        prev = cur;
+        cur = t;
+        fill = 0;
+      }
+    }
+
+    if (status == TINFL_STATUS_DONE || status < 0 || (status == TINFL_STATUS_NEEDS_MORE_INPUT && inputEnded))
+      break;
+  }
+  HeapTelemetry::release(block);
+  if (ok && rows < height_)
+    Serial.printf("PngDecoder: image data ended after %d of %d rows\n", rows, height_);
+  return ok && rows == height_;
+}
+
+bool PngDecoder::readHeader(ImageSource& in, long length) {
+  if (length != 13)
+    return false;
+  long long w = in.readU32();
+  long long h = in.readU32();
+  int depth = in.next();
+  int color = in.next();
+  int compression = in.next();
+  int filter = in.next();
+  int interlace = in.next();
+  if (w <= 0 || w > MAX_WIDTH || h <= 0 || h > 0x7FFFFFFF || compression != 0 || filter != 0 || interlace != 0) {
+    Serial.printf("PngDecoder: unsupported image (%lldx%lld, interlace %d)\n", w, h, interlace);
+    return false;
+  }
+  switch (color) {
+    case 0:
+      channels_ = 1;
+      break;
+    case 2:
+      channels_ = 3;
+      break;
+    case 3:
+      channels_ = 1;
+      break;
+    case 4:
+      channels_ = 2;
+      break;
+    case 6:
+      channels_ = 4;
+      break;
+    default:
+      return false;
+  }
+  bool depthOk = depth == 8 || (depth == 16 && color != 3) || ((depth == 1 || depth == 2 || depth == 4) &&
+                                                                  (color == 0 || color == 3));
+  if (!depthOk)
+    return false;
+  width_ = (int)w;
+  height_ = (int)h;
+  bitDepth_ = (uint8_t)depth;
+  colorType_ = (uint8_t)color;
+  return true;
+}
+
+bool PngDecoder::readPalette(ImageSource& in, long length) {
+  if (length % 3 != 0 || length > 3 * 256)
+    return false;
+  paletteSize_ = (int)(length / 3);
+  for (int i = 0; i < paletteSize_; i++) {
+    uint8_t rgb[3];
+    if (!in.read(rgb, 3))
+      return false;
+    paletteLuma_[i] = lumaOf(rgb[0], rgb[1], rgb[2]);
+  }
+  return true;
+}
+
+bool PngDecoder::readTransparency(ImageSource& in, long length) {
+  // Only palette alpha is used; a single transparent gray or RGB value is rare on covers and ignored
+  if (colorType_ != 3)
+    return in.skip((size_t)length);
+  for (long i = 0; i < length; i++) {
+    int a = in.next();
+    if (a < 0)
+      return false;
+    if (i < 256)
+      paletteAlpha_[i] = (uint8_t)a;
+  }
+  return true;
+}
+
+void PngDecoder::toLuma(const uint8_t* s, uint8_t* luma) const {
+  // Samples wider than 8 bits contribute their high byte
+  int step = bitDepth_ == 16 ? 2 : 1;
+  int px = channels_ * step;
+  for (int x = 0; x < width_; x++) {
+    const uint8_t* p = s + x * px;
+    switch (colorType_) {
+      case 0:
+      case 3: {
+        int v = p[0];
+        if (bitDepth_ < 8) {
+          int bit = x * bitDepth_;
+          int mask = (1 << bitDepth_) - 1;
+          v = (s[bit >> 3] >> (8 - bitDepth_ - (bit & 7))) & mask;
+          if (colorType_ == 0)
+            v = v * 255 / mask;
+        }
+        luma[x] = colorType_ == 0 ? (uint8_t)v : overWhite(paletteLuma_[v], paletteAlpha_[v]);
+        break;
+      }
+      case 2:
+        luma[x] = lumaOf(p[0], p[step], p[2 * step]);
+        break;
+      case 4:
+        luma[x] = overWhite(p[0], p[step]);
+        break;
+      case 6:
+        luma[x] = overWhite(lumaOf(p[0], p[step], p[2 * step]), p[3 * step]);
+        break;
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef PNG_DECODER_H
+#define PNG_DECODER_H
+
+#include <cstdint>
+
+#include "ImageSource.h"
+
+/**
+ * PngDecoder - streaming PNG decoder producing luma rows
+ *
+ * IDAT data is inflated incrementally into a 32 KB wrapping window and
+ * unfiltered one scanline at a time, so memory is the window plus two
+ * scanlines, independent of the image height. All color types and bit
+ * depths of non-interlaced PNGs are accepted; color is reduced to luma and
+ * alpha is composited over white (the paper). Interlaced (Adam7) files are
+ * rejected.
+ */
+class PngDecoder {
+ public:
+  PngDecoder() {}
+  ~PngDecoder() {}
+
+  PngDecoder(const PngDecoder&) = delete;
+  PngDecoder& operator=(const PngDecoder&) = delete;
+
+  // Decode the image from in, calling sink.begin() and then sink.row() for every row. False on unsupported or
+  // corrupt data (rows already delivered stay delivered).
+  bool decode(ImageSource& in, ImageRowSink& sink);
+
+  int getWidth() const {
+    return width_;
+  }
+  int getHeight() const {
+    return height_;
+  }
+
+ private:
+  bool readHeader(ImageSource& in, long length);
+  bool readPalette(ImageSource& in, long length);
+  bool readTransparency(ImageSource& in, long length);
+  void toLuma(const uint8_t* scanline, uint8_t* luma) const;
+
+  int width_ = 0;
+  int height_ = 0;
+  uint8_t bitDepth_ = 0;
+  uint8_t colorType_ = 0;
+  uint8_t channels_ = 0;
+  uint8_t paletteLuma_[256];  // Palette entries as luma
+  uint8_t paletteAlpha_[256];
+  int paletteSize_ = 0;
+};
+
+#endif
@@ -0,0 +1,660 @@
+#include "LibraryIndex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "../../core/BufferedFileWriter.h"
+#include "../epub/EpubReader.h"
+#include "../image/CoverThumbnail.h"
+
+static const char* INDEX_MAGIC = "MRLIB";
+static const char* INDEX_END = "MREND";  // Last line of a rewrite, tells a complete .tmp from a cut one
+static const int INDEX_VERSION = 1;
+static const int RECORD_FIELDS = 11;
+static const int PROGRESS_FIELDS = 5;
+static const int MAX_PATH_BYTES = 255;
+static const int MAX_TEXT_BYTES = 127;
+static const int MAX_LINE_BYTES = 1024;
+static const int MAX_FOLDER_DEPTH = 8;
+
+// Reads '\n'-terminated lines through a sector-sized buffer, tracking the file offset of each line. A last line
+// without its '\n' is a record cut by a reset and is not returned.
+class LineReader {
+ public:
+  LineReader(File& file, uint32_t startOffset) : file_(file), base_(startOffset) {}
+
+  bool next(String& line, uint32_t& offset) {
+    line = "";
+    offset = base_ + pos_;
+    while (true) {
+      if (pos_ >= len_) {
+        base_ += len_;
+        pos_ = 0;
+        len_ = file_.read((uint8_t*)buf_, sizeof(buf_));
+        if (len_ == 0)
+          return false;
+      }
+      char c = buf_[pos_++];
+      if (c == '\n')
+        return true;
+      if (line.length() < MAX_LINE_BYTES)
+        line += c;
+    }
+  }
+
+ private:
+  File& file_;
+  char buf_[512];
+  size_t len_ = 0;
+  size_t pos_ = 0;
+  uint32_t base_;
+};
+
+static uint32_t hashPath(const String& path) {
+  uint32_t h = 2166136261u;  // FNV-1a
+  for (int i = 0; i < path.length(); i++) {
+    h ^= (uint8_t)path[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// Split a record line at tabs; returns the number of fields found
+static int splitFields(const String& line, String* fields, int maxFields) {
+  int count = 0;
+  int start = 0;
+  while (count < maxFields) {
+    int tab = line.indexOf('\t', start);
+    if (tab < 0) {
+      fields[count++] = line.substring(start);
+      break;
+    }
+    fields[count++] = line.substring(start, tab);
+    start = tab + 1;
+  }
+  return count;
+}
+
+static bool parseRecord(const String& line, LibraryIndex::Book& out) {
+  String f[RECORD_FIELDS];
+  if (splitFields(line, f, RECORD_FIELDS) < RECORD_FIELDS || f[0].isEmpty())
+    return false;
+  out.path = f[0];
+  out.size = (uint32_t)strtoul(f[1].c_str(), nullptr, 10);
+  out.mtime = (uint32_t)strtoul(f[2].c_str(), nullptr, 10);
+  out.opened = (uint32_t)strtoul(f[3].c_str(), nullptr, 10);
+  out.chapter = (int)f[4].toInt();
+  out.position = (int)f[5].toInt();
+  out.permille = (uint16_t)f[6].toInt();
+  out.flags = (uint8_t)f[7].toInt();
+  out.language = f[8];
+  out.title = f[9];
+  out.author = f[10];
+  return true;
+}
+
+// Text field for a record: tabs and line breaks become spaces, cut to maxBytes without splitting a UTF-8 sequence
+static void writeField(BufferedFileWriter& out, const String& text, int maxBytes) {
+  int length = text.length();
+  if (length > maxBytes) {
+    length = maxBytes;
+    while (length > 0 && ((uint8_t)text[length] & 0xC0) == 0x80)
+      length--;
+  }
+  for (int i = 0; i < length; i++) {
+    char c = text[i];
+    out.put((c == '\t' || c == '\n' || c == '\r') ? ' ' : c);
+  }
+}
+
+static void writeRecord(BufferedFileWriter& out, const LibraryIndex::Book& book) {
+  char numbers[96];
+  snprintf(numbers, sizeof(numbers), "\t%lu\t%lu\t%lu\t%d\t%d\t%u\t%u\t", (unsigned long)book.size,
+           (unsigned long)book.mtime, (unsigned long)book.opened, book.chapter, book.position,
+           (unsigned)book.permille, (unsigned)book.flags);
+  writeField(out, book.path, MAX_PATH_BYTES);
+  out.print(numbers);
+  writeField(out, book.language, 15);
+  out.put('\t');
+  writeField(out, book.title, MAX_TEXT_BYTES);
+  out.put('\t');
+  writeField(out, book.author, MAX_TEXT_BYTES);
+  out.put('\n');
+}
+
+static String baseName(const String& path) {
+  int slash = path.lastIndexOf('/');
+  return slash >= 0 ? path.substring(slash + 1) : path;
+}
+
+static bool hasExtension(const String& name, const char* ext) {
+  int n = (int)strlen(ext);
+  return name.length() > n && strcasecmp(name.c_str() + name.length() - n, ext) == 0;
+}
+
+static String joinPath(const String& folder, const String& name) {
+  if (folder.length() > 0 && folder[folder.length() - 1] == '/')
+    return folder + name;
+  return folder + "/" + name;
+}
+
+// "/microreader/library.idx" -> "/microreader/library.jnl"
+static String progressPathFor(const String& indexPath) {
+  int dot = indexPath.lastIndexOf('.');
+  String base = dot > indexPath.lastIndexOf('/') ? indexPath.substring(0, dot) : indexPath;
+  return base + ".jnl";
+}
+
+LibraryIndex::LibraryIndex(const char* root, const char* indexPath)
+    : root_(root), indexPath_(indexPath), progress_(progressPathFor(String(indexPath))) {
+  // Folders are kept without a trailing slash except for the card root
+  while (root_.length() > 1 && root_[root_.length() - 1] == '/')
+    root_ = root_.substring(0, root_.length() - 1);
+}
+
+String LibraryIndex::parentFolder(const String& path) {
+  int slash = path.lastIndexOf('/');
+  if (slash < 0)
+    return String("");
+  if (slash == 0)
+    return String("/");
+  return path.substring(0, slash);
+}
+
+uint16_t LibraryIndex::folderId(const String& folder) {
+  for (size_t i = 0; i < folders_.size(); i++) {
+    if (folders_[i] == folder)
+      return (uint16_t)i;
+  }
+  folders_.push_back(folder);
+  return (uint16_t)(folders_.size() - 1);
+}
+
+bool LibraryIndex::load() {
+  progress_.load();
+  String tmpPath = indexPath_ + ".tmp";
+  bool complete = false;
+  if (SD.exists(indexPath_.c_str())) {
+    // A left-over rewrite never replaced the index, which is still complete
+    if (SD.exists(tmpPath.c_str()))
+      SD.remove(tmpPath.c_str());
+    return readIndex(indexPath_, complete);
+  }
+
+  // Interrupted between removing the old index and renaming the new one
+  if (SD.exists(tmpPath.c_str())) {
+    if (readIndex(tmpPath, complete) && complete && SD.rename(tmpPath.c_str(), indexPath_.c_str())) {
+      Serial.printf("LibraryIndex: recovered %s\n", indexPath_.c_str());
+      return true;
+    }
+    SD.remove(tmpPath.c_str());
+  }
+  return readIndex(indexPath_, complete);
+}
+
+bool LibraryIndex::readIndex(const String& path, bool& complete) {
+  entries_.clear();
+  folders_.clear();
+  nextOpened_ = 1;
+  viewValid_ = false;
+  complete = false;
+
+  File index = SD.open(path.c_str());
+  if (!index)
+    return false;
+
+  LineReader reader(index, 0);
+  String line;
+  uint32_t offset;
+  String header[3];
+  if (!reader.next(line, offset) || splitFields(line, header, 3) < 3 || header[0] != INDEX_MAGIC ||
+      header[1].toInt() != INDEX_VERSION) {
+    Serial.printf("LibraryIndex: %s has an unknown format, ignoring it\n", path.c_str());
+    index.close();
+    return false;
+  }
+  nextOpened_ = (uint32_t)strtoul(header[2].c_str(), nullptr, 10);
+  if (nextOpened_ == 0)
+    nextOpened_ = 1;
+
+  Book book;
+  while (reader.next(line, offset)) {
+    // A rewrite ends with the end line; records appended later go after it
+    complete = line == INDEX_END;
+    if (!parseRecord(line, book))
+      continue;
+    applyProgress(book);
+    if (book.opened >= nextOpened_)
+      nextOpened_ = book.opened + 1;
+    addEntry(book, offset);
+  }
+  index.close();
+  revision_++;
+  Serial.printf("LibraryIndex: %d books, %d folders\n", (int)entries_.size(), (int)folders_.size());
+  return true;
+}
+
+void LibraryIndex::addEntry(const Book& book, uint32_t offset) {
+  Entry e;
+  e.offset = offset;
+  e.pathHash = hashPath(book.path);
+  e.size = book.size;
+  e.mtime = book.mtime;
+  e.opened = book.opened;
+  e.folder = folderId(parentFolder(book.path));
+  e.permille = book.permille;
+  int n = 0;
+  for (; n < TITLE_KEY_LENGTH && n < book.title.length(); n++)
+    e.titleKey[n] = (char)tolower((unsigned char)book.title[n]);
+  e.titleKey[n] = '\0';
+  entries_.push_back(e);
+}
+
+bool LibraryIndex::readRecord(File& index, const Entry& entry, Book& out) {
+  if (!index.seek(entry.offset))
+    return false;
+  LineReader reader(index, entry.offset);
+  String line;
+  uint32_t offset;
+  if (!reader.next(line, offset) || !parseRecord(line, out))
+    return false;
+  applyProgress(out);
+  return true;
+}
+
+void LibraryIndex::applyProgress(Book& book) const {
+  String value;
+  String f[PROGRESS_FIELDS];
+  if (!progress_.get(book.path, value) || splitFields(value, f, PROGRESS_FIELDS) < PROGRESS_FIELDS)
+    return;
+  book.opened = (uint32_t)strtoul(f[0].c_str(), nullptr, 10);
+  book.chapter = (int)f[1].toInt();
+  book.position = (int)f[2].toInt();
+  book.permille = (uint16_t)f[3].toInt();
+  book.flags |= (uint8_t)f[4].toInt();
+}
+
+int LibraryIndex::findEntry(const String& path, File& index, Book& out) {
+  uint32_t hash = hashPath(path);
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].pathHash == hash && readRecord(index, entries_[i], out) && out.path == path)
+      return (int)i;
+  }
+  return -1;
+}
+
+bool LibraryIndex::find(const String& path, Book& out) {
+  File index = SD.open(indexPath_.c_str());
+  if (!index)
+    return false;
+  int i = findEntry(path, index, out);
+  index.close();
+  return i >= 0;
+}
+
+void LibraryIndex::readMetadata(Book& book) {
+  String name = baseName(book.path);
+  if (hasExtension(name, ".epub")) {
+    EpubReader reader(book.path.c_str(), false);
+    if (reader.isValid()) {
+      book.title = reader.getTitle();
+      book.author = reader.getAuthor();
+      book.language = reader.getLanguage();
+      if (SD.exists(EpubReader::extractDirFor(book.path.c_str()).c_str()))
+        book.flags |= FLAG_EXTRACTED;
+      // Decode the cover now, so browsing only ever reads the small cached thumbnail
+      CoverThumbnail cover;
+      if (cover.build(reader, CoverThumbnail::pathFor(book.path.c_str()).c_str()))
+        book.flags |= FLAG_COVER;
+    }
+  }
+  if (book.title.isEmpty()) {
+    int dot = name.lastIndexOf('.');
+    book.title = dot > 0 ? name.substring(0, dot) : name;
+  }
+}
+
+void LibraryIndex::scanFolder(const String& folder, int depth) {
+  File dir = SD.open(folder.c_str());
+  if (!dir || !dir.isDirectory()) {
+    dir.close();
+    return;
+  }
+  String skip = parentFolder(indexPath_);  // Cache folder (/microreader)
+  while (true) {
+    File f = dir.openNextFile();
+    if (!f)
+      break;
+    String name = baseName(String(f.name()));
+    if (name.isEmpty() || name[0] == '.') {
+      f.close();
+      continue;
+    }
+    String path = joinPath(folder, name);
+    if (f.isDirectory()) {
+      f.close();
+      if (depth < MAX_FOLDER_DEPTH && path != skip)
+        scan_.folders.push_back(std::make_pair(path, depth + 1));
+      continue;
+    }
+    if (!hasExtension(name, ".epub") && !hasExtension(name, ".txt")) {
+      f.close();
+      continue;
+    }
+    uint32_t size = (uint32_t)f.size();
+    uint32_t mtime = (uint32_t)f.getLastWrite();
+    f.close();
+
+    // Unchanged if a record with this path hash has the same fingerprint
+    uint32_t hash = hashPath(path);
+    auto it = std::lower_bound(scan_.byHash.begin(), scan_.byHash.end(), std::make_pair(hash, (uint32_t)0));
+    bool known = false;
+    for (; it != scan_.byHash.end() && it->first == hash; ++it) {
+      const Entry& e = entries_[it->second];
+      if (e.size == size && e.mtime == mtime && !scan_.seen[it->second]) {
+        scan_.seen[it->second] = 1;
+        known = true;
+        break;
+      }
+    }
+    if (!known)
+      scan_.found.push_back({path, size, mtime});
+  }
+  dir.close();
+}
+
+bool LibraryIndex::refresh() {
+  startRefresh();
+  while (refreshStep()) {
+  }
+  return scan_.ok;
+}
+
+void LibraryIndex::startRefresh() {
+  if (scan_.active)
+    return;
+  scan_ = Scan();
+  scan_.active = true;
+  scan_.startTime = millis();
+  scan_.byHash.reserve(entries_.size());
+  for (size_t i = 0; i < entries_.size(); i++)
+    scan_.byHash.push_back(std::make_pair(entries_[i].pathHash, (uint32_t)i));
+  std::sort(scan_.byHash.begin(), scan_.byHash.end());
+  scan_.seen.assign(entries_.size(), 0);
+  scan_.folders.push_back(std::make_pair(root_, 0));
+}
+
+bool LibraryIndex::refreshStep() {
+  if (!scan_.active)
+    return false;
+
+  // Walk the card one folder at a time
+  if (!scan_.folders.empty()) {
+    std::pair<String, int> next = scan_.folders.back();
+    scan_.folders.pop_back();
+    scanFolder(next.first, next.second);
+    return true;
+  }
+
+  // Drop the records of removed and changed books; the first books on a card need an index to be appended to
+  if (!scan_.pruned) {
+    scan_.pruned = true;
+    int removed = (int)std::count(scan_.seen.begin(), scan_.seen.end(), 0);
+    Serial.printf("LibraryIndex: scan took %lu ms, %d new or changed, %d gone\n", millis() - scan_.startTime,
+                  (int)scan_.found.size(), removed);
+    if (removed > 0 || (!scan_.found.empty() && !SD.exists(indexPath_.c_str())))
+      scan_.ok = writeIndex(scan_.seen);
+    scan_.seen.clear();
+    scan_.byHash.clear();
+    if (scan_.ok && scan_.added < scan_.found.size())
+      return true;
+  }
+
+  // New and changed books, one per step; opening each EPUB also prepares its extract cache
+  if (scan_.ok && scan_.added < scan_.found.size()) {
+    scan_.ok = appendBook(scan_.found[scan_.added++]);
+    if (scan_.ok && scan_.added < scan_.found.size())
+      return true;
+  }
+
+  cancelRefresh();
+  return false;
+}
+
+void LibraryIndex::cancelRefresh() {
+  bool ok = scan_.ok;
+  scan_ = Scan();
+  scan_.ok = ok;
+}
+
+bool LibraryIndex::appendBook(const Found& found) {
+  Book book;
+  book.path = found.path;
+  book.size = found.size;
+  book.mtime = found.mtime;
+  readMetadata(book);
+
+  // A record cut by a reset was skipped by load(); rewriting drops it so this one starts on a line of its own
+  if (!endsWithNewline() && !writeIndex(std::vector<uint8_t>(entries_.size(), 1)))
+    return false;
+
+  File out = SD.open(indexPath_.c_str(), FILE_APPEND);
+  if (!out) {
+    Serial.printf("LibraryIndex: cannot append to %s\n", indexPath_.c_str());
+    return false;
+  }
+  uint32_t offset = (uint32_t)out.size();
+  bool ok;
+  {
+    BufferedFileWriter writer(out);
+    writeRecord(writer, book);
+    ok = writer.flush();
+  }
+  out.close();
+  if (!ok)
+    return false;
+
+  addEntry(book, offset);
+  viewValid_ = false;
+  revision_++;
+  return true;
+}
+
+bool LibraryIndex::endsWithNewline() {
+  File index = SD.open(indexPath_.c_str());
+  if (!index)
+    return false;
+  char last = 0;
+  size_t size = index.size();
+  if (size > 0 && index.seek(size - 1))
+    index.read((uint8_t*)&last, 1);
+  index.close();
+  return last == '\n';
+}
+
+bool LibraryIndex::writeIndex(const std::vector<uint8_t>& keep) {
+  String tmpPath = indexPath_ + ".tmp";
+  SD.remove(tmpPath.c_str());
+  File out = SD.open(tmpPath.c_str(), FILE_WRITE);
+  if (!out) {
+    Serial.printf("LibraryIndex: cannot create %s\n", tmpPath.c_str());
+    return false;
+  }
+
+  bool ok;
+  {
+    BufferedFileWriter writer(out);
+    char header[32];
+    snprintf(header, sizeof(header), "%s\t%d\t%lu\n", INDEX_MAGIC, INDEX_VERSION, (unsigned long)nextOpened_);
+    writer.print(header);
+
+    // Kept records, copied in file order with the journaled progress folded in
+    File old = SD.open(indexPath_.c_str());
+    if (old) {
+      LineReader reader(old, 0);
+      String line;
+      uint32_t offset;
+      size_t next = 0;
+      Book book;
+      while (next < entries_.size() && reader.next(line, offset)) {
+        if (offset != entries_[next].offset)
+          continue;  // Header or a line load() skipped
+        if (keep[next] && parseRecord(line, book)) {
+          applyProgress(book);
+          writeRecord(writer, book);
+        }
+        next++;
+      }
+      old.close();
+    }
+    writer.print(INDEX_END);
+    writer.put('\n');
+    ok = writer.flush();
+  }
+  out.close();
+
+  if (!ok) {
+    SD.remove(tmpPath.c_str());
+    return false;
+  }
+  SD.remove(indexPath_.c_str());
+  if (!SD.rename(tmpPath.c_str(), indexPath_.c_str())) {
+    Serial.printf("LibraryIndex: cannot rename %s\n", tmpPath.c_str());
+    return false;
+  }
+
+  // The records hold the progress now, so the journal starts over
+  std::vector<String> folded;
+  for (const auto& kv : progress_.entries())
+    folded.push_back(kv.first);
+  for (const String& path : folded)
+    progress_.erase(path);
+  progress_.commit();
+
+  bool complete;
+  return readIndex(indexPath_, complete);
+}
+
+bool LibraryIndex::recordProgress(const String& path, int chapter, int position, float progress, bool extracted) {
+  File index = SD.open(indexPath_.c_str());
+  if (!index)
+    return false;
+  Book book;
+  int i = findEntry(path, index, book);
+  index.close();
+  if (i < 0)
+    return false;
+
+  if (progress < 0.0f)
+    progress = 0.0f;
+  if (progress > 1.0f)
+    progress = 1.0f;
+  uint16_t permille = (uint16_t)(progress * 1000.0f + 0.5f);
+  uint32_t opened = nextOpened_++;
+  char value[64];
+  snprintf(value, sizeof(value), "%lu\t%d\t%d\t%u\t%u", (unsigned long)opened, chapter, position, (unsigned)permille,
+           (unsigned)((book.flags | (extracted ? FLAG_EXTRACTED : 0)) & FLAG_EXTRACTED));
+  if (!progress_.set(path, String(value)) || !progress_.commit())
+    return false;
+
+  entries_[i].opened = opened;
+  entries_[i].permille = permille;
+  viewValid_ = false;
+  return true;
+}
+
+void LibraryIndex::buildView(const String& folder, Sort sort) {
+  if (viewValid_ && viewFolder_ == folder && viewSort_ == sort)
+    return;
+  viewFolder_ = folder;
+  viewSort_ = sort;
+  viewFolders_.clear();
+  viewBooks_.clear();
+
+  // Subfolders: the next path component of every indexed folder below this one
+  String prefix = folder == "/" ? folder : folder + "/";
+  for (const String& f : folders_) {
+    if (f.length() <= prefix.length() || strncmp(f.c_str(), prefix.c_str(), prefix.length()) != 0)
+      continue;
+    int slash = f.indexOf('/', prefix.length());
+    String child = slash >= 0 ? f.substring(0, slash) : f;
+    if (std::find(viewFolders_.begin(), viewFolders_.end(), child) == viewFolders_.end())
+      viewFolders_.push_back(child);
+  }
+  std::sort(viewFolders_.begin(), viewFolders_.end(),
+            [](const String& a, const String& b) { return strcasecmp(a.c_str(), b.c_str()) < 0; });
+
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (folders_[entries_[i].folder] == folder)
+      viewBooks_.push_back((uint32_t)i);
+  }
+  const std::vector<Entry>& entries = entries_;
+  std::sort(viewBooks_.begin(), viewBooks_.end(), [&entries, sort](uint32_t a, uint32_t b) {
+    const Entry& ea = entries[a];
+    const Entry& eb = entries[b];
+    if (sort == SORT_RECENT && ea.opened != eb.opened)
+      return ea.opened > eb.opened;
+    int c = strcmp(ea.titleKey, eb.titleKey);
+    return c != 0 ? c < 0 : a < b;
+  });
+  viewValid_ = true;
+}
+
+int LibraryIndex::count(const String& folder) {
+  buildView(folder, viewValid_ ? viewSort_ : SORT_TITLE);
+  return (int)(viewFolders_.size() + viewBooks_.size());
+}
+
+int LibraryIndex::list(const String& folder, Sort sort, int start, int maxItems, std::vector<Item>& out) {
+  out.clear();
+  buildView(folder, sort);
+  int total = (int)(viewFolders_.size() + viewBooks_.size());
+  if (start < 0)
+    start = 0;
+  int end = std::min(total, start + maxItems);
+
+  File index;
+  for (int row = start; row < end; row++) {
+    Item item;
+    if (row < (int)viewFolders_.size()) {
+      item.isFolder = true;
+      item.folder = viewFolders_[row];
+    } else {
+      if (!index)
+        index = SD.open(indexPath_.c_str());
+      if (!index || !readRecord(index, entries_[viewBooks_[row - viewFolders_.size()]], item.book))
+        continue;
+    }
+    out.push_back(item);
+  }
+  if (index)
+    index.close();
+  return (int)out.size();
+}
+
+int LibraryIndex::rowOf(const String& folder, Sort sort, const String& path) {
+  buildView(folder, sort);
+  for (size_t i = 0; i < viewFolders_.size(); i++) {
+    if (viewFolders_[i] == path)
+      return (int)i;
+  }
+  uint32_t hash = hashPath(path);
+  File index;
+  Book book;
+  int row = -1;
+  for (size_t i = 0; i < viewBooks_.size() && row < 0; i++) {
+    const Entry& e = entries_[viewBooks_[i]];
+    if (e.pathHash != hash)
+      continue;
+    if (!index)
+      index = SD.open(indexPath_.c_str());
+    if (index && readRecord(index, e, book) && book.path == path)
+      row = (int)(viewFolders_.size() + i);
+  }
+  if (index)
+    index.close();
+  return row;
+}
@@ -0,0 +1,203 @@
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../../core/JournalStore.h"
+
+/**
+ * LibraryIndex - persistent index of the books on the SD card
+ *
+ * One text record per book in /microreader/library.idx (tab-separated, one
+ * line each): path, size/mtime fingerprint, title, author and language from
+ * EpubReader::parseMetadata(), reading progress and cache status. The
+ * browser lists folders from the index instead of opening every book.
+ *
+ * refresh() walks the card (directory entries only) and compares each
+ * book's size and mtime with its record. Only new or changed books are
+ * opened to read their metadata. Records of removed and changed books are
+ * dropped by rewriting the index, once per refresh and only if there are
+ * any; records of new books are appended one at a time. A rewrite goes to
+ * "<indexPath>.tmp", which replaces the index once it is complete; load()
+ * finishes a replacement that a reset interrupted. A record cut short by a
+ * reset (no line end) is ignored, so its book is indexed again, and is
+ * dropped by a rewrite before the next record is appended.
+ *
+ * The same refresh runs in the background with startRefresh() and one
+ * refreshStep() per scheduler step (a folder scanned or a book added), so
+ * the browser can list the books already indexed at once and pick up new
+ * ones as they arrive (getRevision()).
+ *
+ * Closing a book does not rewrite the index: its progress and recency go to
+ * a JournalStore next to it (library.jnl), which is laid over the records
+ * when they are read and folded into them by the next rewrite.
+ *
+ * Records stay on SD: memory holds a small fixed-size entry per book (record
+ * offset, path hash, fingerprint, sort keys), so thousands of books fit, and
+ * list() reads just the records of the rows being shown.
+ *
+ *   LibraryIndex library;
+ *   library.load();
+ *   library.refresh();
+ *   int rows = library.count("/");
+ *   std::vector<LibraryIndex::Item> page;
+ *   library.list("/", LibraryIndex::SORT_TITLE, 0, 16, page);
+ *
+ * Paths are full SD paths ("/books/Dune.epub"); folders are listed with
+ * their subfolders first, then their books.
+ */
+class LibraryIndex {
+ public:
+  enum Sort : uint8_t { SORT_TITLE, SORT_RECENT };
+
+  static const uint8_t FLAG_EXTRACTED = 0x01;  // EPUB extract cache was written when the book was indexed or opened
+  static const uint8_t FLAG_COVER = 0x02;      // A cover thumbnail was cached (CoverThumbnail::pathFor())
+
+  struct Book {
+    String path;
+    uint32_t size = 0;
+    uint32_t mtime = 0;
+    uint32_t opened = 0;  // Order of the last close (higher = more recent), 0 if never opened
+    int chapter = 0;
+    int position = 0;
+    uint16_t permille = 0;  // Progress through the book
+    uint8_t flags = 0;
+    String language;
+    String title;
+    String author;
+  };
+
+  // One row of a folder listing
+  struct Item {
+    bool isFolder = false;
+    String folder;  // Full path of the subfolder when isFolder
+    Book book;
+  };
+
+  // root: directory scanned for books ("/" on the device); indexPath: where the index is kept
+  explicit LibraryIndex(const char* root = "/", const char* indexPath = "/microreader/library.idx");
+
+  LibraryIndex(const LibraryIndex&) = delete;
+  LibraryIndex& operator=(const LibraryIndex&) = delete;
+
+  // Read the index file, adopting a complete rewrite left in "<indexPath>.tmp" by a reset. Returns false if it is
+  // missing or unreadable (the index is then empty).
+  bool load();
+
+  // Bring the index up to date with the card. Returns false if the new index could not be written.
+  bool refresh();
+
+  // The same in steps: startRefresh() (nothing if one is under way), then refreshStep() until it returns false.
+  // A refresh cut short by cancelRefresh() keeps the books it added; the next one finds the rest.
+  void startRefresh();
+  bool refreshStep();
+  void cancelRefresh();
+  bool isRefreshing() const {
+    return scan_.active;
+  }
+  // True if the last refresh wrote everything it had to
+  bool lastRefreshOk() const {
+    return scan_.ok;
+  }
+
+  // Changes whenever books are added to or dropped from the index
+  uint32_t getRevision() const {
+    return revision_;
+  }
+
+  // Rows (subfolders, then books) in a folder
+  int count(const String& folder);
+
+  // Fill out with up to maxItems rows of a folder starting at row start. Returns the number of rows.
+  int list(const String& folder, Sort sort, int start, int maxItems, std::vector<Item>& out);
+
+  // Row of a subfolder or book in a folder listing, or -1
+  int rowOf(const String& folder, Sort sort, const String& path);
+
+  // Look up one book by path
+  bool find(const String& path, Book& out);
+
+  // Store reading progress (0.0 to 1.0, as WordProvider::getPercentage()) when a book is closed; the book becomes
+  // the most recent one. Appends to the progress journal, the index itself is not rewritten.
+  bool recordProgress(const String& path, int chapter, int position, float progress, bool extracted);
+
+  int getBookCount() const {
+    return (int)entries_.size();
+  }
+  String getRoot() const {
+    return root_;
+  }
+
+  // "/books/Dune.epub" -> "/books", "/Dune.epub" -> "/"
+  static String parentFolder(const String& path);
+
+ private:
+  static const int TITLE_KEY_LENGTH = 11;
+
+  // Per-book state kept in memory; the record itself stays on SD
+  struct Entry {
+    uint32_t offset;  // Of the record line in the index file
+    uint32_t pathHash;
+    uint32_t size;
+    uint32_t mtime;
+    uint32_t opened;
+    uint16_t folder;  // Index into folders_
+    uint16_t permille;
+    char titleKey[TITLE_KEY_LENGTH + 1];  // Lowercased title prefix for sorting
+  };
+
+  // A file found by refresh() that needs a new record
+  struct Found {
+    String path;
+    uint32_t size;
+    uint32_t mtime;
+  };
+
+  // A refresh between its steps
+  struct Scan {
+    bool active = false;
+    bool ok = true;
+    bool pruned = false;                                // Records of removed and changed books dropped
+    std::vector<std::pair<String, int>> folders;        // Still to scan, with their depth
+    std::vector<std::pair<uint32_t, uint32_t>> byHash;  // (path hash, entry) of the records before the refresh
+    std::vector<uint8_t> seen;                          // Per entry: the book is still there, unchanged
+    std::vector<Found> found;
+    size_t added = 0;  // Books of found indexed so far
+    unsigned long startTime = 0;
+  };
+
+  bool readIndex(const String& path, bool& complete);
+  bool readRecord(File& index, const Entry& entry, Book& out);
+  bool writeIndex(const std::vector<uint8_t>& keep);
+  void applyProgress(Book& book) const;
+  void addEntry(const Book& book, uint32_t offset);
+  void scanFolder(const String& folder, int depth);
+  bool appendBook(const Found& found);
+  bool endsWithNewline();
+  void readMetadata(Book& book);
+  int findEntry(const String& path, File& index, Book& out);
+  uint16_t folderId(const String& folder);
+  void buildView(const String& folder, Sort sort);
+
+  String root_;
+  String indexPath_;
+  JournalStore progress_;  // Tab-separated opened, chapter, position, permille, flags by path; newer than the records
+  std::vector<Entry> entries_;
+  std::vector<String> folders_;  // Folders that directly hold indexed books
+  uint32_t nextOpened_ = 1;
+  uint32_t revision_ = 0;
+  Scan scan_;
+
+  // Listing order of the last folder asked for
+  bool viewValid_ = false;
+  String viewFolder_;
+  Sort viewSort_ = SORT_TITLE;
+  std::vector<String> viewFolders_;
+  std::vector<uint32_t> viewBooks_;
+};
+
+#endif
@@ -3,10 +3,15 @@
 #include <Arduino.h>
 #include <SD.h>
 #include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <cmath>  // for std::round
 #include <vector>
 
+#include "../../core/HeapTelemetry.h"
+#include "../../core/Trace.h"
+
 // #define EPUB_DEBUG_CLEAN_CACHE
 
 // Helper function to map language string to Language enum
@@ -148,7 +153,7 @@ bool EpubWordProvider::isInlineStyleElement(const String& name) {
   return name == "b" || name == "strong" || name == "i" || name == "em" || name == "span";
 }
 
-bool EpubWordProvider::convertXhtmlToTxt(const String& srcPath, String& outTxtPath, ConversionTimings* timings) {
+bool EpubWordProvider::convertXhtmlToTxt(const String& srcPath, String& outTxtPath) {
   if (srcPath.isEmpty())
     return false;
 
@@ -167,15 +172,6 @@ bool EpubWordProvider::convertXhtmlToTxt(const String& srcPath, String& outTxtPa
       size_t sz = chk.size();
       chk.close();
       if (sz > 0) {
-        if (timings) {
-          timings->total = 0;
-          timings->parserOpen = 0;
-          timings->outOpen = 0;
-          timings->conversion = 0;
-          timings->parserClose = 0;
-          timings->closeOut = 0;
-          timings->bytes = sz;
-        }
         Serial.printf("  Reusing existing TXT: %s  —  %u bytes\n", dest.c_str(), (unsigned)sz);
         outTxtPath = dest;
         return true;
@@ -190,60 +186,38 @@ bool EpubWordProvider::convertXhtmlToTxt(const String& srcPath, String& outTxtPa
   }
 
   // Open input and output files
+  TRACE_SCOPE_NAMED(convertScope, CONVERT_CHAPTER, 0);
+  HEAP_SUBSYSTEM(CONVERSION);
   SimpleXmlParser parser;
-  unsigned long totalStartMs = millis();
-  unsigned long t0 = millis();
   if (!parser.open(srcPath.c_str()))
     return false;
-  unsigned long parserOpenMs = millis() - t0;
-  if (timings)
-    timings->parserOpen = parserOpenMs;
 
-  t0 = millis();
   File out = SD.open(dest.c_str(), FILE_WRITE);
-  unsigned long outOpenMs = millis() - t0;
   if (!out) {
     parser.close();
     return false;
   }
-  Serial.printf("  Output file open took  %lu ms\n", outOpenMs);
-  if (timings)
-    timings->outOpen = outOpenMs;
+
+  String anchorPath = anchorPathFor(dest);
+  SD.remove(anchorPath.c_str());
+  File anchors = SD.open(anchorPath.c_str(), FILE_WRITE);
 
   // Perform the conversion using common logic
-  t0 = millis();
   size_t bytesWritten = 0;
-  performXhtmlToTxtConversion(parser, out, &bytesWritten);
-  unsigned long conversionMs = millis() - t0;
-  if (timings)
-    timings->conversion = conversionMs;
+  performXhtmlToTxtConversion(parser, out, &bytesWritten, anchors ? &anchors : nullptr);
+  HEAP_CHECKPOINT("conversion");
+  TRACE_SCOPE_END_ARG(convertScope, bytesWritten);
 
-  // Cleanup and close (timed)
-  t0 = millis();
   parser.close();
-  unsigned long parserCloseMs = millis() - t0;
-  if (timings)
-    timings->parserClose = parserCloseMs;
-  t0 = millis();
   out.close();
-  unsigned long closeOutMs = millis() - t0;
-  if (timings)
-    timings->closeOut = closeOutMs;
-  unsigned long totalMs = millis() - totalStartMs;
-  if (timings) {
-    timings->total = totalMs;
-    timings->bytes = (unsigned int)bytesWritten;
-  }
-  Serial.printf(
-      "Converted XHTML to TXT: %s  —  total = %lu ms  ( parserOpen = %lu, outOpen = %lu, conversion = %lu, parserClose "
-      "= %lu, "
-      "closeOut = %lu )\n",
-      dest.c_str(), totalMs, parserOpenMs, outOpenMs, conversionMs, parserCloseMs, closeOutMs);
+  if (anchors)
+    anchors.close();
+  Serial.printf("Converted XHTML to TXT: %s  —  %u bytes\n", dest.c_str(), (unsigned)bytesWritten);
   outTxtPath = dest;
   return true;
 }
 
-void EpubWordProvider::writeParagraphStyleToken(String& writeBuffer, String& pendingTag,
+void EpubWordProvider::writeParagraphStyleToken(BufferedFileWriter& writer, String& pendingTag,
                                                 const String& pendingParagraphClasses, const String& pendingInlineStyle,
                                                 bool& paragraphClassesWritten,
                                                 std::vector<char>& paragraphStyleEmitted) {
@@ -279,7 +253,7 @@ void EpubWordProvider::writeParagraphStyleToken(String& writeBuffer, String& pen
 
     if (combined.hasMarginTop) {
       for (int i = 0; i < combined.marginTop; ++i) {
-        writeBuffer += "\n";
+        writer.put('\n');
       }
     }
 
@@ -317,13 +291,13 @@ void EpubWordProvider::writeParagraphStyleToken(String& writeBuffer, String& pen
     }
 
     if (styleToken.length() > 0) {
-      writeBuffer += styleToken;
+      writer.print(styleToken);
     }
 
     // Automatically make headers bold to reflect typical user agent stylesheets
     if (isHeaderElement(pendingTag)) {
-      writeBuffer += (char)0x1B;  // ESC
-      writeBuffer += 'B';
+      writer.put((char)0x1B);  // ESC
+      writer.put('B');
       paragraphStyleEmitted.push_back('B');
     }
 
@@ -340,12 +314,12 @@ void EpubWordProvider::writeParagraphStyleToken(String& writeBuffer, String& pen
       if (spaces > 12)
         spaces = 12;
 
-      writeBuffer += (char)0x1B;  // ESC
-      writeBuffer += 'H';
+      writer.put((char)0x1B);  // ESC
+      writer.put('H');
       for (int i = 0; i < spaces; ++i)
-        writeBuffer += '-';
-      writeBuffer += (char)0x1B;  // ESC
-      writeBuffer += 'h';
+        writer.put('-');
+      writer.put((char)0x1B);  // ESC
+      writer.put('h');
     }
 
     // Paragraph-level CSS may also include font-weight/font-style which we
@@ -359,12 +333,12 @@ void EpubWordProvider::writeParagraphStyleToken(String& writeBuffer, String& pen
   }
 }
 
-void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File& out, size_t* outBytes) {
-  const size_t FLUSH_THRESHOLD = 2048;
-  if (outBytes)
-    *outBytes = 0;
-
-  String buffer;                     // Output buffer
+void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File& out, size_t* outBytes,
+                                                   File* anchors) {
+  BufferedFileWriter writer(out);    // Sector-aligned output block
+  // Element ids and where they land in the text, for TOC anchors
+  BufferedFileWriter* anchorWriter =
+      anchors ? new BufferedFileWriter(*anchors, BufferedFileWriter::SMALL_BLOCK_SIZE) : nullptr;
   std::vector<String> elementStack;  // Track nested elements
   std::vector<bool> linkStack;       // Track if each element is a link with href
   char lastCharWritten = '\0';       // Track last char written (persists across buffer flushes)
@@ -398,11 +372,11 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
             // Use lastCharWritten to handle case where buffer was flushed
             if (lastCharWritten != '\0' && lastCharWritten != ' ' && lastCharWritten != '\n' &&
                 lastCharWritten != '\t') {
-              buffer += ' ';
+              writer.put(' ');
             }
-            buffer += (char)0x1B;  // ESC
-            buffer += 'O';         // Link open (italic style)
-            buffer += '(';
+            writer.put((char)0x1B);  // ESC
+            writer.put('O');         // Link open (italic style)
+            writer.put('(');
           }
         }
         linkStack.push_back(isLinkWithHref);
@@ -411,13 +385,26 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
       // Block elements: add newline before if current line has content
       // This ensures blockquotes, nested divs, etc. start on a new line
       if (isBlockElement(name) && lineHasContent) {
-        buffer += "\n";
+        writer.put('\n');
         lastCharWritten = '\n';
         lineHasContent = false;
         lineHasNbsp = false;
         pendingLinkCloseSpace = false;  // Clear pending space at block boundaries
       }
 
+      // Record the element's id (or an old-style <a name>) at the text offset it starts at
+      if (anchorWriter) {
+        String id = parser.getAttribute("id");
+        if (id.isEmpty() && name == "a")
+          id = parser.getAttribute("name");
+        if (!id.isEmpty()) {
+          anchorWriter->print(id);
+          anchorWriter->put(' ');
+          anchorWriter->print((unsigned long)writer.position());
+          anchorWriter->put('\n');
+        }
+      }
+
       // Capture CSS classes and inline styles for block elements
       if (isBlockElement(name)) {
         pendingParagraphClasses = parser.getAttribute("class");
@@ -430,9 +417,9 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
       if (isInlineStyleElement(name) && !parser.isEmptyElement()) {
         String classAttr = parser.getAttribute("class");
         String styleAttr = parser.getAttribute("style");
-        // writeInlineStyleToken will push state into inlineStyleStack_ and
-        // emit a combined token if necessary (supports bold+italic stacking)
-        (void)writeInlineStyleToken(buffer, name, classAttr, styleAttr);
+        // writeInlineStyleToken pushes state into inlineStyleStack_; the combined
+        // token is emitted with the next text (supports bold+italic stacking)
+        (void)writeInlineStyleToken(name, classAttr, styleAttr);
       }
 
       // Handle <br/> - only add newline if line has content
@@ -445,18 +432,18 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
               char endCmd = startCmd;
               if (startCmd >= 'A' && startCmd <= 'Z') {
                 endCmd = (char)tolower(startCmd);
-                buffer += (char)0x1B;
+                writer.put((char)0x1B);
               }
-              buffer += endCmd;
+              writer.put(endCmd);
             }
             paragraphStyleEmitted.clear();
           }
           // Close any open inline styles before newline
           if (writtenInlineCombined_ != '\0') {
-            writeStyleResetToken(buffer, writtenInlineCombined_);
+            writeStyleResetToken(writer, writtenInlineCombined_);
             writtenInlineCombined_ = '\0';
           }
-          buffer += "\n";
+          writer.put('\n');
           lastCharWritten = '\n';
           lineHasContent = false;
           lineHasNbsp = false;
@@ -472,14 +459,14 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
 
       // Handle end of inline style elements
       if (isInlineStyleElement(name) && !inlineStyleStack_.empty()) {
-        closeInlineStyleElement(buffer);
+        closeInlineStyleElement();
       }
 
       // Handle end of link elements - add closing bracket and reset style
       if (name == "a" && !linkStack.empty() && linkStack.back()) {
-        buffer += ')';
-        buffer += (char)0x1B;  // ESC
-        buffer += 'o';         // Link close (reset style)
+        writer.put(')');
+        writer.put((char)0x1B);  // ESC
+        writer.put('o');         // Link close (reset style)
         // Set flag to potentially add space before next text content
         pendingLinkCloseSpace = true;
       }
@@ -494,21 +481,21 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
               char endCmd = startCmd;
               if (startCmd >= 'A' && startCmd <= 'Z') {
                 endCmd = (char)tolower(startCmd);
-                buffer += (char)0x1B;
+                writer.put((char)0x1B);
               }
-              buffer += endCmd;
+              writer.put(endCmd);
             }
             paragraphStyleEmitted.clear();
           }
 
-          buffer += "\n";
+          writer.put('\n');
           lastCharWritten = '\n';
         }
         // Close any open inline styles at paragraph end to prevent carry-over between paragraphs
         // Use the *written* inline combination so we close whatever was actually emitted
         // into the output buffer instead of the abstract current state.
         if (writtenInlineCombined_ != '\0') {
-          writeStyleResetToken(buffer, writtenInlineCombined_);
+          writeStyleResetToken(writer, writtenInlineCombined_);
           writtenInlineCombined_ = '\0';
         }
 
@@ -538,75 +525,94 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
         continue;
       }
 
-      // Read and process text
-      String text = readAndDecodeText(parser);
-      if (text.isEmpty()) {
-        continue;
-      }
-
-      // Check if we need to add a space after a link close
-      if (pendingLinkCloseSpace) {
-        // Only add space if text doesn't start with whitespace
-        bool startsWithWhitespace = false;
-        if (text.length() > 0) {
-          char firstChar = text.charAt(0);
-          startsWithWhitespace = (firstChar == ' ' || firstChar == '\n' || firstChar == '\t' || firstChar == '\r');
+      // Single pass over the node: decode entities, collapse whitespace and trim at line start while appending
+      // straight to the output buffer. Style tokens are written just before the first visible character.
+      bool firstChar = true;      // Next decoded char is the first of the node
+      bool textStarted = false;   // Style tokens written for this node
+      bool lastWasSpace = false;  // Collapse whitespace runs within the node
+      bool nbspLead = false;      // 0xC2 held back until we know whether it starts a UTF-8 nbsp
+
+      auto emit = [&](char c) {
+        if (!textStarted) {
+          writeParagraphStyleToken(writer, pendingTag, pendingParagraphClasses, pendingInlineStyle,
+                                   paragraphClassesWritten, paragraphStyleEmitted);
+          ensureInlineStyleEmitted(writer);
+          textStarted = true;
+          lineHasContent = true;
         }
-        if (!startsWithWhitespace) {
-          buffer += ' ';
+        writer.put(c);
+        lastCharWritten = c;
+      };
+
+      auto put = [&](char c) {
+        if (firstChar) {
+          firstChar = false;
+          // Space after a link close unless the text brings its own
+          if (pendingLinkCloseSpace) {
+            if (c != ' ' && c != '\n')
+              writer.put(' ');
+            pendingLinkCloseSpace = false;
+          }
         }
-        pendingLinkCloseSpace = false;
-      }
-
-      if (text.indexOf("\xC2\xA0") >= 0) {
-        lineHasNbsp = true;
-      }
-
-      // Normalize: collapse whitespace, convert nbsp to space
-      text = normalizeWhitespace(text);
-      if (text.isEmpty()) {
-        continue;
-      }
+        if (nbspLead) {
+          nbspLead = false;
+          if (c == '\xA0') {
+            lineHasNbsp = true;
+            c = ' ';
+          } else {
+            lastWasSpace = false;
+            emit('\xC2');
+          }
+        }
+        if (c == '\xC2') {
+          nbspLead = true;
+          return;
+        }
+        if (c == ' ' || c == '\n') {
+          // Leading whitespace at line start is dropped
+          if (lastWasSpace || !lineHasContent)
+            return;
+          c = ' ';
+          lastWasSpace = true;
+        } else {
+          lastWasSpace = false;
+        }
+        emit(c);
+      };
 
-      // Trim leading space if at line start
-      if (!lineHasContent) {
-        text = trimLeadingSpaces(text);
-        if (text.isEmpty()) {
+      while (parser.hasMoreTextChars()) {
+        char c = parser.readTextNodeCharForward();
+        if (c == '\r')
+          continue;
+        if (c == '\t')
+          c = ' ';
+        if (c != '&') {
+          put(c);
           continue;
         }
-      }
-
-      // Write style token at start of paragraph and remember the emitted raw tokens
-      writeParagraphStyleToken(buffer, pendingTag, pendingParagraphClasses, pendingInlineStyle, paragraphClassesWritten,
-                               paragraphStyleEmitted);
-
-      // Ensure inline style tokens (open/close) are emitted right before we write visible text
-      ensureInlineStyleEmitted(buffer);
-
-      // Append text
-      buffer += text;
-      lineHasContent = true;
-      // Track last character for space logic across buffer flushes
-      if (text.length() > 0) {
-        lastCharWritten = text.charAt(text.length() - 1);
-      }
-    }
 
-    // Periodic flush to avoid excessive memory use and ensure data hits SD
-    if (buffer.length() > FLUSH_THRESHOLD) {
-      // Remember last char before clearing buffer for space logic
-      if (buffer.length() > 0) {
-        lastCharWritten = buffer.charAt(buffer.length() - 1);
-      }
-      size_t toWrite = buffer.length();
-      size_t written = out.write((const uint8_t*)buffer.c_str(), toWrite);
-      if (outBytes)
-        *outBytes += written;
-      if (written != toWrite) {
-        Serial.printf("WARNING: partial write during conversion: attempted=%u wrote=%u\n", (unsigned)toWrite,
-                      (unsigned)written);
+        char entity[12];
+        size_t entityLength = 0;
+        entity[entityLength++] = '&';
+        while (parser.hasMoreTextChars()) {
+          char next = parser.readTextNodeCharForward();
+          entity[entityLength++] = next;
+          if (next == ';' || entityLength > 10)
+            break;
+        }
+        char decoded[4];
+        size_t decodedLength = SimpleXmlParser::decodeEntity(entity, entityLength, decoded);
+        if (decodedLength == 0) {
+          // Unknown entity - pass through as-is
+          for (size_t i = 0; i < entityLength; i++)
+            put(entity[i]);
+        } else {
+          for (size_t i = 0; i < decodedLength; i++)
+            put(decoded[i]);
+        }
       }
-      buffer = "";
+      if (nbspLead)
+        emit('\xC2');
     }
   }
 
@@ -618,16 +624,16 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
       char endCmd = startCmd;
       if (startCmd >= 'A' && startCmd <= 'Z') {
         endCmd = (char)tolower(startCmd);
-        buffer += (char)0x1B;
+        writer.put((char)0x1B);
       }
-      buffer += endCmd;
+      writer.put(endCmd);
     }
     paragraphStyleEmitted.clear();
   }
 
   // Close any remaining inline styles (close what was actually emitted)
   if (writtenInlineCombined_ != '\0') {
-    writeStyleResetToken(buffer, writtenInlineCombined_);
+    writeStyleResetToken(writer, writtenInlineCombined_);
     writtenInlineCombined_ = '\0';
   }
   // Reset base and stack state
@@ -635,19 +641,12 @@ void EpubWordProvider::performXhtmlToTxtConversion(SimpleXmlParser& parser, File
   currentInlineCombined_ = '\0';
   inlineStyleStack_.clear();
 
-  // Periodic flush and final flush using write() to verify bytes written
+  writer.flush();
   if (outBytes)
-    *outBytes = 0;
-
-  if (buffer.length() > 0) {
-    size_t toWrite = buffer.length();
-    size_t written = out.write((const uint8_t*)buffer.c_str(), toWrite);
-    if (outBytes)
-      *outBytes += written;
-    if (written != toWrite) {
-      Serial.printf("WARNING: partial write: attempted=%u wrote=%u\n", (unsigned)toWrite, (unsigned)written);
-    }
-    buffer = "";
+    *outBytes = writer.bytesWritten();
+  if (anchorWriter) {
+    anchorWriter->flush();
+    delete anchorWriter;
   }
 }
 
@@ -660,108 +659,7 @@ bool EpubWordProvider::isInsideSkippedElement(const std::vector<String>& element
   return false;
 }
 
-String EpubWordProvider::readAndDecodeText(SimpleXmlParser& parser) {
-  String result;
-
-  while (parser.hasMoreTextChars()) {
-    char c = parser.readTextNodeCharForward();
-
-    // Skip carriage returns
-    if (c == '\r') {
-      continue;
-    }
-
-    // Convert tabs to spaces
-    if (c == '\t') {
-      c = ' ';
-    }
-
-    // Decode HTML entities
-    if (c == '&') {
-      String entity = "&";
-      while (parser.hasMoreTextChars()) {
-        char next = parser.peekTextNodeChar();
-        entity += next;
-        parser.readTextNodeCharForward();
-        if (next == ';' || entity.length() > 10) {
-          break;
-        }
-      }
-      result += decodeHtmlEntity(entity);
-    } else {
-      result += c;
-    }
-  }
-
-  return result;
-}
-
-String EpubWordProvider::decodeHtmlEntity(const String& entity) {
-  if (entity == "&nbsp;")
-    return "\xC2\xA0";  // Non-breaking space
-  if (entity == "&amp;")
-    return "&";
-  if (entity == "&lt;")
-    return "<";
-  if (entity == "&gt;")
-    return ">";
-  if (entity == "&quot;")
-    return "\"";
-  if (entity == "&apos;")
-    return "'";
-  // Unknown entity - return as-is
-  return entity;
-}
-
-String EpubWordProvider::normalizeWhitespace(const String& text) {
-  String result;
-  bool lastWasSpace = false;
-
-  for (int i = 0; i < text.length(); i++) {
-    char c = text.charAt(i);
-
-    // Convert non-breaking space to regular space
-    if (c == '\xC2' && i + 1 < text.length() && text.charAt(i + 1) == '\xA0') {
-      c = ' ';
-      i++;  // skip the second byte (0xA0)
-    }
-
-    bool isSpace = (c == ' ' || c == '\n');
-
-    if (isSpace) {
-      if (!lastWasSpace) {
-        result += ' ';
-        lastWasSpace = true;
-      }
-    } else {
-      result += c;
-      lastWasSpace = false;
-    }
-  }
-
-  return result;
-}
-
-void EpubWordProvider::trimTrailingSpaces(String& buffer) {
-  while (buffer.length() > 0) {
-    char last = buffer.charAt(buffer.length() - 1);
-    if (last == ' ' || last == '\t') {
-      buffer = buffer.substring(0, buffer.length() - 1);
-    } else {
-      break;
-    }
-  }
-}
-
-String EpubWordProvider::trimLeadingSpaces(const String& text) {
-  int start = 0;
-  while (start < text.length() && (text.charAt(start) == ' ' || text.charAt(start) == '\n')) {
-    start++;
-  }
-  return text.substring(start);
-}
-
-char EpubWordProvider::writeInlineStyleToken(String& writeBuffer, const String& elementName, const String& classAttr,
+char EpubWordProvider::writeInlineStyleToken(const String& elementName, const String& classAttr,
                                              const String& styleAttr) {
   // Determine style flags for this element (from tag name, classes, inline styles)
   InlineStyleState state;
@@ -804,7 +702,7 @@ char EpubWordProvider::writeInlineStyleToken(String& writeBuffer, const String&
   return currentInlineCombined_;
 }
 
-void EpubWordProvider::closeInlineStyleElement(String& writeBuffer) {
+void EpubWordProvider::closeInlineStyleElement() {
   if (inlineStyleStack_.empty())
     return;
 
@@ -815,7 +713,7 @@ void EpubWordProvider::closeInlineStyleElement(String& writeBuffer) {
   updateEffectiveInlineCombined();
 }
 
-void EpubWordProvider::writeStyleResetToken(String& writeBuffer, char startCmd) {
+void EpubWordProvider::writeStyleResetToken(BufferedFileWriter& writer, char startCmd) {
   // Emit a token to reset back to normal style
   // Map startCmd (uppercase) to corresponding lowercase end token
   if (startCmd == '\0')
@@ -824,24 +722,24 @@ void EpubWordProvider::writeStyleResetToken(String& writeBuffer, char startCmd)
   if (endCmd >= 'A' && endCmd <= 'Z') {
     endCmd = (char)tolower(endCmd);
   }
-  writeBuffer += (char)0x1B;  // ESC
-  writeBuffer += endCmd;      // Reset token corresponding to startCmd
+  writer.put((char)0x1B);  // ESC
+  writer.put(endCmd);      // Reset token corresponding to startCmd
 }
 
-void EpubWordProvider::ensureInlineStyleEmitted(String& writeBuffer) {
+void EpubWordProvider::ensureInlineStyleEmitted(BufferedFileWriter& writer) {
   // If the written style already matches current, nothing to do
   if (writtenInlineCombined_ == currentInlineCombined_)
     return;
 
   // Close whatever was previously emitted
   if (writtenInlineCombined_ != '\0') {
-    writeStyleResetToken(writeBuffer, writtenInlineCombined_);
+    writeStyleResetToken(writer, writtenInlineCombined_);
   }
 
   // Open new combined style if any
   if (currentInlineCombined_ != '\0') {
-    writeBuffer += (char)0x1B;
-    writeBuffer += currentInlineCombined_;
+    writer.put((char)0x1B);
+    writer.put(currentInlineCombined_);
   }
 
   // Update the written-tracking state
@@ -902,8 +800,7 @@ static int parser_stream_callback(char* buffer, size_t maxSize, void* userData)
   return bytesRead;
 }
 
-bool EpubWordProvider::convertXhtmlStreamToTxt(const char* epubFilename, String& outTxtPath,
-                                               ConversionTimings* timings) {
+bool EpubWordProvider::convertXhtmlStreamToTxt(const char* epubFilename, String& outTxtPath) {
   if (!epubReader_) {
     return false;
   }
@@ -923,9 +820,6 @@ bool EpubWordProvider::convertXhtmlStreamToTxt(const char* epubFilename, String&
     createDirRecursive(dir);
   }
 
-  // Start pull-based streaming from EPUB
-  unsigned long totalStartMs = millis();
-  unsigned long t0 = millis();
   // If the TXT file already exists and is non-empty, reuse it and skip conversion
   if (SD.exists(dest.c_str())) {
     File chk = SD.open(dest.c_str());
@@ -933,17 +827,6 @@ bool EpubWordProvider::convertXhtmlStreamToTxt(const char* epubFilename, String&
       size_t sz = chk.size();
       chk.close();
       if (sz > 0) {
-        if (timings) {
-          timings->total = 0;
-          timings->startStream = 0;
-          timings->parserOpen = 0;
-          timings->outOpen = 0;
-          timings->conversion = 0;
-          timings->parserClose = 0;
-          timings->endStream = 0;
-          timings->closeOut = 0;
-          timings->bytes = sz;
-        }
         Serial.printf("  Reusing existing streamed TXT: %s  —  %u bytes\n", dest.c_str(), (unsigned)sz);
         outTxtPath = dest;
         return true;
@@ -951,10 +834,10 @@ bool EpubWordProvider::convertXhtmlStreamToTxt(const char* epubFilename, String&
     }
   }
 
+  // Start pull-based streaming from EPUB
+  TRACE_SCOPE_NAMED(convertScope, CONVERT_CHAPTER, 0);
+  HEAP_SUBSYSTEM(CONVERSION);
   epub_stream_context* epubStream = epubReader_->startStreaming(epubFilename);
-  unsigned long startStreamingMs = millis() - t0;
-  if (timings)
-    timings->startStream = startStreamingMs;
   if (!epubStream) {
     Serial.printf("ERROR: Failed to start EPUB streaming for file: %s\n", epubFilename);
     return false;
@@ -966,7 +849,6 @@ bool EpubWordProvider::convertXhtmlStreamToTxt(const char* epubFilename, String&
 
   // Open parser in streaming mode
   SimpleXmlParser parser;
-  t0 = millis();
   // Memory debug: before opening parser from stream
   uint32_t heapBeforeParserOpen = ESP.getFreeHeap();
   Serial.printf("  [MEM] before parser.openFromStream: Free=%u, Total=%u, MinFree=%u\n", heapBeforeParserOpen,
@@ -985,53 +867,33 @@ bool EpubWordProvider::convertXhtmlStreamToTxt(const char* epubFilename, String&
   uint32_t heapAfterParserOpen = ESP.getFreeHeap();
   int32_t parserOpenDelta = (int32_t)heapAfterParserOpen - (int32_t)heapBeforeParserOpen;
   Serial.printf("  [MEM] after parser.openFromStream: Free=%u (delta: %d)\n", heapAfterParserOpen, parserOpenDelta);
-  unsigned long parserOpenMs = millis() - t0;
-  if (timings)
-    timings->parserOpen = parserOpenMs;
 
-  // Remove existing file to ensure clean write (timed)
-  t0 = millis();
+  // Remove existing file to ensure clean write
   if (SD.exists(dest.c_str())) {
     SD.remove(dest.c_str());
   }
   File out = SD.open(dest.c_str(), FILE_WRITE);
-  unsigned long outOpenMs = millis() - t0;
   if (!out) {
     Serial.printf("ERROR: Failed to open output TXT file '%s' for writing\n", dest.c_str());
     parser.close();
     epub_end_streaming(epubStream);
     return false;
   }
-  Serial.printf("  Output file open took  %lu ms\n", outOpenMs);
-  if (timings)
-    timings->outOpen = outOpenMs;
 
-  // Perform the conversion using common logic (timed)
-  t0 = millis();
+  String anchorPath = anchorPathFor(dest);
+  SD.remove(anchorPath.c_str());
+  File anchors = SD.open(anchorPath.c_str(), FILE_WRITE);
+
+  // Perform the conversion using common logic
   size_t bytesWritten = 0;
-  performXhtmlToTxtConversion(parser, out, &bytesWritten);
-  unsigned long conversionMs = millis() - t0;
-  if (timings)
-    timings->conversion = conversionMs;
+  performXhtmlToTxtConversion(parser, out, &bytesWritten, anchors ? &anchors : nullptr);
+  HEAP_CHECKPOINT("conversion");
 
-  // Close parser and streaming in separate timed steps
-  t0 = millis();
   parser.close();
-  unsigned long parserCloseMs = millis() - t0;
-  if (timings)
-    timings->parserClose = parserCloseMs;
-
-  t0 = millis();
   epub_end_streaming(epubStream);
-  unsigned long endStreamMs = millis() - t0;
-  if (timings)
-    timings->endStream = endStreamMs;
-
-  t0 = millis();
   out.close();
-  unsigned long closeOutMs = millis() - t0;
-  if (timings)
-    timings->closeOut = closeOutMs;
+  if (anchors)
+    anchors.close();
 
   // Re-open the output file to get final size (some SD implementations report size=0 until closed)
   File check = SD.open(dest.c_str());
@@ -1043,23 +905,16 @@ bool EpubWordProvider::convertXhtmlStreamToTxt(const char* epubFilename, String&
   Serial.printf("  [STREAM] bytesPulled=%u, bytesWrittenReported=%u\n", (unsigned)streamCtx.bytesPulled,
                 (unsigned)checkSize);
   bytesWritten = checkSize;
+  TRACE_SCOPE_END_ARG(convertScope, bytesWritten);
 
-  unsigned long totalMs = millis() - totalStartMs;
-  if (timings) {
-    timings->total = totalMs;
-    timings->bytes = (unsigned int)bytesWritten;
-  }
-  Serial.printf(
-      "Converted XHTML to TXT (streamed): %s  —  total = %lu ms  ( startStream = %lu, parserOpen = %lu, outOpen = %lu, "
-      "conversion = "
-      "%lu, parserClose = %lu, endStream = %lu, closeOut = %lu )  —  %u bytes\n",
-      dest.c_str(), totalMs, startStreamingMs, parserOpenMs, (timings ? timings->outOpen : 0), conversionMs,
-      parserCloseMs, endStreamMs, closeOutMs, (unsigned int)bytesWritten);
+  Serial.printf("Converted XHTML to TXT (streamed): %s  —  %u bytes\n", dest.c_str(), (unsigned int)bytesWritten);
   outTxtPath = dest;
   return true;
 }
 
 bool EpubWordProvider::openChapter(int chapterIndex) {
+  TRACE_SCOPE(OPEN_CHAPTER, chapterIndex);
+  HEAP_SUBSYSTEM(EPUB);
   if (!epubReader_) {
     return false;
   }
@@ -1070,21 +925,6 @@ bool EpubWordProvider::openChapter(int chapterIndex) {
     return false;
   }
 
-  const SpineItem* spineItem = epubReader_->getSpineItem(chapterIndex);
-  if (!spineItem) {
-    Serial.printf("ERROR: Failed to get spine item for chapter index %d\n", chapterIndex);
-    return false;
-  }
-
-  // Build full path: content.opf is at OEBPS/content.opf, so hrefs are relative to OEBPS/
-  String contentOpfPath = epubReader_->getContentOpfPath();
-  String baseDir = "";
-  int lastSlash = contentOpfPath.lastIndexOf('/');
-  if (lastSlash >= 0) {
-    baseDir = contentOpfPath.substring(0, lastSlash + 1);
-  }
-  String fullHref = baseDir + spineItem->href;
-
   // Close existing parser if any
   if (parser_) {
     parser_->close();
@@ -1092,52 +932,19 @@ bool EpubWordProvider::openChapter(int chapterIndex) {
     parser_ = nullptr;
   }
 
-  // Convert XHTML to text file using selected method
-  String txtPath;
-  unsigned long convStart = millis();
-  if (useStreamingConversion_) {
-    // Stream XHTML from EPUB directly to memory and convert (no intermediate XHTML file)
-    ConversionTimings t;
-    if (!convertXhtmlStreamToTxt(fullHref.c_str(), txtPath, &t)) {
-      return false;
-    }
-    // Print detailed breakdown for chapter-level conversion
-    Serial.printf(
-        "    Converted XHTML to TXT (streamed): %s  —  total = %lu ms  ( startStream = %lu, parserOpen = %lu, outOpen "
-        "= %lu, conversion = %lu, parserClose = %lu, endStream = %lu, closeOut = %lu )  —  %u bytes\n",
-        txtPath.c_str(), t.total, t.startStream, t.parserOpen, t.outOpen, t.conversion, t.parserClose, t.endStream,
-        t.closeOut, (unsigned int)t.bytes);
-  } else {
-    // Extract XHTML file first, then convert from file
-    String xhtmlPath = epubReader_->getFile(fullHref.c_str());
-    if (xhtmlPath.isEmpty()) {
-      return false;
-    }
-    ConversionTimings t;
-    if (!convertXhtmlToTxt(xhtmlPath, txtPath, &t)) {
-      return false;
-    }
-    // Print detailed breakdown for chapter-level conversion when using file-based conversion
-    Serial.printf(
-        "    Converted XHTML to TXT: %s  —  total = %lu ms  ( parserOpen = %lu, outOpen = %lu, conversion = %lu, "
-        "parserClose = %lu, closeOut = %lu )  —  %u bytes\n",
-        txtPath.c_str(), t.total, t.parserOpen, t.outOpen, t.conversion, t.parserClose, t.closeOut,
-        (unsigned int)t.bytes);
+  String txtPath = getChapterTextPath(chapterIndex);
+  if (txtPath.isEmpty()) {
+    return false;
   }
-  unsigned long conversionAndExtractMs = millis() - convStart;
-  Serial.printf("  Chapter conversion + extract took  %lu ms\n", conversionAndExtractMs);
 
-  String newXhtmlPath = fullHref;  // Keep for tracking
+  String newXhtmlPath = chapterHref(chapterIndex);  // Keep for tracking
 
   // Delete any previous file provider and create new one for this chapter
   if (fileProvider_) {
     delete fileProvider_;
     fileProvider_ = nullptr;
   }
-  unsigned long fileProvStart = millis();
   fileProvider_ = new FileWordProvider(txtPath.c_str(), bufSize_);
-  unsigned long fileProvMs = millis() - fileProvStart;
-  Serial.printf("    FileWordProvider init took  %lu ms\n", fileProvMs);
   if (!fileProvider_ || !fileProvider_->isValid()) {
     if (fileProvider_) {
       delete fileProvider_;
@@ -1162,10 +969,196 @@ bool EpubWordProvider::openChapter(int chapterIndex) {
   currentIndex_ = 0;
 
   Serial.printf("Opened chapter %d: %s\n", chapterIndex, currentChapterName_.c_str());
+  HEAP_CHECKPOINT("chapter open");
 
   return true;
 }
 
+String EpubWordProvider::chapterHref(int chapterIndex) {
+  const SpineItem* spineItem = epubReader_->getSpineItem(chapterIndex);
+  if (!spineItem) {
+    Serial.printf("ERROR: Failed to get spine item for chapter index %d\n", chapterIndex);
+    return String("");
+  }
+
+  // Build full path: content.opf is at OEBPS/content.opf, so hrefs are relative to OEBPS/
+  String contentOpfPath = epubReader_->getContentOpfPath();
+  String baseDir = "";
+  int lastSlash = contentOpfPath.lastIndexOf('/');
+  if (lastSlash >= 0) {
+    baseDir = contentOpfPath.substring(0, lastSlash + 1);
+  }
+  return baseDir + spineItem->href;
+}
+
+String EpubWordProvider::getChapterTextPath(int chapterIndex) {
+  String txtPath;
+  if (!isEpub_) {
+    if (chapterIndex != 0 || !convertXhtmlToTxt(xhtmlPath_, txtPath))
+      return String("");
+    return txtPath;
+  }
+  if (!epubReader_ || chapterIndex < 0 || chapterIndex >= epubReader_->getSpineCount())
+    return String("");
+  String fullHref = chapterHref(chapterIndex);
+  if (fullHref.isEmpty())
+    return String("");
+
+  // Convert XHTML to text file using selected method
+  if (useStreamingConversion_) {
+    // Stream XHTML from EPUB directly to memory and convert (no intermediate XHTML file)
+    if (!convertXhtmlStreamToTxt(fullHref.c_str(), txtPath)) {
+      return String("");
+    }
+  } else {
+    // Extract XHTML file first, then convert from file
+    String xhtmlPath = epubReader_->getFile(fullHref.c_str());
+    if (xhtmlPath.isEmpty()) {
+      return String("");
+    }
+    if (!convertXhtmlToTxt(xhtmlPath, txtPath)) {
+      return String("");
+    }
+  }
+  return txtPath;
+}
+
+String EpubWordProvider::anchorPathFor(const String& txtPath) {
+  String path = txtPath;
+  int length = path.length();
+  if (length > 4 && path.substring(length - 4) == ".txt") {
+    path = path.substring(0, length - 4);
+  }
+  return path + ".anc";
+}
+
+int EpubWordProvider::findAnchor(int chapterIndex, const String& id) {
+  if (id.isEmpty()) {
+    return -1;
+  }
+  String txtPath = getChapterTextPath(chapterIndex);
+  if (txtPath.isEmpty()) {
+    return -1;
+  }
+  File in = SD.open(anchorPathFor(txtPath).c_str());
+  if (!in) {
+    return -1;
+  }
+
+  // Match lines as they stream past; ids too long for the line buffer never match
+  uint8_t block[256];
+  char line[96];
+  size_t lineLength = 0;
+  bool overflow = false;
+  int result = -1;
+  size_t n;
+  while (result < 0 && (n = in.read(block, sizeof(block))) > 0) {
+    for (size_t i = 0; i < n && result < 0; i++) {
+      if (block[i] != '\n') {
+        if (lineLength < sizeof(line) - 1)
+          line[lineLength++] = (char)block[i];
+        else
+          overflow = true;
+        continue;
+      }
+      line[lineLength] = '\0';
+      char* space = strrchr(line, ' ');
+      if (!overflow && space && (size_t)(space - line) == (size_t)id.length() &&
+          strncmp(line, id.c_str(), id.length()) == 0)
+        result = atoi(space + 1);
+      lineLength = 0;
+      overflow = false;
+    }
+  }
+  in.close();
+  return result;
+}
+
+bool EpubWordProvider::locatePercentage(float percentage, int& chapter, int& position) {
+  if (percentage < 0.0f)
+    percentage = 0.0f;
+  if (percentage > 1.0f)
+    percentage = 1.0f;
+  if (!isEpub_ || !epubReader_ || epubReader_->getTotalBookSize() == 0) {
+    if (!fileProvider_)
+      return false;
+    chapter = 0;
+    position = (int)(percentage * fileSize_);
+    return true;
+  }
+
+  // Spine offsets are cumulative XHTML sizes: the chapter is the last one starting at or before the target
+  size_t target = (size_t)(percentage * epubReader_->getTotalBookSize());
+  int lo = 0;
+  int hi = epubReader_->getSpineCount() - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (epubReader_->getSpineItemOffset(mid) <= target)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  size_t xhtmlSize = epubReader_->getSpineItemSize(lo);
+  size_t into = target - epubReader_->getSpineItemOffset(lo);
+  float fraction = 0.0f;
+  if (xhtmlSize > 0)
+    fraction = into < xhtmlSize ? (float)into / (float)xhtmlSize : 1.0f;
+
+  // The same fraction of the converted text, as getPercentage() maps it back
+  String txtPath = getChapterTextPath(lo);
+  if (txtPath.isEmpty())
+    return false;
+  File f = SD.open(txtPath.c_str());
+  size_t textSize = 0;
+  if (f) {
+    textSize = f.size();
+    f.close();
+  }
+  chapter = lo;
+  position = (int)(fraction * textSize);
+  return true;
+}
+
+bool EpubWordProvider::locateTocEntry(int tocIndex, int& chapter, int& position) {
+  const TocItem* item = epubReader_ ? epubReader_->getTocItem(tocIndex) : nullptr;
+  if (!item)
+    return false;
+  int spineIndex = epubReader_->getSpineIndexForHref(item->href);
+  if (spineIndex < 0)
+    return false;
+  chapter = spineIndex;
+  position = 0;
+  if (!item->anchor.isEmpty()) {
+    int anchorPosition = findAnchor(spineIndex, item->anchor);
+    if (anchorPosition > 0)
+      position = anchorPosition;
+  }
+  return true;
+}
+
+int EpubWordProvider::findTocEntryBefore(int chapter, int position) {
+  if (!epubReader_)
+    return -1;
+  // Only entries in `chapter` itself need their anchors resolved
+  int found = -1;
+  for (int i = 0; i < epubReader_->getTocCount(); i++) {
+    const TocItem* item = epubReader_->getTocItem(i);
+    int spineIndex = epubReader_->getSpineIndexForHref(item->href);
+    if (spineIndex < 0 || spineIndex > chapter)
+      continue;
+    if (spineIndex < chapter) {
+      found = i;
+      continue;
+    }
+    int entryPosition = item->anchor.isEmpty() ? 0 : findAnchor(spineIndex, item->anchor);
+    if (entryPosition < 0)
+      entryPosition = 0;
+    if (entryPosition < position)
+      found = i;
+  }
+  return found;
+}
+
 int EpubWordProvider::getChapterCount() {
   if (!epubReader_) {
     return 1;  // Single XHTML file = 1 chapter
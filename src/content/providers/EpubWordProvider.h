@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <vector>
 
+#include "../../core/BufferedFileWriter.h"
 #include "../../text/hyphenation/HyphenationStrategy.h"
 #include "../epub/EpubReader.h"
 #include "../xml/SimpleXmlParser.h"
@@ -54,6 +55,11 @@ class EpubWordProvider : public WordProvider {
   // Get the language of the EPUB for hyphenation
   Language getLanguage() const;
 
+  // Underlying EPUB (spine sizes, TOC); nullptr for direct XHTML files
+  const EpubReader* getEpubReader() const {
+    return epubReader_;
+  }
+
   // Style support
   CssStyle getCurrentStyle() override {
     return CssStyle();
@@ -65,6 +71,25 @@ class EpubWordProvider : public WordProvider {
     return TextAlign::Left;
   }
 
+  // Converted text file of a chapter, converting it first if needed, without leaving the current chapter;
+  // empty on failure. Direct XHTML files have only chapter 0.
+  String getChapterTextPath(int chapterIndex);
+
+  // Navigation targets as (chapter, text index) pairs, computed without opening the chapter: at most its
+  // conversion, a file size and an anchor table lookup.
+  // A book-wide fraction (0..1), inverting getPercentage()
+  bool locatePercentage(float percentage, int& chapter, int& position);
+  // A TOC entry: its spine item, and within it the element its anchor names (the chapter start if the anchor is
+  // not found); false if the entry's file is not in the spine
+  bool locateTocEntry(int tocIndex, int& chapter, int& position);
+  // The last TOC entry that starts before (chapter, position), -1 if none
+  int findTocEntryBefore(int chapter, int position);
+  // Text index of the element with the given id in a chapter, -1 if there is none
+  int findAnchor(int chapterIndex, const String& id);
+
+  // Anchor table written next to a converted chapter: one "<id> <text index>" line per element with an id
+  static String anchorPathFor(const String& txtPath);
+
   // Streaming conversion mode (true = extract to memory, false = extract to file first)
   void setUseStreamingConversion(bool enabled) {
     useStreamingConversion_ = enabled;
@@ -74,20 +99,12 @@ class EpubWordProvider : public WordProvider {
   }
 
  private:
-  struct ConversionTimings {
-    unsigned long startStream = 0;
-    unsigned long parserOpen = 0;
-    unsigned long outOpen = 0;
-    unsigned long conversion = 0;
-    unsigned long parserClose = 0;
-    unsigned long endStream = 0;
-    unsigned long closeOut = 0;
-    unsigned long total = 0;
-    size_t bytes = 0;
-  };
   // Opens a specific chapter (spine item) for reading
   bool openChapter(int chapterIndex);
 
+  // Archive path of a chapter's XHTML (content.opf directory + spine href); empty if there is no such item
+  String chapterHref(int chapterIndex);
+
   // Helper to check if an element is a block-level element
   bool isBlockElement(const String& name);
 
@@ -101,27 +118,28 @@ class EpubWordProvider : public WordProvider {
   bool isInlineStyleElement(const String& name);
 
   // Convert an XHTML file to a plain-text file suitable for FileWordProvider.
-  bool convertXhtmlToTxt(const String& srcPath, String& outTxtPath, ConversionTimings* timings = nullptr);
+  bool convertXhtmlToTxt(const String& srcPath, String& outTxtPath);
 
   // Convert XHTML from EPUB stream to plain-text file (no intermediate XHTML file)
-  bool convertXhtmlStreamToTxt(const char* epubFilename, String& outTxtPath, ConversionTimings* timings = nullptr);
+  bool convertXhtmlStreamToTxt(const char* epubFilename, String& outTxtPath);
 
   // Common conversion logic used by both convertXhtmlToTxt and convertXhtmlStreamToTxt
   // If outBytes is provided, it will be set to the number of bytes written to `out`.
-  void performXhtmlToTxtConversion(SimpleXmlParser& parser, File& out, size_t* outBytes = nullptr);
+  // If anchors is provided, the element ids and their offsets in `out` are written to it.
+  void performXhtmlToTxtConversion(SimpleXmlParser& parser, File& out, size_t* outBytes = nullptr,
+                                   File* anchors = nullptr);
 
   // Emit style properties for a paragraph's classes and inline styles as an escaped token written to buffer
-  void writeParagraphStyleToken(String& writeBuffer, String& name, const String& pendingParagraphClasses,
+  void writeParagraphStyleToken(BufferedFileWriter& writer, String& name, const String& pendingParagraphClasses,
                                 const String& pendingInlineStyle, bool& paragraphClassesWritten,
                                 std::vector<char>& paragraphStyleEmitted);
 
   // Emit inline style token (for bold/italic elements like <b>, <i>, <em>, <strong>, <span>)
   // Returns the uppercase command char emitted (e.g. 'B','I','X') or '\0' if none
-  char writeInlineStyleToken(String& writeBuffer, const String& elementName, const String& classAttr,
-                             const String& styleAttr);
+  char writeInlineStyleToken(const String& elementName, const String& classAttr, const String& styleAttr);
 
   // Close an inline style element (called when an inline element ends)
-  void closeInlineStyleElement(String& writeBuffer);
+  void closeInlineStyleElement();
 
   // Track active inline style stack for correct combined styling (bold+italic = 'X')
   struct InlineStyleState {
@@ -148,23 +166,18 @@ class EpubWordProvider : public WordProvider {
   void updateEffectiveInlineCombined();
 
   // Emit style reset token (to return to normal after inline style element closes)
-  void writeStyleResetToken(String& writeBuffer, char startCmd);
+  void writeStyleResetToken(BufferedFileWriter& writer, char startCmd);
 
   // Ensure that the currently-emitted inline style in the output buffer matches
   // the effective inline style state (`currentInlineCombined_`). This will emit
   // the necessary reset/open tokens just before writing visible text.
-  void ensureInlineStyleEmitted(String& writeBuffer);
+  void ensureInlineStyleEmitted(BufferedFileWriter& writer);
 
   // Helper to create directories recursively for a given path
   bool createDirRecursive(const String& path);
 
   // Text processing helpers
   bool isInsideSkippedElement(const std::vector<String>& elementStack);
-  String readAndDecodeText(SimpleXmlParser& parser);
-  String decodeHtmlEntity(const String& entity);
-  String normalizeWhitespace(const String& text);
-  void trimTrailingSpaces(String& buffer);
-  String trimLeadingSpaces(const String& text);
 
   bool valid_ = false;
   bool isEpub_ = false;                 // True if source is EPUB, false if direct XHTML
@@ -2,6 +2,8 @@
 
 #include <Arduino.h>
 
+#include "../../core/HeapTelemetry.h"
+#include "../../core/Trace.h"
 #include "WString.h"
 
 // ESC-based format constants:
@@ -163,7 +165,7 @@ FileWordProvider::FileWordProvider(const char* path, size_t bufSize) : bufSize_(
   fileSize_ = file_.size();
   index_ = 0;
   prevIndex_ = 0;
-  buf_ = (uint8_t*)malloc(bufSize_);
+  buf_ = (uint8_t*)HeapTelemetry::allocate(bufSize_);
   bufStart_ = 0;
   bufLen_ = 0;
   // Skip UTF-8 BOM at start of file if present so it doesn't appear as a word
@@ -176,7 +178,7 @@ FileWordProvider::~FileWordProvider() {
   if (file_)
     file_.close();
   if (buf_)
-    free(buf_);
+    HeapTelemetry::release(buf_);
 }
 
 bool FileWordProvider::hasNextWord() {
@@ -215,7 +217,9 @@ bool FileWordProvider::ensureBufferForPos(size_t pos) {
 
   if (!file_.seek(start))
     return false;
+  TRACE_SCOPE_NAMED(readScope, SD_READ, start);
   size_t r = file_.read(buf_, bufSize_);
+  TRACE_SCOPE_END_ARG(readScope, r);
   if (r == 0)
     return false;
   bufStart_ = start;
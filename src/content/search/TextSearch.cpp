@@ -0,0 +1,386 @@
+#include "TextSearch.h"
+
+#include <SD.h>
+#include <string.h>
+
+#include "../../core/HeapTelemetry.h"
+
+static const char FILTER_MAGIC[4] = {'M', 'R', 'T', 'G'};
+static const size_t FILTER_HEADER_SIZE = 8;
+
+// Base letters of U+00C0..U+00FF; 0 keeps the code point (with 'x' marking the two-letter folds below)
+static const char LATIN1_BASE[64 + 1] =
+    "aaaaaaxceeeeiiiidnooooo\0ouuuuy\0x"
+    "aaaaaaxceeeeiiiidnooooo\0ouuuuy\0y";
+// Base letters of U+0100..U+017F (Latin Extended-A); 'x' marks the ligatures
+static const char LATIN_EXT_A_BASE[128 + 1] =
+    "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiiixxjjkkkllllllllllnnnnnnnnnooooooxxrrrrrrsssssssstttttt"
+    "uuuuuuuuuuuuwwyyyzzzzzzs";
+
+static inline bool isSpace(uint32_t cp) {
+  return cp <= 0x20 || cp == 0xA0 || (cp >= 0x2000 && cp <= 0x200A) || cp == 0x2028 || cp == 0x2029 ||
+         cp == 0x202F || cp == 0x3000;
+}
+
+// Characters that never show: soft hyphen, zero-width space and joiners, byte order mark
+static inline bool isInvisible(uint32_t cp) {
+  return cp == 0xAD || (cp >= 0x200B && cp <= 0x200D) || cp == 0xFEFF;
+}
+
+static size_t encodeUtf8(uint32_t cp, uint8_t* out) {
+  if (cp < 0x80) {
+    out[0] = (uint8_t)cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = (uint8_t)(0xC0 | (cp >> 6));
+    out[1] = (uint8_t)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    out[0] = (uint8_t)(0xE0 | (cp >> 12));
+    out[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = (uint8_t)(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  out[0] = (uint8_t)(0xF0 | (cp >> 18));
+  out[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = (uint8_t)(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+static inline size_t pair(uint8_t* out, char a, char b) {
+  out[0] = (uint8_t)a;
+  out[1] = (uint8_t)b;
+  return 2;
+}
+
+size_t TextSearch::foldCodepoint(uint32_t cp, uint8_t* out) {
+  if (cp < 0x80) {
+    out[0] = (uint8_t)(cp >= 'A' && cp <= 'Z' ? cp + 32 : cp);
+    return 1;
+  }
+  switch (cp) {
+    case 0xC6:
+    case 0xE6:
+      return pair(out, 'a', 'e');
+    case 0xDF:
+    case 0x1E9E:
+      return pair(out, 's', 's');
+    case 0x132:
+    case 0x133:
+      return pair(out, 'i', 'j');
+    case 0x152:
+    case 0x153:
+      return pair(out, 'o', 'e');
+    case 0x2018:
+    case 0x2019:
+    case 0x201B:
+    case 0x2032:
+      out[0] = '\'';
+      return 1;
+    case 0x201C:
+    case 0x201D:
+    case 0x201F:
+    case 0x2033:
+      out[0] = '"';
+      return 1;
+    case 0xDE:
+      cp = 0xFE;  // Thorn
+      break;
+    case 0x3C2:
+      cp = 0x3C3;  // Final sigma
+      break;
+  }
+  if (cp >= 0xC0 && cp <= 0xFF && LATIN1_BASE[cp - 0xC0]) {
+    out[0] = (uint8_t)LATIN1_BASE[cp - 0xC0];
+    return 1;
+  }
+  if (cp >= 0x100 && cp <= 0x17F) {
+    out[0] = (uint8_t)LATIN_EXT_A_BASE[cp - 0x100];
+    return 1;
+  }
+  if (cp >= 0x391 && cp <= 0x3AB && cp != 0x3A2)
+    cp += 0x20;  // Greek capitals
+  else if (cp >= 0x410 && cp <= 0x42F)
+    cp += 0x20;  // Cyrillic capitals
+  else if (cp >= 0x400 && cp <= 0x40F)
+    cp += 0x50;  // Cyrillic capitals with diacritics (Ё, Ї, ...)
+  return encodeUtf8(cp, out);
+}
+
+// Fold a UTF-8 pattern the way the text is folded, trimming outer whitespace; returns the folded length, or
+// cap + 1 if it does not fit
+static size_t foldPattern(const char* utf8, uint8_t* out, size_t cap) {
+  size_t length = 0;
+  bool space = true;
+  const uint8_t* p = (const uint8_t*)utf8;
+  while (*p) {
+    uint32_t cp = *p++;
+    int extra = cp >= 0xF0 ? 3 : cp >= 0xE0 ? 2 : cp >= 0xC0 ? 1 : 0;
+    if (extra)
+      cp &= 0x3F >> extra;
+    for (; extra > 0 && (*p & 0xC0) == 0x80; extra--)
+      cp = (cp << 6) | (*p++ & 0x3F);
+    if (isSpace(cp)) {
+      if (!space && length < cap)
+        out[length++] = ' ';
+      else if (!space)
+        return cap + 1;
+      space = true;
+      continue;
+    }
+    if (isInvisible(cp))
+      continue;
+    uint8_t folded[4];
+    size_t n = TextSearch::foldCodepoint(cp, folded);
+    if (length + n > cap)
+      return cap + 1;
+    memcpy(out + length, folded, n);
+    length += n;
+    space = false;
+  }
+  if (length > 0 && out[length - 1] == ' ')
+    length--;
+  return length;
+}
+
+TextSearch::~TextSearch() {
+  HeapTelemetry::release(filter_);
+}
+
+bool TextSearch::addPattern(const char* utf8) {
+  size_t room = MAX_PATTERN_BYTES - foldedLength_;
+  size_t length = foldPattern(utf8, folded_ + foldedLength_, room);
+  if (length == 0 || length > room)
+    return false;
+
+  Pattern pattern = {(uint8_t)foldedLength_, (uint8_t)length};
+  for (size_t i = 0; i < length; i++)
+    masks_[folded_[foldedLength_ + i]] |= 1ULL << (foldedLength_ + i);
+  startBits_ |= 1ULL << foldedLength_;
+  endBits_ |= 1ULL << (foldedLength_ + length - 1);
+  foldedLength_ += length;
+  patterns_.push_back(pattern);
+  return true;
+}
+
+void TextSearch::clearPatterns() {
+  patterns_.clear();
+  foldedLength_ = 0;
+  memset(masks_, 0, sizeof(masks_));
+  startBits_ = 0;
+  endBits_ = 0;
+}
+
+String TextSearch::filterPathFor(const char* path) {
+  String filterPath = path;
+  int length = filterPath.length();
+  if (length > 4 && filterPath.substring(length - 4) == ".txt")
+    filterPath = filterPath.substring(0, length - 4);
+  return filterPath + ".tri";
+}
+
+uint16_t TextSearch::trigramBit(uint8_t a, uint8_t b, uint8_t c) {
+  uint32_t key = ((uint32_t)a << 16) | ((uint32_t)b << 8) | c;
+  return (uint16_t)((key * 2654435761u) >> 20);  // Top 12 bits: FILTER_BYTES * 8 buckets
+}
+
+bool TextSearch::mayContain(const char* path) {
+  File in = SD.open(path);
+  if (!in)
+    return true;
+  uint32_t size = (uint32_t)in.size();
+  in.close();
+  return checkFilter(path, size) != FILTER_EXCLUDES;
+}
+
+TextSearch::FilterResult TextSearch::checkFilter(const char* path, uint32_t textSize) {
+  String filterPath = filterPathFor(path);
+  File in = SD.open(filterPath.c_str());
+  if (!in)
+    return FILTER_ABSENT;
+  uint8_t header[FILTER_HEADER_SIZE];
+  uint8_t* bits = (uint8_t*)HeapTelemetry::allocate(FILTER_BYTES);
+  bool ok = bits && in.size() == FILTER_HEADER_SIZE + FILTER_BYTES &&
+            in.read(header, FILTER_HEADER_SIZE) == FILTER_HEADER_SIZE && memcmp(header, FILTER_MAGIC, 4) == 0 &&
+            (header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24)) == textSize &&
+            in.read(bits, FILTER_BYTES) == FILTER_BYTES;
+  in.close();
+  if (!ok) {
+    HeapTelemetry::release(bits);
+    return FILTER_ABSENT;
+  }
+
+  // A pattern can occur only if all its trigrams are in the set
+  bool possible = false;
+  for (size_t p = 0; p < patterns_.size() && !possible; p++) {
+    const uint8_t* s = folded_ + patterns_[p].offset;
+    possible = true;
+    for (size_t i = 2; i < patterns_[p].length && possible; i++) {
+      uint16_t bit = trigramBit(s[i - 2], s[i - 1], s[i]);
+      possible = (bits[bit >> 3] >> (bit & 7)) & 1;
+    }
+  }
+  HeapTelemetry::release(bits);
+  return possible ? FILTER_ALLOWS : FILTER_EXCLUDES;
+}
+
+void TextSearch::saveFilter(const char* path, uint32_t textSize) {
+  String filterPath = filterPathFor(path);
+  SD.remove(filterPath.c_str());
+  File out = SD.open(filterPath.c_str(), FILE_WRITE);
+  if (!out)
+    return;
+  uint8_t header[FILTER_HEADER_SIZE];
+  memcpy(header, FILTER_MAGIC, 4);
+  for (int i = 0; i < 4; i++)
+    header[4 + i] = (uint8_t)(textSize >> (8 * i));
+  bool ok = out.write(header, FILTER_HEADER_SIZE) == FILTER_HEADER_SIZE &&
+            out.write(filter_, FILTER_BYTES) == FILTER_BYTES;
+  out.close();
+  if (!ok)
+    SD.remove(filterPath.c_str());
+}
+
+bool TextSearch::searchFile(const char* path, int chapter, uint32_t from, std::vector<SearchHit>& hits,
+                            size_t maxHits) {
+  if (patterns_.empty() || hits.size() >= maxHits)
+    return true;
+  File in = SD.open(path);
+  if (!in)
+    return false;
+  uint32_t size = (uint32_t)in.size();
+  if (from >= size) {
+    in.close();
+    return true;
+  }
+
+  // A filter only comes from a scan of the whole file
+  bool buildFilter = false;
+  if (useFilter_) {
+    FilterResult filter = checkFilter(path, size);
+    if (filter == FILTER_EXCLUDES) {
+      in.close();
+      return true;
+    }
+    if (filter == FILTER_ABSENT && from == 0) {
+      filter_ = (uint8_t*)HeapTelemetry::allocateZeroed(1, FILTER_BYTES);
+      buildFilter = filter_ != nullptr;
+    }
+  }
+
+  uint8_t* block = (uint8_t*)HeapTelemetry::allocate(READ_BLOCK_SIZE);
+  bool ok = block != nullptr && (from == 0 || in.seek(from));
+  resetScan();
+  hits_ = &hits;
+  maxHits_ = maxHits;
+  chapter_ = chapter;
+  uint32_t offset = from;
+  while (ok && offset < size && hits.size() < maxHits) {
+    size_t n = in.read(block, READ_BLOCK_SIZE);
+    if (n == 0) {
+      ok = false;
+      break;
+    }
+    for (size_t i = 0; i < n; i++)
+      feed(block[i], offset + (uint32_t)i);
+    offset += (uint32_t)n;
+  }
+  in.close();
+  HeapTelemetry::release(block);
+  hits_ = nullptr;
+
+  if (buildFilter && ok && offset >= size)
+    saveFilter(path, size);
+  HeapTelemetry::release(filter_);
+  filter_ = nullptr;
+  return ok;
+}
+
+void TextSearch::resetScan() {
+  state_ = 0;
+  count_ = 0;
+  pending_ = 0;
+  escape_ = false;
+  hidden_ = false;
+  space_ = true;
+  last_[0] = last_[1] = 0;
+}
+
+void TextSearch::feed(uint8_t b, uint32_t offset) {
+  // ESC and its command byte never reach the matcher; ESC H ... ESC h is hidden indent
+  if (escape_) {
+    escape_ = false;
+    if (b == 'H')
+      hidden_ = true;
+    else if (b == 'h')
+      hidden_ = false;
+    return;
+  }
+  if (b == 0x1B) {
+    escape_ = true;
+    pending_ = 0;
+    return;
+  }
+  if (hidden_)
+    return;
+
+  if (pending_ > 0) {
+    if ((b & 0xC0) == 0x80) {
+      codepoint_ = (codepoint_ << 6) | (b & 0x3F);
+      if (--pending_ == 0)
+        emitCodepoint(codepoint_, codepointStart_);
+      return;
+    }
+    pending_ = 0;  // Truncated sequence: drop it and take b afresh
+  }
+  if (b < 0x80) {
+    emitCodepoint(b, offset);
+  } else if (b >= 0xC0) {
+    pending_ = b >= 0xF0 ? 3 : b >= 0xE0 ? 2 : 1;
+    codepoint_ = b & (0x3F >> pending_);
+    codepointStart_ = offset;
+  }
+}
+
+void TextSearch::emitCodepoint(uint32_t cp, uint32_t offset) {
+  if (isSpace(cp)) {
+    if (!space_)
+      push(' ', offset);
+    space_ = true;
+    return;
+  }
+  if (isInvisible(cp))
+    return;
+  space_ = false;
+  uint8_t folded[4];
+  size_t n = foldCodepoint(cp, folded);
+  for (size_t i = 0; i < n; i++)
+    push(folded[i], offset);
+}
+
+void TextSearch::push(uint8_t c, uint32_t offset) {
+  starts_[count_ & 63] = offset;
+  state_ = ((state_ << 1) | startBits_) & masks_[c];
+
+  if (filter_ && count_ >= 2) {
+    uint16_t bit = trigramBit(last_[0], last_[1], c);
+    filter_[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+  }
+  last_[0] = last_[1];
+  last_[1] = c;
+
+  uint64_t ended = state_ & endBits_;
+  if (ended) {
+    for (size_t p = 0; p < patterns_.size(); p++) {
+      const Pattern& pattern = patterns_[p];
+      if (!((ended >> (pattern.offset + pattern.length - 1)) & 1) || hits_->size() >= maxHits_)
+        continue;
+      SearchHit hit = {chapter_, starts_[(count_ - pattern.length + 1) & 63], (uint8_t)p};
+      hits_->push_back(hit);
+    }
+  }
+  count_++;
+}
@@ -0,0 +1,124 @@
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One match: the chapter and the byte offset of the match's first character in the chapter's text file, which
+// is the index FileWordProvider::setPosition() takes
+struct SearchHit {
+  int chapter;
+  uint32_t offset;
+  uint8_t pattern;  // Index of the matching pattern, in addPattern() order
+};
+
+/**
+ * TextSearch - streaming multi-pattern search over the chapter text cache
+ *
+ * The matcher is bit-parallel Shift-And: the folded patterns sit side by
+ * side in one 64-bit state word, so every pattern advances with one shift,
+ * one OR and one AND per text byte, whatever the pattern lengths. The text
+ * is fed through the same folding as the patterns:
+ *
+ *   - ESC style tokens (two bytes) are skipped, and so is the hidden
+ *     indent between ESC H and ESC h;
+ *   - UTF-8 is decoded, case is folded and Latin diacritics are dropped
+ *     ("Café" finds "cafe", "STRASSE" finds "straße", "Łódź" finds "lodz");
+ *     Greek and Cyrillic capitals fold to their lower case;
+ *   - runs of whitespace (line breaks, no-break spaces) become one space and
+ *     soft hyphens vanish, so a phrase matches across lines.
+ *
+ * Chapter files are read in READ_BLOCK_SIZE sequential blocks, and the
+ * matcher's state carries over between blocks, so matches may straddle them.
+ *
+ * Trigram filter: a full scan of a chapter also sets one bit per folded
+ * trigram in a 4096-bit hashed set, stored next to the chapter as
+ * "<chapter>.tri". Later searches skip a chapter whose filter lacks one of
+ * the trigrams of every pattern; patterns shorter than three folded bytes
+ * never skip. The filter records the text file size it was built from and
+ * is ignored once that no longer matches.
+ */
+class TextSearch {
+ public:
+  static const size_t MAX_PATTERN_BYTES = 64;  // Sum of the folded pattern lengths
+  static const size_t READ_BLOCK_SIZE = 4096;
+  static const size_t FILTER_BYTES = 512;
+
+  TextSearch() {}
+  ~TextSearch();
+
+  TextSearch(const TextSearch&) = delete;
+  TextSearch& operator=(const TextSearch&) = delete;
+
+  // Add a UTF-8 pattern; false if it folds to nothing or the patterns would exceed MAX_PATTERN_BYTES
+  bool addPattern(const char* utf8);
+  void clearPatterns();
+  size_t getPatternCount() const {
+    return patterns_.size();
+  }
+
+  // Read and write trigram filters next to the chapter files (default on)
+  void setUseFilter(bool enabled) {
+    useFilter_ = enabled;
+  }
+
+  // Search the text file at path from byte offset from, appending hits (tagged with chapter) until hits holds
+  // maxHits. Returns false if the file cannot be read. A chapter its filter rules out is not read at all.
+  bool searchFile(const char* path, int chapter, uint32_t from, std::vector<SearchHit>& hits, size_t maxHits);
+
+  // Whether the patterns can occur in the text file at path according to its trigram filter (true when there is
+  // no usable filter)
+  bool mayContain(const char* path);
+
+  // Fold one code point the way the matcher does; writes up to 4 bytes (UTF-8) to out and returns how many
+  static size_t foldCodepoint(uint32_t cp, uint8_t* out);
+
+  // Filter file of the chapter text file at path
+  static String filterPathFor(const char* path);
+
+ private:
+  enum FilterResult { FILTER_ABSENT, FILTER_ALLOWS, FILTER_EXCLUDES };
+
+  struct Pattern {
+    uint8_t offset;  // First bit in the state word
+    uint8_t length;  // Folded bytes
+  };
+
+  void resetScan();
+  void feed(uint8_t b, uint32_t offset);
+  void emitCodepoint(uint32_t cp, uint32_t offset);
+  void push(uint8_t c, uint32_t offset);
+  FilterResult checkFilter(const char* path, uint32_t textSize);
+  void saveFilter(const char* path, uint32_t textSize);
+  static uint16_t trigramBit(uint8_t a, uint8_t b, uint8_t c);
+
+  // Patterns: folded bytes back to back, with the Shift-And tables over them
+  std::vector<Pattern> patterns_;
+  uint8_t folded_[MAX_PATTERN_BYTES];
+  size_t foldedLength_ = 0;
+  uint64_t masks_[256] = {};
+  uint64_t startBits_ = 0;  // First bit of each pattern
+  uint64_t endBits_ = 0;    // Last bit of each pattern
+  bool useFilter_ = true;
+
+  // Scan state, carried across read blocks
+  uint64_t state_ = 0;
+  uint32_t starts_[64];  // Source offset of the last 64 folded bytes, by folded count
+  uint32_t count_ = 0;   // Folded bytes so far
+  uint32_t codepoint_ = 0;
+  uint32_t codepointStart_ = 0;
+  uint8_t pending_ = 0;  // Continuation bytes still expected
+  bool escape_ = false;  // Previous byte was ESC
+  bool hidden_ = false;  // Inside ESC H ... ESC h
+  bool space_ = true;    // Last folded byte was a space (or nothing yet)
+  uint8_t last_[2] = {};
+  std::vector<SearchHit>* hits_ = nullptr;
+  size_t maxHits_ = 0;
+  int chapter_ = 0;
+  uint8_t* filter_ = nullptr;  // Trigram set being built, only during a full scan
+};
+
+#endif
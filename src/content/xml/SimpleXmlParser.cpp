@@ -1,6 +1,10 @@
 #include "SimpleXmlParser.h"
 
 #include <Arduino.h>
+#include <string.h>
+
+#include "../../core/HeapTelemetry.h"
+#include "../../core/Trace.h"
 
 SimpleXmlParser::SimpleXmlParser()
     : buffer_(nullptr),
@@ -27,7 +31,7 @@ SimpleXmlParser::SimpleXmlParser()
       elementStartPos_(0),
       elementEndPos_(0) {
   // Allocate primary buffer on heap to avoid stack overflow on ESP32
-  buffer_ = (uint8_t*)malloc(BUFFER_SIZE);
+  buffer_ = (uint8_t*)HeapTelemetry::allocate(BUFFER_SIZE);
   if (buffer_) {
     Serial.printf("  [MEM] SimpleXmlParser ctor: allocated primary buffer %d bytes, Free=%u\n", BUFFER_SIZE,
                   ESP.getFreeHeap());
@@ -47,7 +51,7 @@ SimpleXmlParser::~SimpleXmlParser() {
   close();
   // Free primary buffer
   if (buffer_) {
-    free(buffer_);
+    HeapTelemetry::release(buffer_);
     buffer_ = nullptr;
   }
 }
@@ -126,12 +130,12 @@ bool SimpleXmlParser::openFromStream(StreamCallback callback, void* userData) {
   for (size_t i = 0; i < NUM_STREAM_BUFFERS; i++) {
     Serial.printf("  [MEM] attempting to alloc stream buffer %d of %d, Free=%u\n", (int)i + 1, (int)NUM_STREAM_BUFFERS,
                   ESP.getFreeHeap());
-    streamBuffers_[i] = (uint8_t*)malloc(BUFFER_SIZE);
+    streamBuffers_[i] = (uint8_t*)HeapTelemetry::allocate(BUFFER_SIZE);
     if (!streamBuffers_[i]) {
       // Allocation failed, clean up
       Serial.printf("  [MEM] failed to alloc stream buffer %d, Free=%u\n", (int)i + 1, ESP.getFreeHeap());
       for (size_t j = 0; j < i; j++) {
-        free(streamBuffers_[j]);
+        HeapTelemetry::release(streamBuffers_[j]);
         streamBuffers_[j] = nullptr;
       }
       return false;
@@ -170,7 +174,7 @@ void SimpleXmlParser::close() {
   if (usingStream_) {
     for (size_t i = 0; i < NUM_STREAM_BUFFERS; i++) {
       if (streamBuffers_[i]) {
-        free(streamBuffers_[i]);
+        HeapTelemetry::release(streamBuffers_[i]);
         streamBuffers_[i] = nullptr;
       }
       streamBufferStarts_[i] = 0;
@@ -297,7 +301,9 @@ bool SimpleXmlParser::loadBufferAround(size_t pos) {
   }
 
   bufferStartPos_ = idealStart;
+  TRACE_SCOPE_NAMED(readScope, SD_READ, idealStart);
   bufferLen_ = file_.read(buffer_, BUFFER_SIZE);
+  TRACE_SCOPE_END_ARG(readScope, bufferLen_);
 
   return bufferLen_ > 0;
 }
@@ -848,4 +854,79 @@ bool SimpleXmlParser::hasMoreTextChars() const {
 
   char c = const_cast<SimpleXmlParser*>(this)->getByteAt(textNodeCurrentPos_);
   return c != '\0' && c != '<';
-}
\ No newline at end of file
+}
+
+size_t SimpleXmlParser::decodeEntity(const char* entity, size_t length, char* out) {
+  if (length < 3 || entity[0] != '&' || entity[length - 1] != ';')
+    return 0;
+  const char* name = entity + 1;
+  size_t nameLength = length - 2;
+
+  if (name[0] != '#') {
+    static const struct {
+      const char* name;
+      const char* utf8;
+    } NAMED[] = {
+        {"nbsp", "\xC2\xA0"}, {"amp", "&"}, {"lt", "<"}, {"gt", ">"}, {"quot", "\""}, {"apos", "'"},
+    };
+    for (const auto& named : NAMED) {
+      if (strlen(named.name) == nameLength && strncmp(named.name, name, nameLength) == 0) {
+        size_t n = strlen(named.utf8);
+        memcpy(out, named.utf8, n);
+        return n;
+      }
+    }
+    return 0;
+  }
+
+  // Numeric character reference: &#8217; or &#x2019;
+  bool hex = nameLength > 1 && (name[1] == 'x' || name[1] == 'X');
+  size_t i = hex ? 2 : 1;
+  if (i >= nameLength)
+    return 0;
+  uint32_t cp = 0;
+  for (; i < nameLength; i++) {
+    char c = name[i];
+    int digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (hex && c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (hex && c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      return 0;
+    cp = cp * (hex ? 16 : 10) + digit;
+    if (cp > 0x10FFFF)
+      return 0;
+  }
+
+  // Tabs and newlines become whitespace; other control characters (ESC starts a style token) and surrogates are
+  // left undecoded
+  if (cp == '\t' || cp == '\n' || cp == '\r') {
+    out[0] = ' ';
+    return 1;
+  }
+  if (cp < 0x20 || cp == 0x7F || (cp >= 0xD800 && cp <= 0xDFFF))
+    return 0;
+  if (cp < 0x80) {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = (char)(0xC0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    out[0] = (char)(0xE0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  out[0] = (char)(0xF0 | (cp >> 18));
+  out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (cp & 0x3F));
+  return 4;
+}
@@ -111,6 +111,12 @@ class SimpleXmlParser {
   // Text node reading helpers
   char readTextNodeCharForward();
 
+  /**
+   * Decode a complete entity ("&amp;", "&#8217;", "&#x2019;") to UTF-8 in out (at least 4 bytes)
+   * Returns the number of bytes written, or 0 if the entity is unknown or malformed
+   */
+  static size_t decodeEntity(const char* entity, size_t length, char* out);
+
   /**
    * Get current file position (the cursor)
    */
@@ -0,0 +1,82 @@
+#include "BufferedFileWriter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+BufferedFileWriter::BufferedFileWriter(File& file, size_t blockSize)
+    : file_(file), block_((char*)malloc(blockSize)), blockSize_(blockSize) {
+  if (!block_) {
+    Serial.printf("BufferedFileWriter: no %u byte block, writing unbuffered\n", (unsigned)blockSize);
+    blockSize_ = 0;
+  }
+}
+
+BufferedFileWriter::~BufferedFileWriter() {
+  flush();
+  free(block_);
+}
+
+void BufferedFileWriter::putSlow(char c) {
+  if (!block_) {
+    writeToFile(&c, 1);
+    return;
+  }
+  flush();
+  block_[fill_++] = c;
+}
+
+void BufferedFileWriter::write(const char* data, size_t length) {
+  if (!block_) {
+    writeToFile(data, length);
+    return;
+  }
+  while (length > 0) {
+    // Aligned and at least a block to go: skip the copy
+    if (fill_ == 0 && length >= blockSize_) {
+      size_t direct = length - length % blockSize_;
+      writeToFile(data, direct);
+      data += direct;
+      length -= direct;
+      continue;
+    }
+    size_t n = blockSize_ - fill_;
+    if (n > length)
+      n = length;
+    memcpy(block_ + fill_, data, n);
+    fill_ += n;
+    data += n;
+    length -= n;
+    if (fill_ == blockSize_)
+      flush();
+  }
+}
+
+void BufferedFileWriter::print(const char* str) {
+  if (str)
+    write(str, strlen(str));
+}
+
+void BufferedFileWriter::print(unsigned long value) {
+  char digits[24];
+  int n = snprintf(digits, sizeof(digits), "%lu", value);
+  write(digits, (size_t)n);
+}
+
+bool BufferedFileWriter::flush() {
+  if (fill_ > 0) {
+    writeToFile(block_, fill_);
+    fill_ = 0;
+  }
+  return ok_;
+}
+
+void BufferedFileWriter::writeToFile(const char* data, size_t length) {
+  size_t written = file_.write((const uint8_t*)data, length);
+  bytesWritten_ += written;
+  if (written != length) {
+    if (ok_)
+      Serial.printf("WARNING: partial write: attempted=%u wrote=%u\n", (unsigned)length, (unsigned)written);
+    ok_ = false;
+  }
+}
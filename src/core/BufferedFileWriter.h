@@ -0,0 +1,85 @@
+#ifndef BUFFERED_FILE_WRITER_H
+#define BUFFERED_FILE_WRITER_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include <cstddef>
+
+/**
+ * BufferedFileWriter - append-only block writer for files on the SD card
+ *
+ * Collects output in one fixed block allocated up front and hands the file
+ * whole blocks. The block size is a multiple of the 512-byte sector and
+ * writers start at offset 0 of a freshly opened file, so every full block
+ * lands on a sector boundary and the card never has to read-modify-write a
+ * sector that a later flush completes. put() is an inline store into the
+ * block; write() copies into the block and passes runs of whole blocks
+ * straight to the file.
+ *
+ *   File f = SD.open(path, FILE_WRITE);
+ *   BufferedFileWriter out(f);
+ *   out.print("version=");
+ *   out.put('\n');
+ *   bool ok = out.flush();
+ *   f.close();
+ *
+ * The destructor flushes what is left, but callers that care about short
+ * writes call flush() and check its result (and ok()) before closing the
+ * file. If the block cannot be allocated every write goes to the file
+ * directly.
+ */
+class BufferedFileWriter {
+ public:
+  static const size_t DEFAULT_BLOCK_SIZE = 4096;  // 8 sectors
+  static const size_t SMALL_BLOCK_SIZE = 512;     // One sector, for small files such as settings
+
+  explicit BufferedFileWriter(File& file, size_t blockSize = DEFAULT_BLOCK_SIZE);
+  ~BufferedFileWriter();
+
+  BufferedFileWriter(const BufferedFileWriter&) = delete;
+  BufferedFileWriter& operator=(const BufferedFileWriter&) = delete;
+
+  void put(char c) {
+    if (fill_ < blockSize_) {
+      block_[fill_++] = c;
+      return;
+    }
+    putSlow(c);
+  }
+  void write(const char* data, size_t length);
+  void print(const char* str);
+  void print(const String& str) {
+    write(str.c_str(), str.length());
+  }
+  void print(unsigned long value);
+
+  // Write the buffered bytes to the file. Returns false if any write so far was short.
+  bool flush();
+
+  // False once the file accepted fewer bytes than it was given
+  bool ok() const {
+    return ok_;
+  }
+  // Bytes the file accepted so far (buffered bytes are not counted until flushed)
+  size_t bytesWritten() const {
+    return bytesWritten_;
+  }
+  // Offset in the file the next byte will land at (buffered bytes included)
+  size_t position() const {
+    return bytesWritten_ + fill_;
+  }
+
+ private:
+  void putSlow(char c);
+  void writeToFile(const char* data, size_t length);
+
+  File& file_;
+  char* block_;
+  size_t blockSize_;
+  size_t fill_ = 0;
+  size_t bytesWritten_ = 0;
+  bool ok_ = true;
+};
+
+#endif
@@ -152,6 +152,10 @@ uint8_t Buttons::consumeNextPress() {
   return button;
 }
 
+bool Buttons::hasQueuedPresses() {
+  return queueCount > 0;
+}
+
 void Buttons::clearQueuedPresses() {
   queueHead = 0;
   queueTail = 0;
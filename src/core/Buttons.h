@@ -20,6 +20,7 @@ class Buttons {
   // Queued button press methods - presses accumulate even during long operations
   uint8_t consumeNextPress();  // Consume and return next queued button, or NONE if empty
   void clearQueuedPresses();   // Clear all queued presses
+  bool hasQueuedPresses();     // True if a press is waiting (does not consume it)
 
   // Button indices
   static const uint8_t NONE = 255;
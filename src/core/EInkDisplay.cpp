@@ -4,6 +4,9 @@
 #include <fstream>
 #include <vector>
 
+#include "Scheduler.h"
+#include "Trace.h"
+
 // SSD1677 command definitions
 // Initialization and reset
 #define CMD_SOFT_RESET 0x12             // Soft reset
@@ -205,18 +208,20 @@ void EInkDisplay::sendData(const uint8_t* data, uint16_t length) {
   SPI.endTransaction();
 }
 
+// Time given to background jobs between two polls of the busy pin
+static const uint32_t BUSY_JOB_MICROS = 2000;
+
 void EInkDisplay::waitWhileBusy(const char* comment) {
   unsigned long start = millis();
   while (digitalRead(_busy) == HIGH) {
-    delay(1);
+    // The panel needs no SPI traffic until it is done, so background jobs may use the bus (and the SD card)
+    if (!scheduler || !scheduler->run(BUSY_JOB_MICROS))
+      delay(1);
     if (millis() - start > 10000) {
       Serial.printf("[%lu]   Timeout waiting for busy%s\n", millis(), comment ? comment : "");
       break;
     }
   }
-  if (comment) {
-    Serial.printf("[%lu]   Wait complete: %s (%lu ms)\n", millis(), comment, millis() - start);
-  }
 }
 
 void EInkDisplay::initDisplayController() {
@@ -371,15 +376,9 @@ void EInkDisplay::drawImage(const uint8_t* imageData, uint16_t x, uint16_t y, ui
 }
 
 void EInkDisplay::writeRamBuffer(uint8_t ramBuffer, const uint8_t* data, uint32_t size) {
-  const char* bufferName = (ramBuffer == CMD_WRITE_RAM_BW) ? "BW" : "RED";
-  unsigned long startTime = millis();
-  Serial.printf("[%lu]   Writing frame buffer to %s RAM (%lu bytes)...\n", startTime, bufferName, size);
-
+  TRACE_SCOPE(WRITE_RAM, ramBuffer);
   sendCommand(ramBuffer);
   sendData(data, size);
-
-  unsigned long duration = millis() - startTime;
-  Serial.printf("[%lu]   %s RAM write complete (%lu ms)\n", millis(), bufferName, duration);
 }
 
 void EInkDisplay::setFramebuffer(const uint8_t* bwBuffer) {
@@ -426,7 +425,11 @@ void EInkDisplay::displayBuffer(RefreshMode mode) {
   // If currently in grayscale mode, revert first to black/white
   if (inGrayscaleMode) {
     inGrayscaleMode = false;
+    // The new page waits in the frame buffer until the revert is done, so no job may borrow it meanwhile
+    Scheduler* jobs = scheduler;
+    scheduler = nullptr;
     grayscaleRevert();
+    scheduler = jobs;
   }
 
   // Set up full screen RAM area
@@ -460,6 +463,8 @@ void EInkDisplay::displayGrayBuffer(bool turnOffScreen) {
 }
 
 void EInkDisplay::refreshDisplay(RefreshMode mode, bool turnOffScreen) {
+  TRACE_SCOPE(REFRESH_DISPLAY, mode);
+
   // Configure Display Update Control 1
   sendCommand(CMD_DISPLAY_UPDATE_CTRL1);
   sendData((mode == FAST_REFRESH) ? CTRL1_NORMAL : CTRL1_BYPASS_RED);  // Configure buffer comparison mode
@@ -504,14 +509,12 @@ void EInkDisplay::refreshDisplay(RefreshMode mode, bool turnOffScreen) {
 
   // Power on and refresh display
   const char* refreshType = (mode == FULL_REFRESH) ? "full" : (mode == HALF_REFRESH) ? "half" : "fast";
-  Serial.printf("[%lu]   Powering on display 0x%02X (%s refresh)...\n", millis(), displayMode, refreshType);
   sendCommand(CMD_DISPLAY_UPDATE_CTRL2);
   sendData(displayMode);
 
   sendCommand(CMD_MASTER_ACTIVATION);
 
   // Wait for display to finish updating
-  Serial.printf("[%lu]   Waiting for display refresh...\n", millis());
   waitWhileBusy(refreshType);
 }
 
@@ -9,6 +9,8 @@
 #include "../test/mocks/platform_stubs.h"
 #endif
 
+class Scheduler;
+
 class EInkDisplay {
  public:
   // Constructor with pin configuration
@@ -59,6 +61,13 @@ class EInkDisplay {
   // Power management
   void deepSleep();
 
+  // Background jobs to step while waiting for the controller instead of sleeping (nullptr to sleep). Jobs may
+  // borrow the frame buffer (chapter conversion inflates into it), so they only run while it holds nothing that
+  // is still to be sent.
+  void setScheduler(Scheduler* jobs) {
+    scheduler = jobs;
+  }
+
   // Access to frame buffer
   uint8_t* getFrameBuffer() {
     return frameBuffer;
@@ -87,6 +96,8 @@ class EInkDisplay {
   bool inGrayscaleMode;
   bool drawGrayscale;
 
+  Scheduler* scheduler = nullptr;
+
   // Low-level display control
   void resetDisplay();
   void sendCommand(uint8_t command);
@@ -0,0 +1,257 @@
+#include "HeapTelemetry.h"
+
+#include <Arduino.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef TEST_BUILD
+#include "HeapModel.h"
+#endif
+
+namespace HeapTelemetry {
+
+static const char* const SUBSYSTEM_NAMES[SUBSYSTEM_COUNT] = {"other", "epub",  "conversion", "layout",
+                                                             "render", "font", "ui"};
+
+Sample sample() {
+  Sample s;
+  s.freeHeap = ESP.getFreeHeap();
+  s.minFreeHeap = ESP.getMinFreeHeap();
+  s.largestBlock = ESP.getMaxAllocHeap();
+  return s;
+}
+
+const char* subsystemName(Subsystem subsystem) {
+  return subsystem < SUBSYSTEM_COUNT ? SUBSYSTEM_NAMES[subsystem] : "unknown";
+}
+
+void* allocate(size_t size) {
+  return ::operator new(size, std::nothrow);
+}
+
+void* allocateZeroed(size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size)
+    return nullptr;
+  void* p = ::operator new(count * size, std::nothrow);
+  if (p)
+    memset(p, 0, count * size);
+  return p;
+}
+
+void release(void* p) {
+  ::operator delete(p);
+}
+
+#ifdef MICROREADER_HEAP_TELEMETRY
+
+static CheckpointStats checkpoints[MAX_CHECKPOINTS];
+static size_t checkpointsUsed = 0;
+static SubsystemStats subsystems[SUBSYSTEM_COUNT];
+static Subsystem current = OTHER;
+static bool allocationsSeen = false;
+
+#ifdef TEST_BUILD
+// The subsystem whose live blocks in the heap model cut the largest free block the most
+static void findBlocker(CheckpointStats& c) {
+  HeapModel::Heap& model = HeapModel::heap();
+  uint32_t largest = model.largestFree();
+  c.blocker = OTHER;
+  c.blockerGain = 0;
+  for (uint8_t s = 0; s < SUBSYSTEM_COUNT; ++s) {
+    uint32_t without = model.largestFreeWithout(s);
+    if (without > largest && without - largest > c.blockerGain) {
+      c.blocker = (Subsystem)s;
+      c.blockerGain = without - largest;
+    }
+  }
+}
+#endif
+
+void checkpoint(const char* tag) {
+  Sample s = sample();
+
+  CheckpointStats* c = nullptr;
+  for (size_t i = 0; i < checkpointsUsed && !c; ++i) {
+    if (checkpoints[i].tag == tag || strcmp(checkpoints[i].tag, tag) == 0)
+      c = &checkpoints[i];
+  }
+  if (!c) {
+    if (checkpointsUsed == MAX_CHECKPOINTS)
+      return;
+    c = &checkpoints[checkpointsUsed++];
+    memset(c, 0, sizeof(*c));
+    c->tag = tag;
+    c->lowestFree = UINT32_MAX;
+    c->lowestLargestBlock = UINT32_MAX;
+  }
+
+  c->count++;
+  c->last = s;
+  if (s.freeHeap < c->lowestFree)
+    c->lowestFree = s.freeHeap;
+  if (s.largestBlock < c->lowestLargestBlock) {
+    c->lowestLargestBlock = s.largestBlock;
+#ifdef TEST_BUILD
+    findBlocker(*c);
+#endif
+  }
+}
+
+size_t checkpointCount() {
+  return checkpointsUsed;
+}
+
+const CheckpointStats& checkpointAt(size_t i) {
+  return checkpoints[i];
+}
+
+Subsystem currentSubsystem() {
+  return current;
+}
+
+void recordAlloc(Subsystem subsystem, size_t size) {
+  if (subsystem >= SUBSYSTEM_COUNT)
+    subsystem = OTHER;
+  SubsystemStats& s = subsystems[subsystem];
+  s.allocs++;
+  s.liveBlocks++;
+  s.liveBytes += (uint32_t)size;
+  if (s.liveBytes > s.peakBytes)
+    s.peakBytes = s.liveBytes;
+  if (size > s.largestAlloc)
+    s.largestAlloc = (uint32_t)size;
+  allocationsSeen = true;
+}
+
+void recordFree(Subsystem subsystem, size_t size) {
+  if (subsystem >= SUBSYSTEM_COUNT)
+    subsystem = OTHER;
+  SubsystemStats& s = subsystems[subsystem];
+  s.frees++;
+  if (s.liveBlocks > 0)
+    s.liveBlocks--;
+  s.liveBytes = s.liveBytes > size ? s.liveBytes - (uint32_t)size : 0;
+}
+
+const SubsystemStats& subsystemStats(Subsystem subsystem) {
+  return subsystems[subsystem < SUBSYSTEM_COUNT ? subsystem : OTHER];
+}
+
+bool tracking() {
+  return allocationsSeen;
+}
+
+void reset() {
+  checkpointsUsed = 0;
+  // Live counts stay valid across a reset; only the history restarts
+  for (SubsystemStats& s : subsystems) {
+    s.allocs = 0;
+    s.frees = 0;
+    s.peakBytes = s.liveBytes;
+    s.largestAlloc = 0;
+  }
+}
+
+void printReport() {
+  Sample now = sample();
+  Serial.printf("[MEM] now: Free=%u, MinFree=%u, MaxBlock=%u\n", now.freeHeap, now.minFreeHeap, now.largestBlock);
+  Serial.printf("[MEM] %-16s %6s %9s %9s %9s %9s  %s\n", "checkpoint", "count", "free", "lowFree", "maxBlock",
+                "lowBlock", "blocked by");
+  for (size_t i = 0; i < checkpointsUsed; ++i) {
+    const CheckpointStats& c = checkpoints[i];
+    char blocker[40] = "-";
+    if (c.blockerGain > 0)
+      snprintf(blocker, sizeof(blocker), "%s (+%u)", subsystemName(c.blocker), (unsigned)c.blockerGain);
+    Serial.printf("[MEM] %-16s %6u %9u %9u %9u %9u  %s\n", c.tag, (unsigned)c.count, c.last.freeHeap, c.lowestFree,
+                  c.last.largestBlock, c.lowestLargestBlock, blocker);
+  }
+  if (!allocationsSeen)
+    return;
+  Serial.printf("[MEM] %-16s %9s %9s %8s %9s %9s %9s\n", "subsystem", "allocs", "frees", "blocks", "live", "peak",
+                "largest");
+  for (uint8_t i = 0; i < SUBSYSTEM_COUNT; ++i) {
+    const SubsystemStats& s = subsystems[i];
+    Serial.printf("[MEM] %-16s %9u %9u %8u %9u %9u %9u\n", SUBSYSTEM_NAMES[i], (unsigned)s.allocs, (unsigned)s.frees,
+                  (unsigned)s.liveBlocks, (unsigned)s.liveBytes, (unsigned)s.peakBytes, (unsigned)s.largestAlloc);
+  }
+}
+
+SubsystemScope::SubsystemScope(Subsystem subsystem) : previous_(current) {
+  current = subsystem;
+}
+
+SubsystemScope::~SubsystemScope() {
+  current = previous_;
+}
+
+#endif  // MICROREADER_HEAP_TELEMETRY
+
+}  // namespace HeapTelemetry
+
+#if defined(MICROREADER_HEAP_TRACKING) && defined(MICROREADER_HEAP_TELEMETRY) && !defined(TEST_BUILD)
+// Tracking allocator: every block carries a header with its size and owning subsystem so frees are
+// attributed to the subsystem that allocated, whichever code releases them
+namespace {
+
+struct alignas(8) BlockHeader {
+  uint32_t size;
+  uint8_t subsystem;
+};
+
+void* trackedAlloc(size_t size) {
+  BlockHeader* h = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + size));
+  if (!h)
+    return nullptr;
+  h->size = (uint32_t)size;
+  h->subsystem = HeapTelemetry::currentSubsystem();
+  HeapTelemetry::recordAlloc((HeapTelemetry::Subsystem)h->subsystem, size);
+  return h + 1;
+}
+
+void trackedFree(void* p) {
+  if (!p)
+    return;
+  BlockHeader* h = static_cast<BlockHeader*>(p) - 1;
+  HeapTelemetry::recordFree((HeapTelemetry::Subsystem)h->subsystem, h->size);
+  free(h);
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  void* p = trackedAlloc(size);
+  if (!p)
+    abort();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return trackedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return trackedAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  trackedFree(p);
+}
+
+void operator delete[](void* p) noexcept {
+  trackedFree(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  trackedFree(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  trackedFree(p);
+}
+#endif
@@ -0,0 +1,119 @@
+#ifndef HEAP_TELEMETRY_H
+#define HEAP_TELEMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * HeapTelemetry - heap checkpoints and per-subsystem allocation counters
+ *
+ * Free heap alone does not explain failed allocations: the 48KB-class buffers
+ * (XML parser, inflate window, chapter buffers) need one contiguous block. A
+ * checkpoint samples free heap, the minimum free heap since boot and the
+ * largest free block, and keeps per tag the latest sample and the lowest
+ * values seen, so the worst moment of e.g. "layout" survives until the report.
+ *
+ * Code also marks which subsystem it is working for with
+ * HEAP_SUBSYSTEM(LAYOUT). When allocations are tracked they are attributed to
+ * the innermost subsystem: on the device MICROREADER_HEAP_TRACKING replaces
+ * operator new/delete with a version that keeps a small header per block, on
+ * the host the benchmark reports allocations itself.
+ *
+ * printReport() writes both tables to Serial; HeapDebugScreen shows them on
+ * the device. Checkpoints and subsystem marks are compiled only when
+ * MICROREADER_HEAP_TELEMETRY is defined.
+ */
+
+namespace HeapTelemetry {
+
+enum Subsystem : uint8_t { OTHER, EPUB, CONVERSION, LAYOUT, RENDER, FONT, UI, SUBSYSTEM_COUNT };
+
+struct Sample {
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;   // Lowest free heap since boot
+  uint32_t largestBlock;  // Largest single allocation that would currently succeed
+};
+
+struct CheckpointStats {
+  const char* tag;  // String literal passed to checkpoint()
+  uint32_t count;
+  Sample last;
+  uint32_t lowestFree;
+  uint32_t lowestLargestBlock;
+  // Host only: the subsystem whose live blocks split the heap most at the lowest largest block,
+  // and how much larger that block would be without them
+  Subsystem blocker;
+  uint32_t blockerGain;
+};
+
+struct SubsystemStats {
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t liveBlocks;
+  uint32_t liveBytes;
+  uint32_t peakBytes;
+  uint32_t largestAlloc;
+};
+
+// Maximum number of distinct checkpoint tags
+static const size_t MAX_CHECKPOINTS = 16;
+
+Sample sample();
+const char* subsystemName(Subsystem subsystem);
+
+// malloc/calloc/free replacements for the large C-style buffers. They go through operator new so a
+// tracking allocator (device or host) sees them; plain malloc blocks are invisible to it.
+void* allocate(size_t size);
+void* allocateZeroed(size_t count, size_t size);
+void release(void* p);
+
+#ifdef MICROREADER_HEAP_TELEMETRY
+
+void checkpoint(const char* tag);
+size_t checkpointCount();
+const CheckpointStats& checkpointAt(size_t i);
+
+// Allocation hooks for a tracking allocator; frees must name the subsystem the block was allocated for
+Subsystem currentSubsystem();
+void recordAlloc(Subsystem subsystem, size_t size);
+void recordFree(Subsystem subsystem, size_t size);
+const SubsystemStats& subsystemStats(Subsystem subsystem);
+// True once any allocation was recorded (otherwise the subsystem table is empty)
+bool tracking();
+
+void reset();
+void printReport();
+
+class SubsystemScope {
+ public:
+  explicit SubsystemScope(Subsystem subsystem);
+  ~SubsystemScope();
+
+ private:
+  Subsystem previous_;
+};
+
+#define HEAP_CONCAT_INNER(a, b) a##b
+#define HEAP_CONCAT(a, b) HEAP_CONCAT_INNER(a, b)
+#define HEAP_CHECKPOINT(tag) HeapTelemetry::checkpoint(tag)
+#define HEAP_SUBSYSTEM(subsystem) \
+  HeapTelemetry::SubsystemScope HEAP_CONCAT(heapScope_, __LINE__)(HeapTelemetry::subsystem)
+
+#else
+
+inline size_t checkpointCount() {
+  return 0;
+}
+inline bool tracking() {
+  return false;
+}
+inline void printReport() {}
+
+#define HEAP_CHECKPOINT(tag)
+#define HEAP_SUBSYSTEM(subsystem)
+
+#endif
+
+}  // namespace HeapTelemetry
+
+#endif
@@ -0,0 +1,249 @@
+#include "JournalStore.h"
+
+#include <string.h>
+
+#include "../lib/miniz.h"
+#include "BufferedFileWriter.h"
+
+static const char JOURNAL_MAGIC[] = "MRJL";
+static const uint8_t JOURNAL_VERSION = 1;
+
+static uint32_t getU32(const uint8_t* in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+bool JournalStore::load() {
+  staged_.clear();
+  entries_.clear();
+  logSize_ = 0;
+  clean_ = false;
+
+  String tmpPath = path_ + ".tmp";
+  if (SD.exists(path_.c_str())) {
+    // A left-over compaction never replaced the log, which is still complete
+    if (SD.exists(tmpPath.c_str()))
+      SD.remove(tmpPath.c_str());
+    return replay(path_, clean_);
+  }
+
+  // Interrupted between removing the old log and renaming the compacted one
+  if (SD.exists(tmpPath.c_str())) {
+    bool clean = false;
+    if (replay(tmpPath, clean) && clean && SD.rename(tmpPath.c_str(), path_.c_str())) {
+      Serial.printf("JournalStore: recovered %s\n", path_.c_str());
+      clean_ = true;
+      return true;
+    }
+    SD.remove(tmpPath.c_str());
+    entries_.clear();
+    logSize_ = 0;
+  }
+  return false;
+}
+
+bool JournalStore::replay(const String& path, bool& clean) {
+  File in = SD.open(path.c_str());
+  if (!in)
+    return false;
+  size_t size = in.size();
+  logSize_ = size;
+  clean = false;
+
+  uint8_t header[HEADER_SIZE];
+  if (in.read(header, HEADER_SIZE) != HEADER_SIZE || memcmp(header, JOURNAL_MAGIC, 4) != 0 ||
+      header[4] != JOURNAL_VERSION) {
+    Serial.printf("JournalStore: ignoring damaged %s\n", path.c_str());
+    in.close();
+    return true;
+  }
+
+  // Records of the batch being read, applied when its commit record arrives
+  struct Pending {
+    String key;
+    String value;
+    bool erase;
+  };
+  std::vector<Pending> batch;
+  std::vector<char> buf;
+  size_t offset = HEADER_SIZE;
+  size_t committed = HEADER_SIZE;
+  uint8_t head[4];
+  uint8_t crc[4];
+  while (offset + 4 <= size) {
+    if (in.read(head, 4) != 4)
+      break;
+    size_t keyLength = head[1];
+    size_t valueLength = head[2] | (head[3] << 8);
+    if (offset + RECORD_OVERHEAD + keyLength + valueLength > size)
+      break;  // Cut short
+    buf.resize(keyLength + valueLength + 1);
+    if (in.read((uint8_t*)buf.data(), keyLength + valueLength) != keyLength + valueLength || in.read(crc, 4) != 4)
+      break;
+    mz_ulong sum = mz_crc32(MZ_CRC32_INIT, head, 4);
+    sum = mz_crc32(sum, (const unsigned char*)buf.data(), keyLength + valueLength);
+    if ((uint32_t)sum != getU32(crc))
+      break;
+    offset += RECORD_OVERHEAD + keyLength + valueLength;
+
+    Pending record;
+    buf[keyLength + valueLength] = '\0';
+    record.value = String(buf.data() + keyLength);
+    buf[keyLength] = '\0';
+    record.key = String(buf.data());
+    record.erase = (head[0] & FLAG_ERASE) != 0;
+    batch.push_back(record);
+    if (head[0] & FLAG_COMMIT) {
+      for (const Pending& p : batch) {
+        if (p.erase)
+          entries_.erase(p.key);
+        else
+          entries_[p.key] = p.value;
+      }
+      batch.clear();
+      committed = offset;
+    }
+  }
+  in.close();
+
+  // Anything after the last commit (a torn or unfinished batch) must not be completed by the next append
+  clean = committed == size;
+  if (!clean)
+    Serial.printf("JournalStore: %s has %u bytes past its last commit\n", path.c_str(), (unsigned)(size - committed));
+  return true;
+}
+
+bool JournalStore::get(const String& key, String& value) const {
+  auto it = entries_.find(key);
+  if (it == entries_.end())
+    return false;
+  value = it->second;
+  return true;
+}
+
+bool JournalStore::set(const String& key, const String& value) {
+  if (key.length() == 0 || (size_t)key.length() > MAX_KEY_LENGTH || (size_t)value.length() > MAX_VALUE_LENGTH)
+    return false;
+  auto it = entries_.find(key);
+  if (it != entries_.end() && it->second == value)
+    return true;
+  entries_[key] = value;
+  for (Change& c : staged_) {
+    if (c.key == key) {
+      c.erase = false;
+      return true;
+    }
+  }
+  staged_.push_back({key, false});
+  return true;
+}
+
+void JournalStore::erase(const String& key) {
+  if (entries_.erase(key) == 0)
+    return;
+  for (Change& c : staged_) {
+    if (c.key == key) {
+      c.erase = true;
+      return;
+    }
+  }
+  staged_.push_back({key, true});
+}
+
+size_t JournalStore::getLiveSize() const {
+  size_t size = HEADER_SIZE;
+  for (const auto& e : entries_)
+    size += RECORD_OVERHEAD + e.first.length() + e.second.length();
+  return size;
+}
+
+void JournalStore::appendRecord(std::vector<uint8_t>& out, uint8_t flags, const String& key, const String& value) {
+  size_t start = out.size();
+  out.push_back(flags);
+  out.push_back((uint8_t)key.length());
+  out.push_back((uint8_t)value.length());
+  out.push_back((uint8_t)(value.length() >> 8));
+  out.insert(out.end(), key.c_str(), key.c_str() + key.length());
+  out.insert(out.end(), value.c_str(), value.c_str() + value.length());
+  uint32_t crc = (uint32_t)mz_crc32(MZ_CRC32_INIT, out.data() + start, out.size() - start);
+  for (int i = 0; i < 4; i++)
+    out.push_back((uint8_t)(crc >> (8 * i)));
+}
+
+bool JournalStore::commit() {
+  if (staged_.empty())
+    return true;
+
+  std::vector<uint8_t> batch;
+  for (size_t i = 0; i < staged_.size(); i++) {
+    const Change& c = staged_[i];
+    uint8_t flags = (c.erase ? FLAG_ERASE : 0) | (i + 1 == staged_.size() ? FLAG_COMMIT : 0);
+    auto it = entries_.find(c.key);
+    appendRecord(batch, flags, c.key, c.erase || it == entries_.end() ? String("") : it->second);
+  }
+
+  // A log without a clean end is rewritten rather than appended to; so is one that has grown mostly stale
+  size_t grown = logSize_ + batch.size();
+  if (!clean_ || (grown >= COMPACT_MIN_BYTES && grown > 2 * getLiveSize()))
+    return compact();
+
+  File out = SD.open(path_.c_str(), FILE_APPEND);
+  if (!out) {
+    Serial.printf("JournalStore: cannot append to %s\n", path_.c_str());
+    return false;
+  }
+  size_t written = out.write(batch.data(), batch.size());
+  out.close();
+  logSize_ += written;
+  if (written != batch.size()) {
+    // The staged changes stay staged; the next commit compacts past the torn batch
+    clean_ = false;
+    return false;
+  }
+  staged_.clear();
+  return true;
+}
+
+bool JournalStore::compact() {
+  String tmpPath = path_ + ".tmp";
+  SD.remove(tmpPath.c_str());
+  File out = SD.open(tmpPath.c_str(), FILE_WRITE);
+  if (!out) {
+    Serial.printf("JournalStore: cannot create %s\n", tmpPath.c_str());
+    return false;
+  }
+
+  // All live entries as a single batch
+  bool ok;
+  size_t size = HEADER_SIZE;
+  {
+    BufferedFileWriter writer(out, BufferedFileWriter::SMALL_BLOCK_SIZE);
+    uint8_t header[HEADER_SIZE] = {};
+    memcpy(header, JOURNAL_MAGIC, 4);
+    header[4] = JOURNAL_VERSION;
+    writer.write((const char*)header, HEADER_SIZE);
+    std::vector<uint8_t> record;
+    size_t remaining = entries_.size();
+    for (const auto& e : entries_) {
+      record.clear();
+      appendRecord(record, --remaining == 0 ? FLAG_COMMIT : 0, e.first, e.second);
+      writer.write((const char*)record.data(), record.size());
+      size += record.size();
+    }
+    ok = writer.flush();
+  }
+  out.close();
+
+  if (!ok) {
+    SD.remove(tmpPath.c_str());
+    return false;
+  }
+  SD.remove(path_.c_str());
+  if (!SD.rename(tmpPath.c_str(), path_.c_str())) {
+    Serial.printf("JournalStore: cannot rename %s\n", tmpPath.c_str());
+    return false;
+  }
+  logSize_ = size;
+  clean_ = true;
+  staged_.clear();
+  return true;
+}
@@ -0,0 +1,91 @@
+#ifndef JOURNAL_STORE_H
+#define JOURNAL_STORE_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/**
+ * JournalStore - small key/value store on the SD card kept as an append-only log
+ *
+ * The values live in RAM; the file only ever grows at its end. Changes are
+ * staged with set() and erase() and written by commit() as one batch of
+ * records:
+ *
+ *   "MRJL" u8 version, 3 reserved
+ *   { u8 flags, u8 key length, u16 value length, key, value, u32 CRC-32 }...
+ *
+ * The CRC covers the record before it, and the last record of a batch
+ * carries the COMMIT flag. load() replays the batches in order and stops at
+ * the first record that is cut short or fails its CRC, so a reset in the
+ * middle of commit() loses that batch only, never an earlier one. Changing
+ * one setting appends a few dozen bytes to the last sector instead of
+ * rewriting the whole file.
+ *
+ * Once the log is more than twice the size the live entries need (and at
+ * least COMPACT_MIN_BYTES), and whenever a damaged tail was found, commit()
+ * compacts instead: the live entries are written to "<path>.tmp" as one
+ * batch, which then replaces the log. load() adopts a complete temporary
+ * file when a reset came between removing the old log and the rename.
+ */
+class JournalStore {
+ public:
+  static const size_t HEADER_SIZE = 8;
+  static const size_t RECORD_OVERHEAD = 8;  // Flags, lengths and CRC
+  static const size_t MAX_KEY_LENGTH = 255;
+  static const size_t MAX_VALUE_LENGTH = 65535;
+  static const size_t COMPACT_MIN_BYTES = 4096;
+
+  explicit JournalStore(const String& path) : path_(path) {}
+
+  JournalStore(const JournalStore&) = delete;
+  JournalStore& operator=(const JournalStore&) = delete;
+
+  // Replay the log into RAM, dropping staged changes. False if there is no log (the store is then empty).
+  bool load();
+
+  bool get(const String& key, String& value) const;
+  const std::map<String, String>& entries() const {
+    return entries_;
+  }
+
+  // Stage a change, visible to get() at once; false if the key or value is too long. Setting a key to its current
+  // value stages nothing.
+  bool set(const String& key, const String& value);
+  void erase(const String& key);
+
+  // Append the staged changes as one batch (compacting when due). True if there was nothing to write.
+  bool commit();
+
+  // Rewrite the log with only the live entries
+  bool compact();
+
+  // Bytes of the log on the card, and how many of those a compacted log would need
+  size_t getLogSize() const {
+    return logSize_;
+  }
+  size_t getLiveSize() const;
+
+ private:
+  enum Flags : uint8_t { FLAG_COMMIT = 0x01, FLAG_ERASE = 0x02 };
+
+  struct Change {
+    String key;
+    bool erase;
+  };
+
+  bool replay(const String& path, bool& clean);
+  static void appendRecord(std::vector<uint8_t>& out, uint8_t flags, const String& key, const String& value);
+
+  String path_;
+  std::map<String, String> entries_;
+  std::vector<Change> staged_;
+  size_t logSize_ = 0;
+  bool clean_ = false;  // The log ends with a complete batch and can be appended to
+};
+
+#endif
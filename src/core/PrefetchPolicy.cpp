@@ -0,0 +1,80 @@
+#include "PrefetchPolicy.h"
+
+#include <Arduino.h>
+
+static const char* MODE_NAMES[] = {"off", "frugal", "normal", "eager"};
+static const char* KIND_NAMES[] = {"page", "chapter"};
+
+void PrefetchPolicy::setPowerState(uint8_t batteryPercent, bool usbConnected) {
+  powerKnown_ = true;
+  batteryPercent_ = batteryPercent;
+  usbConnected_ = usbConnected;
+}
+
+PrefetchPolicy::Mode PrefetchPolicy::getMode() const {
+  if (!powerKnown_)
+    return MODE_NORMAL;
+  if (usbConnected_)
+    return MODE_EAGER;
+  if (batteryPercent_ <= LOW_BATTERY_PERCENT)
+    return MODE_OFF;
+  return batteryPercent_ < HIGH_BATTERY_PERCENT ? MODE_FRUGAL : MODE_NORMAL;
+}
+
+void PrefetchPolicy::notePageTurn(int direction, unsigned long nowMs) {
+  int8_t step = direction < 0 ? -1 : 1;
+  if (streak_ == 0 || (streak_ > 0) != (step > 0))
+    streak_ = step;
+  else if (streak_ < MAX_STREAK && streak_ > -MAX_STREAK)
+    streak_ += step;
+
+  // A long pause is the book put down, not reading speed
+  if (haveTurn_) {
+    unsigned long elapsed = nowMs - lastTurnMs_;
+    if (elapsed <= MAX_PAGE_INTERVAL_MS)
+      pageIntervalMs_ = pageIntervalMs_ ? (3 * pageIntervalMs_ + (uint32_t)elapsed) / 4 : (uint32_t)elapsed;
+  }
+  lastTurnMs_ = nowMs;
+  haveTurn_ = true;
+}
+
+void PrefetchPolicy::noteJump() {
+  streak_ = 0;
+  haveTurn_ = false;
+}
+
+PrefetchPolicy::Plan PrefetchPolicy::plan(float pagesLeft) const {
+  Plan p = {(int8_t)getDirection(), false, 0};
+  switch (getMode()) {
+    case MODE_OFF:
+      break;
+    case MODE_FRUGAL:
+      p.layoutPage = getStreak() >= FRUGAL_PAGE_STREAK;
+      if (pagesLeft <= FRUGAL_CHAPTER_PAGES)
+        p.chaptersAhead = 1;
+      break;
+    case MODE_NORMAL: {
+      p.layoutPage = true;
+      uint32_t interval = pageIntervalMs_ ? pageIntervalMs_ : DEFAULT_PAGE_INTERVAL_MS;
+      if (pagesLeft * interval <= CHAPTER_LEAD_MS)
+        p.chaptersAhead = 1;
+      break;
+    }
+    case MODE_EAGER:
+      p.layoutPage = true;
+      p.chaptersAhead = USB_CHAPTERS_AHEAD;
+      break;
+  }
+  return p;
+}
+
+void PrefetchPolicy::printReport() const {
+  Serial.printf("Prefetch: mode=%s battery=%u%% usb=%d direction=%d streak=%u interval=%lums\n", MODE_NAMES[getMode()],
+                (unsigned)batteryPercent_, usbConnected_ ? 1 : 0, getDirection(), (unsigned)getStreak(),
+                (unsigned long)pageIntervalMs_);
+  for (int k = 0; k < KIND_COUNT; k++) {
+    const Counters& c = counters_[k];
+    Serial.printf("  %-8s issued=%lu used=%lu wasted=%lu\n", KIND_NAMES[k], (unsigned long)c.issued,
+                  (unsigned long)c.used, (unsigned long)c.wasted);
+  }
+}
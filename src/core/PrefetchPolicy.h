@@ -0,0 +1,118 @@
+#ifndef PREFETCH_POLICY_H
+#define PREFETCH_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * PrefetchPolicy - how much speculative reading work to do
+ *
+ * The reader can lay out the page the user will most likely turn to next, and
+ * convert the chapters around the current one into the chapter text cache,
+ * before they are asked for. This work is wasted when the reader jumps
+ * elsewhere, so how much to do depends on the power source and on how the
+ * book is being read:
+ *
+ *   MODE_OFF     battery at LOW_BATTERY_PERCENT or below: nothing
+ *   MODE_FRUGAL  battery below HIGH_BATTERY_PERCENT: the next page only after
+ *                a few turns the same way, the next chapter only on the last
+ *                pages of this one
+ *   MODE_NORMAL  the next page in the reading direction always, the next
+ *                chapter once the reader will get there within CHAPTER_LEAD_MS
+ *   MODE_EAGER   on USB power: the next page, and USB_CHAPTERS_AHEAD chapters
+ *                in the reading direction wherever the reader is
+ *
+ * The reading direction and speed come from the page turns: a streak counts
+ * turns in the same direction (a jump resets it) and the time between turns
+ * is averaged, ignoring pauses longer than MAX_PAGE_INTERVAL_MS.
+ *
+ * The counters tell how much of the speculation paid off: a prefetch is
+ * "used" when the reader asks for what was prepared and "wasted" when it is
+ * dropped unused. The policy only decides and counts; the screen does the
+ * work through the Scheduler.
+ */
+class PrefetchPolicy {
+ public:
+  enum Mode : uint8_t { MODE_OFF, MODE_FRUGAL, MODE_NORMAL, MODE_EAGER };
+  enum Kind : uint8_t { KIND_PAGE, KIND_CHAPTER, KIND_COUNT };
+
+  static const uint8_t LOW_BATTERY_PERCENT = 20;
+  static const uint8_t HIGH_BATTERY_PERCENT = 50;
+  static const uint8_t FRUGAL_PAGE_STREAK = 2;       // Turns the same way before a frugal page prefetch
+  static const uint8_t FRUGAL_CHAPTER_PAGES = 2;     // Pages left in the chapter before a frugal chapter prefetch
+  static const uint8_t USB_CHAPTERS_AHEAD = 3;
+  static const uint32_t CHAPTER_LEAD_MS = 90000;
+  static const uint32_t DEFAULT_PAGE_INTERVAL_MS = 30000;  // Assumed until two turns have been seen
+  static const uint32_t MAX_PAGE_INTERVAL_MS = 300000;
+
+  // What to prepare now
+  struct Plan {
+    int8_t direction;       // +1 forward, -1 backward
+    bool layoutPage;        // Lay out the page the reader turns to next in that direction
+    uint8_t chaptersAhead;  // Chapters in that direction to convert, nearest first
+  };
+
+  struct Counters {
+    uint32_t issued;
+    uint32_t used;
+    uint32_t wasted;
+  };
+
+  PrefetchPolicy() {}
+
+  // Latest battery charge (0-100) and whether USB power is present
+  void setPowerState(uint8_t batteryPercent, bool usbConnected);
+  Mode getMode() const;
+
+  // A page turn by the reader (+1 forward, -1 backward) at nowMs
+  void notePageTurn(int direction, unsigned long nowMs);
+  // Any other move (chapter jump, search, percentage): the reading pattern starts over
+  void noteJump();
+
+  int getDirection() const {
+    return streak_ < 0 ? -1 : 1;
+  }
+  // Turns in a row in the current direction
+  uint8_t getStreak() const {
+    return (uint8_t)(streak_ < 0 ? -streak_ : streak_);
+  }
+  // Average time between page turns, 0 until known
+  uint32_t getPageIntervalMs() const {
+    return pageIntervalMs_;
+  }
+
+  // What to prepare with pagesLeft pages between the current page and the end of the chapter in the reading
+  // direction
+  Plan plan(float pagesLeft) const;
+
+  void recordIssued(Kind kind) {
+    counters_[kind].issued++;
+  }
+  void recordUsed(Kind kind) {
+    counters_[kind].used++;
+  }
+  void recordWasted(Kind kind) {
+    counters_[kind].wasted++;
+  }
+  const Counters& getCounters(Kind kind) const {
+    return counters_[kind];
+  }
+
+  void printReport() const;
+
+ private:
+  static const int8_t MAX_STREAK = 8;
+
+  bool powerKnown_ = false;
+  uint8_t batteryPercent_ = 100;
+  bool usbConnected_ = false;
+
+  int8_t streak_ = 0;  // Positive forward, negative backward
+  unsigned long lastTurnMs_ = 0;
+  bool haveTurn_ = false;
+  uint32_t pageIntervalMs_ = 0;
+
+  Counters counters_[KIND_COUNT] = {};
+};
+
+#endif
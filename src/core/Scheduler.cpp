@@ -0,0 +1,185 @@
+#include "Scheduler.h"
+
+#include <Arduino.h>
+
+#include "Trace.h"
+
+static const char* STATE_NAMES[] = {"free", "queued", "done", "cancelled"};
+static const char* PRIORITY_NAMES[] = {"low", "normal", "high"};
+
+Scheduler::Scheduler() {
+  for (Slot& slot : slots_) {
+    slot.job = nullptr;
+    slot.sliceMicros = 0;
+    slot.stats = {};
+  }
+}
+
+Scheduler::~Scheduler() {
+  cancelAll();
+}
+
+Scheduler::JobId Scheduler::add(Job* job, Priority priority, uint32_t sliceMicros) {
+  if (!job)
+    return NO_JOB;
+
+  // A free slot, or else the one holding the oldest finished job
+  Slot* target = nullptr;
+  for (Slot& slot : slots_) {
+    if (slot.stats.state == STATE_FREE) {
+      target = &slot;
+      break;
+    }
+    if (slot.stats.state != STATE_QUEUED && (!target || slot.stats.id < target->stats.id))
+      target = &slot;
+  }
+  if (!target) {
+    Serial.printf("Scheduler: no slot for %s\n", job->name());
+    delete job;
+    return NO_JOB;
+  }
+
+  target->job = job;
+  target->sliceMicros = sliceMicros > 0 ? sliceMicros : DEFAULT_SLICE_MICROS;
+  target->stats = {};
+  target->stats.name = job->name();
+  target->stats.id = nextId_++;
+  target->stats.priority = priority < PRIORITY_COUNT ? priority : PRIORITY_HIGH;
+  target->stats.state = STATE_QUEUED;
+  return target->stats.id;
+}
+
+bool Scheduler::cancel(JobId id) {
+  for (int i = 0; i < (int)MAX_JOBS; i++) {
+    Slot& slot = slots_[i];
+    if (slot.stats.state != STATE_QUEUED || slot.stats.id != id)
+      continue;
+    if (i == current_)
+      slot.stats.state = STATE_CANCELLED;  // Deleted by run() once its step returns
+    else
+      retire(slot, STATE_CANCELLED);
+    return true;
+  }
+  return false;
+}
+
+void Scheduler::cancelAll() {
+  for (const Slot& slot : slots_) {
+    if (slot.stats.state == STATE_QUEUED)
+      cancel(slot.stats.id);
+  }
+}
+
+void Scheduler::retire(Slot& slot, State state) {
+  if (state == STATE_CANCELLED)
+    slot.job->cancelled();
+  delete slot.job;
+  slot.job = nullptr;
+  slot.stats.state = state;
+}
+
+bool Scheduler::isActive(JobId id) const {
+  for (const Slot& slot : slots_) {
+    if (slot.stats.state == STATE_QUEUED && slot.stats.id == id)
+      return true;
+  }
+  return false;
+}
+
+bool Scheduler::hasWork() const {
+  for (const Slot& slot : slots_) {
+    if (slot.stats.state == STATE_QUEUED)
+      return true;
+  }
+  return false;
+}
+
+int Scheduler::pickNext() const {
+  // Highest priority wins; among equals the first one after the slot stepped last
+  int best = -1;
+  for (int n = 1; n <= (int)MAX_JOBS; n++) {
+    int i = (lastSlot_ + n) % (int)MAX_JOBS;
+    if (slots_[i].stats.state != STATE_QUEUED)
+      continue;
+    if (best < 0 || slots_[i].stats.priority > slots_[best].stats.priority)
+      best = i;
+  }
+  return best;
+}
+
+bool Scheduler::run(uint32_t budgetMicros) {
+  if (running_)
+    return false;
+  running_ = true;
+
+  bool ran = false;
+  uint32_t start = micros();
+  while (true) {
+    uint32_t elapsed = micros() - start;
+    if (elapsed >= budgetMicros)
+      break;
+    int index = pickNext();
+    if (index < 0)
+      break;
+    if (preempt_ && preempt_(preemptContext_)) {
+      preemptions_++;
+      break;
+    }
+
+    Slot& slot = slots_[index];
+    uint32_t slice = budgetMicros - elapsed;
+    if (slice > slot.sliceMicros)
+      slice = slot.sliceMicros;
+
+    current_ = index;
+    uint32_t stepStart = micros();
+    bool more;
+    {
+      TRACE_SCOPE(RUN_JOB, slot.stats.id);
+      more = slot.job->step(slice);
+    }
+    uint32_t took = micros() - stepStart;
+    current_ = -1;
+    lastSlot_ = index;
+    ran = true;
+
+    JobStats& stats = slot.stats;
+    stats.steps++;
+    stats.cpuMicros += took;
+    if (took > stats.longestStepMicros)
+      stats.longestStepMicros = took;
+    if (took > slot.sliceMicros)
+      stats.overruns++;
+
+    // The job may have been cancelled from inside its own step
+    if (stats.state == STATE_CANCELLED)
+      retire(slot, STATE_CANCELLED);
+    else if (!more)
+      retire(slot, STATE_DONE);
+  }
+
+  running_ = false;
+  return ran;
+}
+
+bool Scheduler::getStats(JobId id, JobStats& out) const {
+  for (const Slot& slot : slots_) {
+    if (slot.stats.state != STATE_FREE && slot.stats.id == id) {
+      out = slot.stats;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Scheduler::printReport() const {
+  Serial.printf("Scheduler: %lu preemptions\n", (unsigned long)preemptions_);
+  for (const Slot& slot : slots_) {
+    const JobStats& s = slot.stats;
+    if (s.state == STATE_FREE)
+      continue;
+    Serial.printf("  #%lu %-16s %-6s %-9s steps=%lu cpu=%lums longest=%luus overruns=%lu\n", (unsigned long)s.id,
+                  s.name, PRIORITY_NAMES[s.priority], STATE_NAMES[s.state], (unsigned long)s.steps,
+                  (unsigned long)(s.cpuMicros / 1000), (unsigned long)s.longestStepMicros, (unsigned long)s.overruns);
+  }
+}
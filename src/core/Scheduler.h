@@ -0,0 +1,129 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Job - a piece of background work that can be resumed
+ *
+ * The job keeps its own progress between calls to step(). Each step does a
+ * bounded amount of work and returns, so the loop can get back to the buttons
+ * and the display in time.
+ */
+class Job {
+ public:
+  virtual ~Job() {}
+
+  // Do some work, returning once budgetMicros have roughly passed. False when the job is finished.
+  virtual bool step(uint32_t budgetMicros) = 0;
+
+  // Called once instead of further steps when the job is cancelled, before it is deleted
+  virtual void cancelled() {}
+
+  // A string literal: it stays in the scheduler's statistics after the job is deleted
+  virtual const char* name() const = 0;
+};
+
+/**
+ * Scheduler - cooperative, time-sliced runner for background jobs
+ *
+ * The firmware has a single loop, so background work (prefetching, chapter
+ * conversion, indexing, thumbnails) gets CPU only where the loop would
+ * otherwise sleep: the idle gap at the end of loop() and the busy wait while
+ * the panel refreshes. run() is called there with a time budget and steps
+ * the queued jobs until it is used up.
+ *
+ * The highest priority job with work left runs first; jobs of equal
+ * priority take turns. Before every step the preempt check is asked (a
+ * queued button press, on the device) and run() returns at once if it says
+ * so, so a job never delays the response to a key by more than one step.
+ *
+ * The scheduler owns its jobs and deletes them when they finish or are
+ * cancelled. The statistics of a job (steps, CPU time, longest step) stay
+ * readable by its id until its slot is taken by a new job. Jobs must not
+ * draw to the display or call back into the scheduler's run().
+ */
+class Scheduler {
+ public:
+  enum Priority : uint8_t { PRIORITY_LOW, PRIORITY_NORMAL, PRIORITY_HIGH, PRIORITY_COUNT };
+  enum State : uint8_t { STATE_FREE, STATE_QUEUED, STATE_DONE, STATE_CANCELLED };
+
+  // Ids are never reused, so a stale id cannot cancel a newer job
+  typedef uint32_t JobId;
+  static const JobId NO_JOB = 0;
+
+  static const size_t MAX_JOBS = 8;
+  static const uint32_t DEFAULT_SLICE_MICROS = 5000;
+
+  // True when the jobs should give way, e.g. while a button press is waiting
+  typedef bool (*PreemptFn)(void* context);
+
+  struct JobStats {
+    const char* name;
+    JobId id;
+    uint8_t priority;
+    uint8_t state;
+    uint32_t steps;
+    uint32_t overruns;  // Steps that took longer than the job's slice
+    uint32_t longestStepMicros;
+    uint64_t cpuMicros;
+  };
+
+  Scheduler();
+  ~Scheduler();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  // Queue a job, taking ownership. Each step gets at most sliceMicros. NO_JOB (and the job is deleted) when every
+  // slot holds an unfinished job.
+  JobId add(Job* job, Priority priority = PRIORITY_NORMAL, uint32_t sliceMicros = DEFAULT_SLICE_MICROS);
+
+  // Drop a job before its next step. False if it already finished or is unknown.
+  bool cancel(JobId id);
+  void cancelAll();
+
+  bool isActive(JobId id) const;
+  bool hasWork() const;
+
+  void setPreemptCheck(PreemptFn check, void* context) {
+    preempt_ = check;
+    preemptContext_ = context;
+  }
+
+  // Step jobs until budgetMicros have passed, no job has work left or the preempt check fires. True if any step
+  // ran. Calls made from inside a step return false without running anything.
+  bool run(uint32_t budgetMicros);
+
+  bool getStats(JobId id, JobStats& out) const;
+
+  // run() calls that ended early because of the preempt check
+  uint32_t getPreemptions() const {
+    return preemptions_;
+  }
+
+  void printReport() const;
+
+ private:
+  struct Slot {
+    Job* job;
+    uint32_t sliceMicros;
+    JobStats stats;
+  };
+
+  int pickNext() const;
+  void retire(Slot& slot, State state);
+
+  Slot slots_[MAX_JOBS];
+  JobId nextId_ = 1;
+  int lastSlot_ = -1;  // Slot stepped last, where the round robin continues
+  int current_ = -1;   // Slot inside step() right now
+  bool running_ = false;
+  uint32_t preemptions_ = 0;
+
+  PreemptFn preempt_ = nullptr;
+  void* preemptContext_ = nullptr;
+};
+
+#endif
@@ -2,64 +2,78 @@
 #include <cstring>
 
 #include <Arduino.h>
+#include <SD.h>
 
-Settings::Settings(SDCardManager& sdManager) : sd(sdManager) {}
+// Settings are appended to a journal; a key=value settings.cfg (the format before the journal, or one written by
+// hand) is imported over them on the next load and then removed
+static const char* SETTINGS_JOURNAL_PATH = "/microreader/settings.jnl";
+static const char* SETTINGS_IMPORT_PATH = "/microreader/settings.cfg";
+
+Settings::Settings(SDCardManager& sdManager) : sd(sdManager), journal(SETTINGS_JOURNAL_PATH) {}
 
 bool Settings::load() {
   if (!sd.ready())
     return false;
 
+  bool found = journal.load();
+
   char buf[2048];
-  size_t r = sd.readFileToBuffer("/microreader/settings.cfg", buf, sizeof(buf));
-  if (r == 0) {
-    kv.clear();
-    return false;
+  size_t r = SD.exists(SETTINGS_IMPORT_PATH) ? sd.readFileToBuffer(SETTINGS_IMPORT_PATH, buf, sizeof(buf)) : 0;
+  if (r > 0) {
+    // Ensure null-termination
+    buf[sizeof(buf) - 1] = '\0';
+    parseSettingsBuffer(buf);
+    if (journal.commit()) {
+      Serial.printf("Imported %s\n", SETTINGS_IMPORT_PATH);
+      SD.remove(SETTINGS_IMPORT_PATH);
+    }
+    found = true;
   }
-
-  // Ensure null-termination
-  buf[sizeof(buf) - 1] = '\0';
-  parseSettingsBuffer(buf);
-  return true;
+  return found;
 }
 
 bool Settings::save() {
   if (!sd.ready())
     return false;
-  String out;
-  for (const auto& p : kv) {
-    out += p.first;
-    out += "=";
-    out += p.second;
-    out += "\n";
-  }
-  return sd.writeFile("/microreader/settings.cfg", out);
+  return journal.commit();
 }
 
 bool Settings::getInt(const String& key, int& out) const {
-  auto it = kv.find(key);
-  if (it == kv.end())
+  String value;
+  if (!journal.get(key, value))
     return false;
-  out = atoi(it->second.c_str());
+  out = atoi(value.c_str());
   return true;
 }
 
 void Settings::setInt(const String& key, int v) {
-  kv[key] = String(v);
+  journal.set(key, String(v));
 }
 
 String Settings::getString(const String& key, const String& def) const {
-  auto it = kv.find(key);
-  if (it == kv.end())
-    return def;
-  return it->second;
+  String value;
+  return journal.get(key, value) ? value : def;
 }
 
 void Settings::setString(const String& key, const String& value) {
-  kv[key] = value;
+  journal.set(key, value);
+}
+
+Settings::AntialiasingMode Settings::getAntialiasingMode() const {
+  int mode = AA_ALWAYS;
+  if (getInt(String("settings.antialiasing"), mode) && mode >= AA_ALWAYS && mode <= AA_OFF)
+    return static_cast<AntialiasingMode>(mode);
+  return AA_ALWAYS;
+}
+
+unsigned long Settings::getAntialiasingDelayMs() const {
+  int delay = 0;
+  if (getInt(String("settings.antialiasingDelay"), delay) && delay >= 0)
+    return static_cast<unsigned long>(delay);
+  return DEFAULT_ANTIALIASING_DELAY_MS;
 }
 
 void Settings::parseSettingsBuffer(const char* buf) {
-  kv.clear();
   const char* p = buf;
   while (*p) {
     // Read line
@@ -80,7 +94,7 @@ void Settings::parseSettingsBuffer(const char* buf) {
         if (eq > 0) {
           String key = line.substring(0, eq);
           String val = line.substring(eq + 1);
-          kv[key] = val;
+          journal.set(key, val);
         }
       }
     }
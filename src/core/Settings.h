@@ -4,15 +4,16 @@
 #include <map>
 #include <string>
 
+#include "core/JournalStore.h"
 #include "core/SDCardManager.h"
 
 class Settings {
  public:
   explicit Settings(SDCardManager& sdManager);
 
-  // Load from /microreader/settings.cfg or import legacy settings
+  // Load from the settings journal, then import /microreader/settings.cfg if there is one
   bool load();
-  // Persist current settings to SD
+  // Persist the settings changed since the last load or save, as one journal commit
   bool save();
 
   // Get/Set simple values
@@ -22,13 +23,23 @@ class Settings {
   String getString(const String& key, const String& def = String("")) const;
   void setString(const String& key, const String& value);
 
+  // Grayscale antialiasing (settings.antialiasing): always, deferred until the user stops on a page, or never
+  enum AntialiasingMode { AA_ALWAYS = 0, AA_ADAPTIVE = 1, AA_OFF = 2 };
+  static const unsigned long DEFAULT_ANTIALIASING_DELAY_MS = 1000;
+
+  // AA_ALWAYS when unset or out of range
+  AntialiasingMode getAntialiasingMode() const;
+  // settings.antialiasingDelay: how long the adaptive mode waits before the grayscale pass
+  unsigned long getAntialiasingDelayMs() const;
+
   // (Positions are stored per-file as `.pos` files; not part of consolidated settings)
 
  private:
   SDCardManager& sd;
-  // Simple map of settings stored as string (use String for compatibility)
-  std::map<String, String> kv;
+  // Settings stored as strings (use String for compatibility), kept in RAM by the journal
+  JournalStore journal;
 
+  // Stage the key=value lines of buf over the current settings
   void parseSettingsBuffer(const char* buf);
 };
 
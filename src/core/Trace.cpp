@@ -0,0 +1,103 @@
+#include "Trace.h"
+
+#ifdef MICROREADER_TRACE
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include <cstdio>
+
+namespace Trace {
+
+static Record ring[CAPACITY];
+static uint32_t total = 0;  // Records written since clear(); next slot is total % CAPACITY
+
+static const char* const EVENT_NAMES[EVENT_COUNT] = {
+    "openFile", "openChapter", "convertChapter", "layoutText", "renderPage", "writeRamBuffer", "refreshDisplay",
+    "sdRead", "runJob",
+};
+
+void record(Event event, Phase phase, uint32_t arg) {
+  Record& r = ring[total % CAPACITY];
+  r.timestampUs = (uint32_t)micros();
+  r.arg = arg;
+  r.event = event;
+  r.phase = phase;
+  total++;
+}
+
+size_t count() {
+  return total < CAPACITY ? total : CAPACITY;
+}
+
+uint32_t recorded() {
+  return total;
+}
+
+Record at(size_t i) {
+  size_t first = total < CAPACITY ? 0 : total % CAPACITY;
+  return ring[(first + i) % CAPACITY];
+}
+
+void clear() {
+  total = 0;
+}
+
+const char* eventName(uint8_t event) {
+  return event < EVENT_COUNT ? EVENT_NAMES[event] : "unknown";
+}
+
+// Writes the ring through any sink with print(const char*) (Serial, File)
+template <typename Out>
+static void writeJson(Out& out) {
+  // End records whose begin was overwritten by the ring would confuse the viewer; skip them
+  uint16_t open[EVENT_COUNT] = {};
+  char line[128];
+  bool first = true;
+
+  out.print("{\"traceEvents\":[\n");
+  size_t n = count();
+  for (size_t i = 0; i < n; ++i) {
+    Record r = at(i);
+    if (r.event >= EVENT_COUNT)
+      continue;
+    if (r.phase == BEGIN) {
+      open[r.event]++;
+    } else if (r.phase == END) {
+      if (open[r.event] == 0)
+        continue;
+      open[r.event]--;
+    }
+    snprintf(line, sizeof(line),
+             "%s{\"name\":\"%s\",\"ph\":\"%c\",%s\"ts\":%lu,\"pid\":1,\"tid\":1,\"args\":{\"arg\":%lu}}",
+             first ? "" : ",\n", eventName(r.event), (char)r.phase, r.phase == INSTANT ? "\"s\":\"t\"," : "",
+             (unsigned long)r.timestampUs, (unsigned long)r.arg);
+    out.print(line);
+    first = false;
+  }
+  snprintf(line, sizeof(line), "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"recorded\":%lu,\"capacity\":%u}}\n",
+           (unsigned long)total, (unsigned)CAPACITY);
+  out.print(line);
+}
+
+void dumpToSerial() {
+  writeJson(Serial);
+}
+
+bool dumpToFile(const char* path) {
+  if (SD.exists(path))
+    SD.remove(path);
+  File out = SD.open(path, FILE_WRITE);
+  if (!out) {
+    Serial.printf("Trace: failed to open %s for writing\n", path);
+    return false;
+  }
+  writeJson(out);
+  out.close();
+  Serial.printf("Trace: wrote %u records to %s\n", (unsigned)count(), path);
+  return true;
+}
+
+}  // namespace Trace
+
+#endif
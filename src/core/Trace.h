@@ -0,0 +1,108 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Trace - fixed-size RAM ring of timing records
+ *
+ * Each record is (event id, phase, timestamp in microseconds, argument). Code
+ * marks a region with TRACE_SCOPE(event, arg), which records a begin on entry
+ * and an end on exit; TRACE_INSTANT records a single point. When the ring is
+ * full the oldest records are overwritten, so it always holds the most recent
+ * activity. Recording is a handful of stores and never touches the UART or SD.
+ *
+ * dumpToSerial() / dumpToFile() write the ring as Chrome trace JSON, which can
+ * be opened in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Tracing is compiled in only when MICROREADER_TRACE is defined. Otherwise the
+ * macros expand to nothing and the dump functions are empty inline stubs.
+ */
+
+namespace Trace {
+
+enum Event : uint8_t {
+  OPEN_FILE,        // TextViewerScreen::openFile (arg: unused)
+  OPEN_CHAPTER,     // EpubWordProvider::openChapter (arg: chapter index)
+  CONVERT_CHAPTER,  // XHTML to TXT conversion of one chapter (end arg: bytes written)
+  LAYOUT_TEXT,      // LayoutStrategy::layoutText (arg: start position)
+  RENDER_PAGE,      // LayoutStrategy::renderPage (arg: number of lines)
+  WRITE_RAM,        // EInkDisplay::writeRamBuffer (arg: controller RAM command)
+  REFRESH_DISPLAY,  // EInkDisplay::refreshDisplay (arg: refresh mode)
+  SD_READ,          // Buffered SD file read (arg: file offset, end arg: bytes read)
+  RUN_JOB,          // Scheduler::run stepping a background job (arg: job id)
+  EVENT_COUNT
+};
+
+enum Phase : uint8_t { BEGIN = 'B', END = 'E', INSTANT = 'i' };
+
+struct Record {
+  uint32_t timestampUs;
+  uint32_t arg;
+  uint8_t event;
+  uint8_t phase;
+};
+
+// Ring capacity in records (12 bytes each)
+static const size_t CAPACITY = 512;
+
+#ifdef MICROREADER_TRACE
+
+void record(Event event, Phase phase, uint32_t arg = 0);
+
+// Number of records held (at most CAPACITY) and total recorded since the last clear()
+size_t count();
+uint32_t recorded();
+// i-th held record, oldest first
+Record at(size_t i);
+void clear();
+
+const char* eventName(uint8_t event);
+
+// Write the held records as Chrome trace JSON; the ring is left untouched
+void dumpToSerial();
+bool dumpToFile(const char* path);
+
+class Scope {
+ public:
+  Scope(Event event, uint32_t arg = 0) : event_(event) {
+    record(event, BEGIN, arg);
+  }
+  ~Scope() {
+    record(event_, END, endArg_);
+  }
+  // Attach a value known only at the end of the region (e.g. bytes read)
+  void setEndArg(uint32_t arg) {
+    endArg_ = arg;
+  }
+
+ private:
+  Event event_;
+  uint32_t endArg_ = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(event, arg) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(Trace::event, (uint32_t)(arg))
+#define TRACE_SCOPE_NAMED(name, event, arg) Trace::Scope name(Trace::event, (uint32_t)(arg))
+#define TRACE_SCOPE_END_ARG(name, arg) (name).setEndArg((uint32_t)(arg))
+#define TRACE_INSTANT(event, arg) Trace::record(Trace::event, Trace::INSTANT, (uint32_t)(arg))
+
+#else
+
+inline void dumpToSerial() {}
+inline bool dumpToFile(const char*) {
+  return false;
+}
+
+#define TRACE_SCOPE(event, arg)
+#define TRACE_SCOPE_NAMED(name, event, arg)
+#define TRACE_SCOPE_END_ARG(name, arg)
+#define TRACE_INSTANT(event, arg)
+
+#endif
+
+}  // namespace Trace
+
+#endif
@@ -1,6 +1,8 @@
 #include <Arduino.h>
 #include <SD.h>
 
+#include "../core/Trace.h"
+
 extern "C" {
 
 void* arduino_file_open(const char* path) {
@@ -60,7 +62,9 @@ size_t arduino_file_read(void* ptr, size_t size, size_t count, void* handle) {
     return 0;
   File* f = static_cast<File*>(handle);
   size_t bytes_to_read = size * count;
+  TRACE_SCOPE_NAMED(readScope, SD_READ, f->position());
   size_t bytes_read = f->read(static_cast<uint8_t*>(ptr), bytes_to_read);
+  TRACE_SCOPE_END_ARG(readScope, bytes_read);
   return bytes_read / size;  // Return number of elements read
 }
 
@@ -8,7 +8,11 @@
 #include "core/BatteryMonitor.h"
 #include "core/Buttons.h"
 #include "core/EInkDisplay.h"
+#include "core/HeapTelemetry.h"
+#include "core/PrefetchPolicy.h"
 #include "core/SDCardManager.h"
+#include "core/Scheduler.h"
+#include "core/Trace.h"
 #include "rendering/SimpleFont.h"
 #include "resources/fonts/FontDefinitions.h"
 #include "resources/fonts/other/MenuFontSmall.h"
@@ -23,6 +27,11 @@ const unsigned long POWER_BUTTON_WAKEUP_MS = 250;  // Time required to confirm b
 // Power button pin (used in multiple places)
 const int POWER_BUTTON_PIN = 3;
 
+// Time given to background jobs per pass of loop() (stands in for its idle delay)
+const uint32_t IDLE_JOB_MICROS = 10000;
+// How often battery charge and USB power are passed to the prefetch policy
+const unsigned long POWER_SAMPLE_MS = 30000;
+
 // Display SPI pins (custom pins, not hardware SPI defaults)
 #define EPD_SCLK 8   // SPI Clock
 #define EPD_DC 4     // Data/Command
@@ -52,6 +61,11 @@ void buttonUpdateTask(void* parameter) {
   }
 }
 
+// Background jobs give way as soon as a button press is waiting
+bool buttonPressWaiting(void* context) {
+  return static_cast<Buttons*>(context)->hasQueuedPresses();
+}
+
 // Write debug log to SD card
 void writeDebugLog() {
   esp_sleep_wakeup_cause_t w = esp_sleep_get_wakeup_cause();
@@ -170,6 +184,11 @@ void setup() {
   Serial.printf("Free memory before display init: %d bytes\n", ESP.getFreeHeap());
   einkDisplay.begin();
 
+  // Background jobs run while the panel refreshes and in the idle gaps of loop()
+  Scheduler& scheduler = uiManager.getScheduler();
+  scheduler.setPreemptCheck(buttonPressWaiting, &buttons);
+  einkDisplay.setScheduler(&scheduler);
+
   // Initialize display controller (handles application logic)
   uiManager.begin();
 
@@ -180,11 +199,36 @@ void loop() {
   // Print memory stats every second
   static unsigned long lastMemPrint = 0;
   if (Serial && millis() - lastMemPrint >= 4000) {
-    Serial.printf("[%lu] Memory - Free: %d bytes, Total: %d bytes, Min Free: %d bytes\n", millis(), ESP.getFreeHeap(),
-                  ESP.getHeapSize(), ESP.getMinFreeHeap());
+    Serial.printf("[%lu] Memory - Free: %d bytes, Total: %d bytes, Min Free: %d bytes, Max Block: %d bytes\n", millis(),
+                  ESP.getFreeHeap(), ESP.getHeapSize(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap());
     lastMemPrint = millis();
   }
 
+#if defined(MICROREADER_TRACE) || defined(MICROREADER_HEAP_TELEMETRY)
+  // Debug dumps on request: 't' prints the timing trace, 'T' writes it to /trace.json, 'h' prints the heap report,
+  // 'j' prints the background job and prefetch counters
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c == 't')
+      Trace::dumpToSerial();
+    else if (c == 'T')
+      Trace::dumpToFile("/trace.json");
+    else if (c == 'h')
+      HeapTelemetry::printReport();
+    else if (c == 'j') {
+      uiManager.getScheduler().printReport();
+      uiManager.getPrefetchPolicy().printReport();
+    }
+  }
+#endif
+
+  // Speculative work depends on the power source; the battery changes slowly
+  static unsigned long lastPowerSample = 0;
+  if (lastPowerSample == 0 || millis() - lastPowerSample >= POWER_SAMPLE_MS) {
+    uiManager.getPrefetchPolicy().setPowerState(g_battery.readPercentage(), isUsbConnected());
+    lastPowerSample = millis();
+  }
+
   // Button state is updated by background task
   uiManager.handleButtons(buttons);
 
@@ -193,6 +237,7 @@ void loop() {
     enterDeepSleep();
   }
 
-  // Small delay to avoid busy loop
-  delay(10);
+  // Background jobs use the idle gap; without any, a small delay avoids a busy loop
+  if (!uiManager.getScheduler().run(IDLE_JOB_MICROS))
+    delay(10);
 }
@@ -0,0 +1,74 @@
+#include "GlyphCache.h"
+
+#include <Arduino.h>
+
+#include <new>
+
+GlyphCache::~GlyphCache() {
+  clear();
+}
+
+void GlyphCache::clear() {
+  delete[] slots;
+  delete[] data;
+  delete[] oversize;
+  slots = nullptr;
+  data = nullptr;
+  oversize = nullptr;
+  oversizeCapacity = 0;
+}
+
+bool GlyphCache::allocate() {
+  slots = new (std::nothrow) Slot[SLOT_COUNT];
+  data = new (std::nothrow) uint8_t[(uint32_t)SLOT_COUNT * 3 * MAX_PLANE_BYTES];
+  if (!slots || !data) {
+    Serial.printf("GlyphCache: failed to allocate %u slots\n", SLOT_COUNT);
+    clear();
+    return false;
+  }
+  for (uint16_t i = 0; i < SLOT_COUNT; i++) {
+    slots[i].font = nullptr;
+    slots[i].glyphIndex = 0;
+  }
+  return true;
+}
+
+const uint8_t* GlyphCache::get(const SimpleGFXfont* font, uint16_t glyphIndex) {
+  const SimpleGFXglyph* glyph = &font->glyph[glyphIndex];
+  uint16_t planeSize = glyphPlaneSize(glyph);
+
+  // Glyphs that do not fit a slot are decoded into a separate scratch buffer every time
+  if (planeSize > MAX_PLANE_BYTES) {
+    uint16_t needed = planeSize * 3;
+    if (needed > oversizeCapacity) {
+      delete[] oversize;
+      oversize = new (std::nothrow) uint8_t[needed];
+      oversizeCapacity = oversize ? needed : 0;
+      if (!oversize)
+        return nullptr;
+    }
+    misses++;
+    decodeGlyphRle(font, glyph, oversize);
+    return oversize;
+  }
+
+  if (!slots && !allocate())
+    return nullptr;
+
+  // Mix the font pointer into the index so different fonts do not collide on the same glyphs
+  uint32_t h = glyphIndex ^ ((uint32_t)((uintptr_t)font >> 4) * 31u);
+  uint16_t slotIndex = h % SLOT_COUNT;
+  Slot& slot = slots[slotIndex];
+  uint8_t* planes = data + (uint32_t)slotIndex * 3 * MAX_PLANE_BYTES;
+
+  if (slot.font == font && slot.glyphIndex == glyphIndex) {
+    hits++;
+    return planes;
+  }
+
+  misses++;
+  decodeGlyphRle(font, glyph, planes);
+  slot.font = font;
+  slot.glyphIndex = glyphIndex;
+  return planes;
+}
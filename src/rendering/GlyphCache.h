@@ -0,0 +1,54 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include <cstdint>
+
+#include "SimpleFont.h"
+
+// Small direct-mapped cache of decoded RLE glyphs.
+// A page is rendered up to three times (BW, gray LSB, gray MSB) with the same
+// glyphs, so keeping the decoded planes around avoids decoding every glyph
+// once per pass. Slots are allocated lazily the first time an RLE font is used;
+// PLANAR fonts never touch the cache.
+class GlyphCache {
+ public:
+  static constexpr uint16_t SLOT_COUNT = 64;
+  static constexpr uint16_t MAX_PLANE_BYTES = 128;  // Per-plane capacity of a slot (e.g. 32x32)
+
+  GlyphCache() = default;
+  ~GlyphCache();
+
+  // Returns the decoded planes (BW, gray LSB, gray MSB, each glyphPlaneSize()
+  // bytes). The pointer stays valid until the next call.
+  const uint8_t* get(const SimpleGFXfont* font, uint16_t glyphIndex);
+
+  // Drop all cached glyphs and release the slot memory
+  void clear();
+
+  uint32_t getHits() const {
+    return hits;
+  }
+  uint32_t getMisses() const {
+    return misses;
+  }
+
+ private:
+  struct Slot {
+    const SimpleGFXfont* font;
+    uint16_t glyphIndex;
+  };
+
+  Slot* slots = nullptr;
+  uint8_t* data = nullptr;  // SLOT_COUNT * 3 * MAX_PLANE_BYTES bytes
+
+  // Fallback buffer for glyphs larger than a slot
+  uint8_t* oversize = nullptr;
+  uint16_t oversizeCapacity = 0;
+
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+
+  bool allocate();
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "SimpleFont.h"
 
+#include <cstring>
+
 // Helper to find a glyph index by codepoint using binary search
 // The glyph array must be sorted by codepoint
 int findGlyphIndex(const SimpleGFXfont* font, uint32_t codepoint) {
@@ -46,4 +48,120 @@ const SimpleGFXfont* getFontVariant(const FontFamily* family, FontStyle style) {
     default:
       return family->regular;
   }
-}
\ No newline at end of file
+}
+
+// Plane bits (bw, lsb, msb) for each GlyphSymbol
+static const uint8_t SYMBOL_BW[5] = {1, 1, 0, 0, 0};
+static const uint8_t SYMBOL_LSB[5] = {0, 1, 0, 1, 0};
+static const uint8_t SYMBOL_MSB[5] = {0, 0, 1, 1, 0};
+
+void decodeGlyphRle(const SimpleGFXfont* font, const SimpleGFXglyph* glyph, uint8_t* outPlanes) {
+  decodeGlyphRleStream(font->bitmap + glyph->bitmapOffset, glyph, outPlanes);
+}
+
+void decodeGlyphRleStream(const uint8_t* src, const SimpleGFXglyph* glyph, uint8_t* outPlanes) {
+  const uint8_t w = glyph->width;
+  const uint16_t planeSize = glyphPlaneSize(glyph);
+  const uint8_t rowStride = (w + 7) / 8;
+  uint8_t* bw = outPlanes;
+  uint8_t* lsb = outPlanes + planeSize;
+  uint8_t* msb = outPlanes + 2 * planeSize;
+
+  // Start from the black symbol (all bits clear) so only set bits need writing
+  memset(outPlanes, 0, planeSize * 3);
+
+  const uint32_t total = (uint32_t)w * glyph->height;
+  uint32_t pixel = 0;
+  uint8_t x = 0;
+  uint16_t rowBase = 0;
+
+  // Append one symbol, advancing the row/column position
+  auto put = [&](uint8_t sym) {
+    uint16_t byteIndex = rowBase + (x >> 3);
+    uint8_t bitMask = 0x80 >> (x & 7);
+    if (SYMBOL_BW[sym])
+      bw[byteIndex] |= bitMask;
+    if (SYMBOL_LSB[sym])
+      lsb[byteIndex] |= bitMask;
+    if (SYMBOL_MSB[sym])
+      msb[byteIndex] |= bitMask;
+    if (++x == w) {
+      x = 0;
+      rowBase += rowStride;
+    }
+    pixel++;
+  };
+
+  while (pixel < total) {
+    uint8_t code = *src++;
+    if (code < 0x80) {
+      uint8_t run = (code & 0x3F) + 1;
+      if (code < 0x40) {
+        // White run: set the BW bit for each pixel, gray planes stay clear
+        while (run-- && pixel < total) {
+          bw[rowBase + (x >> 3)] |= 0x80 >> (x & 7);
+          if (++x == w) {
+            x = 0;
+            rowBase += rowStride;
+          }
+          pixel++;
+        }
+      } else {
+        // Black run: all planes stay clear, only advance the position
+        uint32_t end = pixel + run;
+        if (end > total)
+          end = total;
+        while (pixel < end) {
+          if (++x == w) {
+            x = 0;
+            rowBase += rowStride;
+          }
+          pixel++;
+        }
+      }
+    } else {
+      uint8_t v = code - 0x80;
+      put(v / 25);
+      if (pixel < total)
+        put((v / 5) % 5);
+      if (pixel < total)
+        put(v % 5);
+    }
+  }
+}
+
+int8_t KerningCursor::next(const SimpleGFXfont* f, int glyphIndex) {
+  int8_t adjust = 0;
+  if (font == f && glyphIndex >= 0) {
+    for (uint16_t i = rangeStart; i < rangeEnd; i++) {
+      if (f->kernPairs[i].right == glyphIndex) {
+        adjust = f->kernPairs[i].adjust;
+        break;
+      }
+    }
+  }
+
+  if (!f || !f->kernPairs || glyphIndex < 0) {
+    font = nullptr;
+    return adjust;
+  }
+
+  // Locate the pairs whose left glyph is glyphIndex for the following call
+  uint16_t low = 0;
+  uint16_t high = f->kernPairCount;
+  while (low < high) {
+    uint16_t mid = low + (high - low) / 2;
+    if (f->kernPairs[mid].left < glyphIndex) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  rangeStart = low;
+  rangeEnd = low;
+  while (rangeEnd < f->kernPairCount && f->kernPairs[rangeEnd].left == glyphIndex) {
+    rangeEnd++;
+  }
+  font = f;
+  return adjust;
+}
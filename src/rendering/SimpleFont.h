@@ -5,9 +5,15 @@
 // Enum for font styles (expandable for future styles)
 enum class FontStyle { REGULAR = 0, BOLD, ITALIC, BOLD_ITALIC, HIDDEN };
 
+// How glyph bitmaps are stored in a SimpleGFXfont
+enum class GlyphFormat : uint8_t {
+  PLANAR = 0,  // bitmap / bitmap_gray_lsb / bitmap_gray_msb are separate row-padded 1-bit planes
+  RLE = 1      // one run-length packed stream per glyph holding all planes (see decodeGlyphRle)
+};
+
 // Minimal font struct used by our TextRenderer
 typedef struct {
-  uint16_t bitmapOffset;  ///< Pointer into font->bitmap
+  uint32_t bitmapOffset;  ///< Pointer into font->bitmap
   uint32_t codepoint;     ///< Unicode codepoint for this glyph
   uint8_t width;          ///< Bitmap dimensions in pixels
   uint8_t height;
@@ -16,6 +22,25 @@ typedef struct {
   int8_t yOffset;    ///< Y dist from cursor pos to UL corner
 } SimpleGFXglyph;
 
+// Kerning pair: horizontal adjustment applied between two glyphs. Pairs are
+// sorted by (left, right) glyph index so all pairs of a left glyph are contiguous.
+typedef struct {
+  uint16_t left;   ///< Glyph index of the first character
+  uint16_t right;  ///< Glyph index of the following character
+  int8_t adjust;   ///< Pixels added to the advance of `left` (usually negative)
+} SimpleGFXkernPair;
+
+// Supplies glyph bitmaps for fonts that are not memory mapped (e.g. font files
+// loaded from SD). For such fonts the bitmap pointers only signal which planes
+// exist; all pixel data comes from the source.
+class GlyphSource {
+ public:
+  virtual ~GlyphSource() {}
+  // Decoded planes (BW, gray LSB, gray MSB) of a glyph in the decodeGlyphRle()
+  // layout, or nullptr if it could not be loaded. Valid until the next call.
+  virtual const uint8_t* getGlyphPlanes(uint16_t glyphIndex) = 0;
+};
+
 typedef struct {
   const uint8_t* bitmap;           ///< Glyph bitmaps, concatenated
   const uint8_t* bitmap_gray_lsb;  ///< Glyph bitmaps, concatenated
@@ -23,6 +48,10 @@ typedef struct {
   const SimpleGFXglyph* glyph;     ///< Glyph array (sorted by codepoint for binary search)
   uint16_t glyphCount;             ///< Number of entries in `glyph`.
   uint8_t yAdvance;                ///< Newline distance (y axis)
+  const SimpleGFXkernPair* kernPairs = nullptr;  ///< Kerning pairs (nullptr when the font has none)
+  uint16_t kernPairCount = 0;                    ///< Number of entries in `kernPairs`
+  GlyphFormat format = GlyphFormat::PLANAR;      ///< Bitmap storage format
+  GlyphSource* source = nullptr;                 ///< Glyph loader for fonts read at runtime (built-in: nullptr)
   // Optional metadata for better font management
   const char* name;  ///< Font name (e.g., "NotoSans")
   uint8_t size;      ///< Font size in points (for reference)
@@ -44,3 +73,48 @@ int findGlyphIndex(const SimpleGFXfont* font, uint32_t codepoint);
 
 // Helper to get a font variant from a family (returns nullptr if not available)
 const SimpleGFXfont* getFontVariant(const FontFamily* family, FontStyle style);
+
+// RLE glyph stream (GlyphFormat::RLE). Pixels are visited row-major without row
+// padding; every pixel is one of five symbols combining the BW and gray planes.
+// For RLE fonts bitmap_gray_lsb/msb point at the same stream as `bitmap` (or are
+// nullptr when the font has no grayscale data). Byte codes:
+//   0x00-0x3F  run of (code & 0x3F) + 1 white pixels
+//   0x40-0x7F  run of (code & 0x3F) + 1 black pixels
+//   0x80-0xFC  three literal symbols, code - 0x80 = s0 * 25 + s1 * 5 + s2
+enum GlyphSymbol : uint8_t {
+  GLYPH_SYM_WHITE = 0,  // bw=1 lsb=0 msb=0
+  GLYPH_SYM_LIGHT = 1,  // bw=1 lsb=1 msb=0
+  GLYPH_SYM_GRAY = 2,   // bw=0 lsb=0 msb=1
+  GLYPH_SYM_DARK = 3,   // bw=0 lsb=1 msb=1
+  GLYPH_SYM_BLACK = 4   // bw=0 lsb=0 msb=0
+};
+
+// Size in bytes of one row-padded 1-bit plane of a glyph
+inline uint16_t glyphPlaneSize(const SimpleGFXglyph* glyph) {
+  return ((glyph->width + 7) / 8) * glyph->height;
+}
+
+// Decode an RLE glyph into three row-padded planes laid out back to back
+// (BW, gray LSB, gray MSB), each glyphPlaneSize() bytes, matching PLANAR layout.
+void decodeGlyphRle(const SimpleGFXfont* font, const SimpleGFXglyph* glyph, uint8_t* outPlanes);
+// Same as decodeGlyphRle() for a stream that is not part of a font's bitmap array
+void decodeGlyphRleStream(const uint8_t* src, const SimpleGFXglyph* glyph, uint8_t* outPlanes);
+
+// Looks up the kerning between consecutive glyphs of a run of text. The pair
+// range of the previous glyph is found once by binary search, so each step only
+// scans the (short) list of partners of that glyph.
+class KerningCursor {
+ public:
+  // Forget the previous glyph (start of a new run of text)
+  void reset() {
+    font = nullptr;
+  }
+
+  // Adjustment to apply before drawing glyphIndex (-1 for a missing glyph)
+  int8_t next(const SimpleGFXfont* f, int glyphIndex);
+
+ private:
+  const SimpleGFXfont* font = nullptr;
+  uint16_t rangeStart = 0;
+  uint16_t rangeEnd = 0;
+};
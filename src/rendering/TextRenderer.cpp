@@ -5,6 +5,10 @@
 #include "../core/EInkDisplay.h"
 #include "SimpleFont.h"
 
+#ifdef TEST_BUILD
+#include "CostModel.h"
+#endif
+
 static constexpr int GLYPH_PADDING = 0;
 static constexpr uint32_t UTF8_REPLACEMENT_CHAR = 0xFFFD;
 static constexpr uint16_t FALLBACK_GLYPH_WIDTH = 6;
@@ -94,6 +98,32 @@ void TextRenderer::drawPixel(int16_t x, int16_t y, bool state) {
   }
 }
 
+void TextRenderer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, bool state) {
+  if (!frameBuffer) {
+    return;
+  }
+  int16_t left = x < 0 ? 0 : x;
+  int16_t right = x + w > EInkDisplay::DISPLAY_HEIGHT ? EInkDisplay::DISPLAY_HEIGHT : x + w;
+  int16_t top = y < 0 ? 0 : y;
+  int16_t bottom = y + h > EInkDisplay::DISPLAY_WIDTH ? EInkDisplay::DISPLAY_WIDTH : y + h;
+
+  // A portrait column is a run of bits in one landscape row, filled a byte at a time
+  for (int16_t px = left; px < right; px++) {
+    uint8_t* row = frameBuffer + (EInkDisplay::DISPLAY_HEIGHT - 1 - px) * EInkDisplay::DISPLAY_WIDTH_BYTES;
+    for (int16_t py = top; py < bottom;) {
+      int first = py % 8;
+      int count = 8 - first < bottom - py ? 8 - first : bottom - py;
+      uint8_t mask = (uint8_t)((0xFF >> first) & (0xFF << (8 - first - count)));
+      if (state) {
+        row[py / 8] &= ~mask;
+      } else {
+        row[py / 8] |= mask;
+      }
+      py += count;
+    }
+  }
+}
+
 void TextRenderer::setFrameBuffer(uint8_t* buffer) {
   frameBuffer = buffer;
 }
@@ -129,6 +159,7 @@ void TextRenderer::setTextColor(uint16_t c) {
 void TextRenderer::setCursor(int16_t x, int16_t y) {
   cursorX = x;
   cursorY = y;
+  kerning.reset();
 }
 
 size_t TextRenderer::print(const char* s) {
@@ -139,6 +170,8 @@ size_t TextRenderer::print(const char* s) {
   size_t written = 0;
   const unsigned char* p = reinterpret_cast<const unsigned char*>(s);
 
+  // Kerning applies within one print() call, matching getTextBounds()
+  kerning.reset();
   while (*p) {
     uint32_t codepoint = decodeUtf8Codepoint(p);
     drawChar(codepoint);
@@ -175,10 +208,12 @@ void TextRenderer::getTextBounds(const char* str, int16_t x, int16_t y, int16_t*
     const SimpleGFXfont* f = currentFont;
     uint16_t totalWidth = 0;
     const unsigned char* p = reinterpret_cast<const unsigned char*>(str);
+    KerningCursor kern;
 
     while (*p) {
       uint32_t codepoint = decodeUtf8Codepoint(p);
       int glyphIndex = findGlyphIndex(f, codepoint);
+      totalWidth += kern.next(f, glyphIndex);
 
       if (glyphIndex >= 0) {
         const SimpleGFXglyph* glyph = &f->glyph[glyphIndex];
@@ -208,10 +243,11 @@ void TextRenderer::drawChar(uint32_t codepoint) {
   }
 
   const SimpleGFXfont* f = currentFont;
+  int glyphIndex = findGlyphIndex(f, codepoint);
+  cursorX += kerning.next(f, glyphIndex);
 
   // For hidden text, advance cursor without drawing
   if (currentStyle == FontStyle::HIDDEN) {
-    int glyphIndex = findGlyphIndex(f, codepoint);
     if (glyphIndex >= 0) {
       const SimpleGFXglyph* glyph = &f->glyph[glyphIndex];
       cursorX += glyph->xAdvance;
@@ -221,8 +257,6 @@ void TextRenderer::drawChar(uint32_t codepoint) {
     return;
   }
 
-  int glyphIndex = findGlyphIndex(f, codepoint);
-
   if (glyphIndex < 0) {
     // Unsupported codepoint; advance by fallback amount
     cursorX += FALLBACK_GLYPH_WIDTH;
@@ -251,7 +285,25 @@ void TextRenderer::drawChar(uint32_t codepoint) {
     return;
   }
 
-  uint16_t bitmapOffset = glyph->bitmapOffset;
+  uint32_t bitmapOffset = glyph->bitmapOffset;
+  const uint8_t* bitmap_lsb = f->bitmap_gray_lsb;
+  const uint8_t* bitmap_msb = f->bitmap_gray_msb;
+
+  // Compressed and runtime-loaded fonts are decoded (or fetched from a cache)
+  // into three planes with the same layout as an uncompressed glyph
+  if (f->source || f->format == GlyphFormat::RLE) {
+    const uint8_t* planes = f->source ? f->source->getGlyphPlanes(glyphIndex) : glyphCache.get(f, glyphIndex);
+    if (!planes) {
+      cursorX += glyph->xAdvance + GLYPH_PADDING;
+      return;
+    }
+    uint16_t planeSize = glyphPlaneSize(glyph);
+    bitmap_lsb = planes + planeSize;
+    bitmap_msb = planes + 2 * planeSize;
+    bitmap = bitmapType == BITMAP_BW ? planes : (bitmapType == BITMAP_GRAY_LSB ? bitmap_lsb : bitmap_msb);
+    bitmapOffset = 0;
+  }
+
   uint8_t w = glyph->width;
   uint8_t h = glyph->height;
   int8_t xOffset = glyph->xOffset;
@@ -260,9 +312,10 @@ void TextRenderer::drawChar(uint32_t codepoint) {
   // Calculate row stride in bytes (width rounded up to byte boundary)
   uint8_t rowStride = (w + 7) / 8;
 
-  // Cache the grayscale bitmap pointers outside the loop for better performance
-  const uint8_t* bitmap_lsb = f->bitmap_gray_lsb;
-  const uint8_t* bitmap_msb = f->bitmap_gray_msb;
+#ifdef TEST_BUILD
+  CostModel::onGlyphPixels((uint32_t)w * h);
+#endif
+
   bool isGrayscale = (bitmapType != BITMAP_BW);
 
   // Determine pixel state based on text color
@@ -277,7 +330,7 @@ void TextRenderer::drawChar(uint32_t codepoint) {
       int16_t py = cursorY + yOffset + yy;
 
       // Calculate bitmap byte and bit positions for current pixel
-      uint16_t byteIndex = bitmapOffset + (yy * rowStride) + (xx / 8);
+      uint32_t byteIndex = bitmapOffset + (yy * rowStride) + (xx / 8);
       uint8_t bitMask = 1 << (7 - (xx % 8));
 
       if (isGrayscale) {
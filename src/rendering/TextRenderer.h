@@ -10,6 +10,7 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "GlyphCache.h"
 #include "SimpleFont.h"
 
 class EInkDisplay;  // Forward declaration
@@ -29,16 +30,25 @@ class TextRenderer {
   // Low-level pixel draw used by font blitting
   void drawPixel(int16_t x, int16_t y, bool state);
 
+  // Fill a portrait rectangle (clipped to the page); state true is black
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, bool state);
+
   // Set which framebuffer to write to
   void setFrameBuffer(uint8_t* buffer);
 
   // Select which bitmap data to use from the font
   void setBitmapType(BitmapType type);
+  BitmapType getBitmapType() const {
+    return bitmapType;
+  }
 
   // Minimal API used by the rest of the project
   void setFont(const SimpleGFXfont* f = nullptr);
   void setFontFamily(FontFamily* family);
   void setFontStyle(FontStyle style);
+  const FontFamily* getFontFamily() const {
+    return currentFamily;
+  }
   void setTextColor(uint16_t c);
   void setCursor(int16_t x, int16_t y);
   size_t print(const char* s);
@@ -61,6 +71,8 @@ class TextRenderer {
   int16_t cursorX = 0;
   int16_t cursorY = 0;
   uint16_t textColor = COLOR_BLACK;
+  GlyphCache glyphCache;  // Decoded glyphs of RLE-compressed fonts
+  KerningCursor kerning;  // Previous glyph of the current print() call
 
   // Draw a single Unicode codepoint. Accepts a full Unicode codepoint
   // (decoded from UTF-8) so the renderer can support multi-byte UTF-8 input.
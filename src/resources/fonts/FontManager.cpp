@@ -1,6 +1,12 @@
 #include "FontManager.h"
 
+#include <SD.h>
+
+#include <vector>
+
 #include "FontDefinitions.h"
+#include "SdFont.h"
+#include "core/HeapTelemetry.h"
 #include "core/Settings.h"
 #include "other/MenuFontBig.h"
 #include "other/MenuFontSmall.h"
@@ -18,6 +24,107 @@ void setCurrentFontFamily(FontFamily* family) {
     currentFamily = family;
 }
 
+// SD fonts: one entry per container file, families are sorted by name and sizes ascending
+struct SdFontEntry {
+  String family;
+  uint8_t size;
+  String path;
+};
+static std::vector<SdFontEntry> sdFontEntries;
+static std::vector<String> sdFontFamilies;
+static SdFontFamily loadedSdFont;
+
+int scanSdFonts() {
+  sdFontEntries.clear();
+  sdFontFamilies.clear();
+
+  File dir = SD.open(SD_FONT_DIR);
+  if (!dir || !dir.isDirectory()) {
+    return 0;
+  }
+
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    String name = f.name();
+    bool isFont = !f.isDirectory() && name.endsWith(".mrf");
+    f.close();
+    if (!isFont)
+      continue;
+
+    // Some cores return the full path from name(), others only the file name
+    int slash = name.lastIndexOf('/');
+    String path = String(SD_FONT_DIR) + "/" + (slash >= 0 ? name.substring(slash + 1) : name);
+
+    SdFontEntry entry;
+    if (!SdFontFamily::readInfo(path.c_str(), entry.family, entry.size)) {
+      Serial.printf("FontManager: ignoring invalid font file %s\n", path.c_str());
+      continue;
+    }
+    entry.path = path;
+
+    // Insert sorted by family name, then size
+    auto it = sdFontEntries.begin();
+    while (it != sdFontEntries.end() &&
+           (it->family < entry.family || (it->family == entry.family && it->size <= entry.size)))
+      ++it;
+    sdFontEntries.insert(it, entry);
+  }
+  dir.close();
+
+  for (const SdFontEntry& e : sdFontEntries) {
+    if (sdFontFamilies.empty() || sdFontFamilies.back() != e.family)
+      sdFontFamilies.push_back(e.family);
+  }
+  return (int)sdFontFamilies.size();
+}
+
+int getSdFontFamilyCount() {
+  return (int)sdFontFamilies.size();
+}
+
+String getSdFontFamilyName(int index) {
+  if (index < 0 || index >= (int)sdFontFamilies.size())
+    return String("");
+  return sdFontFamilies[index];
+}
+
+int findSdFontFamily(const String& name) {
+  for (size_t i = 0; i < sdFontFamilies.size(); i++) {
+    if (sdFontFamilies[i] == name)
+      return (int)i;
+  }
+  return -1;
+}
+
+FontFamily* loadSdFontFamily(int index, int sizeIndex) {
+  if (index < 0 || index >= (int)sdFontFamilies.size())
+    return nullptr;
+
+  // Entries are sorted by size, so pick the sizeIndex-th file of this family
+  const SdFontEntry* chosen = nullptr;
+  int n = 0;
+  for (const SdFontEntry& e : sdFontEntries) {
+    if (e.family != sdFontFamilies[index])
+      continue;
+    chosen = &e;
+    if (n++ == sizeIndex)
+      break;
+  }
+  if (!chosen)
+    return nullptr;
+
+  if (loadedSdFont.isLoaded() && loadedSdFont.getPath() == chosen->path)
+    return loadedSdFont.getFamily();
+
+  // The current family may point into the font being replaced
+  if (currentFamily == loadedSdFont.getFamily())
+    currentFamily = &bookerly26Family;
+  HEAP_SUBSYSTEM(FONT);
+  if (!loadedSdFont.load(chosen->path.c_str()))
+    return nullptr;
+  HEAP_CHECKPOINT("font load");
+  return loadedSdFont.getFamily();
+}
+
 // Simple fonts
 static const SimpleGFXfont* titleFont = &MenuHeader;
 
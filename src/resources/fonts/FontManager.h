@@ -1,5 +1,7 @@
 #pragma once
 
+#include <Arduino.h>
+
 #include "rendering/SimpleFont.h"
 
 // Font family
@@ -11,4 +13,17 @@ class Settings;
 const SimpleGFXfont* getUIFont(Settings& settings);
 
 const SimpleGFXfont* getTitleFont();
-void setTitleFont(const SimpleGFXfont* font);
\ No newline at end of file
+void setTitleFont(const SimpleGFXfont* font);
+
+// Fonts on SD (font container files in SD_FONT_DIR, see SdFont.h)
+#define SD_FONT_DIR "/microreader/fonts"
+
+// Scan SD_FONT_DIR and group the files by family name. Returns the number of families.
+int scanSdFonts();
+int getSdFontFamilyCount();
+String getSdFontFamilyName(int index);
+// Index of the SD family with the given name, or -1
+int findSdFontFamily(const String& name);
+// Load an SD family at the sizeIndex-th smallest size it is available in (clamped).
+// Replaces the previously loaded SD family. Returns nullptr on failure.
+FontFamily* loadSdFontFamily(int index, int sizeIndex);
@@ -0,0 +1,368 @@
+#include "SdFont.h"
+
+#include <cstring>
+#include <new>
+
+static constexpr uint32_t HEADER_SIZE = 48;
+static constexpr uint32_t VARIANT_ENTRY_SIZE = 24;
+static constexpr uint32_t GLYPH_RECORD_SIZE = 16;
+static constexpr uint32_t KERN_RECORD_SIZE = 6;
+static constexpr uint8_t MAX_VARIANTS = 4;
+
+static uint16_t readU16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readU32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// True when an RLE stream of length bytes holds only valid codes and covers all pixels of the glyph, so
+// decoding it stays inside the stream
+static bool rleStreamComplete(const uint8_t* src, uint32_t length, uint32_t pixels) {
+  uint32_t covered = 0;
+  for (uint32_t i = 0; i < length && covered < pixels; i++) {
+    if (src[i] > 0xFC)
+      return false;
+    covered += src[i] < 0x80 ? (src[i] & 0x3F) + 1 : 3;
+  }
+  return covered >= pixels;
+}
+
+// Validate the fixed header and extract the family name
+static bool parseHeader(const uint8_t* header, String& familyName, uint8_t& size, uint8_t& variantCount) {
+  if (memcmp(header, "MRFN", 4) != 0) {
+    return false;
+  }
+  uint16_t version = readU16(header + 4);
+  if (version != SdFontFamily::VERSION) {
+    Serial.printf("SdFont: unsupported version %u\n", version);
+    return false;
+  }
+  size = header[6];
+  variantCount = header[7];
+  char name[SdFontFamily::FAMILY_NAME_LENGTH + 1];
+  memcpy(name, header + 8, SdFontFamily::FAMILY_NAME_LENGTH);
+  name[SdFontFamily::FAMILY_NAME_LENGTH] = '\0';
+  familyName = String(name);
+  return variantCount > 0 && variantCount <= MAX_VARIANTS;
+}
+
+bool SdFontFamily::readInfo(const char* path, String& familyName, uint8_t& size) {
+  File f = SD.open(path);
+  if (!f) {
+    return false;
+  }
+  uint8_t header[HEADER_SIZE];
+  uint8_t variantCount = 0;
+  bool ok = f.read(header, HEADER_SIZE) == HEADER_SIZE && parseHeader(header, familyName, size, variantCount);
+  f.close();
+  return ok;
+}
+
+SdFontFamily::~SdFontFamily() {
+  unload();
+}
+
+bool SdFontFamily::load(const char* filePath) {
+  unload();
+
+  file = SD.open(filePath);
+  if (!file) {
+    Serial.printf("SdFont: failed to open %s\n", filePath);
+    return false;
+  }
+
+  uint8_t header[HEADER_SIZE];
+  uint8_t size = 0;
+  uint8_t variantCount = 0;
+  if (file.read(header, HEADER_SIZE) != HEADER_SIZE || !parseHeader(header, familyName, size, variantCount)) {
+    Serial.printf("SdFont: invalid font file %s\n", filePath);
+    unload();
+    return false;
+  }
+
+  uint8_t entries[MAX_VARIANTS * VARIANT_ENTRY_SIZE];
+  if (file.read(entries, variantCount * VARIANT_ENTRY_SIZE) != variantCount * VARIANT_ENTRY_SIZE) {
+    unload();
+    return false;
+  }
+
+  for (uint8_t i = 0; i < variantCount; i++) {
+    const uint8_t* entry = entries + i * VARIANT_ENTRY_SIZE;
+    uint8_t style = entry[0];
+    if (style >= MAX_VARIANTS || variants[style].font.glyph) {
+      Serial.printf("SdFont: skipping variant with style %u\n", style);
+      continue;
+    }
+    if (!variants[style].load(&file, &cache, entry, familyName.c_str(), size)) {
+      Serial.printf("SdFont: failed to load style %u of %s\n", style, filePath);
+      unload();
+      return false;
+    }
+    if (variants[style].getSlotSize() > cache.slotSize)
+      cache.slotSize = variants[style].getSlotSize();
+  }
+
+  auto variantFont = [this](FontStyle style) -> const SimpleGFXfont* {
+    Variant& v = variants[(int)style];
+    return v.font.glyph ? &v.font : nullptr;
+  };
+  family.familyName = familyName.c_str();
+  family.regular = variantFont(FontStyle::REGULAR);
+  family.bold = variantFont(FontStyle::BOLD);
+  family.italic = variantFont(FontStyle::ITALIC);
+  family.boldItalic = variantFont(FontStyle::BOLD_ITALIC);
+
+  if (!family.regular) {
+    Serial.printf("SdFont: %s has no regular style\n", filePath);
+    unload();
+    return false;
+  }
+
+  path = filePath;
+  Serial.printf("SdFont: loaded %s %u from %s\n", familyName.c_str(), size, filePath);
+  return true;
+}
+
+void SdFontFamily::unload() {
+  for (int i = 0; i < MAX_VARIANTS; i++) {
+    variants[i].unload();
+  }
+  cache.release();
+  family = {};
+  path = "";
+  if (file) {
+    file.close();
+  }
+}
+
+SdFontFamily::Variant::~Variant() {
+  unload();
+}
+
+bool SdFontFamily::GlyphCache::allocate() {
+  data = new (std::nothrow) uint8_t[(uint32_t)SLOTS * slotSize];
+  readBuffer = new (std::nothrow) uint8_t[slotSize ? slotSize : 1];
+  if (!data || !readBuffer) {
+    Serial.printf("SdFont: failed to allocate glyph cache (%u bytes)\n", (unsigned)(SLOTS * slotSize));
+    release();
+    return false;
+  }
+  memset(lastUse, 0, sizeof(lastUse));
+  useTick = 0;
+  return true;
+}
+
+void SdFontFamily::GlyphCache::release() {
+  delete[] data;
+  delete[] readBuffer;
+  data = nullptr;
+  readBuffer = nullptr;
+  slotSize = 0;
+  memset(lastUse, 0, sizeof(lastUse));
+  useTick = 0;
+}
+
+bool SdFontFamily::Variant::load(File* fontFile, GlyphCache* glyphCache, const uint8_t* entry,
+                                 const char* familyName, uint8_t size) {
+  file = fontFile;
+  cache = glyphCache;
+  flags = entry[1];
+  uint16_t glyphCount = readU16(entry + 4);
+  uint16_t kernPairCount = readU16(entry + 6);
+  uint32_t glyphTableOffset = readU32(entry + 8);
+  bitmapOffset = readU32(entry + 12);
+  bitmapSize = readU32(entry + 16);
+  uint32_t kernTableOffset = readU32(entry + 20);
+
+  if (glyphCount == 0) {
+    return false;
+  }
+
+  glyphs = new (std::nothrow) SimpleGFXglyph[glyphCount];
+  if (!glyphs) {
+    return false;
+  }
+
+  // Read the glyph table in chunks to keep the stack buffer small
+  uint8_t records[32 * GLYPH_RECORD_SIZE];
+  if (!file->seek(glyphTableOffset)) {
+    return false;
+  }
+  for (uint16_t i = 0; i < glyphCount;) {
+    uint16_t n = glyphCount - i < 32 ? glyphCount - i : 32;
+    if (file->read(records, n * GLYPH_RECORD_SIZE) != n * GLYPH_RECORD_SIZE) {
+      return false;
+    }
+    for (uint16_t k = 0; k < n; k++, i++) {
+      const uint8_t* r = records + k * GLYPH_RECORD_SIZE;
+      SimpleGFXglyph& g = glyphs[i];
+      g.bitmapOffset = readU32(r);
+      g.codepoint = readU32(r + 4);
+      g.width = r[8];
+      g.height = r[9];
+      g.xAdvance = r[10];
+      g.xOffset = (int8_t)r[11];
+      g.yOffset = (int8_t)r[12];
+    }
+  }
+
+  if (kernPairCount > 0 && !loadKerning(kernTableOffset, kernPairCount)) {
+    return false;
+  }
+
+  font.glyph = glyphs;
+  font.glyphCount = glyphCount;
+  if (bitmapSize > file->size() || bitmapOffset > file->size() - bitmapSize || !validateGlyphs()) {
+    Serial.printf("SdFont: glyph data of style %u does not match the file\n", entry[0]);
+    return false;
+  }
+
+  glyphSlot = new (std::nothrow) uint8_t[glyphCount];
+  if (!glyphSlot) {
+    return false;
+  }
+  memset(glyphSlot, NO_SLOT, glyphCount);
+
+  // Size the cache slots for the largest glyph
+  uint16_t maxPlane = 0;
+  for (uint16_t i = 0; i < glyphCount; i++) {
+    uint16_t plane = glyphPlaneSize(&glyphs[i]);
+    if (plane > maxPlane)
+      maxPlane = plane;
+  }
+  slotSize = maxPlane * 3;
+
+  // The bitmap pointers only tell the renderer which planes exist; pixels come from getGlyphPlanes()
+  static const uint8_t planePresent = 0;
+  bool grayscale = flags & FLAG_GRAYSCALE;
+  font.bitmap = &planePresent;
+  font.bitmap_gray_lsb = grayscale ? &planePresent : nullptr;
+  font.bitmap_gray_msb = grayscale ? &planePresent : nullptr;
+  font.yAdvance = entry[2];
+  font.kernPairs = kernPairs;
+  font.kernPairCount = kernPairs ? kernPairCount : 0;
+  font.format = (flags & FLAG_RLE) ? GlyphFormat::RLE : GlyphFormat::PLANAR;
+  font.source = this;
+  font.name = familyName;
+  font.size = size;
+  font.style = (FontStyle)entry[0];
+  return true;
+}
+
+bool SdFontFamily::Variant::loadKerning(uint32_t offset, uint16_t count) {
+  kernPairs = new (std::nothrow) SimpleGFXkernPair[count];
+  if (!kernPairs || !file->seek(offset)) {
+    return false;
+  }
+  uint8_t records[32 * KERN_RECORD_SIZE];
+  for (uint16_t i = 0; i < count;) {
+    uint16_t n = count - i < 32 ? count - i : 32;
+    if (file->read(records, n * KERN_RECORD_SIZE) != n * KERN_RECORD_SIZE) {
+      return false;
+    }
+    for (uint16_t k = 0; k < n; k++, i++) {
+      const uint8_t* r = records + k * KERN_RECORD_SIZE;
+      kernPairs[i].left = readU16(r);
+      kernPairs[i].right = readU16(r + 2);
+      kernPairs[i].adjust = (int8_t)r[4];
+    }
+  }
+  return true;
+}
+
+void SdFontFamily::Variant::unload() {
+  delete[] glyphs;
+  delete[] kernPairs;
+  delete[] glyphSlot;
+  glyphs = nullptr;
+  kernPairs = nullptr;
+  glyphSlot = nullptr;
+  slotSize = 0;
+  file = nullptr;
+  cache = nullptr;
+  font = {};
+}
+
+uint32_t SdFontFamily::Variant::storedLength(uint16_t glyphIndex) const {
+  if (!(flags & FLAG_RLE)) {
+    return (uint32_t)glyphPlaneSize(&glyphs[glyphIndex]) * ((flags & FLAG_GRAYSCALE) ? 3 : 1);
+  }
+  // RLE streams are written in glyph table order, so a glyph ends where the next one starts
+  uint32_t end = (glyphIndex + 1 < font.glyphCount) ? glyphs[glyphIndex + 1].bitmapOffset : bitmapSize;
+  return end - glyphs[glyphIndex].bitmapOffset;
+}
+
+// Glyph data must lie inside the bitmap section in glyph table order, and no glyph may be stored in more bytes
+// than its decoded planes take (a valid RLE stream needs at most one byte per three pixels), so every glyph fits
+// the read buffer of a cache slot
+bool SdFontFamily::Variant::validateGlyphs() const {
+  for (uint16_t i = 0; i < font.glyphCount; i++) {
+    uint32_t start = glyphs[i].bitmapOffset;
+    uint32_t next = (i + 1 < font.glyphCount) ? glyphs[i + 1].bitmapOffset : bitmapSize;
+    if (start > next) {
+      return false;
+    }
+    uint32_t stored = storedLength(i);
+    if (stored > next - start || stored > (uint32_t)glyphPlaneSize(&glyphs[i]) * 3) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const uint8_t* SdFontFamily::Variant::getGlyphPlanes(uint16_t glyphIndex) {
+  if (!glyphs || glyphIndex >= font.glyphCount) {
+    return nullptr;
+  }
+  if (!cache->data && !cache->allocate()) {
+    return nullptr;
+  }
+
+  cache->useTick++;
+  uint8_t slot = glyphSlot[glyphIndex];
+  if (slot != NO_SLOT) {
+    cache->lastUse[slot] = cache->useTick;
+    return cache->data + (uint32_t)slot * cache->slotSize;
+  }
+
+  // Evict the least recently used slot (empty slots have tick 0), whichever style it belongs to
+  slot = 0;
+  for (uint8_t i = 1; i < GlyphCache::SLOTS; i++) {
+    if (cache->lastUse[i] < cache->lastUse[slot])
+      slot = i;
+  }
+  if (cache->lastUse[slot] != 0) {
+    cache->owner[slot]->glyphSlot[cache->glyph[slot]] = NO_SLOT;
+    cache->lastUse[slot] = 0;
+  }
+
+  const SimpleGFXglyph* glyph = &glyphs[glyphIndex];
+  uint32_t length = storedLength(glyphIndex);
+  if (!file->seek(bitmapOffset + glyph->bitmapOffset) || file->read(cache->readBuffer, length) != length) {
+    Serial.printf("SdFont: failed to read glyph 0x%X\n", (unsigned)glyph->codepoint);
+    return nullptr;
+  }
+
+  uint8_t* planes = cache->data + (uint32_t)slot * cache->slotSize;
+  uint16_t planeSize = glyphPlaneSize(glyph);
+  if (flags & FLAG_RLE) {
+    if (!rleStreamComplete(cache->readBuffer, length, (uint32_t)glyph->width * glyph->height)) {
+      Serial.printf("SdFont: damaged glyph 0x%X\n", (unsigned)glyph->codepoint);
+      return nullptr;
+    }
+    decodeGlyphRleStream(cache->readBuffer, glyph, planes);
+  } else {
+    memcpy(planes, cache->readBuffer, length);
+    if (!(flags & FLAG_GRAYSCALE)) {
+      memset(planes + planeSize, 0, planeSize * 2);
+    }
+  }
+
+  cache->owner[slot] = this;
+  cache->glyph[slot] = glyphIndex;
+  cache->lastUse[slot] = cache->useTick;
+  glyphSlot[glyphIndex] = slot;
+  return planes;
+}
@@ -0,0 +1,117 @@
+#ifndef SD_FONT_H
+#define SD_FONT_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "rendering/SimpleFont.h"
+
+// Font family loaded at runtime from a font container file on SD (*.mrf),
+// written by scripts/generate_simplefont (cli.py --bin-out).
+//
+// Only the glyph tables are kept in RAM. Glyph bitmaps are read from the open
+// file on demand and kept decoded in an LRU cache shared by the styles, so
+// unused sizes and families cost neither flash nor RAM. The tables are checked
+// against the file when loading, so a damaged file fails to load instead of
+// making glyph reads run past their buffers.
+//
+// Container layout (little endian):
+//   header   48 bytes  "MRFN", u16 version, u8 size, u8 variantCount, char family[32], 8 reserved
+//   variants 24 bytes  u8 style, u8 flags, u8 yAdvance, u8 reserved, u16 glyphCount, u16 kernPairCount,
+//                      u32 glyphTableOffset, u32 bitmapOffset, u32 bitmapSize, u32 kernTableOffset
+//   glyphs   16 bytes  u32 dataOffset, u32 codepoint, u8 width, u8 height, u8 xAdvance,
+//                      i8 xOffset, i8 yOffset, 3 reserved (sorted by codepoint)
+//   kerning   6 bytes  u16 leftGlyph, u16 rightGlyph, i8 adjust, 1 reserved (sorted by glyph pair)
+// Glyph data is stored in glyph table order, either planar (BW plane followed
+// by the LSB and MSB planes when grayscale) or as an RLE stream (SimpleFont.h).
+class SdFontFamily {
+ public:
+  static constexpr uint16_t VERSION = 1;
+  static constexpr uint8_t FLAG_GRAYSCALE = 0x01;
+  static constexpr uint8_t FLAG_RLE = 0x02;
+  static constexpr int FAMILY_NAME_LENGTH = 32;
+
+  SdFontFamily() = default;
+  ~SdFontFamily();
+
+  // Read only the container header (family name and size). Used when enumerating fonts.
+  static bool readInfo(const char* path, String& familyName, uint8_t& size);
+
+  // Load the glyph tables of all variants and keep the file open for glyph reads
+  bool load(const char* path);
+  void unload();
+
+  bool isLoaded() const {
+    return family.regular != nullptr;
+  }
+  FontFamily* getFamily() {
+    return isLoaded() ? &family : nullptr;
+  }
+  const String& getPath() const {
+    return path;
+  }
+
+ private:
+  class Variant;
+
+  // Decoded glyphs of all styles share one LRU cache. A page is set mostly in
+  // one style, so a cache per style would mostly hold glyphs that are not on
+  // screen: 64 slots of a 30 pt family take about 23 KB, four of them ~90 KB.
+  // Slots are sized for the largest glyph and allocated on the first request.
+  struct GlyphCache {
+    static constexpr uint8_t SLOTS = 64;
+
+    uint16_t slotSize = 0;          // 3 * largest plane size of any style
+    uint8_t* data = nullptr;        // SLOTS * slotSize
+    uint8_t* readBuffer = nullptr;  // Raw glyph data as stored in the file, slotSize bytes
+    Variant* owner[SLOTS] = {};     // Style whose glyph each slot holds
+    uint16_t glyph[SLOTS] = {};     // Glyph index held by each slot
+    uint32_t lastUse[SLOTS] = {};   // Use tick of each slot, 0 = empty
+    uint32_t useTick = 0;
+
+    bool allocate();
+    void release();
+  };
+
+  // One style variant; provides decoded glyphs to the TextRenderer
+  class Variant : public GlyphSource {
+   public:
+    ~Variant();
+    bool load(File* file, GlyphCache* cache, const uint8_t* entry, const char* familyName, uint8_t size);
+    void unload();
+    const uint8_t* getGlyphPlanes(uint16_t glyphIndex) override;
+
+    // Cache slot size needed by the largest glyph of this style
+    uint16_t getSlotSize() const {
+      return slotSize;
+    }
+
+    SimpleGFXfont font = {};
+
+   private:
+    File* file = nullptr;
+    GlyphCache* cache = nullptr;
+    uint8_t flags = 0;
+    uint32_t bitmapOffset = 0;
+    uint32_t bitmapSize = 0;
+    SimpleGFXglyph* glyphs = nullptr;
+    SimpleGFXkernPair* kernPairs = nullptr;
+    uint8_t* glyphSlot = nullptr;  // Cache slot per glyph, NO_SLOT if not cached
+    uint16_t slotSize = 0;
+
+    static constexpr uint8_t NO_SLOT = 0xFF;
+
+    uint32_t storedLength(uint16_t glyphIndex) const;
+    bool validateGlyphs() const;
+    bool loadKerning(uint32_t offset, uint16_t count);
+  };
+
+  File file;
+  String path;
+  String familyName;
+  Variant variants[4];  // Indexed by FontStyle (REGULAR..BOLD_ITALIC)
+  GlyphCache cache;
+  FontFamily family = {};
+};
+
+#endif
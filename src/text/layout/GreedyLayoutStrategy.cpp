@@ -1,6 +1,8 @@
 #include "GreedyLayoutStrategy.h"
 
 #include "../../content/providers/WordProvider.h"
+#include "../../core/HeapTelemetry.h"
+#include "../../core/Trace.h"
 #include "../../rendering/TextRenderer.h"
 #include "WString.h"
 
@@ -18,6 +20,8 @@ GreedyLayoutStrategy::~GreedyLayoutStrategy() {}
 
 LayoutStrategy::PageLayout GreedyLayoutStrategy::layoutText(WordProvider& provider, TextRenderer& renderer,
                                                             const LayoutConfig& config) {
+  TRACE_SCOPE(LAYOUT_TEXT, provider.getCurrentIndex());
+  HEAP_SUBSYSTEM(LAYOUT);
   const int16_t maxWidth = config.pageWidth - config.marginLeft - config.marginRight;
   const int16_t x = config.marginLeft;
 
@@ -81,17 +85,19 @@ LayoutStrategy::PageLayout GreedyLayoutStrategy::layoutText(WordProvider& provid
   // reset the provider to the start index
   provider.setPosition(startIndex);
 
+  HEAP_CHECKPOINT("layout");
   return result;
 }
 
 void GreedyLayoutStrategy::renderPage(const PageLayout& layout, TextRenderer& renderer, const LayoutConfig& config) {
+  TRACE_SCOPE(RENDER_PAGE, layout.lines.size());
+  HEAP_SUBSYSTEM(RENDER);
   for (const auto& line : layout.lines) {
     for (const auto& word : line.words) {
-      renderer.setFontStyle(word.style);
-      renderer.setCursor(word.x, word.y);
-      renderer.print(word.text);
+      renderWord(word, renderer, config);
     }
   }
+  HEAP_CHECKPOINT("render");
 }
 
 LayoutStrategy::Line GreedyLayoutStrategy::test_getNextLine(WordProvider& provider, TextRenderer& renderer,
@@ -1,7 +1,10 @@
 #include "KnuthPlassLayoutStrategy.h"
 
 #include "../../content/providers/WordProvider.h"
+#include "../../core/HeapTelemetry.h"
+#include "../../core/Trace.h"
 #include "../../rendering/TextRenderer.h"
+#include "../hyphenation/HyphenationStrategy.h"
 #include "WString.h"
 #ifdef ARDUINO
 #include <Arduino.h>
@@ -14,15 +17,19 @@ extern unsigned long millis();
 #include <cmath>
 #include <limits>
 
-#define DEBUG_LAYOUT
-
 KnuthPlassLayoutStrategy::KnuthPlassLayoutStrategy() {}
 
 KnuthPlassLayoutStrategy::~KnuthPlassLayoutStrategy() {}
 
+void KnuthPlassLayoutStrategy::clearParagraphCache() {
+  cacheValid_ = false;
+  cache_ = BrokenParagraph();
+}
+
 LayoutStrategy::PageLayout KnuthPlassLayoutStrategy::layoutText(WordProvider& provider, TextRenderer& renderer,
                                                                 const LayoutConfig& config) {
-  Serial.println("[KP] layoutText start");
+  TRACE_SCOPE(LAYOUT_TEXT, provider.getCurrentIndex());
+  HEAP_SUBSYSTEM(LAYOUT);
   const int16_t maxWidth = config.pageWidth - config.marginLeft - config.marginRight;
 
   // Calculate vertical centering offset based on maximum line capacity
@@ -41,302 +48,685 @@ LayoutStrategy::PageLayout KnuthPlassLayoutStrategy::layoutText(WordProvider& pr
   renderer.getTextBounds(" ", 0, 0, nullptr, nullptr, &spaceWidth_, nullptr);
 
   PageLayout result;
-  std::vector<ParagraphLayoutInfo> paragraphs;
-  std::vector<LayoutStrategy::Word> words;
-  words.reserve(512);  // Pre-allocate to avoid reallocation during paragraph collection
-
   int startIndex = provider.getCurrentIndex();
+  int position = startIndex;
+  int linesUsed = 0;
+  CacheKey key = makeCacheKey(provider, renderer, maxWidth);
+
   while (y < maxY) {
-    int16_t yStart = y;
-    int16_t lineCount = 0;
-    bool isParagraphEnd = false;
-    TextAlignment paragraphAlignment = config.alignment;  // Will be set by first line
-
-    // Collect words for the paragraph
-    while (y < maxY && !isParagraphEnd) {
-      Line lineResult = getNextLine(provider, renderer, maxWidth, isParagraphEnd, config.alignment);
-      y += config.lineHeight;
+    provider.setPosition(position);
+    if (!provider.hasNextWord()) {
+      break;
+    }
 
-      // Capture alignment from first line of paragraph
-      if (lineCount == 0 && !lineResult.words.empty()) {
-        paragraphAlignment = lineResult.alignment;
-      }
+    // Continue a paragraph broken for an earlier page, or break the next one
+    size_t lineIndex = 0;
+    if (findCachedLine(provider, key, position, lineIndex)) {
+      stats_.cacheHits++;
+    } else {
+      provider.setPosition(position);
+      breakParagraph(provider, renderer, config.alignment, maxWidth, cache_);
+      cacheKey_ = key;
+      cacheValid_ = true;
+    }
 
-      // Only count lines that have actual content
-      if (!lineResult.words.empty()) {
-        lineCount++;
-      }
+    if (cache_.empty) {
+      // Blank line between paragraphs
+      y += config.lineHeight;
+      linesUsed++;
+      position = cache_.endPosition;
+      continue;
+    }
 
-      // iterate line by line until paragraph end
-      size_t wordsBefore = words.size();
-      for (size_t i = 0; i < lineResult.words.size(); i++) {
-        words.push_back(lineResult.words[i]);
-      }
+    int lastPosition = position;
+    for (; lineIndex < cache_.lines.size() && y < maxY; lineIndex++) {
+      const BrokenLine& broken = cache_.lines[lineIndex];
+      std::vector<Word> words = broken.words;
+      Line line;
+      placeLine(words, broken.lastInParagraph, cache_.alignment, config.marginLeft, y, maxWidth, line);
+      result.lines.push_back(line);
+      position = broken.endPosition;
+      y += config.lineHeight;
+      linesUsed++;
+    }
+    if (cache_.lines.empty()) {
+      position = cache_.endPosition;
     }
+    if (position == lastPosition) {
+      break;  // No progress (should not happen)
+    }
+  }
 
-    if (!words.empty()) {
-      // Calculate line breaks using Knuth-Plass algorithm
-      std::vector<size_t> breaks = calculateBreaks(words, maxWidth);
+  if (linesUsed > maxLines) {
+    lineCountMismatch_ = true;
+    expectedLineCount_ = maxLines;
+    actualLineCount_ = linesUsed;
+  }
 
-      if (lineCount != breaks.size() + 1) {
-        lineCountMismatch_ = true;
-        expectedLineCount_ = lineCount;
-        actualLineCount_ = breaks.size() + 1;
-      }
+  result.endPosition = position;
+  // reset the provider to the start index
+  provider.setPosition(startIndex);
 
-      // Convert breaks into lines and calculate positions
-      int16_t currentY = yStart;
+  HEAP_CHECKPOINT("layout");
+  return result;
+}
 
-      size_t lineStart = 0;
-      for (size_t breakIdx = 0; breakIdx <= breaks.size(); breakIdx++) {
-        size_t lineEnd = (breakIdx < breaks.size()) ? breaks[breakIdx] : words.size();
-        if (lineStart >= lineEnd)
-          break;
+int KnuthPlassLayoutStrategy::getPreviousPageStart(WordProvider& provider, TextRenderer& renderer,
+                                                   const LayoutConfig& config, int currentStartPosition) {
+  HEAP_SUBSYSTEM(LAYOUT);
+  int savedPosition = provider.getCurrentIndex();
+  const int16_t maxWidth = config.pageWidth - config.marginLeft - config.marginRight;
+  renderer.setFontStyle(FontStyle::REGULAR);
+  renderer.getTextBounds(" ", 0, 0, nullptr, nullptr, &spaceWidth_, nullptr);
 
-        std::vector<Word> lineWords;
-        for (size_t i = lineStart; i < lineEnd; i++) {
-          lineWords.push_back(words[i]);
-        }
+  // Lines layoutText() puts on a page, counted the way it fills one
+  const int16_t availableHeight = config.pageHeight - config.marginTop - config.marginBottom;
+  const int16_t maxLines = availableHeight / config.lineHeight;
+  const int16_t verticalPadding = (availableHeight - (maxLines * config.lineHeight - config.lineSpacing)) / 2;
+  const int16_t maxY = config.pageHeight - config.marginBottom;
+  size_t pageLines = 0;
+  for (int16_t y = config.marginTop + verticalPadding + (config.lineHeight - config.lineSpacing); y < maxY;
+       y += config.lineHeight)
+    pageLines++;
+
+  // Prepend whole paragraphs until a page of lines lies before the current start
+  std::vector<LineStart> starts;
+  int from = currentStartPosition;
+  while (starts.size() < pageLines && from > 0) {
+    int paragraphStart = previousParagraphStart(provider, from);
+    std::vector<LineStart> paragraph;
+    collectLineStarts(provider, renderer, config.alignment, maxWidth, paragraphStart, from, paragraph);
+    starts.insert(starts.begin(), paragraph.begin(), paragraph.end());
+    from = paragraphStart;
+  }
 
-        // Calculate indentation from leading spaces for first line
-        int16_t indent = 0;
-        // if (breakIdx == 0) {
-        //   for (const auto& w : lineWords) {
-        //     if (w.text == " ") {
-        //       indent += w.width;
-        //     } else {
-        //       break;
-        //     }
-        //   }
-        // }
-        const int16_t x = config.marginLeft + indent;
-        int16_t effectiveMaxWidth = maxWidth - indent;
-
-        // Trim leading and trailing spaces
-        while (!lineWords.empty() && lineWords.front().text == " ") {
-          lineWords.erase(lineWords.begin());
-        }
-        while (!lineWords.empty() && lineWords.back().text == " ") {
-          lineWords.erase(lineWords.end() - 1);
-        }
+  int previousPageStart = 0;
+  if (starts.size() >= pageLines) {
+    const LineStart& first = starts[starts.size() - pageLines];
+    previousPageStart = first.position;
 
-        // Calculate positions for words in this line
-        bool isLastLine = (breakIdx == breaks.size()) && isParagraphEnd;
-        size_t numWords = lineWords.size();
-        size_t numSpaceWords = 0;
-        for (const auto& w : lineWords) {
-          if (w.text == " ")
-            numSpaceWords++;
-        }
+    // The previous page is usually laid out next: leave its paragraph in the cache
+    provider.setPosition(first.paragraphStart);
+    breakParagraph(provider, renderer, config.alignment, maxWidth, cache_);
+    cacheKey_ = makeCacheKey(provider, renderer, maxWidth);
+    cacheValid_ = true;
+  }
 
-        if (isLastLine || numSpaceWords == 0) {
-          // Last line: use alignment, no justification
-          int16_t lineWidth = 0;
-          for (size_t i = 0; i < lineWords.size(); i++) {
-            lineWidth += lineWords[i].width;
-          }
+  provider.setPosition(savedPosition);
+  return previousPageStart;
+}
 
-          int16_t xPos = x;
-          if (paragraphAlignment == ALIGN_CENTER) {
-            xPos = x + (effectiveMaxWidth - lineWidth) / 2;
-          } else if (paragraphAlignment == ALIGN_RIGHT) {
-            xPos = x + effectiveMaxWidth - lineWidth;
-          }
+int KnuthPlassLayoutStrategy::previousParagraphStart(WordProvider& provider, int position) {
+  // The line break that ends the paragraph before position does not count
+  provider.setPosition(position);
+  bool skipBreak = true;
+  while (provider.getCurrentIndex() > 0) {
+    int index = provider.getCurrentIndex();
+    StyledWord word = provider.getPrevWord();
+    if (word.text == String("\n") && !skipBreak)
+      return index;
+    skipBreak = false;
+  }
+  return 0;
+}
 
-          int16_t currentX = xPos;
-          for (size_t i = 0; i < lineWords.size(); i++) {
-            lineWords[i].x = currentX;
-            lineWords[i].y = currentY;
-            currentX += lineWords[i].width;
-          }
-        } else {
-          // Non-last line: justify by distributing space evenly among space words
-          int16_t totalWordWidth = 0;
-          for (size_t i = 0; i < lineWords.size(); i++) {
-            totalWordWidth += lineWords[i].width;
-          }
+void KnuthPlassLayoutStrategy::collectLineStarts(WordProvider& provider, TextRenderer& renderer,
+                                                 TextAlignment defaultAlignment, int16_t maxWidth, int from, int to,
+                                                 std::vector<LineStart>& starts) {
+  // Same paragraph (and chunk) boundaries as layoutText(), so the same breaks
+  BrokenParagraph paragraph;
+  int position = from;
+  while (position < to) {
+    provider.setPosition(position);
+    if (!provider.hasNextWord())
+      break;
+    breakParagraph(provider, renderer, defaultAlignment, maxWidth, paragraph);
+    if (paragraph.empty)
+      starts.push_back({position, position});
+    for (const BrokenLine& line : paragraph.lines) {
+      if (line.startPosition >= to)
+        break;
+      starts.push_back({line.startPosition, position});
+    }
+    if (paragraph.endPosition <= position)
+      break;
+    position = paragraph.endPosition;
+  }
+}
 
-          // Calculate space to distribute among space words
-          int16_t totalSpaceWidth = maxWidth - totalWordWidth;
-          float extraPerSpace = (float)totalSpaceWidth / (float)numSpaceWords;
+void KnuthPlassLayoutStrategy::renderPage(const PageLayout& layout, TextRenderer& renderer,
+                                          const LayoutConfig& config) {
+  TRACE_SCOPE(RENDER_PAGE, layout.lines.size());
+  HEAP_SUBSYSTEM(RENDER);
+  for (const auto& line : layout.lines) {
+    for (const auto& word : line.words) {
+      renderWord(word, renderer, config);
+    }
+  }
+  HEAP_CHECKPOINT("render");
+}
 
-          if (extraPerSpace > 16 * spaceWidth_) {
-            // Limit maximum space stretch to avoid extreme gaps
-            extraPerSpace = std::max(extraPerSpace * 0.25f, (float)spaceWidth_);
-          }
+void KnuthPlassLayoutStrategy::placeLine(std::vector<Word>& lineWords, bool isLastLine, TextAlignment alignment,
+                                         int16_t x, int16_t y, int16_t maxWidth, Line& out) {
+  size_t numSpaceWords = 0;
+  for (const auto& w : lineWords) {
+    if (w.text == " ")
+      numSpaceWords++;
+  }
 
-          // Increase widths of space words
-          float accumulatedExtra = 0.0f;
-          for (auto& w : lineWords) {
-            if (w.text == " ") {
-              accumulatedExtra += extraPerSpace;
-              int16_t extra = (int16_t)accumulatedExtra;
-              w.width += extra;
-              accumulatedExtra -= extra;
-            }
-          }
+  if (isLastLine || numSpaceWords == 0) {
+    // Last line: use alignment, no justification
+    int16_t lineWidth = 0;
+    for (size_t i = 0; i < lineWords.size(); i++) {
+      lineWidth += lineWords[i].width;
+    }
 
-          // Now place words
-          int16_t currentX = x;
-          for (size_t i = 0; i < lineWords.size(); i++) {
-            lineWords[i].x = currentX;
-            lineWords[i].y = currentY;
-            currentX += lineWords[i].width;
-          }
-        }
+    int16_t xPos = x;
+    if (alignment == ALIGN_CENTER) {
+      xPos = x + (maxWidth - lineWidth) / 2;
+    } else if (alignment == ALIGN_RIGHT) {
+      xPos = x + maxWidth - lineWidth;
+    }
+
+    int16_t currentX = xPos;
+    for (size_t i = 0; i < lineWords.size(); i++) {
+      lineWords[i].x = currentX;
+      lineWords[i].y = y;
+      currentX += lineWords[i].width;
+    }
+  } else {
+    // Non-last line: justify by distributing space evenly among space words
+    int16_t totalWordWidth = 0;
+    for (size_t i = 0; i < lineWords.size(); i++) {
+      totalWordWidth += lineWords[i].width;
+    }
 
-        Line lineStruct;
-        lineStruct.words = lineWords;
-        lineStruct.alignment = paragraphAlignment;
-        result.lines.push_back(lineStruct);
-        lineStart = lineEnd;
-        currentY += config.lineHeight;
+    // Calculate space to distribute among space words
+    int16_t totalSpaceWidth = maxWidth - totalWordWidth;
+    float extraPerSpace = (float)totalSpaceWidth / (float)numSpaceWords;
+
+    if (extraPerSpace > 16 * spaceWidth_) {
+      // Limit maximum space stretch to avoid extreme gaps
+      extraPerSpace = std::max(extraPerSpace * 0.25f, (float)spaceWidth_);
+    }
+
+    // Increase widths of space words
+    float accumulatedExtra = 0.0f;
+    for (auto& w : lineWords) {
+      if (w.text == " ") {
+        accumulatedExtra += extraPerSpace;
+        int16_t extra = (int16_t)accumulatedExtra;
+        w.width += extra;
+        accumulatedExtra -= extra;
       }
+    }
 
-      words.clear();
+    // Now place words
+    int16_t currentX = x;
+    for (size_t i = 0; i < lineWords.size(); i++) {
+      lineWords[i].x = currentX;
+      lineWords[i].y = y;
+      currentX += lineWords[i].width;
     }
   }
 
-  result.endPosition = provider.getCurrentIndex();
-  // reset the provider to the start index
-  provider.setPosition(startIndex);
-
-  return result;
+  out.words.swap(lineWords);
+  out.alignment = alignment;
 }
 
-void KnuthPlassLayoutStrategy::renderPage(const PageLayout& layout, TextRenderer& renderer,
-                                          const LayoutConfig& config) {
-  for (const auto& line : layout.lines) {
-    for (const auto& word : line.words) {
-      renderer.setFontStyle(word.style);
-      renderer.setCursor(word.x, word.y);
-      renderer.print(word.text);
+void KnuthPlassLayoutStrategy::readParagraph(WordProvider& provider, TextRenderer& renderer,
+                                             std::vector<Token>& tokens, bool& paragraphEnd,
+                                             TextAlignment& alignment, TextAlignment defaultAlignment) {
+  tokens.clear();
+  paragraphEnd = false;
+  alignment = defaultAlignment;
+  bool alignmentCaptured = false;
+
+  while (provider.hasNextWord()) {
+    if (tokens.size() >= MAX_PARAGRAPH_TOKENS) {
+      return;
+    }
+    int start = provider.getCurrentIndex();
+    StyledWord styledWord = provider.getNextWord();
+
+    if (!alignmentCaptured) {
+      alignmentCaptured = true;
+      alignment = paragraphAlignment(provider, defaultAlignment);
     }
+
+    if (styledWord.text == String("\n")) {
+      paragraphEnd = true;
+      return;
+    }
+    if (styledWord.text.isEmpty()) {
+      continue;
+    }
+
+    uint16_t width = 0;
+    renderer.setFontStyle(styledWord.style);
+    renderer.getTextBounds(styledWord.text.c_str(), 0, 0, nullptr, nullptr, &width, nullptr);
+    Token token;
+    token.text = styledWord.text;
+    token.width = static_cast<int16_t>(width);
+    token.style = styledWord.style;
+    token.start = start;
+    token.end = provider.getCurrentIndex();
+    token.isGlue = styledWord.text[0] == ' ';
+    tokens.push_back(token);
   }
+
+  // End of the document also ends the paragraph
+  paragraphEnd = true;
 }
 
-std::vector<size_t> KnuthPlassLayoutStrategy::calculateBreaks(const std::vector<Word>& words, int16_t maxWidth) {
-  std::vector<size_t> breaks;
+void KnuthPlassLayoutStrategy::buildItems(const std::vector<Token>& tokens, TextRenderer& renderer, bool hyphenate,
+                                          std::vector<Item>& items) {
+  items.clear();
+  items.reserve(tokens.size() + 2);
+  bool allowHyphens = hyphenationStrategy_ && hyphenationStrategy_->getLanguage() != Language::NONE;
+
+  for (size_t k = 0; k < tokens.size(); k++) {
+    const Token& token = tokens[k];
+    if (token.isGlue) {
+      // Spaces may grow to twice their width and shrink by a third
+      items.push_back({GLUE, false, token.width, token.width, (int16_t)(token.width / 3), 0, (uint16_t)k, 0, 0});
+      continue;
+    }
 
-  if (words.empty()) {
-    return breaks;
-  }
+    uint16_t length = token.text.length();
+    std::vector<int> positions;
+    if (allowHyphens) {
+      if (hyphenate) {
+        positions = hyphenationStrategy_->findHyphenPositions(token.text.c_str());
+      } else {
+        // The first pass only breaks at hyphens already in the text
+        for (uint16_t i = 0; i < length; i++) {
+          if (token.text[i] == '-')
+            positions.push_back(i);
+        }
+      }
+    }
+
+    uint16_t prevSplit = 0;
+    int16_t prevWidth = 0;
+    int16_t hyphenWidth = -1;
+    for (int pos : positions) {
+      bool isAlgorithmic = pos < 0;
+      // Length of the first fragment (an existing hyphen stays with it)
+      uint16_t split = isAlgorithmic ? -(pos + 1) : pos + 1;
+      if (split <= prevSplit || split >= length) {
+        continue;
+      }
 
-  size_t n = words.size();
+      uint16_t prefixWidth = 0;
+      renderer.setFontStyle(token.style);
+      renderer.getTextBounds(token.text.substring(0, split).c_str(), 0, 0, nullptr, nullptr, &prefixWidth, nullptr);
+      if (isAlgorithmic && hyphenWidth < 0) {
+        uint16_t w = 0;
+        renderer.getTextBounds("-", 0, 0, nullptr, nullptr, &w, nullptr);
+        hyphenWidth = static_cast<int16_t>(w);
+      }
 
-  // Dynamic programming array: minimum demerits to reach each word
-  std::vector<float> minDemerits(n + 1, INFINITY_PENALTY);
-  std::vector<int> prevBreak(n + 1, -1);
+      items.push_back({BOX, false, (int16_t)(prefixWidth - prevWidth), 0, 0, 0, (uint16_t)k, prevSplit, split});
+      items.push_back({PENALTY, true, (int16_t)(isAlgorithmic ? hyphenWidth : 0), 0, 0,
+                       isAlgorithmic ? HYPHEN_PENALTY : EXPLICIT_HYPHEN_PENALTY, (uint16_t)k, split, split});
+      prevSplit = split;
+      prevWidth = prefixWidth;
+    }
+    items.push_back({BOX, false, (int16_t)(token.width - prevWidth), 0, 0, 0, (uint16_t)k, prevSplit, length});
+  }
 
-  // Base case: starting position has 0 demerits
-  minDemerits[0] = 0.0f;
+  // Paragraph end: glue that absorbs all remaining space, then a forced break
+  items.push_back({GLUE, false, 0, INT16_MAX, 0, 0, NO_TOKEN, 0, 0});
+  items.push_back({PENALTY, false, 0, 0, 0, (int16_t)-INFINITY_PENALTY, NO_TOKEN, 0, 0});
+  stats_.items += items.size();
+}
 
-  // For each possible starting position
-  for (size_t i = 0; i < n; i++) {
-    if (minDemerits[i] >= INFINITY_PENALTY) {
-      continue;  // This position is unreachable
+bool KnuthPlassLayoutStrategy::findBreaks(const std::vector<Item>& items, int16_t maxWidth, float tolerance,
+                                          bool allowOverfull, std::vector<size_t>& breaks) {
+  breaks.clear();
+  std::vector<Node> nodes;
+  nodes.reserve(64);
+  std::vector<int> active;
+
+  // Totals of everything after a break at `position`, skipping the glue and
+  // penalties that disappear at the start of a line
+  int32_t sumWidth = 0;
+  int32_t sumStretch = 0;
+  int32_t sumShrink = 0;
+  auto afterBreak = [&](size_t position, int32_t& width, int32_t& stretch, int32_t& shrink) {
+    width = sumWidth;
+    stretch = sumStretch;
+    shrink = sumShrink;
+    for (size_t i = position; i < items.size(); i++) {
+      const Item& item = items[i];
+      if (item.type == BOX) {
+        break;
+      }
+      if (item.type == GLUE) {
+        width += item.width;
+        stretch += item.stretch;
+        shrink += item.shrink;
+      } else if (item.penalty <= -INFINITY_PENALTY && i > position) {
+        break;
+      }
+    }
+  };
+
+  Node start = {0, 0, 1, 0, 0, 0, 0.0f, -1};
+  afterBreak(0, start.totalWidth, start.totalStretch, start.totalShrink);
+  nodes.push_back(start);
+  active.push_back(0);
+
+  for (size_t b = 0; b < items.size(); b++) {
+    const Item& item = items[b];
+    if (item.type == BOX) {
+      sumWidth += item.width;
+      continue;
     }
 
-    // Try to fit words [i, j) on one line
-    int16_t lineWidth = 0;
-    for (size_t j = i; j < n; j++) {
-      lineWidth += words[j].width;
-
-      // Check if line is too wide
-      if (lineWidth > maxWidth) {
-        // Special case: if this is the first word on the line and it's too wide,
-        // we must still place it on its own line to make progress
-        if (j == i) {
-          // Force this oversized word onto its own line with a high but not infinite penalty
-          // Use a large fixed penalty (100) rather than INFINITY_PENALTY to allow progress
-          float demerits = 100.0f;
-
-          // Add a constant penalty per line to favor fewer lines
-          demerits += 50.0f;
-
-          float totalDemerits = minDemerits[i] + demerits;
-          if (totalDemerits < minDemerits[j + 1]) {
-            minDemerits[j + 1] = totalDemerits;
-            prevBreak[j + 1] = i;
-          }
+    // Glue is a legal break after a box (but not the paragraph-end glue before the forced break)
+    bool feasible = item.type == GLUE ? (b > 0 && items[b - 1].type == BOX && item.token != NO_TOKEN)
+                                      : item.penalty < INFINITY_PENALTY;
+    if (feasible) {
+      stats_.breakpoints++;
+      bool forced = item.type == PENALTY && item.penalty <= -INFINITY_PENALTY;
+      int16_t breakWidth = item.type == PENALTY ? item.width : 0;
+
+      float bestDemerits[4];
+      int bestNode[4] = {-1, -1, -1, -1};
+      float minDemerits = std::numeric_limits<float>::max();
+      for (int fc = 0; fc < 4; fc++)
+        bestDemerits[fc] = std::numeric_limits<float>::max();
+      int lastResort = -1;
+
+      for (size_t k = 0; k < active.size();) {
+        const Node& a = nodes[active[k]];
+        int32_t width = sumWidth - a.totalWidth + breakWidth;
+        float ratio = 0.0f;
+        if (width < maxWidth) {
+          int32_t stretch = sumStretch - a.totalStretch;
+          ratio = stretch > 0 ? (float)(maxWidth - width) / (float)stretch : INFINITY_BADNESS;
+        } else if (width > maxWidth) {
+          int32_t shrink = sumShrink - a.totalShrink;
+          ratio = shrink > 0 ? (float)(maxWidth - width) / (float)shrink : -INFINITY_BADNESS;
         }
-        break;  // Can't fit any more words on this line
-      }
 
-      // Calculate badness and demerits for this line
-      bool isLastLine = (j == n - 1);
-      float badness = calculateBadness(lineWidth, maxWidth);
-      float demerits = calculateDemerits(badness, isLastLine);
+        if (ratio < -1.0f) {
+          // Overfull: this and every later break from `a` is too long
+          if (lastResort < 0 || a.totalDemerits < nodes[lastResort].totalDemerits)
+            lastResort = active[k];
+        } else {
+          float badness = std::min(100.0f * std::fabs(ratio) * ratio * ratio, INFINITY_BADNESS);
+          if (badness <= tolerance) {
+            uint8_t fitness = ratio < -0.5f ? 0 : (ratio <= 0.5f ? 1 : (ratio <= 1.0f ? 2 : 3));
+            float demerits = (LINE_PENALTY + badness) * (LINE_PENALTY + badness);
+            if (item.type == PENALTY && !forced) {
+              float p = item.penalty;
+              demerits += item.penalty > 0 ? p * p : -p * p;
+            }
+            const Item& from = items[a.position];
+            bool fromHyphen = a.prev >= 0 && from.type == PENALTY && from.flagged;
+            if (fromHyphen && item.type == PENALTY && item.flagged)
+              demerits += DOUBLE_HYPHEN_DEMERITS;
+            if (fromHyphen && forced)
+              demerits += FINAL_HYPHEN_DEMERITS;
+            if (std::abs((int)fitness - (int)a.fitness) > 1)
+              demerits += ADJ_DEMERITS;
+
+            float total = a.totalDemerits + demerits;
+            if (total < bestDemerits[fitness]) {
+              bestDemerits[fitness] = total;
+              bestNode[fitness] = active[k];
+            }
+            minDemerits = std::min(minDemerits, total);
+          }
+        }
 
-      // Add a constant penalty per line to favor fewer lines
-      // This makes layouts with fewer lines always preferable
-      demerits += 50.0f;
+        if (ratio < -1.0f || forced) {
+          active.erase(active.begin() + k);
+        } else {
+          k++;
+        }
+      }
 
-      // Update minimum demerits to reach position j+1
-      float totalDemerits = minDemerits[i] + demerits;
-      if (totalDemerits < minDemerits[j + 1]) {
-        minDemerits[j + 1] = totalDemerits;
-        prevBreak[j + 1] = i;
+      int32_t width, stretch, shrink;
+      if (minDemerits < std::numeric_limits<float>::max()) {
+        afterBreak(b, width, stretch, shrink);
+        for (int fc = 0; fc < 4; fc++) {
+          if (bestNode[fc] >= 0 && bestDemerits[fc] <= minDemerits + ADJ_DEMERITS) {
+            Node node = {b, nodes[bestNode[fc]].line + 1, (uint8_t)fc, width, stretch, shrink, bestDemerits[fc],
+                         bestNode[fc]};
+            active.push_back(nodes.size());
+            nodes.push_back(node);
+          }
+        }
+      } else if (allowOverfull && active.empty() && lastResort >= 0) {
+        // Nothing fits: let the line overflow at the earliest possible break
+        afterBreak(b, width, stretch, shrink);
+        float demerits = (LINE_PENALTY + INFINITY_BADNESS) * (LINE_PENALTY + INFINITY_BADNESS);
+        Node node = {b, nodes[lastResort].line + 1, 0, width, stretch, shrink,
+                     nodes[lastResort].totalDemerits + demerits, lastResort};
+        active.push_back(nodes.size());
+        nodes.push_back(node);
       }
 
-      // If this word was split (hyphenated), we must break the line here
-      if (words[j].wasSplit) {
-        break;
+      stats_.maxActiveNodes = std::max<uint32_t>(stats_.maxActiveNodes, active.size());
+      if (active.empty()) {
+        return false;
       }
     }
+
+    if (item.type == GLUE) {
+      sumWidth += item.width;
+      sumStretch += item.stretch;
+      sumShrink += item.shrink;
+    }
   }
 
-  // Reconstruct breaks by backtracking
-  int pos = n;
-  while (pos > 0 && prevBreak[pos] >= 0) {
-    breaks.push_back(pos);
-    pos = prevBreak[pos];
+  // The forced break at the end leaves only nodes that end the paragraph
+  int best = -1;
+  for (int index : active) {
+    if (nodes[index].position == items.size() - 1 &&
+        (best < 0 || nodes[index].totalDemerits < nodes[best].totalDemerits)) {
+      best = index;
+    }
+  }
+  if (best < 0) {
+    return false;
   }
 
-  // Reverse to get breaks in forward order
+  for (int index = best; nodes[index].prev >= 0; index = nodes[index].prev) {
+    breaks.push_back(nodes[index].position);
+  }
   std::reverse(breaks.begin(), breaks.end());
+  return true;
+}
 
-  // Remove the last break (end of text)
-  if (!breaks.empty() && breaks.back() == n) {
-    breaks.pop_back();
-  }
+std::vector<LayoutStrategy::Word> KnuthPlassLayoutStrategy::lineWords(const std::vector<Token>& tokens,
+                                                                      const std::vector<Item>& items, size_t from,
+                                                                      size_t to, TextRenderer& renderer) {
+  std::vector<Word> words;
 
-  return breaks;
-}
+  // Glue and penalties at the start of a line are discarded
+  size_t i = from;
+  while (i < to && items[i].type != BOX)
+    i++;
 
-float KnuthPlassLayoutStrategy::calculateBadness(int16_t actualWidth, int16_t targetWidth) {
-  if (actualWidth > targetWidth) {
-    // Line is too wide - very bad
-    return INFINITY_PENALTY;
+  for (; i < to; i++) {
+    const Item& item = items[i];
+    if (item.token == NO_TOKEN || item.type == PENALTY) {
+      continue;
+    }
+    const Token& token = tokens[item.token];
+    if (item.type == GLUE) {
+      words.push_back(Word(token.text, token.width, 0, 0, false, token.style));
+      words.back().start = token.start;
+      words.back().end = token.end;
+      continue;
+    }
+
+    // Join the fragments of a word that is not broken inside this line
+    uint16_t charEnd = item.charEnd;
+    while (i + 2 < to && items[i + 1].type == PENALTY && items[i + 2].type == BOX && items[i + 2].token == item.token) {
+      i += 2;
+      charEnd = items[i].charEnd;
+    }
+    if (item.charStart == 0 && charEnd == token.text.length()) {
+      words.push_back(Word(token.text, token.width, 0, 0, false, token.style));
+    } else {
+      words.push_back(Word(token.text.substring(item.charStart, charEnd), 0, 0, 0, false, token.style));
+    }
+    // Fragments keep the whole token's range
+    words.back().start = token.start;
+    words.back().end = token.end;
   }
 
-  if (actualWidth == targetWidth) {
-    // Perfect fit
-    return 0.0f;
+  // Trailing spaces before the break are dropped as well
+  while (!words.empty() && words.back().text[0] == ' ') {
+    words.pop_back();
   }
 
-  // Calculate adjustment ratio (how much space needs to be stretched)
-  float ratio = (float)(targetWidth - actualWidth) / (float)targetWidth;
+  // Line ends at a hyphenation point: mark the fragment and add the hyphen
+  const Item& brk = items[to];
+  if (brk.type == PENALTY && brk.flagged && !words.empty()) {
+    Word& last = words.back();
+    if (brk.width > 0) {
+      last.text += "-";
+    }
+    last.wasSplit = true;
+    last.width = 0;
+  }
 
-  // Badness is cube of ratio (Knuth-Plass formula)
-  // This penalizes very loose lines more heavily
-  float badness = ratio * ratio * ratio * 100.0f;
+  // Measure fragments
+  for (Word& w : words) {
+    if (w.width == 0 && !w.text.isEmpty()) {
+      uint16_t width = 0;
+      renderer.setFontStyle(w.style);
+      renderer.getTextBounds(w.text.c_str(), 0, 0, nullptr, nullptr, &width, nullptr);
+      w.width = static_cast<int16_t>(width);
+    }
+  }
+  return words;
+}
 
-  return badness;
+int KnuthPlassLayoutStrategy::breakPosition(WordProvider& provider, const std::vector<Token>& tokens,
+                                            const std::vector<Item>& items, size_t breakItem) {
+  const Item& item = items[breakItem];
+  const Token& token = tokens[item.token];
+  if (item.type == GLUE) {
+    return token.end;
+  }
+  // Inside a word: let the provider translate the character offset
+  provider.setPosition(token.start);
+  provider.consumeChars(item.charStart);
+  return provider.getCurrentIndex();
 }
 
-float KnuthPlassLayoutStrategy::calculateDemerits(float badness, bool isLastLine) {
-  if (badness >= INFINITY_PENALTY) {
-    return INFINITY_PENALTY;
+void KnuthPlassLayoutStrategy::breakParagraph(WordProvider& provider, TextRenderer& renderer,
+                                              TextAlignment defaultAlignment, int16_t maxWidth,
+                                              BrokenParagraph& out) {
+  int paragraphStart = provider.getCurrentIndex();
+  std::vector<Token> tokens;
+  bool paragraphEnd = false;
+  readParagraph(provider, renderer, tokens, paragraphEnd, out.alignment, defaultAlignment);
+  out.lines.clear();
+  out.endPosition = provider.getCurrentIndex();
+  out.empty = false;
+
+  bool hasWords = false;
+  for (const Token& token : tokens) {
+    if (!token.isGlue) {
+      hasWords = true;
+      break;
+    }
+  }
+  if (!hasWords) {
+    out.empty = paragraphEnd;
+    return;
+  }
+  stats_.paragraphs++;
+
+  // Pass 1 without hyphenation, pass 2 with hyphenation, pass 3 accepts anything
+  std::vector<Item> items;
+  std::vector<size_t> breaks;
+  buildItems(tokens, renderer, false, items);
+  bool found = findBreaks(items, maxWidth, PRETOLERANCE, false, breaks);
+  if (!found && hyphenationStrategy_ && hyphenationStrategy_->getLanguage() != Language::NONE) {
+    stats_.hyphenationPasses++;
+    buildItems(tokens, renderer, true, items);
+    found = findBreaks(items, maxWidth, TOLERANCE, false, breaks);
+  }
+  if (!found) {
+    stats_.emergencyPasses++;
+    findBreaks(items, maxWidth, INFINITY_BADNESS, true, breaks);
+  }
+
+  size_t from = 0;
+  int lineStart = paragraphStart;
+  for (size_t i = 0; i < breaks.size(); i++) {
+    bool last = i + 1 == breaks.size();
+    BrokenLine line;
+    line.words = lineWords(tokens, items, from, breaks[i], renderer);
+    line.startPosition = lineStart;
+    line.endPosition = last ? out.endPosition : breakPosition(provider, tokens, items, breaks[i]);
+    line.lastInParagraph = last && paragraphEnd;
+
+    size_t first = from;
+    while (items[first].type != BOX)
+      first++;
+    line.firstToken = tokens[items[first].token].text.substring(items[first].charStart);
+
+    out.lines.push_back(line);
+    lineStart = line.endPosition;
+    from = breaks[i] + 1;
   }
 
-  // Last line is allowed to be loose without penalty
-  if (isLastLine) {
-    return 0.0f;
+  // A paragraph cut at MAX_PARAGRAPH_TOKENS: the last line was broken without
+  // knowing what follows, so it is broken again together with the next chunk
+  if (!paragraphEnd && out.lines.size() > 1) {
+    out.lines.pop_back();
+    out.endPosition = out.lines.back().endPosition;
   }
+  provider.setPosition(out.endPosition);
+}
 
-  // Demerits is square of (1 + badness)
-  float demerits = (1.0f + badness) * (1.0f + badness);
+KnuthPlassLayoutStrategy::CacheKey KnuthPlassLayoutStrategy::makeCacheKey(WordProvider& provider,
+                                                                          TextRenderer& renderer,
+                                                                          int16_t maxWidth) const {
+  const FontFamily* family = renderer.getFontFamily();
+  CacheKey key;
+  key.provider = &provider;
+  key.chapter = provider.getCurrentChapter();
+  key.maxWidth = maxWidth;
+  key.spaceWidth = spaceWidth_;
+  key.language = hyphenationStrategy_ ? hyphenationStrategy_->getLanguage() : Language::NONE;
+  key.family = family;
+  key.glyphs = (family && family->regular) ? family->regular->glyph : nullptr;
+  return key;
+}
 
-  return demerits;
+bool KnuthPlassLayoutStrategy::findCachedLine(WordProvider& provider, const CacheKey& key, int position,
+                                              size_t& lineIndex) {
+  if (!cacheValid_ || !(key == cacheKey_)) {
+    return false;
+  }
+  for (size_t i = 0; i < cache_.lines.size(); i++) {
+    const BrokenLine& line = cache_.lines[i];
+    if (line.startPosition != position) {
+      continue;
+    }
+    // Make sure the provider still holds the same text at this position
+    provider.setPosition(position);
+    StyledWord word = provider.getNextWord();
+    while (!word.text.isEmpty() && word.text[0] == ' ' && provider.hasNextWord()) {
+      word = provider.getNextWord();
+    }
+    if (word.text != line.firstToken) {
+      return false;
+    }
+    lineIndex = i;
+    return true;
+  }
+  return false;
 }
@@ -5,12 +5,47 @@
 
 #include "LayoutStrategy.h"
 
+/**
+ * Optimal-fit line breaking (Knuth & Plass, "Breaking Paragraphs into Lines").
+ *
+ * Each paragraph is read in full and turned into boxes (words or word
+ * fragments), glue (space tokens, which may stretch and shrink) and penalties
+ * (hyphenation points). Breaks are chosen to minimise total demerits over the
+ * whole paragraph using an active-node list, so the cost is roughly linear in
+ * the paragraph length. Lines are classified into fitness classes to avoid a
+ * very loose line next to a very tight one.
+ *
+ * Like TeX the breaker runs up to three passes: without hyphenation, with
+ * hyphenation at all break points reported by the hyphenation strategy, and a
+ * final pass that accepts any stretch (and overfull lines if a word is wider
+ * than the page).
+ *
+ * The most recently broken paragraph is cached, so a page that starts inside
+ * it (the page after one that ended mid-paragraph) reuses its lines instead of
+ * breaking the remainder again.
+ *
+ * Paging backward re-breaks whole paragraphs from their start rather than
+ * fitting lines greedily from the end, because optimal breaks depend on the
+ * text before them; only then does the previous page start where paging
+ * forward put it.
+ */
 class KnuthPlassLayoutStrategy : public LayoutStrategy {
  public:
+  // Counters for tests and benchmarks
+  struct Stats {
+    uint32_t paragraphs = 0;         // Paragraphs (or paragraph chunks) broken
+    uint32_t hyphenationPasses = 0;  // Paragraphs that needed the hyphenation pass
+    uint32_t emergencyPasses = 0;    // Paragraphs that needed the unlimited-stretch pass
+    uint32_t items = 0;              // Boxes, glue and penalties built
+    uint32_t breakpoints = 0;        // Feasible breakpoints examined
+    uint32_t maxActiveNodes = 0;     // Largest active list seen
+    uint32_t cacheHits = 0;          // Paragraph continuations served from the cache
+  };
+
   KnuthPlassLayoutStrategy();
   ~KnuthPlassLayoutStrategy();
 
-  // Test support: check if line count mismatch occurred
+  // Test support: set when a page was given more lines than fit on it
   bool hasLineCountMismatch() const {
     return lineCountMismatch_;
   }
@@ -26,6 +61,16 @@ class KnuthPlassLayoutStrategy : public LayoutStrategy {
     actualLineCount_ = 0;
   }
 
+  const Stats& getStats() const {
+    return stats_;
+  }
+  void resetStats() {
+    stats_ = Stats();
+  }
+
+  // Drop the cached paragraph (e.g. after the document content changed)
+  void clearParagraphCache();
+
   Type getType() const override {
     return KNUTH_PLASS;
   }
@@ -34,34 +79,136 @@ class KnuthPlassLayoutStrategy : public LayoutStrategy {
   PageLayout layoutText(WordProvider& provider, TextRenderer& renderer, const LayoutConfig& config) override;
   void renderPage(const PageLayout& layout, TextRenderer& renderer, const LayoutConfig& config) override;
 
+  // Breaks the paragraphs before currentStartPosition the way layoutText() does and steps back one page of their
+  // lines, so the result is the start the forward pass gives the previous page. The paragraph it falls in is left
+  // in the cache for the layoutText() call that usually follows.
+  int getPreviousPageStart(WordProvider& provider, TextRenderer& renderer, const LayoutConfig& config,
+                           int currentStartPosition) override;
+
  private:
   // spaceWidth_ is defined in base class
 
-  struct ParagraphLayoutInfo {
-    std::vector<Word> words;
-    std::vector<size_t> breaks;
-    bool paragraphEnd;
-    int16_t yStart;
+  // Knuth-Plass parameters (TeX defaults where applicable)
+  static constexpr int16_t INFINITY_PENALTY = 10000;
+  static constexpr int16_t HYPHEN_PENALTY = 50;
+  static constexpr int16_t EXPLICIT_HYPHEN_PENALTY = 50;
+  static constexpr float INFINITY_BADNESS = 10000.0f;
+  static constexpr float PRETOLERANCE = 100.0f;  // Badness limit of the pass without hyphenation
+  static constexpr float TOLERANCE = 200.0f;     // Badness limit of the hyphenation pass
+  static constexpr float LINE_PENALTY = 10.0f;
+  static constexpr float DOUBLE_HYPHEN_DEMERITS = 3000.0f;
+  static constexpr float FINAL_HYPHEN_DEMERITS = 5000.0f;
+  static constexpr float ADJ_DEMERITS = 10000.0f;  // Fitness classes of adjacent lines differ by more than one
+
+  // Longest paragraph read at once; longer paragraphs are broken in chunks
+  static constexpr size_t MAX_PARAGRAPH_TOKENS = 1024;
+
+  // A token as returned by the word provider
+  struct Token {
+    String text;
+    int16_t width;
+    FontStyle style;
+    int start;    // Provider position before the token
+    int end;      // Provider position after the token
+    bool isGlue;  // Space token
   };
 
-  // Knuth-Plass parameters
-  static constexpr float INFINITY_PENALTY = 10000.0f;
-  static constexpr float HYPHEN_PENALTY = 50.0f;
-  static constexpr float FITNESS_DEMERITS = 100.0f;
+  enum ItemType : uint8_t { BOX, GLUE, PENALTY };
 
-  // Node for dynamic programming
+  struct Item {
+    ItemType type;
+    bool flagged;       // Hyphenation penalty
+    int16_t width;      // Box/glue width, or width added when breaking at a penalty (the hyphen)
+    int16_t stretch;    // Glue only
+    int16_t shrink;     // Glue only
+    int16_t penalty;    // Penalty only
+    uint16_t token;     // Source token (NO_TOKEN for the paragraph-end glue and penalty)
+    uint16_t charStart;  // Box: fragment of the token text; penalty: split position in the token
+    uint16_t charEnd;
+  };
+  static constexpr uint16_t NO_TOKEN = 0xFFFF;
+
+  // Node in the breaking graph (a feasible break with the best way to reach it)
   struct Node {
-    size_t position;      // Word index
-    size_t line;          // Line number
-    float totalDemerits;  // Total demerits up to this point
-    int16_t totalWidth;   // Width accumulated up to this position
-    int prevBreak;        // Previous break point index (-1 if none)
+    size_t position;  // Item index of the break (0 for the paragraph start)
+    int line;         // Number of lines ending at this break
+    uint8_t fitness;  // 0 tight, 1 decent, 2 loose, 3 very loose
+    int32_t totalWidth;
+    int32_t totalStretch;
+    int32_t totalShrink;
+    float totalDemerits;
+    int prev;  // Index of the previous node in the pool (-1 for the start)
+  };
+
+  // One broken line of a paragraph, not yet positioned on a page
+  struct BrokenLine {
+    std::vector<Word> words;
+    int startPosition;  // Provider position of the first word
+    int endPosition;    // Provider position where the next line starts
+    bool lastInParagraph;
+    String firstToken;  // Provider token at startPosition, used to validate cache hits
+  };
+
+  struct BrokenParagraph {
+    std::vector<BrokenLine> lines;
+    TextAlignment alignment;
+    int endPosition;  // Provider position after the paragraph (or chunk)
+    bool empty;       // Paragraph without any words (blank line)
   };
 
-  // Helper methods
-  std::vector<size_t> calculateBreaks(const std::vector<Word>& words, int16_t maxWidth);
-  float calculateBadness(int16_t actualWidth, int16_t targetWidth);
-  float calculateDemerits(float badness, bool isLastLine);
+  // Identifies what the cached paragraph was broken for
+  struct CacheKey {
+    const WordProvider* provider;
+    int chapter;
+    int16_t maxWidth;
+    uint16_t spaceWidth;
+    Language language;
+    const FontFamily* family;
+    const void* glyphs;
+    bool operator==(const CacheKey& o) const {
+      return provider == o.provider && chapter == o.chapter && maxWidth == o.maxWidth &&
+             spaceWidth == o.spaceWidth && language == o.language && family == o.family && glyphs == o.glyphs;
+    }
+  };
+
+  // Paragraph handling
+  void readParagraph(WordProvider& provider, TextRenderer& renderer, std::vector<Token>& tokens,
+                     bool& paragraphEnd, TextAlignment& alignment, TextAlignment defaultAlignment);
+  void breakParagraph(WordProvider& provider, TextRenderer& renderer, TextAlignment defaultAlignment,
+                      int16_t maxWidth, BrokenParagraph& out);
+  void buildItems(const std::vector<Token>& tokens, TextRenderer& renderer, bool hyphenate,
+                  std::vector<Item>& items);
+  bool findBreaks(const std::vector<Item>& items, int16_t maxWidth, float tolerance, bool allowOverfull,
+                  std::vector<size_t>& breaks);
+  std::vector<Word> lineWords(const std::vector<Token>& tokens, const std::vector<Item>& items, size_t from,
+                              size_t to, TextRenderer& renderer);
+  int breakPosition(WordProvider& provider, const std::vector<Token>& tokens, const std::vector<Item>& items,
+                    size_t breakItem);
+
+  // A line (or blank line) of the forward layout: where it starts and where the break that produced it began
+  struct LineStart {
+    int position;
+    int paragraphStart;
+  };
+
+  // Backward paging
+  int previousParagraphStart(WordProvider& provider, int position);
+  void collectLineStarts(WordProvider& provider, TextRenderer& renderer, TextAlignment defaultAlignment,
+                         int16_t maxWidth, int from, int to, std::vector<LineStart>& starts);
+
+  // Page placement
+  void placeLine(std::vector<Word>& words, bool isLastLine, TextAlignment alignment, int16_t x, int16_t y,
+                 int16_t maxWidth, Line& out);
+
+  // Paragraph cache
+  CacheKey makeCacheKey(WordProvider& provider, TextRenderer& renderer, int16_t maxWidth) const;
+  bool findCachedLine(WordProvider& provider, const CacheKey& key, int position, size_t& lineIndex);
+
+  bool cacheValid_ = false;
+  CacheKey cacheKey_ = {};
+  BrokenParagraph cache_;
+
+  Stats stats_;
 
   // Line count mismatch tracking for testing
   bool lineCountMismatch_ = false;
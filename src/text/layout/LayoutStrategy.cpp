@@ -26,6 +26,43 @@ void LayoutStrategy::setLanguage(Language language) {
   hyphenationStrategy_ = createHyphenationStrategy(language);
 }
 
+LayoutStrategy::TextAlignment LayoutStrategy::paragraphAlignment(WordProvider& provider,
+                                                                 TextAlignment defaultAlignment) {
+  // Prefer the provider's paragraph alignment if available (providers report Left by default)
+  switch (provider.getParagraphAlignment()) {
+    case TextAlign::Center:
+      return ALIGN_CENTER;
+    case TextAlign::Right:
+      return ALIGN_RIGHT;
+    case TextAlign::Left:
+      return ALIGN_LEFT;
+    default:
+      // Keep defaultAlignment for Justify or unknown
+      return defaultAlignment;
+  }
+}
+
+void LayoutStrategy::renderWord(const Word& word, TextRenderer& renderer, const LayoutConfig& config) {
+  renderer.setFontStyle(word.style);
+  bool bw = renderer.getBitmapType() == TextRenderer::BITMAP_BW;
+  if (word.mark == MARK_INVERT) {
+    if (!bw)
+      return;
+    // The baseline sits about four fifths down the font height
+    int16_t fontHeight = config.lineHeight - config.lineSpacing;
+    renderer.fillRect(word.x, word.y - fontHeight * 4 / 5 - 1, word.width, fontHeight + 2, true);
+    renderer.setTextColor(TextRenderer::COLOR_WHITE);
+    renderer.setCursor(word.x, word.y);
+    renderer.print(word.text);
+    renderer.setTextColor(TextRenderer::COLOR_BLACK);
+    return;
+  }
+  renderer.setCursor(word.x, word.y);
+  renderer.print(word.text);
+  if (word.mark == MARK_UNDERLINE && bw)
+    renderer.fillRect(word.x, word.y + 2, word.width, 2, true);
+}
+
 LayoutStrategy::Line LayoutStrategy::getNextLine(WordProvider& provider, TextRenderer& renderer, int16_t maxWidth,
                                                  bool& isParagraphEnd, TextAlignment defaultAlignment) {
   isParagraphEnd = false;
@@ -44,23 +81,8 @@ LayoutStrategy::Line LayoutStrategy::getNextLine(WordProvider& provider, TextRen
     // Capture alignment when we see one in the paragraph
     // CSS alignment overrides the default
     if (!alignmentCaptured) {
-      // Prefer the provider's paragraph alignment if available (providers report Left by default)
-      TextAlign pAlign = provider.getParagraphAlignment();
       alignmentCaptured = true;
-      switch (pAlign) {
-        case TextAlign::Center:
-          result.alignment = ALIGN_CENTER;
-          break;
-        case TextAlign::Right:
-          result.alignment = ALIGN_RIGHT;
-          break;
-        case TextAlign::Left:
-          result.alignment = ALIGN_LEFT;
-          break;
-        default:
-          // Keep defaultAlignment for Justify or unknown
-          break;
-      }
+      result.alignment = paragraphAlignment(provider, defaultAlignment);
     }
 
     int16_t bx = 0, by = 0;
@@ -68,6 +90,8 @@ LayoutStrategy::Line LayoutStrategy::getNextLine(WordProvider& provider, TextRen
     renderer.setFontStyle(styledWord.style);
     renderer.getTextBounds(text.c_str(), 0, 0, &bx, &by, &bw, &bh);
     Word currentWord(text, static_cast<int16_t>(bw), 0, 0, false, styledWord.style);
+    currentWord.start = wordStartIndex;
+    currentWord.end = provider.getCurrentIndex();
 
     // Check for breaks - breaks are returned as special words
     if (currentWord.text == String("\n")) {
@@ -103,13 +127,15 @@ LayoutStrategy::Line LayoutStrategy::getNextLine(WordProvider& provider, TextRen
         uint16_t bw2 = 0, bh2 = 0;
         renderer.setFontStyle(styledWord.style);
         renderer.getTextBounds(firstPart.c_str(), 0, 0, &bx2, &by2, &bw2, &bh2);
-        result.words.push_back(
-            Word(firstPart, static_cast<int16_t>(bw2), 0, 0, true, currentWord.style));  // wasSplit = true
+        Word part(firstPart, static_cast<int16_t>(bw2), 0, 0, true, currentWord.style);  // wasSplit = true
 
         // Move provider position: consume characters up to the split point
         // For existing hyphens, include the hyphen character (+1)
         provider.setPosition(wordStartIndex);
         provider.consumeChars(split.position + (split.isAlgorithmic ? 0 : 1));
+        part.start = wordStartIndex;
+        part.end = provider.getCurrentIndex();
+        result.words.push_back(part);
         break;
       } else if (currentWidth > 0) {
         // Can't split, put it back and end line
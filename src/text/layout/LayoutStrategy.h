@@ -26,6 +26,9 @@ class LayoutStrategy {
 
   enum TextAlignment { ALIGN_LEFT, ALIGN_CENTER, ALIGN_RIGHT };
 
+  // Annotation drawn over a word by renderPage()
+  enum WordMark : uint8_t { MARK_NONE, MARK_UNDERLINE, MARK_INVERT };
+
   struct Word {
     String text;
     int16_t width;
@@ -33,6 +36,9 @@ class LayoutStrategy {
     int16_t y;
     bool wasSplit;                         // True if this word was split (hyphenated) and must end the line
     FontStyle style = FontStyle::REGULAR;  // Font style for this word
+    int32_t start = -1;                    // Provider positions of the source token (-1 when unknown)
+    int32_t end = -1;
+    uint8_t mark = MARK_NONE;              // WordMark, set by the caller between layoutText() and renderPage()
 
     // Default constructor
     Word() : text(), width(0), x(0), y(0), wasSplit(false), style(FontStyle::REGULAR) {}
@@ -115,6 +121,13 @@ class LayoutStrategy {
     bool isAlgorithmic;  // True if hyphen needs to be inserted, false if it exists in text
     bool found;          // True if a valid split was found
   };
+  // Alignment of the paragraph the provider is in (CSS alignment overrides the default)
+  static TextAlignment paragraphAlignment(WordProvider& provider, TextAlignment defaultAlignment);
+
+  // Draw one laid-out word with its mark. Marks are solid black and only drawn on the black and white pass;
+  // the grayscale passes leave inverted words out so that their edges stay sharp.
+  static void renderWord(const Word& word, TextRenderer& renderer, const LayoutConfig& config);
+
   // Shared helpers used by multiple strategies
   Line getNextLine(WordProvider& provider, TextRenderer& renderer, int16_t maxWidth, bool& isParagraphEnd,
                    TextAlignment defaultAlignment);
@@ -2,17 +2,46 @@
 
 #include <resources/fonts/FontManager.h>
 
+#include "content/library/LibraryIndex.h"
+#include "core/HeapTelemetry.h"
+#include "core/JournalStore.h"
+#include "core/PrefetchPolicy.h"
+#include "core/Scheduler.h"
 #include "core/Settings.h"
 #include "resources/images/bebop_image.h"
 #include "ui/screens/FileBrowserScreen.h"
+#include "ui/screens/HeapDebugScreen.h"
 #include "ui/screens/ImageViewerScreen.h"
 #include "ui/screens/SettingsScreen.h"
 #include "ui/screens/TextViewerScreen.h"
 
+// Brings the library index up to date in the background, a folder or a book per step
+class LibraryRefreshJob : public Job {
+ public:
+  explicit LibraryRefreshJob(LibraryIndex& library) : library_(library) {}
+
+  bool step(uint32_t) override {
+    return library_.refreshStep();
+  }
+  void cancelled() override {
+    library_.cancelRefresh();
+  }
+  const char* name() const override {
+    return "libraryRefresh";
+  }
+
+ private:
+  LibraryIndex& library_;
+};
+
 UIManager::UIManager(EInkDisplay& display, SDCardManager& sdManager)
     : display(display), sdManager(sdManager), textRenderer(display) {
   // Initialize consolidated settings manager
   settings = new Settings(sdManager);
+  library = new LibraryIndex();
+  positions = new JournalStore("/microreader/positions.jnl");
+  scheduler = new Scheduler();
+  prefetch = new PrefetchPolicy();
   // Create concrete screens and store pointers in the map.
   screens[ScreenId::FileBrowser] =
       std::unique_ptr<Screen>(new FileBrowserScreen(display, textRenderer, sdManager, *this));
@@ -20,12 +49,18 @@ UIManager::UIManager(EInkDisplay& display, SDCardManager& sdManager)
   screens[ScreenId::TextViewer] =
       std::unique_ptr<Screen>(new TextViewerScreen(display, textRenderer, sdManager, *this));
   screens[ScreenId::Settings] = std::unique_ptr<Screen>(new SettingsScreen(display, textRenderer, *this));
+  screens[ScreenId::HeapDebug] = std::unique_ptr<Screen>(new HeapDebugScreen(display, textRenderer, *this));
   Serial.printf("[%lu] UIManager: Constructor called\n", millis());
 }
 
 UIManager::~UIManager() {
+  // Jobs may point into the screens, so they go first
+  delete scheduler;
+  delete prefetch;
   if (settings)
     delete settings;
+  delete library;
+  delete positions;
 }
 
 void UIManager::begin() {
@@ -34,6 +69,10 @@ void UIManager::begin() {
   if (sdManager.ready()) {
     if (settings)
       settings->load();
+    positions->load();
+    // The browser lists the books indexed before; ones added, changed or removed since the last boot follow
+    library->load();
+    refreshLibrary();
   }
   // Initialize screens using generic Screen interface
   for (auto& p : screens) {
@@ -81,6 +120,7 @@ void UIManager::begin() {
 void UIManager::handleButtons(Buttons& buttons) {
   // Pass buttons to the current screen
   // Directly forward to the active screen (must exist)
+  HEAP_SUBSYSTEM(UI);
   screens[currentScreen]->handleButtons(buttons);
 }
 
@@ -115,6 +155,8 @@ void UIManager::showSleepScreen() {
 }
 
 void UIManager::prepareForSleep() {
+  // Let unfinished background work clean up before the screen saves its state
+  scheduler->cancelAll();
   // Notify the active screen that the device is powering down so it can
   // persist any state (e.g. current reading position).
   if (screens[currentScreen])
@@ -131,6 +173,12 @@ void UIManager::prepareForSleep() {
   }
 }
 
+void UIManager::refreshLibrary() {
+  library->startRefresh();
+  if (!scheduler->isActive(libraryJob))
+    libraryJob = scheduler->add(new LibraryRefreshJob(*library), Scheduler::PRIORITY_LOW);
+}
+
 void UIManager::openTextFile(const String& sdPath) {
   Serial.printf("UIManager: openTextFile %s\n", sdPath.c_str());
   // Directly access TextViewerScreen and open the file (guaranteed to exist)
@@ -140,6 +188,8 @@ void UIManager::openTextFile(const String& sdPath) {
 
 void UIManager::showScreen(ScreenId id) {
   // Directly show the requested screen (assumed present)
+  if (id != currentScreen && screens[currentScreen])
+    screens[currentScreen]->deactivate();
   previousScreen = currentScreen;
   currentScreen = id;
   // Call activate so screens can perform any work needed when they become
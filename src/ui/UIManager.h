@@ -6,6 +6,7 @@
 
 #include "core/Buttons.h"
 #include "core/EInkDisplay.h"
+#include "core/Scheduler.h"
 #include "rendering/TextRenderer.h"
 #include "text/layout/LayoutStrategy.h"
 #include "ui/screens/Screen.h"
@@ -17,6 +18,7 @@ class FileBrowserScreen;
 class ImageViewerScreen;
 class TextViewerScreen;
 class SettingsScreen;
+class HeapDebugScreen;
 
 // Hash function for enum class
 struct EnumClassHash {
@@ -27,11 +29,14 @@ struct EnumClassHash {
 };
 
 class Settings;
+class LibraryIndex;
+class JournalStore;
+class PrefetchPolicy;
 
 class UIManager {
  public:
   // Typed screen identifiers so callers don't use raw indices
-  enum class ScreenId { FileBrowser, ImageViewer, TextViewer, Settings };
+  enum class ScreenId { FileBrowser, ImageViewer, TextViewer, Settings, HeapDebug };
 
   // Constructor
   UIManager(EInkDisplay& display, class SDCardManager& sdManager);
@@ -49,6 +54,9 @@ class UIManager {
   // Open a text file (path on SD) in the text viewer and switch to that screen.
   void openTextFile(const String& sdPath);
 
+  // Bring the library index up to date with the card as a background job
+  void refreshLibrary();
+
  private:
   EInkDisplay& display;
   SDCardManager& sdManager;
@@ -64,11 +72,40 @@ class UIManager {
   // Global settings manager (single consolidated settings file)
   class Settings* settings = nullptr;
 
+  // Book metadata and progress for the file browser
+  LibraryIndex* library = nullptr;
+
+  // Reading positions of all books ("chapter,position" by path), appended on every save
+  JournalStore* positions = nullptr;
+
+  // Background jobs, stepped in the idle gaps of loop() and while the display refreshes
+  Scheduler* scheduler = nullptr;
+  Scheduler::JobId libraryJob = Scheduler::NO_JOB;  // Library refresh
+
+  // How much of that work may be speculative, given the power source and how the reader turns pages
+  PrefetchPolicy* prefetch = nullptr;
+
  public:
   Settings& getSettings() {
     return *settings;
   }
 
+  LibraryIndex& getLibrary() {
+    return *library;
+  }
+
+  JournalStore& getPositions() {
+    return *positions;
+  }
+
+  Scheduler& getScheduler() {
+    return *scheduler;
+  }
+
+  PrefetchPolicy& getPrefetchPolicy() {
+    return *prefetch;
+  }
+
   Screen* getScreen(ScreenId id) {
     auto it = screens.find(id);
     if (it != screens.end()) {
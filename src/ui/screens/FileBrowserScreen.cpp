@@ -6,9 +6,6 @@
 #include <resources/fonts/other/MenuFontSmall.h>
 #include <resources/fonts/other/MenuHeader.h>
 
-#include <algorithm>
-#include <cstring>
-
 #include "../../core/BatteryMonitor.h"
 #include "../../core/Buttons.h"
 #include "../../core/Settings.h"
@@ -22,6 +19,17 @@ constexpr int LINE_HEIGHT = 28;
 constexpr int BATTERY_Y = 790;
 constexpr int MAX_DISPLAY_NAME_LENGTH = 30;
 constexpr int MAX_VISIBLE_FILES = 16;
+constexpr int COVER_Y = 624;  // Below the last row; a multiple of 8 so the planes stay byte-aligned
+// Least time between redraws while books are being indexed in the background
+constexpr unsigned long LIBRARY_REDRAW_MS = 10000;
+
+bool anyButtonDown(Buttons& buttons) {
+  for (uint8_t i = Buttons::BACK; i <= Buttons::POWER; i++) {
+    if (buttons.isDown(i))
+      return true;
+  }
+  return false;
+}
 }  // namespace
 
 FileBrowserScreen::FileBrowserScreen(EInkDisplay& display, TextRenderer& renderer, SDCardManager& sdManager,
@@ -39,12 +47,20 @@ void FileBrowserScreen::activate() {
 void FileBrowserScreen::show() {
   render();
   display.displayBuffer(EInkDisplay::FAST_REFRESH);
+
+  // The cover's grays wait until the user stops on a book, as adaptive antialiasing does for pages
+  Settings& settings = uiManager.getSettings();
+  antialiasingDelayMs = settings.getAntialiasingDelayMs();
+  coverGrayPending = cover.isLoaded() && coverBook.length() > 0 && settings.getAntialiasingMode() != Settings::AA_OFF;
+  coverRequestTime = millis();
 }
 
 void FileBrowserScreen::handleButtons(Buttons& buttons) {
   bool needsUpdate = false;
   bool shouldGoBack = false;
   bool shouldConfirm = false;
+  bool shouldToggleSort = false;
+  bool shouldRescan = false;
 
   uint8_t btn;
   while ((btn = buttons.consumeNextPress()) != Buttons::NONE) {
@@ -63,24 +79,63 @@ void FileBrowserScreen::handleButtons(Buttons& buttons) {
         selectPrev();
         needsUpdate = true;
         break;
+      case Buttons::VOLUME_UP:
+        shouldToggleSort = true;
+        break;
+      case Buttons::VOLUME_DOWN:
+        shouldRescan = true;
+        break;
     }
   }
 
   if (shouldGoBack) {
-    uiManager.showScreen(UIManager::ScreenId::Settings);
+    if (folder == "/") {
+      uiManager.showScreen(UIManager::ScreenId::Settings);
+    } else {
+      // Up one folder, keeping the folder we left selected
+      openFolder(LibraryIndex::parentFolder(folder), folder);
+      show();
+    }
   } else if (shouldConfirm) {
     confirm();
+  } else if (shouldToggleSort) {
+    toggleSort();
+    show();
+  } else if (shouldRescan) {
+    // The rows follow once the background refresh has changed something
+    uiManager.refreshLibrary();
   } else if (needsUpdate) {
     show();
+  } else if (libraryRevision != uiManager.getLibrary().getRevision() &&
+             (!uiManager.getLibrary().isRefreshing() || millis() - rowsLoadedTime >= LIBRARY_REDRAW_MS)) {
+    if (anyButtonDown(buttons))
+      return;
+    // Books were indexed or dropped in the background: reload the rows, keeping the selection
+    int row = selectedIndex - scrollOffset;
+    String selected = row >= 0 && row < static_cast<int>(files.size()) ? files[row].path : String("");
+    openFolder(folder, selected);
+    show();
+  } else if (coverGrayPending && millis() - coverRequestTime >= antialiasingDelayMs) {
+    if (anyButtonDown(buttons))
+      return;
+    coverGrayPending = false;
+    renderCoverGrayscale();
   }
 }
 
 void FileBrowserScreen::confirm() {
-  if (!files.empty()) {
-    String fullPath = "/" + files[selectedIndex].filename;
-    Serial.printf("Selected file: %s\n", fullPath.c_str());
-    uiManager.openTextFile(fullPath);
+  int row = selectedIndex - scrollOffset;
+  if (row < 0 || row >= static_cast<int>(files.size())) {
+    return;
+  }
+  const FileEntry& entry = files[row];
+  if (entry.isFolder) {
+    openFolder(entry.path, "");
+    show();
+    return;
   }
+  Serial.printf("Selected file: %s\n", entry.path.c_str());
+  uiManager.openTextFile(entry.path);
 }
 
 void FileBrowserScreen::selectNext() {
@@ -92,23 +147,28 @@ void FileBrowserScreen::selectPrev() {
 }
 
 void FileBrowserScreen::offsetSelection(int offset) {
-  if (files.empty()) {
+  if (itemCount == 0) {
     return;
   }
 
-  int fileCount = static_cast<int>(files.size());
-  selectedIndex = (selectedIndex + offset % fileCount + fileCount) % fileCount;
+  selectedIndex = (selectedIndex + offset % itemCount + itemCount) % itemCount;
 
   // Keep selection visible
+  int previousOffset = scrollOffset;
   if (selectedIndex >= scrollOffset + MAX_VISIBLE_FILES) {
     scrollOffset = selectedIndex - MAX_VISIBLE_FILES + 1;
   } else if (selectedIndex < scrollOffset) {
     scrollOffset = selectedIndex;
   }
+  if (scrollOffset != previousOffset) {
+    loadRows();
+  }
 
   // Persist selection
-  Settings& settings = uiManager.getSettings();
-  settings.setString("filebrowser.selected", files[selectedIndex].filename);
+  int row = selectedIndex - scrollOffset;
+  if (row >= 0 && row < static_cast<int>(files.size())) {
+    uiManager.getSettings().setString("filebrowser.selected", files[row].path);
+  }
 }
 
 void FileBrowserScreen::render() {
@@ -142,7 +202,7 @@ void FileBrowserScreen::render() {
     barYOffset = -18;
   }
 
-  int visibleCount = std::min(MAX_VISIBLE_FILES, static_cast<int>(files.size()) - scrollOffset);
+  int visibleCount = static_cast<int>(files.size());
   if (visibleCount <= 0) {
     return;
   }
@@ -153,7 +213,7 @@ void FileBrowserScreen::render() {
   for (int i = 0; i < visibleCount; ++i) {
     int fileIndex = scrollOffset + i;
     int rowY = startY + i * LINE_HEIGHT;
-    const String& displayName = files[fileIndex].displayName;
+    const String& displayName = files[i].displayName;
 
     textRenderer.getTextBounds(displayName.c_str(), 0, 0, &x1, &y1, &w, &h);
     int16_t centerX = (SCREEN_WIDTH - w) / 2;
@@ -176,6 +236,19 @@ void FileBrowserScreen::render() {
     }
   }
 
+  // Cover of the selected book
+  int selectedRow = selectedIndex - scrollOffset;
+  const FileEntry* selected = selectedRow >= 0 && selectedRow < visibleCount ? &files[selectedRow] : nullptr;
+  if (selected && selected->hasCover) {
+    if (coverBook != selected->path) {
+      coverBook = selected->path;
+      cover.load(CoverThumbnail::pathFor(selected->path.c_str()).c_str());
+    }
+    cover.draw(display, (SCREEN_WIDTH - cover.getWidth()) / 2, COVER_Y, CoverThumbnail::PLANE_BW);
+  } else {
+    coverBook = "";
+  }
+
   // Battery indicator
   textRenderer.setFont(&MenuFontSmall);
   String batteryText = String(g_battery.readPercentage()) + "%";
@@ -184,8 +257,9 @@ void FileBrowserScreen::render() {
   textRenderer.print(batteryText);
 }
 
-void FileBrowserScreen::loadFolder(int maxFiles) {
+void FileBrowserScreen::loadFolder() {
   files.clear();
+  itemCount = 0;
   selectedIndex = 0;
   scrollOffset = 0;
 
@@ -194,62 +268,89 @@ void FileBrowserScreen::loadFolder(int maxFiles) {
     return;
   }
 
-  // Collect supported files
-  for (const auto& name : sdManager.listFiles("/", maxFiles)) {
-    if (isSupportedFile(name)) {
-      files.push_back(createFileEntry(name));
-    }
+  Settings& settings = uiManager.getSettings();
+  int savedSort = 0;
+  settings.getInt(String("filebrowser.sort"), savedSort);
+  sort = savedSort == LibraryIndex::SORT_RECENT ? LibraryIndex::SORT_RECENT : LibraryIndex::SORT_TITLE;
+
+  // Folders without books drop out of the index; fall back to the root then
+  String saved = settings.getString("filebrowser.folder", "/");
+  if (saved != "/" && uiManager.getLibrary().count(saved) == 0) {
+    saved = "/";
   }
+  openFolder(saved, settings.getString("filebrowser.selected", ""));
+}
 
-  // Sort alphabetically by display name
-  std::sort(files.begin(), files.end(), [](const FileEntry& a, const FileEntry& b) {
-    return std::strcmp(a.displayName.c_str(), b.displayName.c_str()) < 0;
-  });
+void FileBrowserScreen::openFolder(const String& path, const String& select) {
+  LibraryIndex& library = uiManager.getLibrary();
+  folder = path;
+  uiManager.getSettings().setString("filebrowser.folder", folder);
+  itemCount = library.count(folder);
+  selectedIndex = 0;
+  scrollOffset = 0;
 
   // Restore saved selection
-  if (!files.empty()) {
-    String saved = uiManager.getSettings().getString("filebrowser.selected", "");
-    for (int i = 0; i < static_cast<int>(files.size()); ++i) {
-      if (files[i].filename == saved) {
-        selectedIndex = i;
-        if (selectedIndex >= MAX_VISIBLE_FILES) {
-          scrollOffset = selectedIndex - MAX_VISIBLE_FILES + 1;
-        }
-        break;
+  if (!select.isEmpty()) {
+    int row = library.rowOf(folder, sort, select);
+    if (row >= 0) {
+      selectedIndex = row;
+      if (selectedIndex >= MAX_VISIBLE_FILES) {
+        scrollOffset = selectedIndex - MAX_VISIBLE_FILES + 1;
       }
     }
   }
+  loadRows();
 }
 
-FileEntry FileBrowserScreen::createFileEntry(const String& filename) const {
-  String name = stripExtension(filename);
-
-  // Truncate with ellipsis
-  if (name.length() > MAX_DISPLAY_NAME_LENGTH) {
-    name = name.substring(0, MAX_DISPLAY_NAME_LENGTH - 3) + "...";
+void FileBrowserScreen::loadRows() {
+  libraryRevision = uiManager.getLibrary().getRevision();
+  rowsLoadedTime = millis();
+  files.clear();
+  std::vector<LibraryIndex::Item> items;
+  uiManager.getLibrary().list(folder, sort, scrollOffset, MAX_VISIBLE_FILES, items);
+  for (const auto& item : items) {
+    files.push_back(createFileEntry(item));
   }
-
-  return {filename, name};
 }
 
-String FileBrowserScreen::stripExtension(const String& filename) const {
-  int dotIndex = filename.lastIndexOf('.');
-  if (dotIndex > 0) {
-    return filename.substring(0, dotIndex);
-  }
-  return filename;
+void FileBrowserScreen::toggleSort() {
+  sort = sort == LibraryIndex::SORT_TITLE ? LibraryIndex::SORT_RECENT : LibraryIndex::SORT_TITLE;
+  uiManager.getSettings().setInt(String("filebrowser.sort"), static_cast<int>(sort));
+  openFolder(folder, "");
 }
 
-bool FileBrowserScreen::isSupportedFile(const String& filename) const {
-  return hasExtension(filename, ".txt") || hasExtension(filename, ".epub");
+void FileBrowserScreen::renderCoverGrayscale() {
+  // The BW screen is already displayed, so the draw buffer can hold the two grayscale planes
+  int x = (SCREEN_WIDTH - cover.getWidth()) / 2;
+  display.clearScreen(0x00);
+  cover.draw(display, x, COVER_Y, CoverThumbnail::PLANE_GRAY_LSB);
+  display.copyGrayscaleLsbBuffers(display.getFrameBuffer());
+  display.clearScreen(0x00);
+  cover.draw(display, x, COVER_Y, CoverThumbnail::PLANE_GRAY_MSB);
+  display.copyGrayscaleMsbBuffers(display.getFrameBuffer());
+  display.displayGrayBuffer();
 }
 
-bool FileBrowserScreen::hasExtension(const String& filename, const char* ext) const {
-  size_t extLen = strlen(ext);
-  if (filename.length() < extLen) {
-    return false;
+FileEntry FileBrowserScreen::createFileEntry(const LibraryIndex::Item& item) const {
+  FileEntry entry;
+  entry.isFolder = item.isFolder;
+  if (item.isFolder) {
+    entry.path = item.folder;
+    entry.displayName = item.folder.substring(item.folder.lastIndexOf('/') + 1) + "/";
+  } else {
+    entry.path = item.book.path;
+    entry.displayName = item.book.title;
+    entry.hasCover = (item.book.flags & LibraryIndex::FLAG_COVER) != 0;
+  }
+
+  // Truncate with ellipsis
+  if (entry.displayName.length() > MAX_DISPLAY_NAME_LENGTH) {
+    entry.displayName = entry.displayName.substring(0, MAX_DISPLAY_NAME_LENGTH - 3) + "...";
+  }
+
+  // Progress of books that have been opened
+  if (!item.isFolder && item.book.opened > 0) {
+    entry.displayName += "  " + String(item.book.permille / 10) + "%";
   }
-  String suffix = filename.substring(filename.length() - extLen);
-  suffix.toLowerCase();
-  return suffix == ext;
+  return entry;
 }
@@ -5,16 +5,22 @@
 
 #include <vector>
 
+#include "../../content/image/CoverThumbnail.h"
+#include "../../content/library/LibraryIndex.h"
 #include "../../core/EInkDisplay.h"
 #include "../../core/SDCardManager.h"
+#include "../../core/Settings.h"
 #include "../../rendering/TextRenderer.h"
 #include "Screen.h"
 
 class UIManager;
 
+// One visible row of the browser
 struct FileEntry {
-  String filename;
+  String path;  // Full SD path of the book or subfolder
   String displayName;
+  bool isFolder = false;
+  bool hasCover = false;
 };
 
 class FileBrowserScreen : public Screen {
@@ -33,20 +39,34 @@ class FileBrowserScreen : public Screen {
 
  private:
   void render();
-  void loadFolder(int maxFiles = 200);
-  FileEntry createFileEntry(const String& filename) const;
-  String stripExtension(const String& filename) const;
-  bool isSupportedFile(const String& filename) const;
-  bool hasExtension(const String& filename, const char* ext) const;
+  void loadFolder();
+  void openFolder(const String& path, const String& select);
+  void loadRows();
+  void toggleSort();
+  void renderCoverGrayscale();
+  FileEntry createFileEntry(const LibraryIndex::Item& item) const;
 
   EInkDisplay& display;
   TextRenderer& textRenderer;
   SDCardManager& sdManager;
   UIManager& uiManager;
 
-  std::vector<FileEntry> files;
+  // Rows come from the library index; only the visible ones are kept
+  String folder = "/";
+  LibraryIndex::Sort sort = LibraryIndex::SORT_TITLE;
+  std::vector<FileEntry> files;  // Rows scrollOffset .. scrollOffset + files.size() - 1
+  int itemCount = 0;
   int selectedIndex = 0;
   int scrollOffset = 0;
+  uint32_t libraryRevision = 0;  // Of the index the rows were loaded from
+  unsigned long rowsLoadedTime = 0;
+
+  // Cover of the selected book, drawn under the list; its grayscale planes follow once the selection settles
+  CoverThumbnail cover;
+  String coverBook;  // Book the loaded cover belongs to
+  bool coverGrayPending = false;
+  unsigned long coverRequestTime = 0;
+  unsigned long antialiasingDelayMs = Settings::DEFAULT_ANTIALIASING_DELAY_MS;
 };
 
 #endif
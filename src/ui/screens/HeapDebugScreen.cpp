@@ -0,0 +1,106 @@
+#include "HeapDebugScreen.h"
+
+#include <resources/fonts/FontManager.h>
+#include <resources/fonts/other/MenuFontSmall.h>
+
+#include <cstdio>
+
+#include "../../core/Buttons.h"
+#include "../../core/HeapTelemetry.h"
+#include "../UIManager.h"
+
+HeapDebugScreen::HeapDebugScreen(EInkDisplay& display, TextRenderer& renderer, UIManager& uiManager)
+    : display(display), textRenderer(renderer), uiManager(uiManager) {}
+
+void HeapDebugScreen::handleButtons(Buttons& buttons) {
+  bool needsUpdate = false;
+  uint8_t btn;
+  while ((btn = buttons.consumeNextPress()) != Buttons::NONE) {
+    switch (btn) {
+      case Buttons::BACK:
+        // Not back to settings: its own BACK would then return here
+        uiManager.showScreen(UIManager::ScreenId::FileBrowser);
+        return;
+      case Buttons::CONFIRM:
+        needsUpdate = true;
+        break;
+      case Buttons::LEFT:
+#ifdef MICROREADER_HEAP_TELEMETRY
+        HeapTelemetry::reset();
+#endif
+        needsUpdate = true;
+        break;
+    }
+  }
+  if (needsUpdate)
+    show();
+}
+
+void HeapDebugScreen::show() {
+  render();
+  display.displayBuffer(EInkDisplay::FAST_REFRESH);
+#ifdef MICROREADER_HEAP_TELEMETRY
+  HeapTelemetry::printReport();
+#endif
+}
+
+void HeapDebugScreen::printLine(int& y, const char* text) {
+  textRenderer.setCursor(MARGIN_X, y);
+  textRenderer.print(text);
+  y += LINE_HEIGHT;
+}
+
+void HeapDebugScreen::render() {
+  display.clearScreen(0xFF);
+  textRenderer.setFrameBuffer(display.getFrameBuffer());
+  textRenderer.setBitmapType(TextRenderer::BITMAP_BW);
+  textRenderer.setTextColor(TextRenderer::COLOR_BLACK);
+
+  textRenderer.setFont(getTitleFont());
+  {
+    const char* title = "Heap";
+    int16_t x1, y1;
+    uint16_t w, h;
+    textRenderer.getTextBounds(title, 0, 0, &x1, &y1, &w, &h);
+    textRenderer.setCursor((DISPLAY_WIDTH - (int)w) / 2, TITLE_Y);
+    textRenderer.print(title);
+  }
+
+  // Fixed small font so the tables fit regardless of the UI font setting
+  textRenderer.setFont(&MenuFontSmall);
+  char line[96];
+  int y = TITLE_Y + 2 * LINE_HEIGHT;
+
+  HeapTelemetry::Sample now = HeapTelemetry::sample();
+  snprintf(line, sizeof(line), "Free %u  min %u", (unsigned)now.freeHeap, (unsigned)now.minFreeHeap);
+  printLine(y, line);
+  snprintf(line, sizeof(line), "Largest block %u", (unsigned)now.largestBlock);
+  printLine(y, line);
+  y += LINE_HEIGHT / 2;
+
+#ifdef MICROREADER_HEAP_TELEMETRY
+  printLine(y, "Checkpoint: count, lowest free, lowest block");
+  for (size_t i = 0; i < HeapTelemetry::checkpointCount(); ++i) {
+    const HeapTelemetry::CheckpointStats& c = HeapTelemetry::checkpointAt(i);
+    snprintf(line, sizeof(line), "%s: %u, %u, %u", c.tag, (unsigned)c.count, (unsigned)c.lowestFree,
+             (unsigned)c.lowestLargestBlock);
+    printLine(y, line);
+  }
+  y += LINE_HEIGHT / 2;
+
+  if (HeapTelemetry::tracking()) {
+    printLine(y, "Subsystem: blocks, live, peak, largest");
+    for (uint8_t i = 0; i < HeapTelemetry::SUBSYSTEM_COUNT; ++i) {
+      HeapTelemetry::Subsystem s = (HeapTelemetry::Subsystem)i;
+      const HeapTelemetry::SubsystemStats& st = HeapTelemetry::subsystemStats(s);
+      snprintf(line, sizeof(line), "%s: %u, %u, %u, %u", HeapTelemetry::subsystemName(s), (unsigned)st.liveBlocks,
+               (unsigned)st.liveBytes, (unsigned)st.peakBytes, (unsigned)st.largestAlloc);
+      printLine(y, line);
+    }
+  } else {
+    printLine(y, "Allocation tracking off (MICROREADER_HEAP_TRACKING)");
+  }
+#else
+  printLine(y, "Checkpoints off (MICROREADER_HEAP_TELEMETRY)");
+#endif
+}
@@ -0,0 +1,37 @@
+#ifndef HEAP_DEBUG_SCREEN_H
+#define HEAP_DEBUG_SCREEN_H
+
+#include "../../core/EInkDisplay.h"
+#include "../../rendering/TextRenderer.h"
+#include "Screen.h"
+
+class Buttons;
+class UIManager;
+
+// Shows the heap telemetry (see core/HeapTelemetry.h): current free heap and
+// largest block, the lowest values seen per checkpoint and, when allocations
+// are tracked, live and peak bytes per subsystem. Opened from the settings
+// screen with VOLUME_UP; CONFIRM refreshes, LEFT resets the history, BACK goes
+// to the file browser.
+class HeapDebugScreen : public Screen {
+ public:
+  HeapDebugScreen(EInkDisplay& display, TextRenderer& renderer, UIManager& uiManager);
+
+  void handleButtons(Buttons& buttons) override;
+  void show() override;
+
+ private:
+  static constexpr int DISPLAY_WIDTH = 480;
+  static constexpr int TITLE_Y = 75;
+  static constexpr int MARGIN_X = 16;
+  static constexpr int LINE_HEIGHT = 22;
+
+  EInkDisplay& display;
+  TextRenderer& textRenderer;
+  UIManager& uiManager;
+
+  void render();
+  void printLine(int& y, const char* text);
+};
+
+#endif
@@ -52,6 +52,12 @@ void SettingsScreen::handleButtons(Buttons& buttons) {
           needsUpdate = true;
         }
         break;
+
+      case Buttons::VOLUME_UP:
+        // Hidden entry to the heap debug screen
+        saveSettings();
+        uiManager.showScreen(UIManager::ScreenId::HeapDebug);
+        return;
     }
   }
 
@@ -228,7 +234,7 @@ void SettingsScreen::toggleCurrentSetting() {
       break;
     case SETTING_FONT_FAMILY:
       fontFamilyIndex++;
-      if (fontFamilyIndex >= FONT_FAMILY_COUNT)
+      if (fontFamilyIndex >= FONT_FAMILY_COUNT + getSdFontFamilyCount())
         fontFamilyIndex = 0;
       applyFontSettings();
       break;
@@ -241,6 +247,11 @@ void SettingsScreen::toggleCurrentSetting() {
     case SETTING_UI_FONT_SIZE:
       uiFontSizeIndex = 1 - uiFontSizeIndex;
       break;
+    case SETTING_ANTIALIASING:
+      antialiasingIndex++;
+      if (antialiasingIndex >= ANTIALIASING_COUNT)
+        antialiasingIndex = 0;
+      break;
   }
 }
 
@@ -281,11 +292,16 @@ void SettingsScreen::loadSettings() {
     showChapterNumbersIndex = showChapters;
   }
 
-  // Load font family (0=NotoSans, 1=Bookerly)
+  // Load font family (0=NotoSans, 1=Bookerly, 2+=SD font stored by name as the SD list may change)
+  scanSdFonts();
   int fontFamily = 1;
   if (s.getInt(String("settings.fontFamily"), fontFamily)) {
     fontFamilyIndex = fontFamily;
   }
+  if (fontFamilyIndex >= FONT_FAMILY_COUNT) {
+    int sdIndex = findSdFontFamily(s.getString(String("settings.sdFontFamily")));
+    fontFamilyIndex = (sdIndex >= 0) ? FONT_FAMILY_COUNT + sdIndex : 1;
+  }
 
   // Load font size (0=Small, 1=Medium, 2=Large)
   int fontSize = 0;
@@ -305,6 +321,12 @@ void SettingsScreen::loadSettings() {
     flipPageButtonsIndex = flipPageButtons;
   }
 
+  // Load antialiasing mode (0=On, 1=Adaptive, 2=Off)
+  int antialiasing = 0;
+  if (s.getInt(String("settings.antialiasing"), antialiasing)) {
+    antialiasingIndex = antialiasing;
+  }
+
   // Apply the loaded font settings
   applyFontSettings();
 }
@@ -317,9 +339,13 @@ void SettingsScreen::saveSettings() {
   s.setInt(String("settings.alignment"), alignmentIndex);
   s.setInt(String("settings.showChapterNumbers"), showChapterNumbersIndex);
   s.setInt(String("settings.fontFamily"), fontFamilyIndex);
+  if (fontFamilyIndex >= FONT_FAMILY_COUNT) {
+    s.setString(String("settings.sdFontFamily"), getSdFontFamilyName(fontFamilyIndex - FONT_FAMILY_COUNT));
+  }
   s.setInt(String("settings.fontSize"), fontSizeIndex);
   s.setInt(String("settings.uiFontSize"), uiFontSizeIndex);
   s.setInt(String("settings.flipPageButtons"), flipPageButtonsIndex);
+  s.setInt(String("settings.antialiasing"), antialiasingIndex);
 
   if (!s.save()) {
     Serial.println("SettingsScreen: Failed to write settings.cfg");
@@ -344,6 +370,8 @@ String SettingsScreen::getSettingName(int index) {
       return "Font Size";
     case SETTING_UI_FONT_SIZE:
       return "UI Font Size";
+    case SETTING_ANTIALIASING:
+      return "Antialiasing";
     default:
       return "";
   }
@@ -377,6 +405,8 @@ String SettingsScreen::getSettingValue(int index) {
         case 1:
           return "Bookerly";
         default:
+          if (fontFamilyIndex >= FONT_FAMILY_COUNT)
+            return getSdFontFamilyName(fontFamilyIndex - FONT_FAMILY_COUNT);
           return "Unknown";
       }
     case SETTING_FONT_SIZE:
@@ -392,6 +422,17 @@ String SettingsScreen::getSettingValue(int index) {
       }
     case SETTING_UI_FONT_SIZE:
       return uiFontSizeIndex ? "Large" : "Small";
+    case SETTING_ANTIALIASING:
+      switch (antialiasingIndex) {
+        case 0:
+          return "On";
+        case 1:
+          return "Adaptive";
+        case 2:
+          return "Off";
+        default:
+          return "Unknown";
+      }
     default:
       return "";
   }
@@ -425,6 +466,14 @@ void SettingsScreen::applyFontSettings() {
         targetFamily = &bookerly30Family;
         break;
     }
+  } else {  // Font family loaded from SD
+    targetFamily = loadSdFontFamily(fontFamilyIndex - FONT_FAMILY_COUNT, fontSizeIndex);
+    if (!targetFamily) {
+      Serial.println("SettingsScreen: Failed to load SD font, falling back to Bookerly");
+      fontFamilyIndex = 1;
+      applyFontSettings();
+      return;
+    }
   }
 
   if (targetFamily) {
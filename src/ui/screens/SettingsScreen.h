@@ -2,6 +2,7 @@
 #define SETTINGSSCREEN_H
 
 #include "../../core/EInkDisplay.h"
+#include "../../core/Settings.h"
 #include "../../rendering/TextRenderer.h"
 #include "Screen.h"
 
@@ -28,7 +29,8 @@ class SettingsScreen : public Screen {
     SETTING_PAGE_BUTTONS = 4,
     SETTING_FONT_FAMILY = 5,
     SETTING_FONT_SIZE = 6,
-    SETTING_UI_FONT_SIZE = 7
+    SETTING_UI_FONT_SIZE = 7,
+    SETTING_ANTIALIASING = 8
   };
 
   // Display and layout constants
@@ -39,9 +41,10 @@ class SettingsScreen : public Screen {
 
   // Setting limits
   static constexpr int ALIGNMENT_COUNT = 3;
-  static constexpr int FONT_FAMILY_COUNT = 2;
+  static constexpr int FONT_FAMILY_COUNT = 2;  // Built-in families; fonts found on SD follow them
   static constexpr int FONT_SIZE_COUNT = 3;
   static constexpr int TOGGLE_COUNT = 2;
+  static constexpr int ANTIALIASING_COUNT = Settings::AA_OFF + 1;
 
   // Default values
   static constexpr int DEFAULT_MARGIN = 10;
@@ -69,11 +72,12 @@ class SettingsScreen : public Screen {
       {ITEM_SPACER,  0                      },
       {ITEM_SETTING, SETTING_CHAPTER_NUMBERS},
       {ITEM_SETTING, SETTING_PAGE_BUTTONS   },
+      {ITEM_SETTING, SETTING_ANTIALIASING   },
       {ITEM_SPACER,  0                      },
       {ITEM_SETTING, SETTING_UI_FONT_SIZE   },
   };
-  static constexpr int MENU_ITEM_COUNT = 11;
-  static constexpr int SETTINGS_COUNT = 8;
+  static constexpr int MENU_ITEM_COUNT = 12;
+  static constexpr int SETTINGS_COUNT = 9;
 
   // Menu navigation
   int selectedIndex = 0;
@@ -83,10 +87,11 @@ class SettingsScreen : public Screen {
   int lineHeightIndex = 1;
   int alignmentIndex = 0;
   int showChapterNumbersIndex = 0;
-  int fontFamilyIndex = 1;       // 0=NotoSans, 1=Bookerly
+  int fontFamilyIndex = 1;       // 0=NotoSans, 1=Bookerly, 2+=SD font families
   int fontSizeIndex = 0;         // 0=Small(26), 1=Medium(28), 2=Large(30)
   int uiFontSizeIndex = 0;       // 0=Small(14), 1=Large(28)
   int flipPageButtonsIndex = 0;  // 0=Normal (LEFT=next), 1=Flipped (RIGHT=next)
+  int antialiasingIndex = 0;     // 0=On, 1=Adaptive (deferred until idle), 2=Off
 
   // Available values for each setting
   static constexpr int marginValues[] = {5, 10, 15, 20, 25, 30};
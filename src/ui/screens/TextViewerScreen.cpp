@@ -5,19 +5,67 @@
 #include <resources/fonts/FontManager.h>
 #include <resources/fonts/other/MenuFontSmall.h>
 
+#include <algorithm>
 #include <cstring>
 
+#include "../../content/library/LibraryIndex.h"
 #include "../../content/providers/EpubWordProvider.h"
 #include "../../content/providers/FileWordProvider.h"
 #include "../../content/providers/StringWordProvider.h"
+#include "../../content/search/TextSearch.h"
 #include "../../core/Buttons.h"
+#include "../../core/JournalStore.h"
+#include "../../core/PrefetchPolicy.h"
 #include "../../core/SDCardManager.h"
 #include "../../core/Settings.h"
+#include "../../core/Trace.h"
 #include "../../text/hyphenation/HyphenationStrategy.h"
 #include "../../text/layout/GreedyLayoutStrategy.h"
 #include "../../text/layout/KnuthPlassLayoutStrategy.h"
 #include "SettingsScreen.h"
 
+// Lays out the page the reader is expected to turn to
+class TextViewerScreen::PageJob : public Job {
+ public:
+  PageJob(TextViewerScreen& screen, int direction) : screen_(screen), direction_(direction) {}
+
+  bool step(uint32_t) override {
+    screen_.prefetchPage(direction_);
+    return false;
+  }
+  const char* name() const override {
+    return "prefetchPage";
+  }
+
+ private:
+  TextViewerScreen& screen_;
+  int direction_;
+};
+
+// Converts chapters into the chapter text cache, one per step
+class TextViewerScreen::ChapterJob : public Job {
+ public:
+  ChapterJob(TextViewerScreen& screen, const std::vector<int>& chapters) : screen_(screen), chapters_(chapters) {}
+
+  bool step(uint32_t) override {
+    int chapter = chapters_[next_++];
+    EpubWordProvider* epub = screen_.currentEpub();
+    if (epub && !epub->getChapterTextPath(chapter).isEmpty()) {
+      screen_.prefetchedChapters.push_back(chapter);
+      screen_.uiManager.getPrefetchPolicy().recordIssued(PrefetchPolicy::KIND_CHAPTER);
+    }
+    return epub && next_ < chapters_.size();
+  }
+  const char* name() const override {
+    return "prefetchChapter";
+  }
+
+ private:
+  TextViewerScreen& screen_;
+  std::vector<int> chapters_;
+  size_t next_ = 0;
+};
+
 TextViewerScreen::TextViewerScreen(EInkDisplay& display, TextRenderer& renderer, SDCardManager& sdManager,
                                    UIManager& uiManager)
     : display(display),
@@ -110,6 +158,9 @@ void TextViewerScreen::loadSettingsFromFile() {
   if (s.getInt(String("settings.flipPageButtons"), flipPageButtonsInt)) {
     flipPageButtons = (flipPageButtonsInt != 0);
   }
+
+  antialiasingMode = s.getAntialiasingMode();
+  antialiasingDelayMs = s.getAntialiasingDelayMs();
 }
 
 void TextViewerScreen::saveSettingsToFile() {
@@ -123,6 +174,11 @@ void TextViewerScreen::saveSettingsToFile() {
   }
 }
 
+void TextViewerScreen::deactivate() {
+  // The layout config may change before the reader is back
+  dropPrefetch(false);
+}
+
 void TextViewerScreen::activate() {
   pageStartIndex = 0;
   // If a file was pending to open from settings, open it now (first time the
@@ -144,18 +200,53 @@ void TextViewerScreen::handleButtons(Buttons& buttons) {
 
   // Check for long press first (chapter jump) - before consuming queued presses
   const unsigned long LONG_PRESS_MS = 500;
+  if (confirmHeld) {
+    // Settings open when CONFIRM comes back up; holding it searches instead
+    if (!buttons.isDown(Buttons::CONFIRM)) {
+      confirmHeld = false;
+      buttons.clearQueuedPresses();
+      uiManager.showScreen(UIManager::ScreenId::Settings);
+    } else if (buttons.getHoldDuration(Buttons::CONFIRM) >= LONG_PRESS_MS) {
+      confirmHeld = false;
+      buttons.clearQueuedPresses();
+      findNext();
+    }
+    return;
+  }
+  if (backHeld) {
+    if (!buttons.isDown(Buttons::BACK)) {
+      backHeld = false;
+      buttons.clearQueuedPresses();
+      savePositionToFile();
+      saveSettingsToFile();
+      uiManager.showScreen(UIManager::ScreenId::FileBrowser);
+    } else if (buttons.getHoldDuration(Buttons::BACK) >= LONG_PRESS_MS) {
+      backHeld = false;
+      buttons.clearQueuedPresses();
+      toggleBookmark();
+    }
+    return;
+  }
+  // The side buttons jump by chapter (TOC entry), the volume rocker by a tenth of the book
+  const float PERCENTAGE_STEP = 0.1f;
   if (buttons.isDown(nextBtn1) || buttons.isDown(nextBtn2)) {
     uint8_t btn = buttons.isDown(nextBtn1) ? nextBtn1 : nextBtn2;
     if (buttons.getHoldDuration(btn) >= LONG_PRESS_MS) {
       buttons.clearQueuedPresses();
-      jumpToNextChapter();
+      if (btn == nextBtn2 && provider)
+        jumpToPercentage(provider->getPercentage(pageStartIndex) + PERCENTAGE_STEP);
+      else
+        jumpToNextChapter();
       return;
     }
   } else if (buttons.isDown(prevBtn1) || buttons.isDown(prevBtn2)) {
     uint8_t btn = buttons.isDown(prevBtn1) ? prevBtn1 : prevBtn2;
     if (buttons.getHoldDuration(btn) >= LONG_PRESS_MS) {
       buttons.clearQueuedPresses();
-      jumpToPreviousChapter();
+      if (btn == prevBtn2 && provider)
+        jumpToPercentage(provider->getPercentage(pageStartIndex) - PERCENTAGE_STEP);
+      else
+        jumpToPreviousChapter();
       return;
     }
   }
@@ -168,13 +259,24 @@ void TextViewerScreen::handleButtons(Buttons& buttons) {
 
   uint8_t btn;
   while ((btn = buttons.consumeNextPress()) != Buttons::NONE) {
+    // Any input means the user is still active; push back a deferred grayscale pass
+    grayscaleRequestTime = millis();
+
     switch (btn) {
       case Buttons::BACK:
-        shouldGoBack = true;
+        // Still down: wait for the release or a long press
+        if (buttons.isDown(Buttons::BACK))
+          backHeld = true;
+        else
+          shouldGoBack = true;
         break;
 
       case Buttons::CONFIRM:
-        shouldOpenSettings = true;
+        // Still down: wait for the release or a long press
+        if (buttons.isDown(Buttons::CONFIRM))
+          confirmHeld = true;
+        else
+          shouldOpenSettings = true;
         break;
 
       default:
@@ -196,6 +298,9 @@ void TextViewerScreen::handleButtons(Buttons& buttons) {
     return;
   }
 
+  if (confirmHeld || backHeld)
+    return;
+
   if (shouldOpenSettings) {
     uiManager.showScreen(UIManager::ScreenId::Settings);
     return;
@@ -204,8 +309,21 @@ void TextViewerScreen::handleButtons(Buttons& buttons) {
   // Page navigation - next takes priority over prev if both pressed
   if (shouldNextPage) {
     nextPage();
+    return;
   } else if (shouldPrevPage) {
     prevPage();
+    return;
+  }
+
+  // Adaptive antialiasing: run the deferred grayscale pass once the user has
+  // stayed on this page long enough and no button is being held
+  if (grayscalePending && millis() - grayscaleRequestTime >= antialiasingDelayMs) {
+    for (uint8_t i = Buttons::BACK; i <= Buttons::POWER; i++) {
+      if (buttons.isDown(i))
+        return;
+    }
+    grayscalePending = false;
+    renderGrayscalePass(&buttons);
   }
 }
 
@@ -216,6 +334,10 @@ void TextViewerScreen::show() {
 void TextViewerScreen::showPage() {
   Serial.println("showPage start");
 
+  // A new page replaces whatever grayscale pass was still pending for the old one
+  grayscalePending = false;
+  currentLayout.lines.clear();
+
   // Apply current settings from memory to layout config
   loadSettingsFromFile();
 
@@ -249,29 +371,26 @@ void TextViewerScreen::showPage() {
   Serial.print("Page start: ");
   Serial.println(provider->getCurrentIndex());
 
-  unsigned long layoutStart = millis();
-  LayoutStrategy::PageLayout layout = layoutStrategy->layoutText(*provider, textRenderer, layoutConfig);
-  unsigned long layoutEnd = millis();
-
-  Serial.print("Layout time: ");
-  Serial.print(layoutEnd - layoutStart);
-  Serial.println(" ms");
+  LayoutStrategy::PageLayout layout;
+  if (!takePrefetchedPage(layout))
+    layout = layoutStrategy->layoutText(*provider, textRenderer, layoutConfig);
 
   pageStartIndex = provider->getCurrentIndex();
   pageEndIndex = layout.endPosition;
-
-  unsigned long renderStart = millis();
+  bool bookmarked = markAnnotations(layout);
 
   // Render to BW buffer
   textRenderer.setFrameBuffer(display.getFrameBuffer());
   textRenderer.setBitmapType(TextRenderer::BITMAP_BW);
   layoutStrategy->renderPage(layout, textRenderer, layoutConfig);
 
-  unsigned long renderEnd = millis();
-
-  Serial.print("Render time: ");
-  Serial.print(renderEnd - renderStart);
-  Serial.println(" ms");
+  // Bookmarked page: a folded corner at the top right (the panel is portrait, so its height is the page width)
+  if (bookmarked) {
+    const int16_t CORNER = 24;
+    const int16_t right = EInkDisplay::DISPLAY_HEIGHT;
+    for (int16_t i = 0; i < CORNER; i++)
+      textRenderer.fillRect(right - CORNER + i, 0, 1, i + 1, true);
+  }
 
   Serial.print("Page end: ");
   Serial.println(pageEndIndex);
@@ -331,34 +450,227 @@ void TextViewerScreen::showPage() {
   // display bw parts
   display.displayBuffer(EInkDisplay::FAST_REFRESH);
 
+  currentLayout = std::move(layout);
+
+  // Queued now, the jobs can run while the grayscale pass refreshes
+  schedulePrefetch();
+
   // grayscale rendering
-  {
-    textRenderer.setTextColor(TextRenderer::COLOR_BLACK);
-    textRenderer.setFontFamily(getCurrentFontFamily());
-    textRenderer.setFontStyle(FontStyle::REGULAR);
+  switch (antialiasingMode) {
+    case Settings::AA_ALWAYS:
+      renderGrayscalePass();
+      break;
+    case Settings::AA_ADAPTIVE:
+      // Defer until the user stays on this page; handleButtons() runs it when idle
+      grayscalePending = true;
+      grayscaleRequestTime = millis();
+      break;
+    case Settings::AA_OFF:
+      break;
+  }
+}
 
-    // Render and copy to LSB buffer
-    display.clearScreen(0x00);
-    textRenderer.setFrameBuffer(display.getFrameBuffer());
-    textRenderer.setBitmapType(TextRenderer::BITMAP_GRAY_LSB);
-    layoutStrategy->renderPage(layout, textRenderer, layoutConfig);
-    display.copyGrayscaleLsbBuffers(display.getFrameBuffer());
+bool TextViewerScreen::renderGrayscalePass(Buttons* buttons) {
+  // The BW page is already on screen (and kept in the display's active buffer),
+  // so the draw buffer can be reused for the two grayscale planes.
+  textRenderer.setTextColor(TextRenderer::COLOR_BLACK);
+  textRenderer.setFontFamily(getCurrentFontFamily());
+  textRenderer.setFontStyle(FontStyle::REGULAR);
 
-    // Render and copy to MSB buffer
-    display.clearScreen(0x00);
-    textRenderer.setFrameBuffer(display.getFrameBuffer());
-    textRenderer.setBitmapType(TextRenderer::BITMAP_GRAY_MSB);
-    layoutStrategy->renderPage(layout, textRenderer, layoutConfig);
-    display.copyGrayscaleMsbBuffers(display.getFrameBuffer());
+  // Render and copy to LSB buffer
+  display.clearScreen(0x00);
+  textRenderer.setFrameBuffer(display.getFrameBuffer());
+  textRenderer.setBitmapType(TextRenderer::BITMAP_GRAY_LSB);
+  layoutStrategy->renderPage(currentLayout, textRenderer, layoutConfig);
+  if (buttons && buttons->hasQueuedPresses())
+    return false;
+  display.copyGrayscaleLsbBuffers(display.getFrameBuffer());
+
+  // Render and copy to MSB buffer
+  display.clearScreen(0x00);
+  textRenderer.setFrameBuffer(display.getFrameBuffer());
+  textRenderer.setBitmapType(TextRenderer::BITMAP_GRAY_MSB);
+  layoutStrategy->renderPage(currentLayout, textRenderer, layoutConfig);
+  if (buttons && buttons->hasQueuedPresses())
+    return false;
+  display.copyGrayscaleMsbBuffers(display.getFrameBuffer());
+
+  // display grayscale part
+  display.displayGrayBuffer();
+  return true;
+}
+
+bool TextViewerScreen::markAnnotations(LayoutStrategy::PageLayout& layout) {
+  std::vector<Annotation> found;
+  annotations.query(provider->getCurrentChapter(), pageStartIndex, pageEndIndex, found);
+  bool bookmarked = false;
+  std::vector<Annotation> ranges;
+  for (const Annotation& a : found) {
+    if (a.type == AnnotationStore::BOOKMARK)
+      bookmarked = true;
+    else
+      ranges.push_back(a);
+  }
+  if (ranges.empty())
+    return bookmarked;
+
+  // Words and ranges both run in position order, so one pass marks them all
+  size_t next = 0;
+  for (auto& line : layout.lines) {
+    for (auto& word : line.words) {
+      if (word.start < 0)
+        continue;
+      while (next < ranges.size() && ranges[next].end <= (uint32_t)word.start)
+        next++;
+      for (size_t i = next; i < ranges.size() && ranges[i].start < (uint32_t)word.end; i++) {
+        if (ranges[i].end > (uint32_t)word.start) {
+          word.mark = ranges[i].type == AnnotationStore::UNDERLINE ? LayoutStrategy::MARK_UNDERLINE
+                                                                   : LayoutStrategy::MARK_INVERT;
+          break;
+        }
+      }
+    }
+  }
+  return bookmarked;
+}
+
+void TextViewerScreen::toggleBookmark() {
+  if (!provider)
+    return;
+  bool bookmarked = false;
+  if (annotations.toggleBookmark(provider->getCurrentChapter(), pageStartIndex, pageEndIndex, bookmarked))
+    Serial.printf("Bookmark %s at %d:%d\n", bookmarked ? "added" : "removed", provider->getCurrentChapter(),
+                  pageStartIndex);
+  else
+    Serial.printf("Bookmark at %d:%d could not be %s\n", provider->getCurrentChapter(), pageStartIndex,
+                  bookmarked ? "removed" : "added");
+  provider->setPosition(pageStartIndex);
+  showPage();
+}
+
+bool TextViewerScreen::takePrefetchedPage(LayoutStrategy::PageLayout& layout) {
+  if (!prefetchedPage.valid)
+    return false;
+  int position = provider->getCurrentIndex();
+  bool sameChapter = prefetchedPage.chapter == provider->getCurrentChapter();
+  if (!sameChapter || prefetchedPage.start != position) {
+    // The same page shown again (a bookmark toggled) still leads to the prefetched one
+    if (!sameChapter || prefetchedPage.from != position) {
+      prefetchedPage.valid = false;
+      prefetchedPage.layout.lines.clear();
+      uiManager.getPrefetchPolicy().recordWasted(PrefetchPolicy::KIND_PAGE);
+    }
+    return false;
+  }
+  layout = std::move(prefetchedPage.layout);
+  prefetchedPage.valid = false;
+  uiManager.getPrefetchPolicy().recordUsed(PrefetchPolicy::KIND_PAGE);
+  return true;
+}
+
+void TextViewerScreen::schedulePrefetch() {
+  Scheduler& scheduler = uiManager.getScheduler();
+  PrefetchPolicy& policy = uiManager.getPrefetchPolicy();
+  scheduler.cancel(pageJob);
+  scheduler.cancel(chapterJob);
+  pageJob = Scheduler::NO_JOB;
+  chapterJob = Scheduler::NO_JOB;
+
+  int chapter = provider->getCurrentChapter();
+  auto entered = std::find(prefetchedChapters.begin(), prefetchedChapters.end(), chapter);
+  if (entered != prefetchedChapters.end()) {
+    prefetchedChapters.erase(entered);
+    policy.recordUsed(PrefetchPolicy::KIND_CHAPTER);
+  }
 
-    // display grayscale part
-    display.displayGrayBuffer();
+  // Pages between this one and the chapter end in the reading direction, judged by this page's share
+  int direction = policy.getDirection();
+  float startShare = provider->getChapterPercentage(pageStartIndex);
+  float endShare = provider->getChapterPercentage(pageEndIndex);
+  float left = direction > 0 ? 1.0f - endShare : startShare;
+  float pagesLeft = endShare > startShare ? left / (endShare - startShare) : 0.0f;
+  PrefetchPolicy::Plan plan = policy.plan(pagesLeft);
+
+  if (plan.layoutPage)
+    pageJob = scheduler.add(new PageJob(*this, plan.direction), Scheduler::PRIORITY_NORMAL);
+
+  if (plan.chaptersAhead > 0 && currentEpub()) {
+    std::vector<int> chapters;
+    for (int i = 1; i <= plan.chaptersAhead; i++) {
+      int next = chapter + i * plan.direction;
+      if (next < 0 || next >= provider->getChapterCount())
+        break;
+      if (std::find(prefetchedChapters.begin(), prefetchedChapters.end(), next) == prefetchedChapters.end())
+        chapters.push_back(next);
+    }
+    if (!chapters.empty())
+      chapterJob = scheduler.add(new ChapterJob(*this, chapters), Scheduler::PRIORITY_LOW);
+  }
+}
+
+void TextViewerScreen::prefetchPage(int direction) {
+  if (!provider)
+    return;
+  int chapter = provider->getCurrentChapter();
+  if (prefetchedPage.valid && prefetchedPage.chapter == chapter && prefetchedPage.from == pageStartIndex &&
+      (prefetchedPage.start > pageStartIndex) == (direction > 0))
+    return;
+
+  // A page in another chapter is left to the chapter prefetch
+  int saved = provider->getCurrentIndex();
+  int start = pageEndIndex;
+  textRenderer.setFontFamily(getCurrentFontFamily());
+  textRenderer.setFontStyle(FontStyle::REGULAR);
+  if (direction > 0) {
+    if (pageEndIndex <= pageStartIndex || provider->getChapterPercentage(pageEndIndex) >= 1.0f)
+      return;
+  } else {
+    provider->setPosition(pageStartIndex);
+    if (!provider->hasPrevWord()) {
+      provider->setPosition(saved);
+      return;
+    }
+    start = layoutStrategy->getPreviousPageStart(*provider, textRenderer, layoutConfig, pageStartIndex);
+  }
+  provider->setPosition(start);
+  LayoutStrategy::PageLayout layout = layoutStrategy->layoutText(*provider, textRenderer, layoutConfig);
+  provider->setPosition(saved);
+
+  PrefetchPolicy& policy = uiManager.getPrefetchPolicy();
+  if (prefetchedPage.valid)
+    policy.recordWasted(PrefetchPolicy::KIND_PAGE);
+  prefetchedPage.valid = true;
+  prefetchedPage.chapter = chapter;
+  prefetchedPage.from = pageStartIndex;
+  prefetchedPage.start = start;
+  prefetchedPage.layout = std::move(layout);
+  policy.recordIssued(PrefetchPolicy::KIND_PAGE);
+}
+
+void TextViewerScreen::dropPrefetch(bool closingBook) {
+  Scheduler& scheduler = uiManager.getScheduler();
+  PrefetchPolicy& policy = uiManager.getPrefetchPolicy();
+  scheduler.cancel(pageJob);
+  scheduler.cancel(chapterJob);
+  pageJob = Scheduler::NO_JOB;
+  chapterJob = Scheduler::NO_JOB;
+  if (prefetchedPage.valid) {
+    prefetchedPage.valid = false;
+    prefetchedPage.layout.lines.clear();
+    policy.recordWasted(PrefetchPolicy::KIND_PAGE);
+  }
+  if (closingBook) {
+    for (size_t i = 0; i < prefetchedChapters.size(); i++)
+      policy.recordWasted(PrefetchPolicy::KIND_CHAPTER);
+    prefetchedChapters.clear();
+    policy.noteJump();
   }
 }
 
 void TextViewerScreen::nextPage() {
   if (!provider)
     return;
+  uiManager.getPrefetchPolicy().notePageTurn(1, millis());
 
   // Check if there are more words in current chapter (use chapter percentage, not book percentage)
   if (provider->getChapterPercentage(pageEndIndex) < 1.0f) {
@@ -382,6 +694,7 @@ void TextViewerScreen::nextPage() {
 void TextViewerScreen::prevPage() {
   if (!provider)
     return;
+  uiManager.getPrefetchPolicy().notePageTurn(-1, millis());
 
   // If at the beginning of current chapter, try to go to previous chapter
   if (!provider->hasPrevWord()) {
@@ -404,8 +717,13 @@ void TextViewerScreen::prevPage() {
 
   textRenderer.setFontFamily(getCurrentFontFamily());
 
-  // Find where the previous page starts
-  pageStartIndex = layoutStrategy->getPreviousPageStart(*provider, textRenderer, layoutConfig, pageStartIndex);
+  // Find where the previous page starts, unless it was laid out ahead
+  const PrefetchedPage& ahead = prefetchedPage;
+  if (ahead.valid && ahead.chapter == provider->getCurrentChapter() && ahead.from == pageStartIndex &&
+      ahead.start < pageStartIndex)
+    pageStartIndex = ahead.start;
+  else
+    pageStartIndex = layoutStrategy->getPreviousPageStart(*provider, textRenderer, layoutConfig, pageStartIndex);
 
   // Set currentIndex to the start of the previous page
   provider->setPosition(pageStartIndex);
@@ -417,6 +735,9 @@ void TextViewerScreen::prevPage() {
 void TextViewerScreen::jumpToNextChapter() {
   if (!provider)
     return;
+  uiManager.getPrefetchPolicy().noteJump();
+  if (stepTocEntry(true))
+    return;
 
   if (provider->hasChapters()) {
     int currentChapter = provider->getCurrentChapter();
@@ -448,6 +769,9 @@ void TextViewerScreen::jumpToNextChapter() {
 void TextViewerScreen::jumpToPreviousChapter() {
   if (!provider)
     return;
+  uiManager.getPrefetchPolicy().noteJump();
+  if (stepTocEntry(false))
+    return;
 
   // If not at start, go to start first
   if (provider->hasPrevWord()) {
@@ -469,10 +793,149 @@ void TextViewerScreen::jumpToPreviousChapter() {
   // If no chapters and at start, already at beginning - do nothing
 }
 
+void TextViewerScreen::jumpTo(int chapter, int position) {
+  if (!provider)
+    return;
+  uiManager.getPrefetchPolicy().noteJump();
+
+  if (provider->hasChapters() && chapter != provider->getCurrentChapter())
+    provider->setChapter(chapter);
+  provider->setPosition(position);
+  if (!provider->hasNextWord() && provider->hasPrevWord()) {
+    // Past the last word: show the last page instead of an empty one
+    pageStartIndex = layoutStrategy->getPreviousPageStart(*provider, textRenderer, layoutConfig,
+                                                          provider->getCurrentIndex());
+    provider->setPosition(pageStartIndex);
+    showPage();
+    return;
+  }
+  // Start the page with the whole word, not in the middle of it
+  while (position > 0 && provider->isInsideWord())
+    provider->setPosition(--position);
+  pageStartIndex = provider->getCurrentIndex();
+  pageEndIndex = 0;
+  showPage();
+}
+
+void TextViewerScreen::jumpToPercentage(float percentage) {
+  if (!provider)
+    return;
+  if (percentage < 0.0f)
+    percentage = 0.0f;
+  if (percentage > 1.0f)
+    percentage = 1.0f;
+
+  int chapter = 0;
+  int position = 0;
+  EpubWordProvider* epub = currentEpub();
+  if (epub) {
+    if (!epub->locatePercentage(percentage, chapter, position))
+      return;
+  } else {
+    // Single file: the percentage is a share of its length
+    provider->setPosition(0x7FFFFFFF);
+    position = (int)(percentage * provider->getCurrentIndex());
+  }
+  jumpTo(chapter, position);
+}
+
+bool TextViewerScreen::jumpToTocEntry(int tocIndex) {
+  EpubWordProvider* epub = currentEpub();
+  int chapter;
+  int position;
+  if (!epub || !epub->locateTocEntry(tocIndex, chapter, position))
+    return false;
+  jumpTo(chapter, position);
+  return true;
+}
+
+EpubWordProvider* TextViewerScreen::currentEpub() {
+  if (!provider || currentFilePath.length() == 0)
+    return nullptr;
+  String lowerPath = currentFilePath;
+  lowerPath.toLowerCase();
+  return lowerPath.endsWith(".epub") ? static_cast<EpubWordProvider*>(provider) : nullptr;
+}
+
+bool TextViewerScreen::stepTocEntry(bool forward) {
+  EpubWordProvider* epub = currentEpub();
+  if (!epub || !epub->getEpubReader() || epub->getEpubReader()->getTocCount() == 0)
+    return false;
+
+  int chapter = provider->getCurrentChapter();
+  if (forward) {
+    // The first entry that starts after this page
+    int tocCount = epub->getEpubReader()->getTocCount();
+    for (int i = epub->findTocEntryBefore(chapter, pageEndIndex) + 1; i < tocCount; i++) {
+      if (jumpToTocEntry(i))
+        return true;
+    }
+  } else {
+    // The start of the section this page is in, or the one before when the page begins a section
+    for (int i = epub->findTocEntryBefore(chapter, pageStartIndex); i >= 0; i--) {
+      if (jumpToTocEntry(i))
+        return true;
+    }
+  }
+  return false;
+}
+
+void TextViewerScreen::findNext() {
+  if (!provider || currentFilePath.length() == 0)
+    return;
+
+  // There is no on-screen keyboard: the query comes from settings.cfg, '|' separating alternatives
+  String query = uiManager.getSettings().getString(String("search.query"), String(""));
+  TextSearch search;
+  int start = 0;
+  while (start < (int)query.length()) {
+    int bar = query.indexOf('|', start);
+    if (bar < 0)
+      bar = query.length();
+    String pattern = query.substring(start, bar);
+    if (pattern.length() > 0 && !search.addPattern(pattern.c_str()))
+      Serial.printf("TextViewerScreen: search pattern '%s' skipped (empty or too long)\n", pattern.c_str());
+    start = bar + 1;
+  }
+  if (search.getPatternCount() == 0) {
+    Serial.println("TextViewerScreen: set search.query in settings.cfg to search");
+    return;
+  }
+
+  // EPUB chapters are searched in their converted text (converting as needed); other files as they are, and
+  // without trigram filters next to them
+  EpubWordProvider* epub = currentEpub();
+  search.setUseFilter(epub != nullptr);
+  int chapterCount = provider->hasChapters() ? provider->getChapterCount() : 1;
+  int current = provider->hasChapters() ? provider->getCurrentChapter() : 0;
+
+  unsigned long startTime = millis();
+  std::vector<SearchHit> hits;
+  // The current chapter after the page start, the chapters after it, then around from the first one
+  for (int i = 0; i <= chapterCount && hits.empty(); i++) {
+    int chapter = (current + i) % chapterCount;
+    String path = epub ? epub->getChapterTextPath(chapter) : currentFilePath;
+    if (path.length() == 0)
+      continue;
+    search.searchFile(path.c_str(), chapter, i == 0 ? (uint32_t)pageStartIndex + 1 : 0, hits, 1);
+  }
+  Serial.printf("TextViewerScreen: search for '%s' took %lu ms\n", query.c_str(), millis() - startTime);
+
+  if (hits.empty()) {
+    // Chapter conversion may have borrowed the frame buffer; put the page back
+    Serial.printf("TextViewerScreen: '%s' not found\n", query.c_str());
+    provider->setPosition(pageStartIndex);
+    showPage();
+    return;
+  }
+  jumpTo(hits[0].chapter, (int)hits[0].offset);
+}
+
 void TextViewerScreen::loadTextFromString(const String& content) {
   // Create provider for the entire content
   // Preserve the passed-in content on the object so the provider has
   // stable storage for its internal copy/operations.
+  dropPrefetch(true);
   delete provider;
   loadedText = content;
   if (loadedText.length() > 0) {
@@ -485,11 +948,11 @@ void TextViewerScreen::loadTextFromString(const String& content) {
   pageEndIndex = 0;
   // Clear any associated file path when loading from memory
   currentFilePath = String("");
+  annotations.close();
 }
 
 void TextViewerScreen::openFile(const String& sdPath) {
-  // measure time taken to open file
-  unsigned long startTime = millis();
+  TRACE_SCOPE(OPEN_FILE, 0);
 
   if (!sdManager.ready()) {
     Serial.println("TextViewerScreen: SD not ready; cannot open file.");
@@ -498,9 +961,11 @@ void TextViewerScreen::openFile(const String& sdPath) {
   }
 
   // Use a buffered file-backed provider to avoid allocating the entire file in RAM.
+  dropPrefetch(true);
   delete provider;
   provider = nullptr;
   currentFilePath = sdPath;
+  annotations.open(sdPath);
 
   // Load the saved position from SD if present
   loadPositionFromFile();
@@ -553,7 +1018,6 @@ void TextViewerScreen::openFile(const String& sdPath) {
   }
 
   // Set chapter first (if provider supports it), then position within chapter
-  unsigned long provStart = millis();
   if (provider->hasChapters() && currentChapter > 0) {
     Serial.printf("Setting chapter to %d\n", currentChapter);
     provider->setChapter(currentChapter);
@@ -563,33 +1027,42 @@ void TextViewerScreen::openFile(const String& sdPath) {
     provider->setChapter(0);
   }
   provider->setPosition(pageStartIndex);
-  unsigned long provMs = millis() - provStart;
-  Serial.printf("  Provider setup took  %lu ms\n", provMs);
-
-  unsigned long endTime = millis();
-  Serial.printf("Opened file  %s  in  %lu ms\n", sdPath.c_str(), endTime - startTime);
 }
 
 void TextViewerScreen::savePositionToFile() {
   if (currentFilePath.length() == 0 || !provider)
     return;
-  // Build pos file name by appending ".pos" to path
-  String posPath = currentFilePath + String(".pos");
   int idx = provider->getCurrentIndex();
   int chapter = provider->getCurrentChapter();
-  // Format: chapter,position
-  String content = String(chapter) + "," + String(idx);
-  if (!sdManager.writeFile(posPath.c_str(), content)) {
+  // Format: chapter,position; one small append to the positions journal
+  JournalStore& positions = uiManager.getPositions();
+  positions.set(currentFilePath, String(chapter) + "," + String(idx));
+  if (!positions.commit()) {
     Serial.printf("Failed to save position for %s\n", currentFilePath.c_str());
   }
+
+  // Progress and recency for the browser; opening an EPUB has written its extract cache
+  String lowerPath = currentFilePath;
+  lowerPath.toLowerCase();
+  uiManager.getLibrary().recordProgress(currentFilePath, chapter, idx, provider->getPercentage(),
+                                        lowerPath.endsWith(".epub"));
 }
 
 void TextViewerScreen::loadPositionFromFile() {
   if (currentFilePath.length() == 0)
     return;
-  String posPath = currentFilePath + String(".pos");
+  // Books last read before the positions journal still have a .pos file next to them
   char buf[64];
-  size_t r = sdManager.readFileToBuffer(posPath.c_str(), buf, sizeof(buf));
+  size_t r = 0;
+  String saved;
+  if (uiManager.getPositions().get(currentFilePath, saved)) {
+    r = (size_t)saved.length() < sizeof(buf) ? (size_t)saved.length() : sizeof(buf) - 1;
+    memcpy(buf, saved.c_str(), r);
+    buf[r] = '\0';
+  } else {
+    String posPath = currentFilePath + String(".pos");
+    r = sdManager.readFileToBuffer(posPath.c_str(), buf, sizeof(buf));
+  }
 
   if (r > 0) {
     buf[sizeof(buf) - 1] = '\0';
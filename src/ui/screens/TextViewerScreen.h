@@ -1,9 +1,12 @@
 #ifndef TEXT_VIEWER_SCREEN_H
 #define TEXT_VIEWER_SCREEN_H
 
+#include "../../content/annotations/AnnotationStore.h"
 #include "../../content/providers/StringWordProvider.h"
 #include "../../core/EInkDisplay.h"
 #include "../../core/SDCardManager.h"
+#include "../../core/Scheduler.h"
+#include "../../core/Settings.h"
 #include "../../rendering/TextRenderer.h"
 #include "../../text/layout/LayoutStrategy.h"
 #include "../UIManager.h"
@@ -16,6 +19,7 @@ class TextViewerScreen : public Screen {
 
   void begin() override;
   void activate() override;
+  void deactivate() override;
 
   // Load content from SD by path and display it
   void openFile(const String& sdPath);
@@ -26,6 +30,12 @@ class TextViewerScreen : public Screen {
   void prevPage();
   void jumpToNextChapter();
   void jumpToPreviousChapter();
+  // Show the page starting at the word that contains `position` in `chapter` (a search hit, a TOC anchor)
+  void jumpTo(int chapter, int position);
+  // Show the page at a book-wide fraction (0..1), as the page indicator counts it
+  void jumpToPercentage(float percentage);
+  // Show the start of a TOC entry; false if the book has no such entry in its spine
+  bool jumpToTocEntry(int tocIndex);
 
   void showPage();
 
@@ -61,6 +71,67 @@ class TextViewerScreen : public Screen {
   // Whether to flip page turn buttons (false=LEFT forward, true=RIGHT forward)
   bool flipPageButtons = false;
 
+  // Grayscale antialiasing mode and, for the adaptive mode, how long the user must stay on a page before the
+  // grayscale pass runs
+  Settings::AntialiasingMode antialiasingMode = Settings::AA_ALWAYS;
+  unsigned long antialiasingDelayMs = Settings::DEFAULT_ANTIALIASING_DELAY_MS;
+
+  // Layout of the page currently on screen, kept so the grayscale pass can be deferred
+  LayoutStrategy::PageLayout currentLayout;
+  bool grayscalePending = false;
+  unsigned long grayscaleRequestTime = 0;
+
+  // Render the grayscale planes of `currentLayout` and refresh with the grayscale LUT.
+  // When `buttons` is given the pass is abandoned as soon as a press is queued.
+  // Returns true if the grayscale refresh was shown.
+  bool renderGrayscalePass(class Buttons* buttons = nullptr);
+
+  // CONFIRM went down and is still held: a release opens the settings, a long press searches instead
+  bool confirmHeld = false;
+  // BACK went down and is still held: a release leaves the book, a long press toggles the page's bookmark instead
+  bool backHeld = false;
+
+  // Bookmarks and highlights of the open file
+  AnnotationStore annotations;
+  // Mark the words of layout covered by highlights; returns whether a bookmark falls on the page
+  bool markAnnotations(LayoutStrategy::PageLayout& layout);
+  void toggleBookmark();
+
+  // Speculative work, as much as the PrefetchPolicy allows: the page the reader is expected to turn to next,
+  // laid out while the current one refreshes or the loop idles
+  struct PrefetchedPage {
+    bool valid = false;
+    int chapter = 0;
+    int from = 0;  // Start of the page on screen when it was laid out
+    int start = 0;
+    LayoutStrategy::PageLayout layout;
+  };
+  PrefetchedPage prefetchedPage;
+  // Chapters converted ahead of the reader and not entered yet
+  std::vector<int> prefetchedChapters;
+  Scheduler::JobId pageJob = Scheduler::NO_JOB;
+  Scheduler::JobId chapterJob = Scheduler::NO_JOB;
+  class PageJob;
+  class ChapterJob;
+
+  // Queue the work the policy asks for around the page just shown
+  void schedulePrefetch();
+  // Lay out the page before (direction < 0) or after the one on screen into prefetchedPage
+  void prefetchPage(int direction);
+  // Take the prefetched page if it starts where the provider is; one that follows the page being shown again
+  // is kept, any other is wasted
+  bool takePrefetchedPage(LayoutStrategy::PageLayout& layout);
+  // Cancel the queued jobs and drop the prefetched page; closing the book also gives up the converted chapters
+  void dropPrefetch(bool closingBook);
+
+  // The provider when an EPUB is open, nullptr otherwise
+  class EpubWordProvider* currentEpub();
+  // Long-press chapter jumps step through the TOC entries when the book has them; false if there is none to go to
+  bool stepTocEntry(bool forward);
+
+  // Jump to the next match of the "search.query" setting after the page start, wrapping around the book
+  void findNext();
+
   // Persist/load current reading position for `currentFilePath`
   void savePositionToFile();
   void loadPositionFromFile();
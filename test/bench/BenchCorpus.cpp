@@ -0,0 +1,319 @@
+#include "BenchCorpus.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "lib/miniz.h"
+
+namespace BenchCorpus {
+
+namespace {
+
+// Linear congruential generator; std:: distributions differ between standard libraries
+struct Random {
+  uint32_t state;
+  explicit Random(uint32_t seed) : state(seed) {}
+  uint32_t next() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  }
+  int range(int lo, int hi) {  // Inclusive
+    return lo + (int)(next() % (uint32_t)(hi - lo + 1));
+  }
+  bool chance(int percent) {
+    return (int)(next() % 100) < percent;
+  }
+};
+
+const char* const VOCABULARY[] = {
+    "the",        "of",          "and",          "to",          "a",            "in",           "that",
+    "was",        "he",          "she",          "it",          "with",         "as",           "his",
+    "her",        "for",         "had",          "you",         "not",          "on",           "at",
+    "but",        "from",        "they",         "were",        "all",          "would",        "there",
+    "their",      "been",        "when",         "who",         "which",        "what",         "said",
+    "could",      "into",        "time",         "little",      "other",        "about",        "only",
+    "station",    "window",      "morning",      "river",       "letter",       "silence",      "garden",
+    "captain",    "question",    "distance",     "shadow",      "evening",      "journey",      "memory",
+    "remembered", "everything",  "afterwards",   "understood",  "considerable", "particularly", "immediately",
+    "nevertheless", "conversation", "extraordinary", "responsibility", "circumstances", "independence",
+    "uncomfortable", "neighbourhood", "characteristic", "disappointment", "correspondence",
+    "walked",     "looked",      "turned",       "opened",      "carried",      "whispered",    "listened",
+    "quietly",    "suddenly",    "slowly",       "perhaps",     "already",      "almost",       "never",
+    "old",        "grey",        "long",         "narrow",      "bright",       "heavy",        "empty"};
+const int VOCABULARY_SIZE = sizeof(VOCABULARY) / sizeof(VOCABULARY[0]);
+
+const char* const STYLESHEET =
+    "@charset \"utf-8\";\n"
+    "body { margin: 0; padding: 0; font-family: \"Bookerly\", serif; }\n"
+    "p { margin: 0; text-indent: 1.2em; text-align: justify; line-height: 1.3; }\n"
+    "p.first, p.noindent { text-indent: 0; }\n"
+    "p.center, div.figure { text-align: center; text-indent: 0; }\n"
+    "p.right { text-align: right; }\n"
+    "h1.chapter { font-size: 1.6em; font-weight: bold; text-align: center; margin: 2em 0 1em 0; }\n"
+    "h2 { font-size: 1.2em; font-style: italic; text-align: center; }\n"
+    "blockquote { margin: 1em 2em; font-style: italic; }\n"
+    ".sc { font-variant: small-caps; }\n"
+    ".bold { font-weight: bold; }\n"
+    ".italic { font-style: italic; }\n"
+    ".bolditalic { font-weight: bold; font-style: italic; }\n"
+    "img { max-width: 100%; }\n";
+
+std::string capitalize(std::string word) {
+  if (!word.empty() && word[0] >= 'a' && word[0] <= 'z')
+    word[0] = (char)(word[0] - 'a' + 'A');
+  return word;
+}
+
+// One paragraph of sentences; markup adds inline styles and entities for XHTML
+std::string paragraph(Random& rng, int words, bool markup) {
+  std::string out;
+  int sentenceLeft = 0;
+  const char* closeTag = nullptr;  // Open inline element, if any
+  bool inQuote = false;
+  for (int w = 0; w < words; w++) {
+    bool sentenceStart = sentenceLeft == 0;
+    if (sentenceStart)
+      sentenceLeft = rng.range(5, 22);
+    if (w > 0)
+      out += ' ';
+
+    if (markup && !closeTag && rng.chance(3)) {
+      static const char* const opens[][2] = {{"<em>", "</em>"},
+                                             {"<strong>", "</strong>"},
+                                             {"<span class=\"italic\">", "</span>"},
+                                             {"<span class=\"bold\">", "</span>"},
+                                             {"<span style=\"font-weight: bold; font-style: italic\">", "</span>"}};
+      int style = rng.next() % 5;
+      out += opens[style][0];
+      closeTag = opens[style][1];
+    }
+    if (sentenceStart && !inQuote && rng.chance(8)) {
+      out += markup ? "&#8220;" : "\"";
+      inQuote = true;
+    }
+
+    std::string word = VOCABULARY[rng.next() % VOCABULARY_SIZE];
+    out += sentenceStart ? capitalize(word) : word;
+
+    if (closeTag && (rng.chance(40) || sentenceLeft == 1 || w == words - 1)) {
+      out += closeTag;
+      closeTag = nullptr;
+    }
+
+    sentenceLeft--;
+    if (sentenceLeft == 0 || w == words - 1) {
+      static const char* const ends[] = {".", ".", ".", "!", "?"};
+      out += ends[rng.next() % 5];
+      if (inQuote) {
+        out += markup ? "&#8221;" : "\"";
+        inQuote = false;
+      }
+      sentenceLeft = 0;
+    } else if (rng.chance(10)) {
+      out += ',';
+    } else if (markup && rng.chance(1)) {
+      out += " &amp;";
+    } else if (markup && rng.chance(1)) {
+      out += "&#8217;s";
+    }
+  }
+  return out;
+}
+
+int chapterParagraphs(Random& rng, const BookSpec& spec) {
+  int half = spec.paragraphsPerChapter / 2;
+  return std::max(1, rng.range(spec.paragraphsPerChapter - half, spec.paragraphsPerChapter + half));
+}
+
+std::string chapterFile(int chapter) {
+  char name[32];
+  snprintf(name, sizeof(name), "ch%03d.xhtml", chapter + 1);
+  return name;
+}
+
+std::string imageFile(int image) {
+  char name[32];
+  snprintf(name, sizeof(name), "img%03d.png", image + 1);
+  return name;
+}
+
+std::string chapterXhtml(Random& rng, const BookSpec& spec, int chapter) {
+  std::string x =
+      "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<!DOCTYPE html>\n"
+      "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\" xml:lang=\"en\">\n"
+      "<head>\n<meta charset=\"utf-8\"/>\n<title>Chapter " +
+      std::to_string(chapter + 1) +
+      "</title>\n"
+      "<link rel=\"stylesheet\" type=\"text/css\" href=\"../css/style.css\"/>\n"
+      "<style type=\"text/css\">p.drop { text-indent: 0; }</style>\n"
+      "</head>\n<body>\n<section epub:type=\"chapter\" id=\"chapter-" +
+      std::to_string(chapter + 1) + "\">\n";
+  x += "<h1 class=\"chapter\">Chapter " + std::to_string(chapter + 1) + "</h1>\n";
+  x += "<h2>" + capitalize(paragraph(rng, rng.range(3, 7), false)) + "</h2>\n";
+
+  int paragraphs = chapterParagraphs(rng, spec);
+  int imageEvery = spec.imagesPerChapter > 0 ? std::max(1, paragraphs / (spec.imagesPerChapter + 1)) : 0;
+  int imagesPlaced = 0;
+  for (int p = 0; p < paragraphs; p++) {
+    int words = rng.range(spec.minWords, spec.maxWords);
+    if (p == 0) {
+      x += "<p class=\"first\">" + paragraph(rng, words, true) + "</p>\n";
+    } else if (rng.chance(4)) {
+      x += "<blockquote><p>" + paragraph(rng, words / 2 + 1, true) + "</p></blockquote>\n";
+    } else if (rng.chance(2)) {
+      x += "<p class=\"center\">* * *</p>\n";
+    } else if (rng.chance(2)) {
+      x += "<p style=\"text-align: right\">" + paragraph(rng, 4, true) + "</p>\n";
+    } else {
+      x += "<p>" + paragraph(rng, words, true) + "</p>\n";
+    }
+    if (imageEvery > 0 && imagesPlaced < spec.imagesPerChapter && (p + 1) % imageEvery == 0) {
+      int image = chapter * spec.imagesPerChapter + imagesPlaced++;
+      x += "<div class=\"figure\"><img src=\"../images/" + imageFile(image) + "\" alt=\"Figure " +
+           std::to_string(image + 1) + "\"/></div>\n";
+    }
+  }
+  x += "</section>\n</body>\n</html>\n";
+  return x;
+}
+
+std::string contentOpf(const BookSpec& spec) {
+  std::string opf =
+      "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"2.0\" unique-identifier=\"bookid\">\n"
+      "<metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmlns:opf=\"http://www.idpf.org/2007/opf\">\n"
+      "<dc:title>" +
+      spec.name +
+      "</dc:title>\n<dc:creator opf:role=\"aut\">Microreader Bench</dc:creator>\n"
+      "<dc:language>en</dc:language>\n"
+      "<dc:identifier id=\"bookid\">urn:microreader:bench:" +
+      spec.name + "</dc:identifier>\n</metadata>\n<manifest>\n";
+  opf += "<item id=\"ncx\" href=\"toc.ncx\" media-type=\"application/x-dtbncx+xml\"/>\n";
+  opf += "<item id=\"css\" href=\"css/style.css\" media-type=\"text/css\"/>\n";
+  for (int c = 0; c < spec.chapters; c++) {
+    opf += "<item id=\"ch" + std::to_string(c + 1) + "\" href=\"text/" + chapterFile(c) +
+           "\" media-type=\"application/xhtml+xml\"/>\n";
+  }
+  for (int i = 0; i < spec.chapters * spec.imagesPerChapter; i++) {
+    opf += "<item id=\"img" + std::to_string(i + 1) + "\" href=\"images/" + imageFile(i) +
+           "\" media-type=\"image/png\"/>\n";
+  }
+  opf += "</manifest>\n<spine toc=\"ncx\">\n";
+  for (int c = 0; c < spec.chapters; c++)
+    opf += "<itemref idref=\"ch" + std::to_string(c + 1) + "\"/>\n";
+  opf += "</spine>\n</package>\n";
+  return opf;
+}
+
+std::string tocNcx(const BookSpec& spec) {
+  std::string ncx =
+      "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<ncx xmlns=\"http://www.daisy.org/z3986/2005/ncx/\" version=\"2005-1\">\n"
+      "<head><meta name=\"dtb:uid\" content=\"urn:microreader:bench:" +
+      spec.name + "\"/></head>\n<docTitle><text>" + spec.name + "</text></docTitle>\n<navMap>\n";
+  for (int c = 0; c < spec.chapters; c++) {
+    std::string n = std::to_string(c + 1);
+    ncx += "<navPoint id=\"nav" + n + "\" playOrder=\"" + n + "\"><navLabel><text>Chapter " + n +
+           "</text></navLabel><content src=\"text/" + chapterFile(c) + "\"/></navPoint>\n";
+  }
+  ncx += "</navMap>\n</ncx>\n";
+  return ncx;
+}
+
+// Small grayscale PNG with some structure so it does not compress to nothing
+std::string pngImage(Random& rng) {
+  const int w = 96, h = 64;
+  std::vector<uint8_t> pixels(w * h);
+  uint8_t base = (uint8_t)rng.range(0, 255);
+  for (int y = 0; y < h; y++)
+    for (int x = 0; x < w; x++)
+      pixels[y * w + x] = (uint8_t)(base + x * 2 + y * 3 + (rng.next() & 7));
+  size_t len = 0;
+  void* png = tdefl_write_image_to_png_file_in_memory(pixels.data(), w, h, 1, &len);
+  std::string out(static_cast<const char*>(png), len);
+  mz_free(png);
+  return out;
+}
+
+bool addEntry(mz_zip_archive& zip, const std::string& name, const std::string& data, bool compress) {
+  return mz_zip_writer_add_mem(&zip, name.c_str(), data.data(), data.size(),
+                               compress ? MZ_DEFAULT_LEVEL : MZ_NO_COMPRESSION);
+}
+
+bool writeEpub(const BookSpec& spec, const std::string& path) {
+  mz_zip_archive zip;
+  memset(&zip, 0, sizeof(zip));
+  if (!mz_zip_writer_init_file(&zip, path.c_str(), 0))
+    return false;
+
+  Random rng(spec.seed);
+  bool ok = addEntry(zip, "mimetype", "application/epub+zip", false);
+  ok = ok && addEntry(zip, "META-INF/container.xml",
+                      "<?xml version=\"1.0\"?>\n"
+                      "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+                      "<rootfiles><rootfile full-path=\"OEBPS/content.opf\" "
+                      "media-type=\"application/oebps-package+xml\"/></rootfiles>\n</container>\n",
+                      true);
+  ok = ok && addEntry(zip, "OEBPS/content.opf", contentOpf(spec), true);
+  ok = ok && addEntry(zip, "OEBPS/toc.ncx", tocNcx(spec), true);
+  ok = ok && addEntry(zip, "OEBPS/css/style.css", STYLESHEET, true);
+  for (int c = 0; ok && c < spec.chapters; c++)
+    ok = addEntry(zip, "OEBPS/text/" + chapterFile(c), chapterXhtml(rng, spec, c), true);
+  for (int i = 0; ok && i < spec.chapters * spec.imagesPerChapter; i++)
+    ok = addEntry(zip, "OEBPS/images/" + imageFile(i), pngImage(rng), false);
+
+  ok = ok && mz_zip_writer_finalize_archive(&zip);
+  mz_zip_writer_end(&zip);
+  return ok;
+}
+
+bool writeTxt(const BookSpec& spec, const std::string& path) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out)
+    return false;
+  Random rng(spec.seed);
+  for (int c = 0; c < spec.chapters; c++) {
+    out << "Chapter " << (c + 1) << "\n\n";
+    int paragraphs = chapterParagraphs(rng, spec);
+    for (int p = 0; p < paragraphs; p++)
+      out << paragraph(rng, rng.range(spec.minWords, spec.maxWords), false) << "\n";
+    out << "\n";
+  }
+  return out.good();
+}
+
+}  // namespace
+
+std::vector<BookSpec> defaultCorpus(bool quick) {
+  std::vector<BookSpec> books = {
+      // Typical novel: ~40 chapters of mixed paragraphs with a few images
+      {"novel", Format::EPUB, 40, 60, 8, 160, 1, 1001},
+      // Long paragraphs stress line breaking and backward page search
+      {"long-paragraphs", Format::EPUB, 8, 30, 400, 900, 0, 2002},
+      // Many short spine items stress the ZIP directory and chapter switching
+      {"many-spine", Format::EPUB, 300, 6, 10, 80, 0, 3003},
+      // Plain text read through FileWordProvider
+      {"plain", Format::TXT, 30, 80, 10, 200, 0, 4004},
+  };
+  if (quick) {
+    for (auto& book : books) {
+      book.chapters = std::max(2, book.chapters / 5);
+      book.paragraphsPerChapter = std::max(2, book.paragraphsPerChapter / 2);
+    }
+  }
+  return books;
+}
+
+std::string writeBook(const BookSpec& spec, const std::string& dir) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  std::string path = dir + "/" + spec.name + (spec.format == Format::EPUB ? ".epub" : ".txt");
+  bool ok = spec.format == Format::EPUB ? writeEpub(spec, path) : writeTxt(spec, path);
+  return ok ? path : std::string();
+}
+
+}  // namespace BenchCorpus
@@ -0,0 +1,37 @@
+/**
+ * BenchCorpus.h - Deterministic synthetic book corpus for microreader_bench
+ *
+ * Generates TXT files and EPUBs from a fixed seed so every run (and every
+ * commit) benchmarks exactly the same bytes. The EPUBs use deflate like real
+ * books, share one stylesheet with class and inline styles, carry a toc.ncx and
+ * embed small PNG images referenced from the chapters.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace BenchCorpus {
+
+enum class Format { TXT, EPUB };
+
+struct BookSpec {
+  std::string name;  // File name without extension
+  Format format;
+  int chapters;              // Spine items (TXT: chapter headings in one file)
+  int paragraphsPerChapter;  // Average, varies +-50% per chapter
+  int minWords;              // Words per paragraph
+  int maxWords;
+  int imagesPerChapter;
+  uint32_t seed;
+};
+
+// The standard corpus; quick shrinks every book for smoke runs
+std::vector<BookSpec> defaultCorpus(bool quick);
+
+// Write the book into dir and return its path (empty on failure)
+std::string writeBook(const BookSpec& spec, const std::string& dir);
+
+}  // namespace BenchCorpus
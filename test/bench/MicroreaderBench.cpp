@@ -0,0 +1,645 @@
+/**
+ * MicroreaderBench.cpp - Host-side end-to-end page-turn benchmark
+ *
+ * Generates the synthetic corpus from BenchCorpus and replays what the reader
+ * does on the device: open a book, convert chapters, show the first page, turn
+ * pages forward and backward, jump between chapters and seek to a percentage.
+ * Every operation is timed, its heap allocations (operator new) counted and
+ * its on-device time estimated with the cost model in test/mocks/CostModel.h.
+ *
+ * Results are written as JSON so runs from two commits can be compared with
+ * test/scripts/compare_bench.py. Run from the repository root:
+ *
+ *   test/build/bench/microreader_bench [--quick] [--layout greedy|knuth-plass]
+ *                                      [--pages N] [--out path.json] [--verbose]
+ *                                      [--cost-model constants.txt] [--trace trace.json]
+ *                                      [--heap-report] [--check-pagination]
+ *
+ * --trace writes the trace ring (src/core/Trace.h) after the run; it holds the
+ * most recent operations, i.e. the end of the last book.
+ *
+ * --heap-report replays every allocation into the device heap model
+ * (test/mocks/HeapModel.h) attributed to the HeapTelemetry subsystem active at
+ * the time, then prints the checkpoint and subsystem tables. The model slows
+ * allocation down, so timings from such a run are not comparable.
+ *
+ * --check-pagination runs no scenarios; it paginates every book forward and
+ * backward (test/common/pagination_check.h), prints each book's mismatches
+ * and prev-page latency by chapter position, and exits with status 1 if any
+ * page boundary differs.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "BenchCorpus.h"
+#include "CostModel.h"
+#include "HeapModel.h"
+#include "WString.h"
+#include "content/epub/EpubReader.h"
+#include "content/providers/EpubWordProvider.h"
+#include "content/providers/FileWordProvider.h"
+#include "core/EInkDisplay.h"
+#include "core/HeapTelemetry.h"
+#include "core/Trace.h"
+#include "pagination_check.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "resources/fonts/FontDefinitions.h"
+#include "test_config.h"
+#include "text/layout/GreedyLayoutStrategy.h"
+#include "text/layout/KnuthPlassLayoutStrategy.h"
+
+// The EPUB parser borrows this display's frame buffer as its inflate window (see main.cpp)
+EInkDisplay einkDisplay(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                        ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+
+// ============================================================================
+// Allocation counting (replaces the global operator new for this binary)
+// ============================================================================
+
+// Each block carries its size in front so frees can be accounted for (live and peak heap), and with
+// --heap-report also its place in the heap model and the subsystem it was allocated for
+struct AllocHeader {
+  size_t size;
+  uint32_t modelOffset;
+  uint8_t subsystem;
+};
+static const size_t ALLOC_HEADER = alignof(std::max_align_t);
+static_assert(sizeof(AllocHeader) <= ALLOC_HEADER, "allocation header does not fit");
+static bool modelHeap = false;
+
+void* operator new(size_t size) {
+  uint8_t* block = static_cast<uint8_t*>(std::malloc(size + ALLOC_HEADER));
+  if (!block)
+    throw std::bad_alloc();
+  AllocHeader* header = reinterpret_cast<AllocHeader*>(block);
+  header->size = size;
+  header->modelOffset = HeapModel::NONE;
+  if (modelHeap) {
+    header->subsystem = HeapTelemetry::currentSubsystem();
+    header->modelOffset = HeapModel::heap().allocate((uint32_t)size, header->subsystem);
+    HeapTelemetry::recordAlloc((HeapTelemetry::Subsystem)header->subsystem, size);
+  }
+  CostModel::onAlloc(size);
+  return block + ALLOC_HEADER;
+}
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+void operator delete(void* p) noexcept {
+  if (!p)
+    return;
+  uint8_t* block = static_cast<uint8_t*>(p) - ALLOC_HEADER;
+  AllocHeader* header = reinterpret_cast<AllocHeader*>(block);
+  if (header->modelOffset != HeapModel::NONE) {
+    HeapModel::heap().release(header->modelOffset);
+    HeapTelemetry::recordFree((HeapTelemetry::Subsystem)header->subsystem, header->size);
+  }
+  CostModel::onFree(header->size);
+  std::free(block);
+}
+void operator delete[](void* p) noexcept {
+  operator delete(p);
+}
+void operator delete(void* p, size_t) noexcept {
+  operator delete(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+// ============================================================================
+// Measurement
+// ============================================================================
+
+namespace {
+
+const int SCHEMA_VERSION = 2;
+const char* const CORPUS_DIR = "test/output/bench";
+
+struct Sample {
+  double ms;
+  double estimatedMs;  // On-device estimate from the cost model
+  CostModel::Counters cost;
+};
+
+struct Metric {
+  std::string book;
+  std::string scenario;
+  std::vector<Sample> samples;
+};
+
+struct Options {
+  bool quick = false;
+  bool verbose = false;
+  bool knuthPlass = true;
+  int pages = 200;  // Page turns per direction
+  std::string out = std::string(CORPUS_DIR) + "/results.json";
+  std::string costModel;  // Calibrated constants, defaults if empty
+  std::string trace;      // Chrome trace output, none if empty
+  bool heapReport = false;
+  bool checkPagination = false;
+};
+
+template <typename F>
+Sample measure(F&& operation) {
+  CostModel::resetPeak();
+  CostModel::Counters before = CostModel::counters();
+  auto start = std::chrono::steady_clock::now();
+  operation();
+  auto end = std::chrono::steady_clock::now();
+  Sample sample;
+  sample.ms = std::chrono::duration<double, std::milli>(end - start).count();
+  sample.cost = CostModel::delta(before, CostModel::counters());
+  sample.estimatedMs = CostModel::estimateMs(sample.cost, sample.ms);
+  return sample;
+}
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty())
+    return 0.0;
+  std::sort(values.begin(), values.end());
+  size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[index];
+}
+
+// Per-operation averages of a metric
+struct Summary {
+  size_t count = 0;
+  double totalMs = 0, meanMs = 0, medianMs = 0, p90Ms = 0, maxMs = 0;
+  double estMeanMs = 0, estP90Ms = 0;
+  double allocs = 0, allocBytes = 0, sdOpens = 0, sdSectorReads = 0, sdSeeks = 0, sdSectorWrites = 0;
+  double spiBytes = 0, glyphPixels = 0;
+  uint64_t heapPeak = 0;  // Largest heap growth within one operation
+};
+
+Summary summarize(const Metric& m) {
+  Summary r;
+  std::vector<double> ms, est;
+  double estTotal = 0;
+  for (const Sample& s : m.samples) {
+    ms.push_back(s.ms);
+    est.push_back(s.estimatedMs);
+    r.totalMs += s.ms;
+    estTotal += s.estimatedMs;
+    r.allocs += s.cost.heapAllocs;
+    r.allocBytes += s.cost.heapBytes;
+    r.sdOpens += s.cost.sdOpens;
+    r.sdSectorReads += s.cost.sdSectorReads;
+    r.sdSeeks += s.cost.sdSeeks;
+    r.sdSectorWrites += s.cost.sdSectorWrites;
+    r.spiBytes += s.cost.spiBytes;
+    r.glyphPixels += s.cost.glyphPixels;
+    r.heapPeak = std::max(r.heapPeak, s.cost.heapPeak);
+  }
+  r.count = m.samples.size();
+  double n = (double)std::max<size_t>(1, r.count);
+  r.meanMs = r.totalMs / n;
+  r.medianMs = percentile(ms, 0.5);
+  r.p90Ms = percentile(ms, 0.9);
+  r.maxMs = percentile(ms, 1.0);
+  r.estMeanMs = estTotal / n;
+  r.estP90Ms = percentile(est, 0.9);
+  for (double* v : {&r.allocs, &r.allocBytes, &r.sdOpens, &r.sdSectorReads, &r.sdSeeks, &r.sdSectorWrites,
+                    &r.spiBytes, &r.glyphPixels})
+    *v /= n;
+  return r;
+}
+
+// Deterministic choices for jumps and seeks
+struct Sequence {
+  uint32_t state;
+  explicit Sequence(uint32_t seed) : state(seed) {}
+  int next(int range) {
+    state = state * 1664525u + 1013904223u;
+    return (int)((state >> 8) % (uint32_t)range);
+  }
+};
+
+// ============================================================================
+// Reader model (mirrors TextViewerScreen navigation)
+// ============================================================================
+
+class Reader {
+ public:
+  Reader(WordProvider& provider, LayoutStrategy& layout, TextRenderer& renderer,
+         const LayoutStrategy::LayoutConfig& config)
+      : provider_(provider), layout_(layout), renderer_(renderer), config_(config) {}
+
+  // Layout, render and send to the panel (black and white pass only)
+  void showPage() {
+    pageStart_ = provider_.getCurrentIndex();
+    LayoutStrategy::PageLayout page = layout_.layoutText(provider_, renderer_, config_);
+    pageEnd_ = page.endPosition;
+    einkDisplay.clearScreen(0xFF);
+    layout_.renderPage(page, renderer_, config_);
+    einkDisplay.displayBuffer(EInkDisplay::FAST_REFRESH);
+  }
+
+  void firstPage(int chapter) {
+    if (provider_.hasChapters())
+      provider_.setChapter(chapter);
+    provider_.setPosition(0);
+    showPage();
+  }
+
+  // Returns false at the end of the book
+  bool nextPage() {
+    if (provider_.getChapterPercentage(pageEnd_) < 1.0f) {
+      provider_.setPosition(pageEnd_);
+      showPage();
+      return true;
+    }
+    if (provider_.hasChapters() && provider_.getCurrentChapter() + 1 < provider_.getChapterCount()) {
+      provider_.setChapter(provider_.getCurrentChapter() + 1);
+      provider_.setPosition(0);
+      showPage();
+      return true;
+    }
+    return false;
+  }
+
+  // Returns false at the start of the book
+  bool prevPage() {
+    provider_.setPosition(pageStart_);
+    if (!provider_.hasPrevWord()) {
+      if (!provider_.hasChapters() || provider_.getCurrentChapter() == 0)
+        return false;
+      provider_.setChapter(provider_.getCurrentChapter() - 1);
+      provider_.setPosition(0x7FFFFFFF);
+      pageStart_ = provider_.getCurrentIndex();
+    }
+    pageStart_ = layout_.getPreviousPageStart(provider_, renderer_, config_, pageStart_);
+    provider_.setPosition(pageStart_);
+    showPage();
+    return true;
+  }
+
+  // Position within the chapter, snapped to a page start found by backward layout
+  void seekInChapter(float fraction) {
+    provider_.setPosition(0x7FFFFFFF);
+    int length = provider_.getCurrentIndex();
+    int target = (int)(fraction * length);
+    provider_.setPosition(target);
+    if (target > 0)
+      target = layout_.getPreviousPageStart(provider_, renderer_, config_, target);
+    provider_.setPosition(target);
+    showPage();
+  }
+
+ private:
+  WordProvider& provider_;
+  LayoutStrategy& layout_;
+  TextRenderer& renderer_;
+  const LayoutStrategy::LayoutConfig& config_;
+  int pageStart_ = 0;
+  int pageEnd_ = 0;
+};
+
+LayoutStrategy::LayoutConfig readerConfig() {
+  LayoutStrategy::LayoutConfig cfg;
+  cfg.marginLeft = ::TestConfig::DEFAULT_MARGIN_LEFT;
+  cfg.marginRight = ::TestConfig::DEFAULT_MARGIN_RIGHT;
+  cfg.marginTop = ::TestConfig::DEFAULT_MARGIN_TOP;
+  cfg.marginBottom = ::TestConfig::DEFAULT_MARGIN_BOTTOM;
+  cfg.lineHeight = ::TestConfig::DEFAULT_LINE_HEIGHT;
+  cfg.lineSpacing = ::TestConfig::DEFAULT_LINE_SPACING;
+  cfg.minSpaceWidth = ::TestConfig::DEFAULT_MIN_SPACE_WIDTH;
+  cfg.pageWidth = ::TestConfig::DISPLAY_WIDTH;
+  cfg.pageHeight = ::TestConfig::DISPLAY_HEIGHT;
+  cfg.alignment = LayoutStrategy::ALIGN_LEFT;
+  cfg.language = Language::ENGLISH;
+  return cfg;
+}
+
+// ============================================================================
+// Scenarios
+// ============================================================================
+
+void turnPages(const std::string& book, Reader& reader, const Options& opt, std::vector<Metric>& metrics) {
+  Metric next{book, "next_page", {}};
+  bool more = true;
+  for (int i = 0; i < opt.pages && more; i++)
+    next.samples.push_back(measure([&] { more = reader.nextPage(); }));
+  if (!more)
+    next.samples.pop_back();  // The failed turn at the end of the book
+  metrics.push_back(next);
+
+  // Walk back over the same pages
+  Metric prev{book, "prev_page", {}};
+  more = true;
+  for (size_t i = 0; i < next.samples.size() && more; i++)
+    prev.samples.push_back(measure([&] { more = reader.prevPage(); }));
+  if (!more)
+    prev.samples.pop_back();
+  metrics.push_back(prev);
+}
+
+void benchEpub(const std::string& book, const std::string& path, LayoutStrategy& layout, TextRenderer& renderer,
+               const Options& opt, std::vector<Metric>& metrics) {
+  const LayoutStrategy::LayoutConfig cfg = readerConfig();
+
+  // Open with an empty extract directory, like a book opened for the first time
+  std::string extractDir = "test/output/epub_" + std::filesystem::path(path).stem().string();
+  Metric open{book, "epub_open", {}};
+  EpubWordProvider* provider = nullptr;
+  for (int i = 0; i < 3; i++) {
+    delete provider;
+    std::filesystem::remove_all(extractDir);
+    open.samples.push_back(measure([&] { provider = new EpubWordProvider(path.c_str()); }));
+  }
+  metrics.push_back(open);
+  if (!provider->isValid()) {
+    fprintf(stderr, "  %s: failed to open\n", path.c_str());
+    delete provider;
+    return;
+  }
+  int chapters = provider->getChapterCount();
+  Reader reader(*provider, layout, renderer, cfg);
+
+  // First visit of every chapter converts its XHTML to the cached TXT
+  Metric convert{book, "chapter_convert", {}};
+  for (int c = 0; c < chapters; c++)
+    convert.samples.push_back(measure([&] { provider->setChapter(c); }));
+  metrics.push_back(convert);
+
+  Metric first{book, "first_page", {}};
+  for (int i = 0; i < 10; i++)
+    first.samples.push_back(measure([&] { reader.firstPage(0); }));
+  metrics.push_back(first);
+
+  reader.firstPage(0);
+  turnPages(book, reader, opt, metrics);
+
+  Sequence seq(0xB00C);
+  Metric jump{book, "chapter_jump", {}};
+  for (int i = 0; i < std::min(50, chapters * 2); i++) {
+    int chapter = seq.next(chapters);
+    jump.samples.push_back(measure([&] { reader.firstPage(chapter); }));
+  }
+  metrics.push_back(jump);
+
+  // Percentage seek: spine offsets pick the chapter, then the position inside it
+  const EpubReader* epub = provider->getEpubReader();
+  Metric seek{book, "percentage_seek", {}};
+  for (int i = 0; i < 20; i++) {
+    float percent = (seq.next(1000) + 0.5f) / 1000.0f;
+    seek.samples.push_back(measure([&] {
+      size_t target = (size_t)(percent * epub->getTotalBookSize());
+      int chapter = 0;
+      while (chapter + 1 < chapters && epub->getSpineItemOffset(chapter + 1) <= target)
+        chapter++;
+      size_t size = std::max<size_t>(1, epub->getSpineItemSize(chapter));
+      provider->setChapter(chapter);
+      reader.seekInChapter((float)(target - epub->getSpineItemOffset(chapter)) / size);
+    }));
+  }
+  metrics.push_back(seek);
+
+  delete provider;
+}
+
+void benchTxt(const std::string& book, const std::string& path, LayoutStrategy& layout, TextRenderer& renderer,
+              const Options& opt, std::vector<Metric>& metrics) {
+  const LayoutStrategy::LayoutConfig cfg = readerConfig();
+
+  Metric open{book, "txt_open", {}};
+  FileWordProvider* provider = nullptr;
+  for (int i = 0; i < 3; i++) {
+    delete provider;
+    open.samples.push_back(measure([&] { provider = new FileWordProvider(path.c_str()); }));
+  }
+  metrics.push_back(open);
+  if (!provider->isValid()) {
+    fprintf(stderr, "  %s: failed to open\n", path.c_str());
+    delete provider;
+    return;
+  }
+  Reader reader(*provider, layout, renderer, cfg);
+
+  Metric first{book, "first_page", {}};
+  for (int i = 0; i < 10; i++)
+    first.samples.push_back(measure([&] { reader.firstPage(0); }));
+  metrics.push_back(first);
+
+  reader.firstPage(0);
+  turnPages(book, reader, opt, metrics);
+
+  Sequence seq(0xB00C);
+  Metric seek{book, "percentage_seek", {}};
+  for (int i = 0; i < 20; i++) {
+    float percent = (seq.next(1000) + 0.5f) / 1000.0f;
+    seek.samples.push_back(measure([&] { reader.seekInChapter(percent); }));
+  }
+  metrics.push_back(seek);
+
+  delete provider;
+}
+
+// Returns the number of page boundaries where backward pagination disagrees with forward
+size_t checkPagination(const BenchCorpus::BookSpec& spec, const std::string& path, LayoutStrategy& layout,
+                       TextRenderer& renderer, const Options& opt) {
+  const LayoutStrategy::LayoutConfig cfg = readerConfig();
+  WordProvider* provider = nullptr;
+  bool valid = false;
+  if (spec.format == BenchCorpus::Format::EPUB) {
+    EpubWordProvider* epub = new EpubWordProvider(path.c_str());
+    valid = epub->isValid();
+    provider = epub;
+  } else {
+    FileWordProvider* txt = new FileWordProvider(path.c_str());
+    valid = txt->isValid();
+    provider = txt;
+  }
+  size_t mismatches = 1;
+  if (valid) {
+    PaginationCheck::Report report = PaginationCheck::run(*provider, layout, renderer, cfg, opt.quick ? opt.pages : 0);
+    printf("\n%s\n", spec.name.c_str());
+    PaginationCheck::printReport(report, stdout);
+    mismatches = report.mismatches.size();
+  } else {
+    fprintf(stderr, "  %s: failed to open\n", path.c_str());
+  }
+  delete provider;
+  return mismatches;
+}
+
+// ============================================================================
+// Output
+// ============================================================================
+
+std::string jsonString(const std::string& s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+bool writeJson(const std::string& path, const Options& opt, const std::vector<BenchCorpus::BookSpec>& corpus,
+               const std::vector<Metric>& metrics) {
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f)
+    return false;
+  fprintf(f, "{\n  \"schema\": %d,\n", SCHEMA_VERSION);
+  fprintf(f, "  \"config\": {\"layout\": %s, \"quick\": %s, \"pages\": %d},\n",
+          jsonString(opt.knuthPlass ? "knuth-plass" : "greedy").c_str(), opt.quick ? "true" : "false", opt.pages);
+  const CostModel::Constants& k = CostModel::constants();
+  fprintf(f,
+          "  \"cost_model\": {\"cpuScale\": %g, \"sdOpenUs\": %g, \"sdSectorReadUs\": %g, \"sdSeekUs\": %g, "
+          "\"sdSectorWriteUs\": %g, \"spiByteUs\": %g, \"allocUs\": %g, \"glyphPixelUs\": %g},\n",
+          k.cpuScale, k.sdOpenUs, k.sdSectorReadUs, k.sdSeekUs, k.sdSectorWriteUs, k.spiByteUs, k.allocUs,
+          k.glyphPixelUs);
+  fprintf(f, "  \"corpus\": [\n");
+  for (size_t i = 0; i < corpus.size(); i++) {
+    const auto& b = corpus[i];
+    fprintf(f,
+            "    {\"name\": %s, \"format\": %s, \"chapters\": %d, \"paragraphs_per_chapter\": %d, \"words\": [%d, %d], "
+            "\"images_per_chapter\": %d, \"seed\": %u}%s\n",
+            jsonString(b.name).c_str(), b.format == BenchCorpus::Format::EPUB ? "\"epub\"" : "\"txt\"", b.chapters,
+            b.paragraphsPerChapter, b.minWords, b.maxWords, b.imagesPerChapter, b.seed,
+            i + 1 < corpus.size() ? "," : "");
+  }
+  fprintf(f, "  ],\n  \"results\": [\n");
+  for (size_t i = 0; i < metrics.size(); i++) {
+    const Metric& m = metrics[i];
+    Summary r = summarize(m);
+    fprintf(f,
+            "    {\"book\": %s, \"scenario\": %s, \"count\": %zu, \"total_ms\": %.3f, \"mean_ms\": %.4f, "
+            "\"median_ms\": %.4f, \"p90_ms\": %.4f, \"max_ms\": %.4f, \"est_device_ms_mean\": %.3f, "
+            "\"est_device_ms_p90\": %.3f, \"allocs_per_op\": %.1f, \"alloc_bytes_per_op\": %.1f, "
+            "\"heap_peak_bytes\": %llu, \"sd_opens_per_op\": %.2f, \"sd_sector_reads_per_op\": %.1f, "
+            "\"sd_seeks_per_op\": %.2f, \"sd_sector_writes_per_op\": %.1f, \"spi_bytes_per_op\": %.0f, "
+            "\"glyph_pixels_per_op\": %.0f}%s\n",
+            jsonString(m.book).c_str(), jsonString(m.scenario).c_str(), r.count, r.totalMs, r.meanMs, r.medianMs,
+            r.p90Ms, r.maxMs, r.estMeanMs, r.estP90Ms, r.allocs, r.allocBytes, (unsigned long long)r.heapPeak,
+            r.sdOpens, r.sdSectorReads, r.sdSeeks, r.sdSectorWrites, r.spiBytes, r.glyphPixels,
+            i + 1 < metrics.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+  return true;
+}
+
+void printSummary(const std::vector<Metric>& metrics) {
+  printf("\n%-16s %-16s %6s %9s %9s %11s %10s %9s %9s\n", "book", "scenario", "count", "mean ms", "p90 ms",
+         "device ms", "allocs/op", "sectors", "seeks");
+  for (const Metric& m : metrics) {
+    Summary r = summarize(m);
+    printf("%-16s %-16s %6zu %9.3f %9.3f %11.1f %10.1f %9.1f %9.2f\n", m.book.c_str(), m.scenario.c_str(), r.count,
+           r.meanMs, r.p90Ms, r.estMeanMs, r.allocs, r.sdSectorReads, r.sdSeeks);
+  }
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--quick") {
+      opt.quick = true;
+    } else if (arg == "--verbose") {
+      opt.verbose = true;
+    } else if (arg == "--layout" && i + 1 < argc) {
+      std::string value = argv[++i];
+      if (value != "greedy" && value != "knuth-plass")
+        return false;
+      opt.knuthPlass = value == "knuth-plass";
+    } else if (arg == "--pages" && i + 1 < argc) {
+      opt.pages = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--out" && i + 1 < argc) {
+      opt.out = argv[++i];
+    } else if (arg == "--cost-model" && i + 1 < argc) {
+      opt.costModel = argv[++i];
+    } else if (arg == "--heap-report") {
+      opt.heapReport = true;
+    } else if (arg == "--check-pagination") {
+      opt.checkPagination = true;
+    } else if (arg == "--trace" && i + 1 < argc) {
+      opt.trace = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    fprintf(stderr,
+            "usage: %s [--quick] [--layout greedy|knuth-plass] [--pages N] [--out results.json] [--verbose] "
+            "[--cost-model constants.txt] [--trace trace.json] [--heap-report] [--check-pagination]\n",
+            argv[0]);
+    return 2;
+  }
+  if (opt.quick)
+    opt.pages = std::min(opt.pages, 40);
+  if (!opt.costModel.empty() && !CostModel::loadConstants(opt.costModel.c_str())) {
+    fprintf(stderr, "failed to load cost model constants from %s\n", opt.costModel.c_str());
+    return 2;
+  }
+  Serial.muted = !opt.verbose;
+  modelHeap = opt.heapReport;
+
+  einkDisplay.begin();
+  TextRenderer renderer(einkDisplay);
+  renderer.setFrameBuffer(einkDisplay.getFrameBuffer());
+  renderer.setTextColor(TextRenderer::COLOR_BLACK);
+  renderer.setFontFamily(&bookerly26Family);
+  renderer.setFontStyle(FontStyle::REGULAR);
+
+  std::vector<BenchCorpus::BookSpec> corpus = BenchCorpus::defaultCorpus(opt.quick);
+  std::vector<Metric> metrics;
+  size_t mismatches = 0;
+  for (const auto& spec : corpus) {
+    fprintf(stderr, "Benchmarking %s...\n", spec.name.c_str());
+    std::string path = BenchCorpus::writeBook(spec, CORPUS_DIR);
+    if (path.empty()) {
+      fprintf(stderr, "  failed to write %s\n", spec.name.c_str());
+      return 1;
+    }
+
+    GreedyLayoutStrategy greedy;
+    KnuthPlassLayoutStrategy knuthPlass;
+    LayoutStrategy& layout = opt.knuthPlass ? static_cast<LayoutStrategy&>(knuthPlass) : greedy;
+    layout.setLanguage(Language::ENGLISH);
+
+    if (opt.checkPagination)
+      mismatches += checkPagination(spec, path, layout, renderer, opt);
+    else if (spec.format == BenchCorpus::Format::EPUB)
+      benchEpub(spec.name, path, layout, renderer, opt, metrics);
+    else
+      benchTxt(spec.name, path, layout, renderer, opt, metrics);
+  }
+
+  Serial.muted = false;
+  if (opt.checkPagination)
+    return mismatches == 0 ? 0 : 1;
+  if (!writeJson(opt.out, opt, corpus, metrics)) {
+    fprintf(stderr, "failed to write %s\n", opt.out.c_str());
+    return 1;
+  }
+  printSummary(metrics);
+  printf("\nWrote %s\n", opt.out.c_str());
+  if (opt.heapReport) {
+    printf("\nHeap model (%u bytes, first fit):\n", (unsigned)HeapModel::heap().size());
+    HeapTelemetry::printReport();
+    printf("[MEM] allocations that did not fit: %u\n", (unsigned)HeapModel::heap().failures());
+  }
+  if (!opt.trace.empty() && !Trace::dumpToFile(opt.trace.c_str()))
+    return 1;
+  return 0;
+}
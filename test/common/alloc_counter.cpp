@@ -0,0 +1,155 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// Plain counters, zero before any constructor runs so allocations during static initialization count too
+AllocCounter::Counts counters;
+
+}  // namespace
+
+#if defined(__GLIBC__)
+// glibc exports its allocator under these names, so malloc and friends can be replaced and still reach it
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+}
+
+static void* rawAlloc(size_t size) {
+  return __libc_malloc(size);
+}
+static void rawFree(void* p) {
+  __libc_free(p);
+}
+
+extern "C" {
+
+void* malloc(size_t size) {
+  void* p = __libc_malloc(size);
+  if (p) {
+    counters.allocs++;
+    counters.bytes += size;
+  }
+  return p;
+}
+
+void* calloc(size_t count, size_t size) {
+  void* p = __libc_calloc(count, size);
+  if (p) {
+    counters.allocs++;
+    counters.bytes += count * size;
+  }
+  return p;
+}
+
+// A realloc counts as one allocation of the new size (and a free when it releases the block)
+void* realloc(void* old, size_t size) {
+  void* p = __libc_realloc(old, size);
+  if (p) {
+    counters.allocs++;
+    counters.bytes += size;
+  }
+  if (old && (p || size == 0))
+    counters.frees++;
+  return p;
+}
+
+void free(void* p) {
+  if (p)
+    counters.frees++;
+  __libc_free(p);
+}
+
+}  // extern "C"
+#else
+static void* rawAlloc(size_t size) {
+  return std::malloc(size);
+}
+static void rawFree(void* p) {
+  std::free(p);
+}
+#endif
+
+void* operator new(size_t size) {
+  void* p = rawAlloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  counters.allocs++;
+  counters.bytes += size;
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  if (p)
+    counters.frees++;
+  rawFree(p);
+}
+
+void operator delete[](void* p) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+namespace AllocCounter {
+
+Counts totals() {
+  return counters;
+}
+
+bool countsMalloc() {
+#if defined(__GLIBC__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+Phase::Phase(const std::string& name) : name_(name) {
+  start_ = counters;
+}
+
+const Counts& Phase::end() {
+  if (!ended_) {
+    Counts now = counters;
+    counts_.allocs = now.allocs - start_.allocs;
+    counts_.frees = now.frees - start_.frees;
+    counts_.bytes = now.bytes - start_.bytes;
+    ended_ = true;
+  }
+  return counts_;
+}
+
+// Callers end the phase first so building the label is not counted against it
+static bool expectBudget(TestUtils::TestRunner& runner, Phase& phase, uint64_t maxAllocs, const std::string& label) {
+  const Counts& c = phase.end();
+  std::string detail = std::to_string(c.allocs) + " allocations (" + std::to_string(c.bytes) + " bytes), budget " +
+                       std::to_string(maxAllocs);
+  return runner.expectTrue(c.allocs <= maxAllocs, phase.name() + label, detail);
+}
+
+bool expectAllocsAtMost(TestUtils::TestRunner& runner, Phase& phase, uint64_t maxAllocs) {
+  phase.end();
+  return expectBudget(runner, phase, maxAllocs, " allocations <= " + std::to_string(maxAllocs));
+}
+
+bool expectNoAllocs(TestUtils::TestRunner& runner, Phase& phase) {
+  phase.end();
+  return expectBudget(runner, phase, 0, " allocation-free");
+}
+
+}  // namespace AllocCounter
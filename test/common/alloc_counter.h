@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "test_utils.h"
+
+/**
+ * alloc_counter.h - Allocation counting for unit tests
+ *
+ * Unit test executables link alloc_counter.cpp, which replaces the global
+ * operator new/delete (and malloc/calloc/realloc/free on glibc) with versions
+ * that count calls and bytes. A Phase takes the difference of the counters
+ * between its construction and end(), so a test can assert that a hot path
+ * stays within an allocation budget:
+ *
+ *   AllocCounter::Phase turn("renderPage");
+ *   layout.renderPage(page, renderer, config);
+ *   AllocCounter::expectNoAllocs(runner, turn);
+ *
+ * The counters are process-wide and not thread-safe; tests are single-threaded.
+ */
+
+namespace AllocCounter {
+
+struct Counts {
+  uint64_t allocs = 0;  // operator new and malloc-family calls that returned memory
+  uint64_t frees = 0;
+  uint64_t bytes = 0;  // Bytes requested by those calls
+};
+
+// Totals since program start
+Counts totals();
+// False when only operator new is counted (malloc is replaced on glibc only)
+bool countsMalloc();
+
+class Phase {
+ public:
+  explicit Phase(const std::string& name);
+
+  // Freezes and returns the counts since construction; later calls return the same counts
+  const Counts& end();
+  const std::string& name() const {
+    return name_;
+  }
+
+ private:
+  std::string name_;
+  Counts start_;
+  Counts counts_;
+  bool ended_ = false;
+};
+
+// Pass when the phase allocated at most maxAllocs times; the message reports calls and bytes
+bool expectAllocsAtMost(TestUtils::TestRunner& runner, Phase& phase, uint64_t maxAllocs);
+bool expectNoAllocs(TestUtils::TestRunner& runner, Phase& phase);
+
+}  // namespace AllocCounter
@@ -0,0 +1,128 @@
+#include "pagination_check.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "content/providers/WordProvider.h"
+#include "rendering/TextRenderer.h"
+
+namespace PaginationCheck {
+
+namespace {
+
+const int POSITION_BUCKETS = 10;
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Words (not whitespace tokens) from one position to another, negative when to < from
+int wordsBetween(WordProvider& provider, int from, int to) {
+  if (from == to)
+    return 0;
+  provider.setPosition(std::min(from, to));
+  int words = 0;
+  while (provider.getCurrentIndex() < std::max(from, to) && provider.hasNextWord()) {
+    StyledWord word = provider.getNextWord();
+    for (int i = 0; i < word.text.length(); i++) {
+      char c = word.text.charAt(i);
+      if (c != ' ' && c != '\n' && c != '\t' && c != '\r') {
+        words++;
+        break;
+      }
+    }
+  }
+  return from < to ? words : -words;
+}
+
+// Page starts of the current chapter, as the reader finds them turning forward
+std::vector<int> paginateForward(WordProvider& provider, LayoutStrategy& layout, TextRenderer& renderer,
+                                 const LayoutStrategy::LayoutConfig& config, int maxPages) {
+  std::vector<int> starts;
+  provider.setPosition(0);
+  while (maxPages <= 0 || (int)starts.size() < maxPages) {
+    int start = provider.getCurrentIndex();
+    starts.push_back(start);
+    int end = layout.layoutText(provider, renderer, config).endPosition;
+    if (end <= start || provider.getChapterPercentage(end) >= 1.0f)
+      break;
+    provider.setPosition(end);
+  }
+  return starts;
+}
+
+}  // namespace
+
+Report run(WordProvider& provider, LayoutStrategy& layout, TextRenderer& renderer,
+           const LayoutStrategy::LayoutConfig& config, int maxPagesPerChapter) {
+  Report report;
+  report.chapters = provider.hasChapters() ? provider.getChapterCount() : 1;
+  for (int chapter = 0; chapter < report.chapters; chapter++) {
+    if (provider.hasChapters())
+      provider.setChapter(chapter);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> starts = paginateForward(provider, layout, renderer, config, maxPagesPerChapter);
+    report.forwardMs += elapsedMs(start);
+    report.pages += (int)starts.size();
+
+    for (int page = (int)starts.size() - 1; page > 0; page--) {
+      provider.setPosition(starts[page]);
+      start = std::chrono::steady_clock::now();
+      int backwardStart = layout.getPreviousPageStart(provider, renderer, config, starts[page]);
+      report.timings.push_back({chapter, page, provider.getChapterPercentage(starts[page]), elapsedMs(start)});
+      if (backwardStart == starts[page - 1])
+        continue;
+
+      provider.setPosition(backwardStart);
+      int backwardEnd = layout.layoutText(provider, renderer, config).endPosition;
+      Mismatch m;
+      m.chapter = chapter;
+      m.page = page - 1;
+      m.expectedStart = starts[page - 1];
+      m.backwardStart = backwardStart;
+      m.expectedEnd = starts[page];
+      m.backwardEnd = backwardEnd;
+      m.startDriftWords = wordsBetween(provider, m.expectedStart, m.backwardStart);
+      m.endDriftWords = wordsBetween(provider, m.backwardEnd, m.expectedEnd);
+      report.mismatches.push_back(m);
+    }
+  }
+  return report;
+}
+
+void printReport(const Report& report, FILE* out, int maxMismatches) {
+  fprintf(out, "Pagination check: %d chapters, %d pages, %zu mismatches (forward pass %.1f ms)\n", report.chapters,
+          report.pages, report.mismatches.size(), report.forwardMs);
+  for (size_t i = 0; i < report.mismatches.size() && (int)i < maxMismatches; i++) {
+    const Mismatch& m = report.mismatches[i];
+    fprintf(out, "  chapter %d page %d: start %d expected %d (%+d words), end %d expected %d (%+d words)\n",
+            m.chapter, m.page, m.backwardStart, m.expectedStart, m.startDriftWords, m.backwardEnd, m.expectedEnd,
+            m.endDriftWords);
+  }
+  if ((int)report.mismatches.size() > maxMismatches)
+    fprintf(out, "  ... %zu more\n", report.mismatches.size() - maxMismatches);
+
+  if (report.timings.empty())
+    return;
+  std::vector<double> buckets[POSITION_BUCKETS];
+  for (const PrevPageTiming& t : report.timings) {
+    int bucket = std::min(POSITION_BUCKETS - 1, std::max(0, (int)(t.position * POSITION_BUCKETS)));
+    buckets[bucket].push_back(t.ms);
+  }
+  fprintf(out, "  prev page latency by chapter position:\n  %-10s %6s %9s %9s %9s\n", "position", "count", "mean ms",
+          "p90 ms", "max ms");
+  for (int b = 0; b < POSITION_BUCKETS; b++) {
+    std::vector<double>& ms = buckets[b];
+    if (ms.empty())
+      continue;
+    std::sort(ms.begin(), ms.end());
+    double total = 0;
+    for (double v : ms)
+      total += v;
+    fprintf(out, "  %3d-%3d%%   %6zu %9.3f %9.3f %9.3f\n", b * 100 / POSITION_BUCKETS, (b + 1) * 100 / POSITION_BUCKETS,
+            ms.size(), total / ms.size(), ms[(size_t)(0.9 * (ms.size() - 1) + 0.5)], ms.back());
+  }
+}
+
+}  // namespace PaginationCheck
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+#include "text/layout/LayoutStrategy.h"
+
+class TextRenderer;
+class WordProvider;
+
+/**
+ * pagination_check.h - Forward/backward pagination determinism checker
+ *
+ * LayoutStrategy::getPreviousPageStart() finds the previous page by walking
+ * back with getPrevLine() and forward again with getNextLine(). It is only
+ * correct if that lands on the page start that forward pagination produced;
+ * otherwise turning back repeats or skips text. run() paginates every
+ * chapter forward with layoutText(), then walks back from the last page,
+ * asking getPreviousPageStart() for each page and comparing the answer (and
+ * where a page laid out from it ends) with the forward page boundaries. Every
+ * mismatch is reported with the number of words repeated or skipped, and
+ * every call is timed so the report doubles as a prev-page latency profile
+ * by position in the chapter.
+ *
+ *   PaginationCheck::Report report = PaginationCheck::run(provider, layout, renderer, config);
+ *   PaginationCheck::printReport(report, stdout);
+ *
+ * Each backward step starts from the forward page start, so one drift does
+ * not hide the ones after it.
+ */
+
+namespace PaginationCheck {
+
+struct Mismatch {
+  int chapter;
+  int page;           // Forward index of the page getPreviousPageStart() should have found
+  int expectedStart;  // Forward page start
+  int backwardStart;  // getPreviousPageStart() result
+  int expectedEnd;    // Start of the page the reader turned back from
+  int backwardEnd;    // End of a page laid out from backwardStart
+  // Words between the expected and the actual boundary: positive when turning back skips them, negative when it
+  // shows them twice
+  int startDriftWords;
+  int endDriftWords;
+};
+
+struct PrevPageTiming {
+  int chapter;
+  int page;
+  float position;  // Chapter fraction of the page start turned back from
+  double ms;
+};
+
+struct Report {
+  int chapters = 0;
+  int pages = 0;
+  double forwardMs = 0;  // Forward pagination of all chapters
+  std::vector<Mismatch> mismatches;
+  std::vector<PrevPageTiming> timings;
+};
+
+// maxPagesPerChapter > 0 stops forward pagination of a chapter after that many pages
+Report run(WordProvider& provider, LayoutStrategy& layout, TextRenderer& renderer,
+           const LayoutStrategy::LayoutConfig& config, int maxPagesPerChapter = 0);
+
+// Mismatch list (up to maxMismatches) and prev-page latency per tenth of the chapter
+void printReport(const Report& report, FILE* out, int maxMismatches = 20);
+
+}  // namespace PaginationCheck
@@ -0,0 +1,124 @@
+/**
+ * FuzzDriver.cpp - Standalone main() for the fuzz targets
+ *
+ *   XmlParserFuzz [FILE|DIR ...]                  run each input once through every mode
+ *   XmlParserFuzz                                 run stdin once (AFL: afl-fuzz ... -- XmlParserFuzz)
+ *   XmlParserFuzz --throughput ROUNDS FILE|DIR    feed the inputs ROUNDS times per mode, report MB/s
+ *   XmlParserFuzz --seed-corpus DIR               write seed inputs generated from the bench corpus
+ *
+ * Built instead of libFuzzer's main unless MICROREADER_LIBFUZZER is on.
+ * Reports go to stderr; the parsers' own diagnostics stay muted.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "FuzzTarget.h"
+
+namespace {
+
+struct Input {
+  std::string path;
+  std::vector<uint8_t> data;
+};
+
+bool readInput(const std::string& path, std::vector<Input>& inputs) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  inputs.push_back({path, std::vector<uint8_t>(std::istreambuf_iterator<char>(in), {})});
+  return true;
+}
+
+bool collectInputs(const std::string& path, std::vector<Input>& inputs) {
+  std::error_code ec;
+  if (!std::filesystem::is_directory(path, ec))
+    return readInput(path, inputs);
+  std::vector<std::string> files;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec))
+    if (entry.is_regular_file())
+      files.push_back(entry.path().string());
+  // Directory order is filesystem dependent; sort for repeatable runs
+  std::sort(files.begin(), files.end());
+  for (const auto& file : files)
+    if (!readInput(file, inputs))
+      return false;
+  return true;
+}
+
+void reportThroughput(const std::vector<Input>& inputs, int rounds) {
+  size_t inputBytes = 0;
+  for (const auto& input : inputs)
+    inputBytes += input.data.size();
+  fprintf(stderr, "%s: %zu inputs, %.2f MB, %d rounds per mode\n", FuzzTarget::name(), inputs.size(),
+          inputBytes / 1e6, rounds);
+  fprintf(stderr, "  %-10s %10s %10s %12s\n", "mode", "in MB/s", "out MB/s", "out bytes");
+  for (int mode = 0; mode < FuzzTarget::modeCount(); mode++) {
+    size_t outputBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++)
+      for (const auto& input : inputs)
+        outputBytes += FuzzTarget::run(input.data.data(), input.data.size(), mode);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double in = seconds > 0 ? inputBytes * (double)rounds / 1e6 / seconds : 0;
+    double out = seconds > 0 ? outputBytes / 1e6 / seconds : 0;
+    fprintf(stderr, "  %-10s %10.2f %10.2f %12zu\n", FuzzTarget::modeName(mode), in, out, outputBytes / rounds);
+  }
+}
+
+int usage(const char* program) {
+  fprintf(stderr, "usage: %s [FILE|DIR ...]\n       %s --throughput ROUNDS FILE|DIR ...\n       %s --seed-corpus DIR\n",
+          program, program, program);
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  LLVMFuzzerInitialize(&argc, &argv);
+
+  int rounds = 0;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--seed-corpus" && i + 1 < argc) {
+      int written = FuzzTarget::writeSeedCorpus(argv[i + 1]);
+      fprintf(stderr, "%s: wrote %d seed inputs to %s\n", FuzzTarget::name(), written, argv[i + 1]);
+      return written > 0 ? 0 : 1;
+    } else if (arg == "--throughput" && i + 1 < argc) {
+      rounds = std::max(1, atoi(argv[++i]));
+    } else if (arg.rfind("--", 0) == 0) {
+      return usage(argv[0]);
+    } else {
+      paths.push_back(arg);
+    }
+  }
+
+  std::vector<Input> inputs;
+  if (paths.empty()) {
+    if (rounds > 0)
+      return usage(argv[0]);
+    inputs.push_back({"<stdin>", std::vector<uint8_t>(std::istreambuf_iterator<char>(std::cin), {})});
+  }
+  for (const auto& path : paths) {
+    if (!collectInputs(path, inputs)) {
+      fprintf(stderr, "cannot read %s\n", path.c_str());
+      return 1;
+    }
+  }
+
+  if (rounds > 0) {
+    reportThroughput(inputs, rounds);
+    return 0;
+  }
+  for (const auto& input : inputs)
+    LLVMFuzzerTestOneInput(input.data.data(), input.data.size());
+  fprintf(stderr, "%s: ran %zu inputs\n", FuzzTarget::name(), inputs.size());
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include "FuzzTarget.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include "core/EInkDisplay.h"
+#include "platform_stubs.h"
+#include "test_config.h"
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+// The EPUB parser borrows this display's frame buffer as its inflate window (see main.cpp)
+EInkDisplay einkDisplay(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                        ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+
+namespace FuzzTarget {
+
+std::string writeTempInput(const uint8_t* data, size_t size) {
+  // One file per process so parallel fuzzing jobs do not overwrite each other's input
+  static const std::string path = (std::filesystem::temp_directory_path() /
+                                   (std::string("microreader_") + name() + "_" + std::to_string(getpid())))
+                                      .string();
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(data), (std::streamsize)size);
+  return path;
+}
+
+}  // namespace FuzzTarget
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {
+  (void)argc;
+  (void)argv;
+  // Parser diagnostics would dominate the run time
+  Serial.muted = true;
+  einkDisplay.begin();
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  for (int mode = 0; mode < FuzzTarget::modeCount(); mode++)
+    FuzzTarget::run(data, size, mode);
+  return 0;
+}
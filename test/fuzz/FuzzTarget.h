@@ -0,0 +1,47 @@
+/**
+ * FuzzTarget.h - Interface between a fuzz target and its drivers
+ *
+ * Each *Fuzz.cpp in this directory implements one target: it feeds an input
+ * through the code under test in one of several modes (e.g. the parser's
+ * memory, stream and file input) and returns how many bytes that produced
+ * (text characters, decompressed bytes). FuzzEntry.cpp turns a target into
+ * a libFuzzer entry point that runs every mode; FuzzDriver.cpp adds a main()
+ * for replaying inputs, AFL-style runs and throughput measurement.
+ *
+ * Targets call FUZZ_CHECK for invariants the parser must keep even on
+ * malformed input; a failed check aborts so the fuzzer records the input.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#define FUZZ_CHECK(condition, message)                                                 \
+  do {                                                                                 \
+    if (!(condition)) {                                                                \
+      fprintf(stderr, "FUZZ_CHECK failed at %s:%d: %s\n", __FILE__, __LINE__, message); \
+      abort();                                                                         \
+    }                                                                                  \
+  } while (0)
+
+namespace FuzzTarget {
+
+// Implemented by the target
+const char* name();
+int modeCount();
+const char* modeName(int mode);
+size_t run(const uint8_t* data, size_t size, int mode);
+// Write seed inputs derived from the benchmark corpus into dir; returns how many were written
+int writeSeedCorpus(const std::string& dir);
+
+// Implemented in FuzzEntry.cpp: writes the input to a per-process temporary file for file-based modes
+std::string writeTempInput(const uint8_t* data, size_t size);
+
+}  // namespace FuzzTarget
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv);
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
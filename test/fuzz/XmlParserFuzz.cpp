@@ -0,0 +1,149 @@
+/**
+ * XmlParserFuzz.cpp - Fuzz target for SimpleXmlParser
+ *
+ * Walks every node with read(), reads every text node through
+ * readTextNodeCharForward() and looks up the attributes the EPUB code uses.
+ * Modes: memory (openFromMemory), stream (openFromStream, delivering chunks
+ * of varying size so node boundaries fall at every offset of the sliding
+ * window) and file (open on a temporary copy). Output is text characters.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "BenchCorpus.h"
+#include "FuzzTarget.h"
+#include "content/epub/epub_parser.h"
+#include "content/xml/SimpleXmlParser.h"
+
+namespace {
+
+enum Mode { MEMORY, STREAM, FILE_MODE, MODE_COUNT };
+const char* const MODE_NAMES[MODE_COUNT] = {"memory", "stream", "file"};
+
+const char* const ATTRIBUTES[] = {"href", "src", "id", "class", "style", "media-type", "full-path", "idref"};
+
+struct StreamInput {
+  const uint8_t* data;
+  size_t size;
+  size_t pos;
+  uint32_t state;
+};
+
+int readStream(char* buffer, size_t maxSize, void* userData) {
+  StreamInput* in = static_cast<StreamInput*>(userData);
+  if (in->pos >= in->size || maxSize == 0)
+    return 0;
+  in->state = in->state * 1103515245u + 12345u;
+  size_t n = std::min<size_t>(1 + (in->state >> 16) % maxSize, in->size - in->pos);
+  memcpy(buffer, in->data + in->pos, n);
+  in->pos += n;
+  return (int)n;
+}
+
+size_t walk(SimpleXmlParser& parser, size_t inputSize) {
+  // Every node and text character consumes input, so these bound a parser that stopped advancing
+  const size_t maxNodes = 2 * inputSize + 16;
+  const size_t maxChars = inputSize + 16;
+  size_t nodes = 0;
+  size_t chars = 0;
+  while (parser.read()) {
+    FUZZ_CHECK(++nodes <= maxNodes, "read() returns more nodes than the input can hold");
+    switch (parser.getNodeType()) {
+      case SimpleXmlParser::Element:
+        parser.getName();
+        for (const char* attribute : ATTRIBUTES)
+          parser.getAttribute(attribute);
+        break;
+      case SimpleXmlParser::Text:
+        while (parser.hasMoreTextChars()) {
+          parser.readTextNodeCharForward();
+          FUZZ_CHECK(++chars <= maxChars, "text node does not end");
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return chars;
+}
+
+}  // namespace
+
+namespace FuzzTarget {
+
+const char* name() {
+  return "XmlParserFuzz";
+}
+
+int modeCount() {
+  return MODE_COUNT;
+}
+
+const char* modeName(int mode) {
+  return MODE_NAMES[mode];
+}
+
+size_t run(const uint8_t* data, size_t size, int mode) {
+  SimpleXmlParser parser;
+  bool opened = false;
+  StreamInput stream = {data, size, 0, (uint32_t)size};
+  switch (mode) {
+    case MEMORY:
+      opened = parser.openFromMemory(reinterpret_cast<const char*>(data), size);
+      break;
+    case STREAM:
+      opened = parser.openFromStream(readStream, &stream);
+      break;
+    case FILE_MODE:
+      opened = parser.open(writeTempInput(data, size).c_str());
+      break;
+  }
+  if (!opened)
+    return 0;
+  size_t chars = walk(parser, size);
+  parser.close();
+  return chars;
+}
+
+// The XHTML, OPF and NCX documents of the quick benchmark EPUBs
+int writeSeedCorpus(const std::string& dir) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  std::string scratch = (std::filesystem::temp_directory_path() / "microreader_xml_seed").string();
+  int written = 0;
+  for (const auto& spec : BenchCorpus::defaultCorpus(true)) {
+    if (spec.format != BenchCorpus::Format::EPUB)
+      continue;
+    std::string path = BenchCorpus::writeBook(spec, scratch);
+    epub_reader* reader = nullptr;
+    if (path.empty() || epub_open(path.c_str(), &reader) != EPUB_OK)
+      continue;
+    for (uint32_t i = 0; i < epub_get_file_count(reader); i++) {
+      epub_file_info info;
+      if (epub_get_file_info(reader, i, &info) != EPUB_OK)
+        continue;
+      std::string entry = info.filename;
+      std::string extension = std::filesystem::path(entry).extension().string();
+      if (extension != ".xhtml" && extension != ".opf" && extension != ".ncx" && extension != ".xml")
+        continue;
+      std::replace(entry.begin(), entry.end(), '/', '_');
+      std::ofstream out(dir + "/" + spec.name + "_" + entry, std::ios::binary);
+      epub_extract_streaming(
+          reader, i,
+          [](const void* chunk, size_t chunkSize, void* user) {
+            static_cast<std::ofstream*>(user)->write(static_cast<const char*>(chunk), (std::streamsize)chunkSize);
+            return 1;
+          },
+          &out);
+      written++;
+    }
+    epub_close(reader);
+  }
+  std::filesystem::remove_all(scratch, ec);
+  return written;
+}
+
+}  // namespace FuzzTarget
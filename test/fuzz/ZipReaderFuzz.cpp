@@ -0,0 +1,107 @@
+/**
+ * ZipReaderFuzz.cpp - Fuzz target for the minimal ZIP reader in epub_parser
+ *
+ * Opens the input as an EPUB (the reader parses the end of central directory
+ * and every zip_central_dir_entry), checks each entry's info and inflates
+ * every entry. Modes: pull (epub_start_streaming / epub_read_chunk, as
+ * EpubReader uses it) and callback (epub_extract_streaming). Output is
+ * decompressed bytes, capped per input so a small zip bomb cannot stall the
+ * fuzzer.
+ */
+
+#include <cstring>
+#include <filesystem>
+
+#include "BenchCorpus.h"
+#include "FuzzTarget.h"
+#include "content/epub/epub_parser.h"
+
+namespace {
+
+enum Mode { PULL, CALLBACK, MODE_COUNT };
+const char* const MODE_NAMES[MODE_COUNT] = {"pull", "callback"};
+
+const size_t MAX_OUTPUT = 8 * 1024 * 1024;
+const size_t CHUNK_SIZE = 4096;
+
+size_t extractPull(epub_reader* reader, uint32_t index, size_t budget) {
+  epub_stream_context* ctx = epub_start_streaming(reader, index);
+  if (!ctx)
+    return 0;
+  static uint8_t buffer[CHUNK_SIZE];
+  size_t total = 0;
+  while (total < budget) {
+    int n = epub_read_chunk(ctx, buffer, sizeof(buffer));
+    FUZZ_CHECK(n <= (int)sizeof(buffer), "epub_read_chunk overran the buffer");
+    if (n <= 0)
+      break;
+    total += (size_t)n;
+  }
+  epub_end_streaming(ctx);
+  return total;
+}
+
+struct CallbackOutput {
+  size_t total;
+  size_t budget;
+};
+
+int countChunk(const void* data, size_t size, void* userData) {
+  (void)data;
+  CallbackOutput* out = static_cast<CallbackOutput*>(userData);
+  out->total += size;
+  return out->total < out->budget ? 1 : 0;
+}
+
+}  // namespace
+
+namespace FuzzTarget {
+
+const char* name() {
+  return "ZipReaderFuzz";
+}
+
+int modeCount() {
+  return MODE_COUNT;
+}
+
+const char* modeName(int mode) {
+  return MODE_NAMES[mode];
+}
+
+size_t run(const uint8_t* data, size_t size, int mode) {
+  epub_reader* reader = nullptr;
+  if (epub_open(writeTempInput(data, size).c_str(), &reader) != EPUB_OK)
+    return 0;
+
+  size_t total = 0;
+  uint32_t count = epub_get_file_count(reader);
+  for (uint32_t i = 0; i < count && total < MAX_OUTPUT; i++) {
+    epub_file_info info;
+    if (epub_get_file_info(reader, i, &info) != EPUB_OK)
+      continue;
+    FUZZ_CHECK(memchr(info.filename, '\0', sizeof(info.filename)) != nullptr, "entry name not terminated");
+    if (mode == PULL) {
+      total += extractPull(reader, i, MAX_OUTPUT - total);
+    } else {
+      CallbackOutput out = {0, MAX_OUTPUT - total};
+      epub_extract_streaming(reader, i, countChunk, &out);
+      total += out.total;
+    }
+  }
+  uint32_t index = 0;
+  epub_locate_file(reader, "META-INF/container.xml", &index);
+  epub_close(reader);
+  return total;
+}
+
+// The quick benchmark EPUBs
+int writeSeedCorpus(const std::string& dir) {
+  int written = 0;
+  for (const auto& spec : BenchCorpus::defaultCorpus(true))
+    if (spec.format == BenchCorpus::Format::EPUB && !BenchCorpus::writeBook(spec, dir).empty())
+      written++;
+  return written;
+}
+
+}  // namespace FuzzTarget
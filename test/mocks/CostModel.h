@@ -0,0 +1,176 @@
+#pragma once
+
+/**
+ * CostModel.h - Estimated ESP32-C3 cost of host runs
+ *
+ * The mocks count the work that is cheap on a desktop but expensive on the
+ * device: SD sectors read and written, seeks to a non-sequential sector, file
+ * opens, bytes clocked out over SPI, heap allocations and glyph pixels drawn
+ * from flash. estimateMs() turns a counter delta plus the host CPU time into
+ * estimated device milliseconds using per-operation costs that can be
+ * calibrated against a measurement on hardware (see loadConstants()).
+ *
+ * The panel's own refresh waveform is not included; it is a fixed cost per
+ * refresh that code changes do not influence.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace CostModel {
+
+struct Counters {
+  uint64_t sdOpens = 0;
+  uint64_t sdSectorReads = 0;
+  uint64_t sdSeeks = 0;
+  uint64_t sdSectorWrites = 0;
+  uint64_t spiBytes = 0;
+  uint64_t heapAllocs = 0;
+  uint64_t heapBytes = 0;
+  uint64_t heapCurrent = 0;  // Live bytes (only with an allocation hook)
+  uint64_t heapPeak = 0;     // Highest heapCurrent since the last resetPeak()
+  uint64_t glyphPixels = 0;
+};
+
+struct Constants {
+  double cpuScale = 40.0;          // Device/host CPU time ratio (160 MHz RV32IMC vs desktop core)
+  double sdOpenUs = 2000.0;        // FAT directory lookup and cluster chain start
+  double sdSectorReadUs = 250.0;   // 512-byte block read over SPI including command overhead
+  double sdSeekUs = 400.0;         // Extra latency when the next sector is not sequential
+  double sdSectorWriteUs = 900.0;  // 512-byte block write including busy wait
+  double spiByteUs = 0.2;          // Display SPI at 40 MHz
+  double allocUs = 3.0;            // Heap allocator overhead beyond what the host CPU time covers
+  double glyphPixelUs = 0.05;      // Flash cache misses reading glyph bitmaps
+};
+
+const size_t SECTOR_SIZE = 512;
+
+inline Counters& counters() {
+  static Counters c;
+  return c;
+}
+
+inline Constants& constants() {
+  static Constants c;
+  return c;
+}
+
+// Hooks called by the mocks, the renderer and allocation-counting binaries
+inline void onSdOpen() {
+  counters().sdOpens++;
+}
+
+// A file read of [position, position + length); lastSector is per file state (SdFat caches one sector)
+inline void onSdRead(size_t position, size_t length, int64_t& lastSector) {
+  if (length == 0)
+    return;
+  int64_t first = (int64_t)(position / SECTOR_SIZE);
+  int64_t last = (int64_t)((position + length - 1) / SECTOR_SIZE);
+  if (first == lastSector)
+    first++;
+  else if (first != lastSector + 1)
+    counters().sdSeeks++;
+  if (last >= first)
+    counters().sdSectorReads += (uint64_t)(last - first + 1);
+  lastSector = last;
+}
+
+// A file write of [position, position + length); each sector is counted once when first touched
+inline void onSdWrite(size_t position, size_t length, int64_t& lastSector) {
+  if (length == 0)
+    return;
+  int64_t first = (int64_t)(position / SECTOR_SIZE);
+  int64_t last = (int64_t)((position + length - 1) / SECTOR_SIZE);
+  if (first == lastSector)
+    first++;
+  if (last >= first)
+    counters().sdSectorWrites += (uint64_t)(last - first + 1);
+  lastSector = last;
+}
+
+inline void onSpiBytes(size_t length) {
+  counters().spiBytes += length;
+}
+
+inline void onGlyphPixels(uint32_t pixels) {
+  counters().glyphPixels += pixels;
+}
+
+inline void onAlloc(size_t size) {
+  Counters& c = counters();
+  c.heapAllocs++;
+  c.heapBytes += size;
+  c.heapCurrent += size;
+  if (c.heapCurrent > c.heapPeak)
+    c.heapPeak = c.heapCurrent;
+}
+
+inline void onFree(size_t size) {
+  counters().heapCurrent -= size;
+}
+
+inline void resetPeak() {
+  counters().heapPeak = counters().heapCurrent;
+}
+
+inline Counters delta(const Counters& before, const Counters& after) {
+  Counters d;
+  d.sdOpens = after.sdOpens - before.sdOpens;
+  d.sdSectorReads = after.sdSectorReads - before.sdSectorReads;
+  d.sdSeeks = after.sdSeeks - before.sdSeeks;
+  d.sdSectorWrites = after.sdSectorWrites - before.sdSectorWrites;
+  d.spiBytes = after.spiBytes - before.spiBytes;
+  d.heapAllocs = after.heapAllocs - before.heapAllocs;
+  d.heapBytes = after.heapBytes - before.heapBytes;
+  d.heapCurrent = after.heapCurrent;
+  d.heapPeak = after.heapPeak > before.heapCurrent ? after.heapPeak - before.heapCurrent : 0;
+  d.glyphPixels = after.glyphPixels - before.glyphPixels;
+  return d;
+}
+
+// Estimated device time for work that took hostMs on this machine and produced counter delta d
+inline double estimateMs(const Counters& d, double hostMs, const Constants& k = constants()) {
+  double us = d.sdOpens * k.sdOpenUs + d.sdSectorReads * k.sdSectorReadUs + d.sdSeeks * k.sdSeekUs +
+              d.sdSectorWrites * k.sdSectorWriteUs + d.spiBytes * k.spiByteUs + d.heapAllocs * k.allocUs +
+              d.glyphPixels * k.glyphPixelUs;
+  return hostMs * k.cpuScale + us / 1000.0;
+}
+
+// Override constants from a "name = value" file ('#' starts a comment); false if unreadable or unknown keys
+inline bool loadConstants(const char* path, Constants& k = constants()) {
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return false;
+  struct Field {
+    const char* name;
+    double* value;
+  } fields[] = {{"cpuScale", &k.cpuScale},       {"sdOpenUs", &k.sdOpenUs},
+                {"sdSectorReadUs", &k.sdSectorReadUs}, {"sdSeekUs", &k.sdSeekUs},
+                {"sdSectorWriteUs", &k.sdSectorWriteUs}, {"spiByteUs", &k.spiByteUs},
+                {"allocUs", &k.allocUs},         {"glyphPixelUs", &k.glyphPixelUs}};
+  bool ok = true;
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    char* hash = strchr(line, '#');
+    if (hash)
+      *hash = '\0';
+    char name[64];
+    double value;
+    if (sscanf(line, " %63[A-Za-z] = %lf", name, &value) != 2)
+      continue;
+    bool known = false;
+    for (const Field& field : fields) {
+      if (strcmp(field.name, name) == 0) {
+        *field.value = value;
+        known = true;
+      }
+    }
+    ok = ok && known;
+  }
+  fclose(f);
+  return ok;
+}
+
+}  // namespace CostModel
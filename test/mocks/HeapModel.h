@@ -0,0 +1,201 @@
+#pragma once
+
+/**
+ * HeapModel.h - First-fit model of the device heap for host runs
+ *
+ * The host allocator says nothing about fragmentation on the ESP32-C3, so
+ * binaries that see every allocation (the benchmark) can replay them into
+ * this model: a fixed-size arena with first-fit placement, 4-byte alignment
+ * and a per-block header like the ESP-IDF heap. The ESP mock reports free
+ * heap, minimum free heap and largest free block from it. Each block records
+ * its owner (a HeapTelemetry subsystem) so largestFreeWithout() can tell how
+ * much a subsystem's live blocks split the free space.
+ *
+ * Until something is allocated in it the model reports an empty heap of
+ * DEFAULT_SIZE bytes. The model's own bookkeeping uses malloc so it can run
+ * inside an operator new replacement.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <new>
+
+namespace HeapModel {
+
+// Free heap after boot on the device (frame buffers are static, not heap)
+const uint32_t DEFAULT_SIZE = 240 * 1024;
+const uint32_t BLOCK_OVERHEAD = 8;
+const uint32_t ALIGN = 4;
+const uint32_t NONE = 0xFFFFFFFFu;
+
+template <typename T>
+struct MallocAllocator {
+  typedef T value_type;
+  MallocAllocator() = default;
+  template <typename U>
+  MallocAllocator(const MallocAllocator<U>&) {}
+  T* allocate(size_t n) {
+    void* p = malloc(n * sizeof(T));
+    if (!p)
+      abort();
+    return static_cast<T*>(p);
+  }
+  void deallocate(T* p, size_t) {
+    free(p);
+  }
+  template <typename U>
+  bool operator==(const MallocAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const MallocAllocator<U>&) const {
+    return false;
+  }
+};
+
+class Heap {
+ public:
+  explicit Heap(uint32_t size = DEFAULT_SIZE) {
+    reset(size);
+  }
+
+  void reset(uint32_t size = DEFAULT_SIZE) {
+    size_ = size;
+    free_.clear();
+    live_.clear();
+    free_[0] = size;
+    freeBytes_ = size;
+    minFreeBytes_ = size;
+    failures_ = 0;
+  }
+
+  // Returns the block offset or NONE when no free range is large enough
+  uint32_t allocate(uint32_t bytes, uint8_t owner) {
+    uint32_t need = ((bytes + ALIGN - 1) / ALIGN) * ALIGN + BLOCK_OVERHEAD;
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+      if (it->second < need)
+        continue;
+      uint32_t offset = it->first;
+      uint32_t remaining = it->second - need;
+      free_.erase(it);
+      if (remaining > 0)
+        free_[offset + need] = remaining;
+      live_[offset] = Block{need, owner};
+      freeBytes_ -= need;
+      if (freeBytes_ < minFreeBytes_)
+        minFreeBytes_ = freeBytes_;
+      return offset;
+    }
+    failures_++;
+    return NONE;
+  }
+
+  void release(uint32_t offset) {
+    auto it = live_.find(offset);
+    if (it == live_.end())
+      return;
+    uint32_t length = it->second.size;
+    live_.erase(it);
+    freeBytes_ += length;
+
+    // Coalesce with the neighbouring free ranges
+    auto next = free_.lower_bound(offset);
+    if (next != free_.end() && next->first == offset + length) {
+      length += next->second;
+      next = free_.erase(next);
+    }
+    if (next != free_.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        prev->second += length;
+        return;
+      }
+    }
+    free_[offset] = length;
+  }
+
+  uint32_t size() const {
+    return size_;
+  }
+  uint32_t freeBytes() const {
+    return freeBytes_;
+  }
+  uint32_t minFreeBytes() const {
+    return minFreeBytes_;
+  }
+  uint32_t failures() const {
+    return failures_;
+  }
+
+  // Largest allocation that would succeed now
+  uint32_t largestFree() const {
+    uint32_t best = 0;
+    for (const auto& range : free_)
+      if (range.second > best)
+        best = range.second;
+    return best > BLOCK_OVERHEAD ? best - BLOCK_OVERHEAD : 0;
+  }
+
+  // Largest allocation that would succeed if every live block of owner were freed
+  uint32_t largestFreeWithout(uint8_t owner) const {
+    uint32_t best = 0, runStart = 0, runEnd = 0;
+    bool inRun = false;
+    auto f = free_.begin();
+    auto l = live_.begin();
+    // Walk free ranges and owner's blocks in address order, merging adjacent ones
+    while (f != free_.end() || l != live_.end()) {
+      uint32_t start, length;
+      if (l == live_.end() || (f != free_.end() && f->first < l->first)) {
+        start = f->first;
+        length = f->second;
+        ++f;
+      } else {
+        bool mine = l->second.owner == owner;
+        start = l->first;
+        length = l->second.size;
+        ++l;
+        if (!mine) {
+          inRun = false;
+          continue;
+        }
+      }
+      if (inRun && start == runEnd) {
+        runEnd += length;
+      } else {
+        runStart = start;
+        runEnd = start + length;
+        inRun = true;
+      }
+      if (runEnd - runStart > best)
+        best = runEnd - runStart;
+    }
+    return best > BLOCK_OVERHEAD ? best - BLOCK_OVERHEAD : 0;
+  }
+
+ private:
+  struct Block {
+    uint32_t size;
+    uint8_t owner;
+  };
+  typedef std::map<uint32_t, uint32_t, std::less<uint32_t>, MallocAllocator<std::pair<const uint32_t, uint32_t>>>
+      FreeMap;
+  typedef std::map<uint32_t, Block, std::less<uint32_t>, MallocAllocator<std::pair<const uint32_t, Block>>> LiveMap;
+
+  uint32_t size_ = 0;
+  FreeMap free_;
+  LiveMap live_;
+  uint32_t freeBytes_ = 0;
+  uint32_t minFreeBytes_ = 0;
+  uint32_t failures_ = 0;
+};
+
+// Never destroyed: operator delete can still run during static destruction
+inline Heap& heap() {
+  static Heap* h = new (malloc(sizeof(Heap))) Heap();
+  return *h;
+}
+
+}  // namespace HeapModel
@@ -0,0 +1,93 @@
+#pragma once
+
+/**
+ * MappedFile.h - Read-only memory-mapped file for the SD mock
+ *
+ * With SD.mapReads set, MockSD::open() maps files opened for reading instead
+ * of copying them into a std::string, and copies of the MockFile share the
+ * mapping. Opening a book then costs no copy of the file, so layout,
+ * hyphenation and rendering can be benchmarked over a whole library at host
+ * speed. Reads still go through MockFile::read() and the cost model, so
+ * estimated device time is unchanged. Platforms without mmap read the file
+ * into memory once.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+ public:
+  explicit MappedFile(const char* path) {
+#ifdef _WIN32
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+      return;
+    in.seekg(0, std::ios::end);
+    copy_.resize((size_t)in.tellg());
+    in.seekg(0, std::ios::beg);
+    in.read(copy_.data(), copy_.size());
+    data_ = copy_.data();
+    size_ = copy_.size();
+    valid_ = true;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+      size_ = (size_t)st.st_size;
+      valid_ = true;
+      // mmap of an empty file fails; an empty file is still a valid file
+      if (size_ > 0) {
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+          size_ = 0;
+          valid_ = false;
+        } else {
+          data_ = static_cast<const char*>(p);
+        }
+      }
+    }
+    ::close(fd);
+#endif
+  }
+
+  ~MappedFile() {
+#ifndef _WIN32
+    if (data_)
+      munmap(const_cast<char*>(data_), size_);
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool valid() const {
+    return valid_;
+  }
+  const char* data() const {
+    return data_;
+  }
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  bool valid_ = false;
+#ifdef _WIN32
+  std::vector<char> copy_;
+#endif
+};
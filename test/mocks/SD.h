@@ -1,31 +1,46 @@
 #pragma once
 
 #include <algorithm>
+#include "CostModel.h"
+#include "MappedFile.h"
 #include "platform_stubs.h"
 #include "WString.h"
 using std::min;
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <ctime>
+#include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <vector>
 
+#include <sys/stat.h>
 #ifdef _WIN32
 #include <direct.h>
-#else
-#include <sys/stat.h>
 #endif
 
 // File open modes
 #define FILE_READ 0
 #define FILE_WRITE 1
+#define FILE_APPEND 2
 
 struct MockFile {
-  std::string content;
+  std::string content;                        // Write mode, and read mode without SD.mapReads
+  std::shared_ptr<const MappedFile> mapping;  // Read mode with SD.mapReads; shared by copies
   std::string filepath;
   size_t currentPos = 0;
   bool isOpen = false;
   bool isWriteMode = false;
+  int64_t lastSector = -1;       // Cost model: sector in the read cache
+  int64_t lastWriteSector = -1;  // Cost model: sector in the write cache
+  bool isDir = false;                    // Directory handle (SD.openDirectories)
+  std::vector<std::string> dirEntries;   // Entry names, sorted
+  size_t dirIndex = 0;                   // Next entry for openNextFile()
+  std::string entryName;                 // Set on handles from openNextFile(): name() is the bare name there
   MockFile() {}
   ~MockFile() {
     close();
@@ -34,7 +49,10 @@ struct MockFile {
     return isOpen;
   }
   size_t size() const {
-    return content.size();
+    return mapping ? mapping->size() : content.size();
+  }
+  const char* data() const {
+    return mapping ? mapping->data() : content.data();
   }
   size_t position() {
     return currentPos;
@@ -48,19 +66,22 @@ struct MockFile {
   size_t read(void* buf, size_t len) {
     if (!isOpen)
       return 0;
-    size_t toRead = std::min(len, content.size() - currentPos);
-    memcpy(buf, content.data() + currentPos, toRead);
+    size_t toRead = currentPos < size() ? std::min(len, size() - currentPos) : 0;
+    CostModel::onSdRead(currentPos, toRead, lastSector);
+    memcpy(buf, data() + currentPos, toRead);
     currentPos += toRead;
     return toRead;
   }
   int read() {
-    if (!isOpen || currentPos >= content.size())
+    if (!isOpen || currentPos >= size())
       return -1;
-    return static_cast<unsigned char>(content[currentPos++]);
+    CostModel::onSdRead(currentPos, 1, lastSector);
+    return static_cast<unsigned char>(data()[currentPos++]);
   }
   size_t write(const uint8_t* buf, size_t len) {
     if (!isOpen)
       return 0;
+    CostModel::onSdWrite(content.size(), len, lastWriteSector);
     content.append(reinterpret_cast<const char*>(buf), len);
     currentPos = content.size();
     return len;
@@ -69,6 +90,7 @@ struct MockFile {
     if (!isOpen || !str)
       return 0;
     size_t len = strlen(str);
+    CostModel::onSdWrite(content.size(), len, lastWriteSector);
     content.append(str, len);
     currentPos = content.size();
     return len;
@@ -76,11 +98,21 @@ struct MockFile {
   size_t print(const String& str) {
     return print(str.c_str());
   }
-  bool isDirectory() const { return false; }
-  MockFile openNextFile() const { return MockFile(); }
-  const char* name() const { return filepath.c_str(); }
+  // Integers print in decimal, as with Arduino's Print (String's char constructor would take a size_t otherwise)
+  template <typename T,
+            typename = typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, char>::value>::type>
+  size_t print(T value) {
+    return print(std::to_string(value).c_str());
+  }
+  bool isDirectory() const { return isDir; }
+  MockFile openNextFile();
+  const char* name() const { return entryName.empty() ? filepath.c_str() : entryName.c_str(); }
+  time_t getLastWrite() const {
+    struct stat st;
+    return (isOpen && ::stat(filepath.c_str(), &st) == 0) ? st.st_mtime : 0;
+  }
   bool available() {
-    return isOpen && currentPos < content.size();
+    return isOpen && currentPos < size();
   }
   void close() {
     if (isOpen && isWriteMode && !filepath.empty()) {
@@ -93,13 +125,24 @@ struct MockFile {
     }
     isOpen = false;
     isWriteMode = false;
+    isDir = false;
+    dirEntries.clear();
+    dirIndex = 0;
+    entryName.clear();
     content.clear();
+    mapping.reset();
     filepath.clear();
     currentPos = 0;
   }
 };
 
 struct MockSD {
+  // Map files opened for reading instead of copying them (see MappedFile.h)
+  bool mapReads = false;
+  // Open directories for openNextFile() iteration. Off by default: on the host, code that walks directories (such
+  // as removing an EPUB extract cache) then changes files on disk
+  bool openDirectories = false;
+
   bool begin(int cs, MockSPI& spi, unsigned long freq) {
     (void)cs; (void)spi; (void)freq; return true;
   }
@@ -109,12 +152,45 @@ struct MockSD {
 
     if (mode == FILE_WRITE) {
       // Write mode - create new file
+      CostModel::onSdOpen();
       f.isOpen = true;
       f.isWriteMode = true;
+    } else if (mode == FILE_APPEND) {
+      // Append mode - writes go after the existing content (created if missing)
+      CostModel::onSdOpen();
+      f.isOpen = true;
+      f.isWriteMode = true;
+      std::ifstream in(path, std::ios::binary);
+      if (in.is_open())
+        f.content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+      f.currentPos = f.content.size();
     } else {
       // Read mode - load existing file
+      // Directories open as streams on some platforms but cannot be read
+      std::error_code ec;
+      if (std::filesystem::is_directory(path, ec)) {
+        if (!openDirectories)
+          return f;
+        CostModel::onSdOpen();
+        f.isOpen = true;
+        f.isDir = true;
+        for (const auto& entry : std::filesystem::directory_iterator(path, ec))
+          f.dirEntries.push_back(entry.path().filename().string());
+        std::sort(f.dirEntries.begin(), f.dirEntries.end());
+        return f;
+      }
+      if (mapReads) {
+        auto mapping = std::make_shared<const MappedFile>(path);
+        if (mapping->valid()) {
+          CostModel::onSdOpen();
+          f.isOpen = true;
+          f.mapping = mapping;
+        }
+        return f;
+      }
       std::ifstream in(path, std::ios::binary);
       if (in.is_open()) {
+        CostModel::onSdOpen();
         f.isOpen = true;
         std::string& content = f.content;
         in.seekg(0, std::ios::end);
@@ -140,7 +216,23 @@ struct MockSD {
   bool remove(const char* path) {
     return std::remove(path) == 0;
   }
+  bool rename(const char* from, const char* to) {
+    return std::rename(from, to) == 0;
+  }
 };
 
 extern MockSD SD;
-typedef MockFile File;
\ No newline at end of file
+typedef MockFile File;
+
+inline MockFile MockFile::openNextFile() {
+  if (!isDir || dirIndex >= dirEntries.size())
+    return MockFile();
+  const std::string& entry = dirEntries[dirIndex++];
+  std::string path = filepath;
+  if (path.empty() || path.back() != '/')
+    path += '/';
+  MockFile f = SD.open((path + entry).c_str());
+  if (f)
+    f.entryName = entry;
+  return f;
+}
\ No newline at end of file
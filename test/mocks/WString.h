@@ -3,6 +3,7 @@
 // used only for building unit tests on the host.
 #pragma once
 
+#include <cstring>
 #include <string>
 
 class String {
@@ -84,6 +85,12 @@ class String {
     size_t pos = s_.find(str, start);
     return (pos == std::string::npos) ? -1 : static_cast<int>(pos);
   }
+  bool endsWith(const char* suffix) const {
+    if (!suffix)
+      return false;
+    size_t n = strlen(suffix);
+    return s_.size() >= n && s_.compare(s_.size() - n, n, suffix) == 0;
+  }
   bool isEmpty() const {
     return s_.empty();
   }
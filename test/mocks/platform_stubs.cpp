@@ -15,6 +15,8 @@ MockSD SD;
 
 // Implement MockSerial methods
 void MockSerial::printf(const char* fmt, ...) {
+  if (muted)
+    return;
   va_list args;
   va_start(args, fmt);
   vprintf(fmt, args);
@@ -67,9 +69,15 @@ MockSPI SPI;
 // Provide ESP mock object
 MockESP ESP;
 
-// Provide millis() implementation for host tests
+// Provide millis() and micros() implementations for host tests
 unsigned long millis() {
   using namespace std::chrono;
   static const auto start = steady_clock::now();
   return static_cast<unsigned long>(duration_cast<milliseconds>(steady_clock::now() - start).count());
 }
+
+unsigned long micros() {
+  using namespace std::chrono;
+  static const auto start = steady_clock::now();
+  return static_cast<unsigned long>(duration_cast<microseconds>(steady_clock::now() - start).count());
+}
@@ -5,6 +5,9 @@
 #include <cstdint>
 #include <cstdio>
 
+#include "CostModel.h"
+#include "HeapModel.h"
+
 // PROGMEM / pgm_read helpers for host builds
 #ifndef PROGMEM
 #define PROGMEM
@@ -29,8 +32,13 @@ struct MockSPI {
   }
   void beginTransaction(const SPISettings&) {}
   void endTransaction() {}
-  void transfer(uint8_t) {}
-  void writeBytes(const uint8_t* data, size_t length) {}
+  void transfer(uint8_t) {
+    CostModel::onSpiBytes(1);
+  }
+  void writeBytes(const uint8_t* data, size_t length) {
+    (void)data;
+    CostModel::onSpiBytes(length);
+  }
 };
 
 extern MockSPI SPI;
@@ -83,6 +91,7 @@ class Print {
 };
 
 struct MockSerial : public Print {
+  bool muted = false;  // Drop all output (benchmarks keep stdout quiet)
   void printf(const char*, ...);
   void println(const char*);
   void println(int v);
@@ -93,27 +102,32 @@ struct MockSerial : public Print {
   void print(int v);
   void print(const String& s);
   size_t write(uint8_t c) {
-    putchar(c);
+    if (!muted)
+      putchar(c);
     return 1;
   }
 };
 
 extern MockSerial Serial;
 
-// Mock ESP class for ESP32-specific functions
+// Mock ESP class for ESP32-specific functions, backed by the heap model (see HeapModel.h)
 struct MockESP {
   uint32_t getFreeHeap() {
-    return 100000;  // Return a reasonable fake value
+    return HeapModel::heap().freeBytes();
   }
   uint32_t getHeapSize() {
-    return 320000;  // Return a reasonable fake total heap size
+    return HeapModel::heap().size();
   }
   uint32_t getMinFreeHeap() {
-    return 80000;  // Return a reasonable fake minimum free heap
+    return HeapModel::heap().minFreeBytes();
+  }
+  uint32_t getMaxAllocHeap() {
+    return HeapModel::heap().largestFree();
   }
 };
 
 extern MockESP ESP;
 
-// Host millis() declaration (defined in platform_stubs.cpp)
+// Host millis()/micros() declarations (defined in platform_stubs.cpp)
 unsigned long millis();
+unsigned long micros();
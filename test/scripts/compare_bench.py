@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compare two microreader_bench result files.
+
+Usage: compare_bench.py BASE.json NEW.json [--threshold PERCENT] [--metric median_ms]
+
+Prints the change of the timing metric and of allocations per operation for
+every (book, scenario) pair and exits with status 1 if any of them got slower
+or allocates more than the threshold allows. Schema 2 results also carry the
+cost model's estimated device time; compare it with --metric est_device_ms_mean.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path, encoding="utf-8") as f:
+        data = json.load(f)
+    if data.get("schema") not in (1, 2):
+        raise SystemExit(f"{path}: unsupported schema {data.get('schema')}")
+    return data, {(r["book"], r["scenario"]): r for r in data["results"]}
+
+
+def change(old, new):
+    if old == 0:
+        return 0.0 if new == 0 else float("inf")
+    return (new - old) * 100.0 / old
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("base")
+    parser.add_argument("new")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed slowdown in percent (default 10)")
+    parser.add_argument("--metric", default="median_ms", help="timing field to compare (default median_ms)")
+    args = parser.parse_args()
+
+    base_data, base = load(args.base)
+    new_data, new = load(args.new)
+    if base_data["config"] != new_data["config"] or base_data["corpus"] != new_data["corpus"]:
+        print("warning: runs used different configurations or corpora", file=sys.stderr)
+
+    regressions = 0
+    print(f"{'book':16} {'scenario':16} {args.metric:>12} {'change':>8} {'allocs/op':>10} {'change':>8}")
+    for key in sorted(set(base) | set(new)):
+        if key not in base or key not in new:
+            print(f"{key[0]:16} {key[1]:16} {'only in ' + ('new' if key in new else 'base'):>12}")
+            continue
+        b, n = base[key], new[key]
+        t = change(b[args.metric], n[args.metric])
+        a = change(b["allocs_per_op"], n["allocs_per_op"])
+        flag = ""
+        if t > args.threshold or a > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(
+            f"{key[0]:16} {key[1]:16} {n[args.metric]:12.3f} {t:+7.1f}% {n['allocs_per_op']:10.1f} {a:+7.1f}%{flag}"
+        )
+
+    if regressions:
+        print(f"\n{regressions} regression(s) above {args.threshold}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
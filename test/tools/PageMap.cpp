@@ -0,0 +1,107 @@
+#include "PageMap.h"
+
+#include "content/providers/WordProvider.h"
+#include "rendering/TextRenderer.h"
+#include "resources/fonts/FontDefinitions.h"
+#include "test_config.h"
+#include "text/hyphenation/HyphenationStrategy.h"
+
+namespace PageMap {
+
+namespace {
+
+const NamedLanguage LANGUAGES[] = {
+    {"none", Language::NONE},
+    {"basic", Language::BASIC},
+    {"english", Language::ENGLISH},
+    {"german", Language::GERMAN},
+};
+
+}  // namespace
+
+const std::vector<Font>& fonts() {
+  static const std::vector<Font> all = {
+      {"bookerly26", &bookerly26Family, 26}, {"bookerly28", &bookerly28Family, 28},
+      {"bookerly30", &bookerly30Family, 30}, {"notosans26", &notoSans26Family, 26},
+      {"notosans28", &notoSans28Family, 28}, {"notosans30", &notoSans30Family, 30},
+  };
+  return all;
+}
+
+const Font* findFont(const std::string& name) {
+  for (const Font& font : fonts())
+    if (name == font.name)
+      return &font;
+  return nullptr;
+}
+
+const NamedLanguage* findLanguage(const std::string& name) {
+  for (const NamedLanguage& language : LANGUAGES)
+    if (name == language.name)
+      return &language;
+  return nullptr;
+}
+
+Settings defaultSettings() {
+  Settings settings;
+  settings.font = &fonts()[0];
+  settings.language = findLanguage("english");
+  return settings;
+}
+
+LayoutStrategy::LayoutConfig layoutConfig(const Settings& settings) {
+  LayoutStrategy::LayoutConfig cfg;
+  cfg.marginLeft = settings.margin;
+  cfg.marginRight = settings.margin;
+  cfg.marginTop = ::TestConfig::DEFAULT_MARGIN_TOP;
+  cfg.marginBottom = ::TestConfig::DEFAULT_MARGIN_BOTTOM;
+  cfg.lineSpacing = settings.lineSpacing;
+  cfg.lineHeight = settings.font->size + settings.lineSpacing;
+  cfg.minSpaceWidth = ::TestConfig::DEFAULT_MIN_SPACE_WIDTH;
+  cfg.pageWidth = ::TestConfig::DISPLAY_WIDTH;
+  cfg.pageHeight = ::TestConfig::DISPLAY_HEIGHT;
+  cfg.alignment = LayoutStrategy::ALIGN_LEFT;
+  cfg.language = settings.language->language;
+  return cfg;
+}
+
+std::string describe(const Settings& settings) {
+  LayoutStrategy::LayoutConfig cfg = layoutConfig(settings);
+  return std::string("layout=") + (settings.knuthPlass ? "knuth-plass" : "greedy") + " font=" + settings.font->name +
+         " language=" + settings.language->name + " margin=" + std::to_string(settings.margin) +
+         " spacing=" + std::to_string(settings.lineSpacing) + " page=" + std::to_string(cfg.pageWidth) + "x" +
+         std::to_string(cfg.pageHeight);
+}
+
+std::vector<int> paginateChapter(WordProvider& provider, LayoutStrategy& layout, TextRenderer& renderer,
+                                 const LayoutStrategy::LayoutConfig& config, bool render) {
+  std::vector<int> starts;
+  provider.setPosition(0);
+  while (true) {
+    int start = provider.getCurrentIndex();
+    starts.push_back(start);
+    LayoutStrategy::PageLayout page = layout.layoutText(provider, renderer, config);
+    if (render)
+      layout.renderPage(page, renderer, config);
+    if (page.endPosition <= start || provider.getChapterPercentage(page.endPosition) >= 1.0f)
+      break;
+    provider.setPosition(page.endPosition);
+  }
+  return starts;
+}
+
+bool write(const std::string& path, const std::string& header, const std::vector<std::vector<int>>& chapters) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f)
+    return false;
+  fprintf(f, "# microreader page map: %s\n", header.c_str());
+  for (size_t c = 0; c < chapters.size(); c++) {
+    fprintf(f, "%zu,", c);
+    for (size_t p = 0; p < chapters[c].size(); p++)
+      fprintf(f, p == 0 ? "%d" : " %d", chapters[c][p]);
+    fprintf(f, "\n");
+  }
+  return fclose(f) == 0;
+}
+
+}  // namespace PageMap
@@ -0,0 +1,60 @@
+#pragma once
+
+/**
+ * PageMap.h - Shared pieces of the host library tools
+ *
+ * Reader settings as TextViewerScreen applies them (font, margin, line
+ * spacing, hyphenation language), forward pagination of a chapter the way
+ * the reader turns pages, and the page map file: a header line naming the
+ * settings followed by one "chapter,start start ..." line per chapter, in
+ * the terms of the reader's .pos files.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "text/layout/LayoutStrategy.h"
+
+class TextRenderer;
+class WordProvider;
+
+namespace PageMap {
+
+struct Font {
+  const char* name;
+  FontFamily* family;
+  int size;
+};
+
+struct NamedLanguage {
+  const char* name;
+  Language language;
+};
+
+// Built-in reading fonts, "bookerly26" first
+const std::vector<Font>& fonts();
+const Font* findFont(const std::string& name);
+const NamedLanguage* findLanguage(const std::string& name);
+
+struct Settings {
+  bool knuthPlass = true;  // The reader's layout
+  const Font* font = nullptr;
+  const NamedLanguage* language = nullptr;
+  int margin = 10;
+  int lineSpacing = 4;
+};
+
+// Defaults of TextViewerScreen: Knuth-Plass, bookerly26, English, margin 10, spacing 4
+Settings defaultSettings();
+LayoutStrategy::LayoutConfig layoutConfig(const Settings& settings);
+std::string describe(const Settings& settings);
+
+// Page starts of the provider's current chapter; renders each page into the renderer's frame buffer if render
+std::vector<int> paginateChapter(WordProvider& provider, LayoutStrategy& layout, TextRenderer& renderer,
+                                 const LayoutStrategy::LayoutConfig& config, bool render);
+
+// header is written after "# microreader page map: "
+bool write(const std::string& path, const std::string& header, const std::vector<std::vector<int>>& chapters);
+
+}  // namespace PageMap
@@ -0,0 +1,214 @@
+/**
+ * PaginateLibrary.cpp - Batch pagination of a book library on the host
+ *
+ * Paginates every .txt and .epub file under the given paths with the
+ * device's layout code and writes a page map per book: one line per chapter
+ * listing the provider index at which each page starts, in the same
+ * "chapter,position" terms as the reader's .pos files. The maps are only
+ * valid for the layout, font and page size named in their header (and, for
+ * EPUBs, for the converter version that produced the chapter text).
+ *
+ * Files are memory mapped through the SD mock (SD.mapReads), so a run over
+ * hundreds of books measures layout, hyphenation and (with --render)
+ * rendering rather than file emulation. Run from the repository root:
+ *
+ *   test/build/tools/microreader_paginate [--layout greedy|knuth-plass] [--font NAME]
+ *                                         [--language none|basic|english|german] [--margin PX]
+ *                                         [--out DIR] [--render] [--no-mmap] PATH...
+ *
+ * Without --out each map is written next to its book as <book>.pages.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "PageMap.h"
+#include "SD.h"
+#include "content/providers/EpubWordProvider.h"
+#include "content/providers/FileWordProvider.h"
+#include "core/EInkDisplay.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "test_config.h"
+#include "text/hyphenation/HyphenationStrategy.h"
+#include "text/layout/GreedyLayoutStrategy.h"
+#include "text/layout/KnuthPlassLayoutStrategy.h"
+
+// The EPUB parser borrows this display's frame buffer as its inflate window (see main.cpp)
+EInkDisplay einkDisplay(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                        ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+
+namespace {
+
+struct Options {
+  PageMap::Settings settings = PageMap::defaultSettings();
+  std::string out;  // Next to each book if empty
+  bool render = false;
+  bool mapReads = true;
+  std::vector<std::string> paths;
+};
+
+struct BookResult {
+  int chapters = 0;
+  int pages = 0;
+  size_t bytes = 0;
+  double ms = 0;
+};
+
+bool isBook(const std::filesystem::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == ".txt" || ext == ".epub";
+}
+
+std::vector<std::string> collectBooks(const std::vector<std::string>& paths) {
+  std::vector<std::string> books;
+  for (const auto& path : paths) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(path, ec)) {
+      books.push_back(path);
+      continue;
+    }
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec))
+      if (entry.is_regular_file() && isBook(entry.path()))
+        books.push_back(entry.path().string());
+  }
+  // Directory order is filesystem dependent; sort for repeatable runs
+  std::sort(books.begin(), books.end());
+  return books;
+}
+
+bool paginateBook(const std::string& path, const Options& opt, LayoutStrategy& layout, TextRenderer& renderer,
+                  BookResult& result) {
+  std::error_code ec;
+  result.bytes = (size_t)std::filesystem::file_size(path, ec);
+  const LayoutStrategy::LayoutConfig cfg = PageMap::layoutConfig(opt.settings);
+  std::vector<std::vector<int>> chapters;
+
+  auto start = std::chrono::steady_clock::now();
+  WordProvider* provider = nullptr;
+  bool valid = false;
+  if (std::filesystem::path(path).extension() == ".txt") {
+    FileWordProvider* txt = new FileWordProvider(path.c_str());
+    valid = txt->isValid();
+    provider = txt;
+  } else {
+    EpubWordProvider* epub = new EpubWordProvider(path.c_str());
+    valid = epub->isValid();
+    provider = epub;
+  }
+  if (valid) {
+    int count = provider->hasChapters() ? provider->getChapterCount() : 1;
+    chapters.resize(count);
+    for (int c = 0; c < count; c++) {
+      if (provider->hasChapters())
+        provider->setChapter(c);
+      chapters[c] = PageMap::paginateChapter(*provider, layout, renderer, cfg, opt.render);
+      result.pages += (int)chapters[c].size();
+    }
+    result.chapters = count;
+  }
+  delete provider;
+  result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  if (!valid)
+    return false;
+
+  std::string mapPath = opt.out.empty() ? path + ".pages"
+                                        : opt.out + "/" + std::filesystem::path(path).filename().string() + ".pages";
+  return PageMap::write(mapPath, PageMap::describe(opt.settings), chapters);
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--layout" && i + 1 < argc) {
+      std::string value = argv[++i];
+      if (value != "greedy" && value != "knuth-plass")
+        return false;
+      opt.settings.knuthPlass = value == "knuth-plass";
+    } else if (arg == "--font" && i + 1 < argc) {
+      opt.settings.font = PageMap::findFont(argv[++i]);
+      if (!opt.settings.font)
+        return false;
+    } else if (arg == "--language" && i + 1 < argc) {
+      opt.settings.language = PageMap::findLanguage(argv[++i]);
+      if (!opt.settings.language)
+        return false;
+    } else if (arg == "--margin" && i + 1 < argc) {
+      opt.settings.margin = std::max(0, atoi(argv[++i]));
+    } else if (arg == "--out" && i + 1 < argc) {
+      opt.out = argv[++i];
+    } else if (arg == "--render") {
+      opt.render = true;
+    } else if (arg == "--no-mmap") {
+      opt.mapReads = false;
+    } else if (arg.rfind("--", 0) == 0) {
+      return false;
+    } else {
+      opt.paths.push_back(arg);
+    }
+  }
+  return !opt.paths.empty();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    fprintf(stderr,
+            "usage: %s [--layout greedy|knuth-plass] [--font NAME] [--language none|basic|english|german] "
+            "[--margin PX] [--out DIR] [--render] [--no-mmap] PATH...\n",
+            argv[0]);
+    return 2;
+  }
+  Serial.muted = true;
+  SD.mapReads = opt.mapReads;
+  if (!opt.out.empty())
+    std::filesystem::create_directories(opt.out);
+
+  einkDisplay.begin();
+  TextRenderer renderer(einkDisplay);
+  renderer.setFrameBuffer(einkDisplay.getFrameBuffer());
+  renderer.setTextColor(TextRenderer::COLOR_BLACK);
+  renderer.setFontFamily(opt.settings.font->family);
+  renderer.setFontStyle(FontStyle::REGULAR);
+
+  GreedyLayoutStrategy greedy;
+  KnuthPlassLayoutStrategy knuthPlass;
+  LayoutStrategy& layout = opt.settings.knuthPlass ? static_cast<LayoutStrategy&>(knuthPlass) : greedy;
+  layout.setLanguage(opt.settings.language->language);
+
+  std::vector<std::string> books = collectBooks(opt.paths);
+  int failed = 0;
+  BookResult total;
+  printf("%-40s %8s %8s %10s %10s\n", "book", "chapters", "pages", "ms", "pages/s");
+  for (const auto& book : books) {
+    BookResult result;
+    if (!paginateBook(book, opt, layout, renderer, result)) {
+      fprintf(stderr, "failed to paginate %s\n", book.c_str());
+      failed++;
+      continue;
+    }
+    std::string name = std::filesystem::path(book).filename().string();
+    if (name.size() > 40)
+      name = name.substr(0, 37) + "...";
+    printf("%-40s %8d %8d %10.1f %10.0f\n", name.c_str(), result.chapters, result.pages, result.ms,
+           result.ms > 0 ? result.pages * 1000.0 / result.ms : 0.0);
+    total.chapters += result.chapters;
+    total.pages += result.pages;
+    total.bytes += result.bytes;
+    total.ms += result.ms;
+  }
+  printf("\n%zu books, %d chapters, %d pages, %.1f MB in %.2f s: %.0f pages/s, %.2f MB/s%s\n",
+         books.size() - failed, total.chapters, total.pages, total.bytes / 1e6, total.ms / 1000.0,
+         total.ms > 0 ? total.pages * 1000.0 / total.ms : 0.0, total.ms > 0 ? total.bytes / 1e3 / total.ms : 0.0,
+         opt.render ? " (with rendering)" : "");
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+/**
+ * PrepareLibrary.cpp - Prepare a book library for the SD card on a PC
+ *
+ * Does the work the reader does on the first open of a book, with the same
+ * code, and writes the result into an SD card tree:
+ *
+ *   OUT/<book>                           copy of every .epub and .txt
+ *   OUT/microreader/epub_<name>/         the EPUB's extract directory: epub_meta.jnl
+ *                                        (CURRENT_EXTRACT_VERSION and file size),
+ *                                        container.xml, the OPF, NCX and CSS files and
+ *                                        the converted chapter text
+ *   OUT/microreader/epub_<name>/pages_<font>.txt   page map per font (PageMap.h)
+ *   OUT/<book>.<font>.pages              page map per font for TXT books
+ *
+ * Copying OUT to the card root makes the reader find a current extract
+ * directory on first open, so it skips extraction, CSS/TOC extraction and
+ * chapter conversion. Page maps are only valid for the settings named in
+ * their header. Run from the repository root:
+ *
+ *   test/build/tools/microreader_prepare --out DIR [--layout greedy|knuth-plass] [--font NAME ...]
+ *                                        [--language none|basic|english|german] [--margin PX]
+ *                                        [--spacing PX] PATH...
+ *
+ * --font may be given several times; the default is bookerly26.
+ *
+ * Each prepared EPUB is opened once more the way the device opens it, and
+ * the SD sectors that open writes are reported ("reopen writes"); anything
+ * but 0 means the device would rebuild the cache and counts as a failure.
+ * Chapter text is reused by EpubWordProvider whenever the file exists.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "CostModel.h"
+#include "PageMap.h"
+#include "SD.h"
+#include "content/epub/EpubReader.h"
+#include "content/providers/EpubWordProvider.h"
+#include "content/providers/FileWordProvider.h"
+#include "core/EInkDisplay.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "test_config.h"
+#include "text/layout/GreedyLayoutStrategy.h"
+#include "text/layout/KnuthPlassLayoutStrategy.h"
+
+// The EPUB parser borrows this display's frame buffer as its inflate window (see main.cpp)
+EInkDisplay einkDisplay(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                        ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+  PageMap::Settings settings = PageMap::defaultSettings();
+  std::vector<const PageMap::Font*> fonts;
+  std::string out;
+  std::vector<std::string> paths;
+};
+
+bool isBook(const fs::path& path) {
+  std::string ext = path.extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  return ext == ".txt" || ext == ".epub";
+}
+
+std::vector<std::string> collectBooks(const std::vector<std::string>& paths) {
+  std::vector<std::string> books;
+  for (const auto& path : paths) {
+    std::error_code ec;
+    if (!fs::is_directory(path, ec)) {
+      books.push_back(path);
+      continue;
+    }
+    for (const auto& entry : fs::recursive_directory_iterator(path, ec))
+      if (entry.is_regular_file() && isBook(entry.path()))
+        books.push_back(entry.path().string());
+  }
+  std::sort(books.begin(), books.end());
+  return books;
+}
+
+// Converts every chapter (EPUB) and writes one page map per font; returns the number of pages of the first font
+int prepareBook(const std::string& path, const Options& opt, TextRenderer& renderer, int& chapterCount) {
+  bool epub = fs::path(path).extension() == ".epub";
+  WordProvider* provider = nullptr;
+  String extractDir;
+  bool valid = false;
+  if (epub) {
+    EpubWordProvider* book = new EpubWordProvider(path.c_str());
+    valid = book->isValid();
+    if (valid)
+      extractDir = book->getEpubReader()->getExtractDir();
+    provider = book;
+  } else {
+    FileWordProvider* book = new FileWordProvider(path.c_str());
+    valid = book->isValid();
+    provider = book;
+  }
+  int firstFontPages = -1;
+  chapterCount = 0;
+  if (valid) {
+    chapterCount = provider->hasChapters() ? provider->getChapterCount() : 1;
+    for (const PageMap::Font* font : opt.fonts) {
+      PageMap::Settings settings = opt.settings;
+      settings.font = font;
+      const LayoutStrategy::LayoutConfig cfg = PageMap::layoutConfig(settings);
+      GreedyLayoutStrategy greedy;
+      KnuthPlassLayoutStrategy knuthPlass;
+      LayoutStrategy& layout = settings.knuthPlass ? static_cast<LayoutStrategy&>(knuthPlass) : greedy;
+      layout.setLanguage(cfg.language);
+      renderer.setFontFamily(font->family);
+
+      std::vector<std::vector<int>> chapters(chapterCount);
+      int pages = 0;
+      for (int c = 0; c < chapterCount; c++) {
+        // The first visit of an EPUB chapter converts it into the extract directory
+        if (provider->hasChapters())
+          provider->setChapter(c);
+        chapters[c] = PageMap::paginateChapter(*provider, layout, renderer, cfg, false);
+        pages += (int)chapters[c].size();
+      }
+      std::string mapPath = epub ? std::string(extractDir.c_str()) + "/pages_" + font->name + ".txt"
+                                 : path + "." + font->name + ".pages";
+      std::string header = PageMap::describe(settings);
+      if (epub)
+        header += std::string(" extract=") + EpubReader::getExtractVersion();
+      if (!PageMap::write(mapPath, header, chapters)) {
+        valid = false;
+        break;
+      }
+      if (firstFontPages < 0)
+        firstFontPages = pages;
+    }
+  }
+  delete provider;
+  return valid ? firstFontPages : -1;
+}
+
+// Sectors an EPUB open writes given the prepared extract directory; 0 means the device would reuse all of it
+uint64_t reopenSectorWrites(const std::string& path) {
+  uint64_t before = CostModel::counters().sdSectorWrites;
+  EpubReader reader(path.c_str());
+  return reader.isValid() ? CostModel::counters().sdSectorWrites - before : UINT64_MAX;
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--out" && i + 1 < argc) {
+      opt.out = argv[++i];
+    } else if (arg == "--layout" && i + 1 < argc) {
+      std::string value = argv[++i];
+      if (value != "greedy" && value != "knuth-plass")
+        return false;
+      opt.settings.knuthPlass = value == "knuth-plass";
+    } else if (arg == "--font" && i + 1 < argc) {
+      const PageMap::Font* font = PageMap::findFont(argv[++i]);
+      if (!font)
+        return false;
+      opt.fonts.push_back(font);
+    } else if (arg == "--language" && i + 1 < argc) {
+      opt.settings.language = PageMap::findLanguage(argv[++i]);
+      if (!opt.settings.language)
+        return false;
+    } else if (arg == "--margin" && i + 1 < argc) {
+      opt.settings.margin = std::max(0, atoi(argv[++i]));
+    } else if (arg == "--spacing" && i + 1 < argc) {
+      opt.settings.lineSpacing = std::max(0, atoi(argv[++i]));
+    } else if (arg.rfind("--", 0) == 0) {
+      return false;
+    } else {
+      opt.paths.push_back(arg);
+    }
+  }
+  if (opt.fonts.empty())
+    opt.fonts.push_back(opt.settings.font);
+  return !opt.out.empty() && !opt.paths.empty();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    fprintf(stderr,
+            "usage: %s --out DIR [--layout greedy|knuth-plass] [--font NAME ...] "
+            "[--language none|basic|english|german] [--margin PX] [--spacing PX] PATH...\n",
+            argv[0]);
+    return 2;
+  }
+  Serial.muted = true;
+  SD.mapReads = true;
+
+  std::error_code ec;
+  std::string extractRoot = opt.out + "/microreader";
+  fs::create_directories(extractRoot, ec);
+  EpubReader::setExtractRoot(extractRoot.c_str());
+
+  einkDisplay.begin();
+  TextRenderer renderer(einkDisplay);
+  renderer.setFrameBuffer(einkDisplay.getFrameBuffer());
+  renderer.setTextColor(TextRenderer::COLOR_BLACK);
+  renderer.setFontStyle(FontStyle::REGULAR);
+
+  std::vector<std::string> books = collectBooks(opt.paths);
+  int failed = 0;
+  double totalMs = 0;
+  printf("%-40s %8s %8s %10s %14s\n", "book", "chapters", "pages", "ms", "reopen writes");
+  for (const auto& book : books) {
+    // The device keys the extract directory on the file name, so the copy is what gets prepared
+    fs::path target = fs::path(opt.out) / fs::path(book).filename();
+    if (!fs::equivalent(book, target, ec))
+      fs::copy_file(book, target, fs::copy_options::overwrite_existing, ec);
+    auto start = std::chrono::steady_clock::now();
+    int chapters = 0;
+    int pages = ec ? -1 : prepareBook(target.string(), opt, renderer, chapters);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (pages < 0) {
+      fprintf(stderr, "failed to prepare %s\n", book.c_str());
+      failed++;
+      ec.clear();
+      continue;
+    }
+    std::string name = target.filename().string();
+    if (name.size() > 40)
+      name = name.substr(0, 37) + "...";
+    if (target.extension() == ".epub") {
+      uint64_t writes = reopenSectorWrites(target.string());
+      printf("%-40s %8d %8d %10.1f %14llu\n", name.c_str(), chapters, pages, ms, (unsigned long long)writes);
+      if (writes != 0)
+        failed++;
+    } else {
+      printf("%-40s %8d %8d %10.1f %14s\n", name.c_str(), chapters, pages, ms, "-");
+    }
+    totalMs += ms;
+  }
+  printf("\nPrepared %zu books in %.2f s into %s (extract version %s, %zu font%s)\n", books.size() - failed,
+         totalMs / 1000.0, opt.out.c_str(), EpubReader::getExtractVersion(), opt.fonts.size(),
+         opt.fonts.size() == 1 ? "" : "s");
+  return failed == 0 ? 0 : 1;
+}
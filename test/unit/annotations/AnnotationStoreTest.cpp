@@ -0,0 +1,188 @@
+#include <SD.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CostModel.h"
+#include "content/annotations/AnnotationStore.h"
+#include "lib/miniz.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Adds, queries and removes bookmarks and highlights of a book under
+// test/output (a bookmark that cannot be removed is reported as kept), then
+// checks the file-level guarantees: nothing is read before the first query, a
+// chapter is found without reading the whole store, a damaged store is
+// ignored and a replacement left behind by an interrupted write is adopted.
+
+namespace fs = std::filesystem;
+
+static void writeFile(const std::string& path, const std::string& content) {
+  std::ofstream out(path, std::ios::binary);
+  out << content;
+}
+
+static void putU32(std::string& s, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    s += (char)(v >> (8 * i));
+}
+
+// A store file with count records per chapter, written directly in the documented format
+static void writeStore(const std::string& path, int chapters, int perChapter) {
+  std::string s = "MRAN";
+  s += (char)1;
+  s += std::string(3, '\0');
+  putU32(s, (uint32_t)(chapters * perChapter));
+  for (int c = 0; c < chapters; c++) {
+    for (int i = 0; i < perChapter; i++) {
+      s += (char)c;
+      s += (char)(c >> 8);
+      s += (char)AnnotationStore::HIGHLIGHT;
+      s += '\0';
+      putU32(s, (uint32_t)(i * 100));
+      putU32(s, (uint32_t)(i * 100 + 20));
+    }
+  }
+  putU32(s, (uint32_t)mz_crc32(MZ_CRC32_INIT, (const unsigned char*)s.data(), s.size()));
+  writeFile(path, s);
+}
+
+static std::string describe(const std::vector<Annotation>& found) {
+  std::string s;
+  for (const auto& a : found) {
+    if (!s.empty())
+      s += ",";
+    s += std::to_string(a.chapter) + ":" + std::to_string(a.start) + "-" + std::to_string(a.end);
+  }
+  return s;
+}
+
+static std::string query(AnnotationStore& store, int chapter, uint32_t from, uint32_t to) {
+  std::vector<Annotation> found;
+  store.query(chapter, from, to, found);
+  return describe(found);
+}
+
+int main() {
+  TestUtils::TestRunner runner("Annotation Store Test");
+
+  const std::string dir = TestConfig::TEST_OUTPUT_DIR + "/annotations";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  const std::string book = dir + "/book.epub";
+  const std::string storePath = AnnotationStore::pathFor(String(book.c_str())).c_str();
+
+  // Adding and querying
+  {
+    AnnotationStore store;
+    store.open(String(book.c_str()));
+    runner.expectTrue(store.getCount() == 0 && query(store, 0, 0, 1000) == "", "no store file is an empty store");
+
+    runner.expectTrue(store.add({2, AnnotationStore::HIGHLIGHT, 500, 520}), "highlight added");
+    store.add({1, AnnotationStore::UNDERLINE, 40, 60});
+    store.add({2, AnnotationStore::HIGHLIGHT, 100, 900});
+    store.add({2, AnnotationStore::BOOKMARK, 1000, 1000});
+    store.add({2, AnnotationStore::HIGHLIGHT, 10, 30});
+    runner.expectTrue(store.add({2, AnnotationStore::HIGHLIGHT, 10, 30}) && store.getCount() == 5,
+                      "identical annotation added once", std::to_string(store.getCount()));
+    runner.expectTrue(fs::file_size(storePath) == AnnotationStore::HEADER_SIZE + 5 * AnnotationStore::RECORD_SIZE + 4,
+                      "fixed-size records");
+
+    runner.expectTrue(query(store, 2, 0, 2000) == "2:10-30,2:100-900,2:500-520,2:1000-1000", "chapter in order",
+                      query(store, 2, 0, 2000));
+    runner.expectTrue(query(store, 2, 600, 700) == "2:100-900", "range starting on an earlier page",
+                      query(store, 2, 600, 700));
+    runner.expectTrue(query(store, 2, 30, 100) == "", "ends are exclusive", query(store, 2, 30, 100));
+    runner.expectTrue(query(store, 2, 1000, 1001) == "2:1000-1000", "bookmark at the page start");
+    runner.expectTrue(query(store, 2, 900, 1000) == "", "bookmark after the page");
+    runner.expectTrue(query(store, 1, 0, 2000) == "1:40-60" && query(store, 3, 0, 2000) == "", "other chapters");
+
+    runner.expectTrue(store.remove({2, AnnotationStore::HIGHLIGHT, 100, 900}), "highlight removed");
+    runner.expectTrue(!store.remove({2, AnnotationStore::HIGHLIGHT, 100, 900}), "removed only once");
+    runner.expectTrue(query(store, 2, 600, 700) == "" && store.getCount() == 4, "removal is visible",
+                      query(store, 2, 600, 700));
+
+    bool bookmarked = false;
+    runner.expectTrue(store.toggleBookmark(1, 200, 400, bookmarked) && bookmarked, "bookmark toggled on");
+    runner.expectTrue(query(store, 1, 200, 400) == "1:200-200", "bookmark at the page start");
+
+    // A rewrite that cannot read the store is reported and leaves the bookmark in place
+    fs::rename(storePath, storePath + ".bak");
+    fs::create_directory(storePath);
+    runner.expectTrue(!store.toggleBookmark(1, 200, 400, bookmarked) && bookmarked &&
+                          query(store, 1, 200, 400) == "1:200-200",
+                      "failed removal reported", query(store, 1, 200, 400));
+    fs::remove(storePath);
+    fs::rename(storePath + ".bak", storePath);
+
+    runner.expectTrue(store.toggleBookmark(1, 200, 400, bookmarked) && !bookmarked &&
+                          query(store, 1, 0, 2000) == "1:40-60",
+                      "bookmark toggled off", query(store, 1, 0, 2000));
+    runner.expectTrue(!fs::exists(storePath + ".tmp"), "no temporary file left");
+  }
+
+  // Reopening reads what was written
+  {
+    AnnotationStore store;
+    store.open(String(book.c_str()));
+    runner.expectTrue(store.getCount() == 4, "count survives a reopen", std::to_string(store.getCount()));
+    runner.expectTrue(query(store, 2, 0, 2000) == "2:10-30,2:500-520,2:1000-1000", "records survive a reopen",
+                      query(store, 2, 0, 2000));
+  }
+
+  // Thousands of annotations: lazy open, chapters found in place, page queries from RAM
+  {
+    writeStore(storePath, 50, 100);
+    AnnotationStore store;
+    uint64_t readsBefore = CostModel::counters().sdSectorReads;
+    store.open(String(book.c_str()));
+    runner.expectTrue(CostModel::counters().sdSectorReads == readsBefore, "open reads nothing");
+    runner.expectTrue(query(store, 3, 1010, 1030) == "3:1000-1020", "query in a large store",
+                      query(store, 3, 1010, 1030));
+    runner.expectTrue(store.getCount() == 5000, "5000 annotations");
+
+    readsBefore = CostModel::counters().sdSectorReads;
+    runner.expectTrue(query(store, 37, 5000, 5200) == "37:5000-5020,37:5100-5120", "another chapter",
+                      query(store, 37, 5000, 5200));
+    uint64_t reads = CostModel::counters().sdSectorReads - readsBefore;
+    runner.expectTrue(reads <= 20, "chapter loaded without reading the store", std::to_string(reads));
+
+    readsBefore = CostModel::counters().sdSectorReads;
+    query(store, 37, 9000, 9400);
+    runner.expectTrue(CostModel::counters().sdSectorReads == readsBefore, "page queries come from RAM");
+    runner.expectTrue(query(store, 49, 9900, 10000) == "49:9900-9920", "last record");
+  }
+
+  // Damaged stores and interrupted writes
+  {
+    std::string good;
+    {
+      std::ifstream in(storePath, std::ios::binary);
+      good.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::string damaged = good;
+    damaged[AnnotationStore::HEADER_SIZE + 7] ^= 0x10;
+    writeFile(storePath, damaged);
+    AnnotationStore store;
+    store.open(String(book.c_str()));
+    runner.expectTrue(store.getCount() == 0 && query(store, 3, 0, 100000) == "", "damaged store ignored");
+
+    // The old file was removed but its replacement not yet renamed
+    fs::remove(storePath);
+    writeFile(storePath + ".tmp", good);
+    store.open(String(book.c_str()));
+    runner.expectTrue(store.getCount() == 5000, "replacement adopted", std::to_string(store.getCount()));
+    runner.expectTrue(fs::exists(storePath) && !fs::exists(storePath + ".tmp"), "replacement renamed");
+
+    // A replacement cut short leaves the old file in charge
+    writeFile(storePath + ".tmp", good.substr(0, good.size() / 2));
+    store.open(String(book.c_str()));
+    runner.expectTrue(store.getCount() == 5000 && query(store, 0, 0, 30) == "0:0-20", "partial replacement ignored");
+    runner.expectTrue(store.add({0, AnnotationStore::BOOKMARK, 5, 5}) && store.getCount() == 5001,
+                      "write after an interrupted one");
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
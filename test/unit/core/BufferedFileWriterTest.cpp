@@ -0,0 +1,106 @@
+#include <SD.h>
+
+#include <algorithm>
+#include <string>
+
+#include "CostModel.h"
+#include "core/BufferedFileWriter.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Checks the block writer: bytes arrive in order through put/write/print,
+// the file only ever sees whole blocks until the final flush, and writing a
+// file through it touches each sector once.
+
+static std::string pattern(size_t length) {
+  std::string s(length, '\0');
+  for (size_t i = 0; i < length; i++)
+    s[i] = (char)('a' + i % 26);
+  return s;
+}
+
+int main() {
+  TestUtils::TestRunner runner("Buffered File Writer Test");
+  const std::string path = TestConfig::TEST_OUTPUT_DIR + "/buffered_writer.txt";
+  const size_t BLOCK = BufferedFileWriter::DEFAULT_BLOCK_SIZE;
+
+  // Mixed put/write/print come out in order
+  {
+    File f = SD.open(path.c_str(), FILE_WRITE);
+    BufferedFileWriter out(f);
+    out.print("version=");
+    out.print(11ul);
+    out.put('\n');
+    out.print(String("key=value"));
+    out.write("\nxyz", 2);
+    runner.expectTrue(f.content.empty(), "nothing reaches the file before the block fills");
+    runner.expectTrue(out.flush(), "flush succeeds");
+    runner.expectTrue(f.content == "version=11\nkey=value\nx", "bytes in order", f.content);
+    runner.expectTrue(out.bytesWritten() == f.content.size(), "bytesWritten counts flushed bytes");
+  }
+
+  // put() hands the file whole blocks
+  {
+    File f = SD.open(path.c_str(), FILE_WRITE);
+    BufferedFileWriter out(f);
+    std::string expected = pattern(3 * BLOCK + 100);
+    bool wholeBlocks = true;
+    for (char c : expected) {
+      out.put(c);
+      wholeBlocks = wholeBlocks && f.content.size() % BLOCK == 0;
+    }
+    runner.expectTrue(wholeBlocks, "file grows by whole blocks");
+    runner.expectTrue(f.content.size() == 3 * BLOCK, "last partial block still buffered",
+                      std::to_string(f.content.size()));
+    out.flush();
+    runner.expectTrue(f.content == expected, "put() output matches");
+  }
+
+  // write() keeps block alignment across unaligned chunks and large runs
+  {
+    File f = SD.open(path.c_str(), FILE_WRITE);
+    BufferedFileWriter out(f);
+    std::string expected = pattern(10 * BLOCK + 77);
+    bool wholeBlocks = true;
+    size_t pos = 0;
+    const size_t chunks[] = {1, 2049, 3 * BLOCK + 5, 17, BLOCK, 2 * BLOCK - 1};
+    for (size_t i = 0; pos < expected.size(); i++) {
+      size_t n = std::min(chunks[i % 6], expected.size() - pos);
+      out.write(expected.data() + pos, n);
+      pos += n;
+      wholeBlocks = wholeBlocks && f.content.size() % BLOCK == 0;
+    }
+    runner.expectTrue(wholeBlocks, "unaligned chunks still reach the file as whole blocks");
+    out.flush();
+    runner.expectTrue(f.content == expected, "write() output matches");
+    runner.expectTrue(out.ok() && out.bytesWritten() == expected.size(), "all bytes accepted");
+  }
+
+  // Each sector of the file is written once
+  {
+    CostModel::Counters before = CostModel::counters();
+    File f = SD.open(path.c_str(), FILE_WRITE);
+    {
+      BufferedFileWriter out(f);
+      for (char c : pattern(64 * 1024))
+        out.put(c);
+    }
+    uint64_t sectors = CostModel::counters().sdSectorWrites - before.sdSectorWrites;
+    runner.expectTrue(sectors == 64 * 1024 / CostModel::SECTOR_SIZE, "one write per sector",
+                      std::to_string(sectors) + " sector writes");
+    runner.expectTrue(f.content.size() == 64 * 1024, "destructor flushes the rest");
+  }
+
+  // Small block for small files
+  {
+    File f = SD.open(path.c_str(), FILE_WRITE);
+    BufferedFileWriter out(f, BufferedFileWriter::SMALL_BLOCK_SIZE);
+    std::string expected = pattern(1500);
+    out.print(expected.c_str());
+    runner.expectTrue(f.content.size() == 1024, "small writer flushes per sector", std::to_string(f.content.size()));
+    out.flush();
+    runner.expectTrue(f.content == expected, "small writer output matches");
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include <cstdint>
+
+#include "HeapModel.h"
+#include "core/HeapTelemetry.h"
+#include "platform_stubs.h"
+#include "test_utils.h"
+
+// Checks the heap model (first fit, coalescing, per-owner fragmentation),
+// subsystem scopes and counters, and checkpoint minima with the subsystem
+// blamed for splitting the heap.
+
+int main() {
+  TestUtils::TestRunner runner("Heap Telemetry Test");
+
+  // First fit, header and alignment overhead, coalescing on release
+  HeapModel::Heap model(1024);
+  uint32_t a = model.allocate(100, 0);
+  uint32_t b = model.allocate(100, 1);
+  uint32_t c = model.allocate(100, 0);
+  runner.expectTrue(a == 0 && b == 108 && c == 216, "blocks placed first fit with overhead");
+  runner.expectTrue(model.freeBytes() == 1024 - 3 * 108, "free bytes account for headers");
+  model.release(b);
+  runner.expectTrue(model.allocate(50, 2) == b, "freed hole reused first");
+  model.release(b);
+  runner.expectTrue(model.largestFree() == 1024 - 324 - HeapModel::BLOCK_OVERHEAD, "tail is the largest block");
+  runner.expectTrue(model.largestFreeWithout(0) == 1024 - HeapModel::BLOCK_OVERHEAD,
+                    "without owner 0 the heap is one range");
+  runner.expectTrue(model.largestFreeWithout(1) == model.largestFree(), "owner without blocks changes nothing");
+  model.release(a);
+  model.release(c);
+  runner.expectTrue(model.freeBytes() == 1024 && model.largestFree() == 1024 - HeapModel::BLOCK_OVERHEAD,
+                    "everything coalesces back");
+  runner.expectTrue(model.allocate(2000, 0) == HeapModel::NONE && model.failures() == 1, "oversized request fails");
+  runner.expectTrue(model.minFreeBytes() == 1024 - 3 * 108, "minimum free bytes kept");
+
+  // Subsystem scopes nest and counters follow allocations and frees
+  HeapTelemetry::reset();
+  runner.expectTrue(HeapTelemetry::currentSubsystem() == HeapTelemetry::OTHER, "default subsystem");
+  {
+    HEAP_SUBSYSTEM(EPUB);
+    runner.expectTrue(HeapTelemetry::currentSubsystem() == HeapTelemetry::EPUB, "outer scope");
+    {
+      HEAP_SUBSYSTEM(LAYOUT);
+      runner.expectTrue(HeapTelemetry::currentSubsystem() == HeapTelemetry::LAYOUT, "inner scope");
+    }
+    runner.expectTrue(HeapTelemetry::currentSubsystem() == HeapTelemetry::EPUB, "inner scope restored");
+  }
+  runner.expectTrue(HeapTelemetry::currentSubsystem() == HeapTelemetry::OTHER, "outer scope restored");
+
+  HeapTelemetry::recordAlloc(HeapTelemetry::FONT, 300);
+  HeapTelemetry::recordAlloc(HeapTelemetry::FONT, 500);
+  HeapTelemetry::recordFree(HeapTelemetry::FONT, 300);
+  const HeapTelemetry::SubsystemStats& font = HeapTelemetry::subsystemStats(HeapTelemetry::FONT);
+  runner.expectTrue(HeapTelemetry::tracking(), "tracking once allocations are recorded");
+  runner.expectTrue(font.allocs == 2 && font.frees == 1 && font.liveBlocks == 1, "alloc and free counts");
+  runner.expectTrue(font.liveBytes == 500 && font.peakBytes == 800 && font.largestAlloc == 500, "live and peak bytes");
+  HeapTelemetry::reset();
+  runner.expectTrue(font.allocs == 0 && font.liveBytes == 500 && font.peakBytes == 500, "reset keeps live bytes");
+  HeapTelemetry::recordFree(HeapTelemetry::FONT, 500);
+
+  // Checkpoints keep the latest and lowest samples; the ESP mock reports the shared heap model
+  HeapModel::Heap& heap = HeapModel::heap();
+  heap.reset(64 * 1024);
+  HeapTelemetry::checkpoint("test");
+  uint32_t parserBuffer = heap.allocate(16 * 1024, HeapTelemetry::CONVERSION);
+  uint32_t pinned = heap.allocate(64, HeapTelemetry::EPUB);
+  heap.release(parserBuffer);
+  HeapTelemetry::checkpoint("test");
+  runner.expectTrue(HeapTelemetry::checkpointCount() == 1, "one entry per tag");
+  const HeapTelemetry::CheckpointStats& stats = HeapTelemetry::checkpointAt(0);
+  runner.expectTrue(stats.count == 2, "checkpoint counted twice");
+  runner.expectTrue(stats.last.freeHeap == heap.freeBytes() && stats.lowestFree == heap.freeBytes(),
+                    "free heap from the model");
+  runner.expectTrue(stats.lowestLargestBlock == heap.largestFree(), "lowest largest block kept");
+  runner.expectTrue(stats.blocker == HeapTelemetry::EPUB && stats.blockerGain > 0,
+                    "block left in the middle blamed on its subsystem");
+  heap.release(pinned);
+  HeapTelemetry::checkpoint("test");
+  runner.expectTrue(stats.last.largestBlock > stats.lowestLargestBlock, "latest sample recovers, lowest stays");
+  heap.reset();
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+#include <SD.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "CostModel.h"
+#include "core/JournalStore.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Commits batches to a journal under test/output and reopens it: values
+// survive, commits append instead of rewriting, a batch cut short by a reset
+// is dropped as a whole, a damaged tail is compacted away on the next
+// commit, stale logs are compacted, and a compaction interrupted before its
+// rename is adopted.
+
+namespace fs = std::filesystem;
+
+static std::string readFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+  std::ofstream out(path, std::ios::binary);
+  out << content;
+}
+
+static std::string value(JournalStore& store, const char* key) {
+  String v;
+  return store.get(String(key), v) ? v.c_str() : "<none>";
+}
+
+int main() {
+  TestUtils::TestRunner runner("Journal Store Test");
+
+  const std::string dir = TestConfig::TEST_OUTPUT_DIR + "/journal";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  const std::string path = dir + "/settings.jnl";
+
+  // Commit and reload
+  {
+    JournalStore store(String(path.c_str()));
+    runner.expectTrue(!store.load() && store.entries().empty(), "no log is an empty store");
+    store.set(String("ui.screen"), String("2"));
+    store.set(String("textviewer.lastPath"), String("/books/dune.epub"));
+    runner.expectTrue(value(store, "ui.screen") == "2", "staged value visible");
+    runner.expectTrue(store.commit() && fs::exists(path), "first commit creates the log");
+    runner.expectTrue(store.commit(), "nothing staged");
+    runner.expectTrue(!store.set(String(std::string(300, 'k').c_str()), String("v")), "overlong key rejected");
+  }
+  {
+    JournalStore store(String(path.c_str()));
+    runner.expectTrue(store.load() && store.entries().size() == 2, "log reloads");
+    runner.expectTrue(value(store, "textviewer.lastPath") == "/books/dune.epub", "value reloads");
+
+    // Small commits append to the end
+    size_t before = fs::file_size(path);
+    store.set(String("ui.screen"), String("1"));
+    store.set(String("ui.screen"), String("1"));
+    uint64_t writesBefore = CostModel::counters().sdSectorWrites;
+    runner.expectTrue(store.commit(), "second commit");
+    runner.expectTrue(fs::file_size(path) == before + JournalStore::RECORD_OVERHEAD + 9 + 1, "one record appended",
+                      std::to_string(fs::file_size(path) - before));
+    runner.expectTrue(CostModel::counters().sdSectorWrites - writesBefore <= 1, "append writes one sector");
+    runner.expectTrue(readFile(path).compare(0, before, readFile(path), 0, before) == 0, "earlier bytes untouched");
+
+    store.set(String("ui.screen"), String("1"));
+    size_t size = fs::file_size(path);
+    store.commit();
+    runner.expectTrue(fs::file_size(path) == size, "unchanged value writes nothing");
+
+    store.erase(String("textviewer.lastPath"));
+    store.commit();
+  }
+  std::string committed = readFile(path);
+  {
+    JournalStore store(String(path.c_str()));
+    store.load();
+    runner.expectTrue(value(store, "ui.screen") == "1" && value(store, "textviewer.lastPath") == "<none>",
+                      "update and erase reload");
+  }
+
+  // A reset in the middle of a batch
+  {
+    JournalStore store(String(path.c_str()));
+    store.load();
+    store.set(String("a"), String("first"));
+    store.set(String("b"), String("second"));
+    store.commit();
+    std::string full = readFile(path);
+    writeFile(path, full.substr(0, full.size() - 3));
+    JournalStore torn(String(path.c_str()));
+    torn.load();
+    runner.expectTrue(value(torn, "a") == "<none>" && value(torn, "b") == "<none>", "torn batch dropped whole");
+    runner.expectTrue(value(torn, "ui.screen") == "1", "earlier batches kept");
+
+    // The next commit does not build on the torn bytes
+    torn.set(String("c"), String("third"));
+    runner.expectTrue(torn.commit(), "commit after a torn batch");
+    JournalStore again(String(path.c_str()));
+    again.load();
+    runner.expectTrue(value(again, "c") == "third" && value(again, "a") == "<none>" && again.entries().size() == 2,
+                      "torn tail compacted away", std::to_string(again.entries().size()));
+    runner.expectTrue(again.getLogSize() == again.getLiveSize(), "log is compact");
+  }
+
+  // A flipped bit fails the record's CRC
+  {
+    std::string damaged = committed;
+    damaged[damaged.size() - 6] ^= 0x01;
+    writeFile(path, damaged);
+    JournalStore store(String(path.c_str()));
+    store.load();
+    runner.expectTrue(value(store, "ui.screen") == "1" && value(store, "textviewer.lastPath") == "/books/dune.epub",
+                      "replay stops at the damaged record", value(store, "textviewer.lastPath"));
+  }
+
+  // Stale logs compact
+  {
+    fs::remove(path);
+    JournalStore store(String(path.c_str()));
+    store.load();
+    store.set(String("other"), String("kept"));
+    store.commit();
+    for (int i = 0; i < 400; i++) {
+      store.set(String("position"), String(std::to_string(i).c_str()));
+      store.commit();
+    }
+    runner.expectTrue(store.getLogSize() < JournalStore::COMPACT_MIN_BYTES + 64, "log stays bounded",
+                      std::to_string(store.getLogSize()));
+    runner.expectTrue(fs::file_size(path) == store.getLogSize(), "log size tracked");
+    JournalStore reloaded(String(path.c_str()));
+    reloaded.load();
+    runner.expectTrue(value(reloaded, "position") == "399" && value(reloaded, "other") == "kept",
+                      "values survive compaction");
+  }
+
+  // Interrupted compaction
+  {
+    std::string log = readFile(path);
+    fs::remove(path);
+    writeFile(path + ".tmp", log);
+    JournalStore store(String(path.c_str()));
+    runner.expectTrue(store.load() && value(store, "position") == "399", "compacted log adopted");
+    runner.expectTrue(fs::exists(path) && !fs::exists(path + ".tmp"), "compacted log renamed");
+
+    writeFile(path + ".tmp", log.substr(0, log.size() / 2));
+    JournalStore again(String(path.c_str()));
+    runner.expectTrue(again.load() && value(again, "position") == "399" && !fs::exists(path + ".tmp"),
+                      "unfinished compaction discarded");
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
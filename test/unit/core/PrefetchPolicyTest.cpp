@@ -0,0 +1,110 @@
+#include <string>
+
+#include "core/PrefetchPolicy.h"
+#include "test_utils.h"
+
+// Feeds power states and page turns to the prefetch policy: the mode follows
+// battery charge and USB power, the reading direction and speed follow the
+// turns (jumps and long pauses do not count), and each mode asks for the
+// pages and chapters it documents.
+
+static std::string describe(const PrefetchPolicy::Plan& plan) {
+  return std::string("direction=") + std::to_string(plan.direction) + " page=" + (plan.layoutPage ? "1" : "0") +
+         " chapters=" + std::to_string(plan.chaptersAhead);
+}
+
+int main() {
+  TestUtils::TestRunner runner("Prefetch Policy Test");
+
+  // Modes
+  {
+    PrefetchPolicy policy;
+    runner.expectTrue(policy.getMode() == PrefetchPolicy::MODE_NORMAL, "normal until the power is known");
+    policy.setPowerState(90, true);
+    runner.expectTrue(policy.getMode() == PrefetchPolicy::MODE_EAGER, "eager on USB");
+    policy.setPowerState(10, true);
+    runner.expectTrue(policy.getMode() == PrefetchPolicy::MODE_EAGER, "eager on USB whatever the charge");
+    policy.setPowerState(80, false);
+    runner.expectTrue(policy.getMode() == PrefetchPolicy::MODE_NORMAL, "normal on a full battery");
+    policy.setPowerState(35, false);
+    runner.expectTrue(policy.getMode() == PrefetchPolicy::MODE_FRUGAL, "frugal on a half-empty battery");
+    policy.setPowerState(PrefetchPolicy::LOW_BATTERY_PERCENT, false);
+    runner.expectTrue(policy.getMode() == PrefetchPolicy::MODE_OFF, "off on a low battery");
+  }
+
+  // Direction and speed
+  {
+    PrefetchPolicy policy;
+    runner.expectTrue(policy.getDirection() == 1 && policy.getStreak() == 0, "forward before any turn");
+    policy.notePageTurn(1, 1000);
+    policy.notePageTurn(1, 21000);
+    policy.notePageTurn(1, 41000);
+    runner.expectTrue(policy.getStreak() == 3 && policy.getPageIntervalMs() == 20000, "forward reading",
+                      std::to_string(policy.getPageIntervalMs()));
+    policy.notePageTurn(-1, 45000);
+    runner.expectTrue(policy.getDirection() == -1 && policy.getStreak() == 1, "a turn back starts a new streak");
+    runner.expectTrue(policy.getPageIntervalMs() == 16000, "interval averaged",
+                      std::to_string(policy.getPageIntervalMs()));
+    policy.notePageTurn(-1, 45000 + PrefetchPolicy::MAX_PAGE_INTERVAL_MS + 1);
+    runner.expectTrue(policy.getPageIntervalMs() == 16000 && policy.getStreak() == 2, "long pause not averaged");
+    policy.noteJump();
+    policy.notePageTurn(1, 2000000);
+    runner.expectTrue(policy.getPageIntervalMs() == 16000 && policy.getStreak() == 1 && policy.getDirection() == 1,
+                      "a jump starts over");
+    for (int i = 0; i < 20; i++)
+      policy.notePageTurn(1, 2000000 + i);
+    runner.expectTrue(policy.getStreak() < 20, "streak is bounded");
+  }
+
+  // Plans
+  {
+    PrefetchPolicy policy;
+    policy.setPowerState(PrefetchPolicy::LOW_BATTERY_PERCENT, false);
+    PrefetchPolicy::Plan plan = policy.plan(0.0f);
+    runner.expectTrue(!plan.layoutPage && plan.chaptersAhead == 0, "off plans nothing", describe(plan));
+
+    policy.setPowerState(35, false);
+    policy.notePageTurn(1, 0);
+    plan = policy.plan(10.0f);
+    runner.expectTrue(!plan.layoutPage && plan.chaptersAhead == 0, "frugal waits for a streak", describe(plan));
+    policy.notePageTurn(1, 20000);
+    plan = policy.plan(10.0f);
+    runner.expectTrue(plan.layoutPage && plan.chaptersAhead == 0, "frugal next page", describe(plan));
+    plan = policy.plan(1.5f);
+    runner.expectTrue(plan.chaptersAhead == 1, "frugal next chapter on the last pages", describe(plan));
+
+    // 20 s per page: the next chapter is due 90 s before the end, 4.5 pages
+    policy.setPowerState(80, false);
+    plan = policy.plan(5.0f);
+    runner.expectTrue(plan.layoutPage && plan.chaptersAhead == 0, "normal far from the chapter end", describe(plan));
+    plan = policy.plan(4.0f);
+    runner.expectTrue(plan.chaptersAhead == 1, "normal next chapter within the lead time", describe(plan));
+    for (int i = 0; i < 10; i++)
+      policy.notePageTurn(1, 20000 + 2000 * (i + 1));
+    plan = policy.plan(20.0f);
+    runner.expectTrue(plan.chaptersAhead == 1, "a fast reader gets the next chapter earlier", describe(plan));
+
+    policy.setPowerState(50, true);
+    policy.notePageTurn(-1, 100000);
+    plan = policy.plan(100.0f);
+    runner.expectTrue(plan.layoutPage && plan.chaptersAhead == PrefetchPolicy::USB_CHAPTERS_AHEAD &&
+                          plan.direction == -1,
+                      "eager in the reading direction", describe(plan));
+  }
+
+  // Counters
+  {
+    PrefetchPolicy policy;
+    policy.recordIssued(PrefetchPolicy::KIND_PAGE);
+    policy.recordIssued(PrefetchPolicy::KIND_PAGE);
+    policy.recordUsed(PrefetchPolicy::KIND_PAGE);
+    policy.recordWasted(PrefetchPolicy::KIND_PAGE);
+    policy.recordIssued(PrefetchPolicy::KIND_CHAPTER);
+    const PrefetchPolicy::Counters& pages = policy.getCounters(PrefetchPolicy::KIND_PAGE);
+    const PrefetchPolicy::Counters& chapters = policy.getCounters(PrefetchPolicy::KIND_CHAPTER);
+    runner.expectTrue(pages.issued == 2 && pages.used == 1 && pages.wasted == 1, "page counters");
+    runner.expectTrue(chapters.issued == 1 && chapters.used == 0 && chapters.wasted == 0, "chapter counters");
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
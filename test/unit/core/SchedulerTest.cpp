@@ -0,0 +1,163 @@
+#include <Arduino.h>
+
+#include <string>
+
+#include "core/Scheduler.h"
+#include "test_utils.h"
+
+// Steps jobs through the scheduler: higher priorities first and equal ones in
+// turn, the run budget and a job's slice are respected, cancelled and
+// finished jobs are deleted (also when cancelled from their own step), the
+// preempt check stops a run before the next step, and the per-job counters
+// add up.
+
+static int liveJobs = 0;
+
+// Appends its tag to a shared log once per step, for a fixed number of steps
+class TagJob : public Job {
+ public:
+  TagJob(char tag, int steps, std::string& log, uint32_t spinMicros = 0)
+      : tag_(tag), steps_(steps), log_(log), spinMicros_(spinMicros) {
+    liveJobs++;
+  }
+  ~TagJob() override {
+    liveJobs--;
+  }
+
+  bool step(uint32_t budgetMicros) override {
+    lastBudget = budgetMicros;
+    unsigned long start = micros();
+    while (micros() - start < spinMicros_) {
+    }
+    log_ += tag_;
+    if (onStep)
+      onStep();
+    return --steps_ > 0;
+  }
+  void cancelled() override {
+    log_ += '!';
+  }
+  const char* name() const override {
+    return "tag";
+  }
+
+  uint32_t lastBudget = 0;
+  void (*onStep)() = nullptr;
+
+ private:
+  char tag_;
+  int steps_;
+  std::string& log_;
+  uint32_t spinMicros_;
+};
+
+static Scheduler* active = nullptr;
+static Scheduler::JobId selfId = Scheduler::NO_JOB;
+static bool nestedRan = true;
+
+static void cancelSelf() {
+  active->cancel(selfId);
+}
+
+static void runNested() {
+  nestedRan = active->run(1000000);
+}
+
+static bool pressWaiting = false;
+static bool checkPress(void*) {
+  return pressWaiting;
+}
+
+int main() {
+  TestUtils::TestRunner runner("Scheduler Test");
+
+  // Priorities and round robin
+  {
+    std::string log;
+    Scheduler scheduler;
+    scheduler.add(new TagJob('l', 2, log), Scheduler::PRIORITY_LOW);
+    scheduler.add(new TagJob('a', 3, log));
+    scheduler.add(new TagJob('b', 2, log));
+    scheduler.add(new TagJob('h', 1, log), Scheduler::PRIORITY_HIGH);
+    runner.expectTrue(scheduler.hasWork() && liveJobs == 4, "jobs queued");
+    runner.expectTrue(scheduler.run(1000000), "run steps jobs");
+    runner.expectTrue(log == "hababall", "priority order, equals in turn", log);
+    runner.expectTrue(!scheduler.hasWork() && liveJobs == 0, "finished jobs deleted");
+    runner.expectTrue(!scheduler.run(1000000), "nothing left to run");
+  }
+
+  // Budgets and counters
+  {
+    std::string log;
+    Scheduler scheduler;
+    TagJob* job = new TagJob('s', 1000, log, 2000);
+    Scheduler::JobId id = scheduler.add(job, Scheduler::PRIORITY_NORMAL, 1000);
+    scheduler.run(5000);
+    runner.expectTrue(log.size() >= 2 && log.size() <= 3, "run stops when its budget is used",
+                      std::to_string(log.size()));
+    runner.expectTrue(job->lastBudget <= 1000, "a step gets at most the job's slice", std::to_string(job->lastBudget));
+
+    Scheduler::JobStats stats;
+    runner.expectTrue(scheduler.getStats(id, stats) && stats.steps == log.size(), "steps counted");
+    runner.expectTrue(stats.cpuMicros >= 2000 * stats.steps && stats.longestStepMicros >= 2000, "CPU time counted",
+                      std::to_string(stats.cpuMicros));
+    runner.expectTrue(stats.overruns == stats.steps, "steps past the slice are overruns");
+    runner.expectTrue(std::string(stats.name) == "tag" && stats.state == Scheduler::STATE_QUEUED, "name and state");
+
+    // Cancelling
+    runner.expectTrue(scheduler.cancel(id) && log.back() == '!' && liveJobs == 0, "cancelled job told and deleted");
+    runner.expectTrue(!scheduler.isActive(id) && !scheduler.cancel(id), "cancelled only once");
+    runner.expectTrue(scheduler.getStats(id, stats) && stats.state == Scheduler::STATE_CANCELLED,
+                      "stats outlive the job");
+  }
+
+  // Cancelled from inside its own step, and no nested runs
+  {
+    std::string log;
+    Scheduler scheduler;
+    active = &scheduler;
+    TagJob* job = new TagJob('c', 5, log);
+    job->onStep = cancelSelf;
+    selfId = scheduler.add(job);
+    TagJob* nested = new TagJob('n', 1, log);
+    nested->onStep = runNested;
+    scheduler.add(nested, Scheduler::PRIORITY_HIGH);
+    scheduler.run(1000000);
+    runner.expectTrue(!nestedRan, "run from inside a step does nothing");
+    runner.expectTrue(log == "nc!" && liveJobs == 0, "job cancelled during its step", log);
+  }
+
+  // Preemption
+  {
+    std::string log;
+    Scheduler scheduler;
+    scheduler.setPreemptCheck(checkPress, nullptr);
+    Scheduler::JobId id = scheduler.add(new TagJob('p', 3, log));
+    pressWaiting = true;
+    runner.expectTrue(!scheduler.run(1000000) && log.empty(), "no step while a press waits");
+    runner.expectTrue(scheduler.getPreemptions() == 1 && scheduler.isActive(id), "preemption counted, job kept");
+    pressWaiting = false;
+    scheduler.run(1000000);
+    runner.expectTrue(log == "ppp", "job resumes after the press", log);
+  }
+
+  // Slots
+  {
+    std::string log;
+    Scheduler scheduler;
+    Scheduler::JobId first = scheduler.add(new TagJob('x', 1, log));
+    scheduler.run(1000000);
+    Scheduler::JobId last = Scheduler::NO_JOB;
+    for (size_t i = 0; i < Scheduler::MAX_JOBS; i++)
+      last = scheduler.add(new TagJob('y', 1, log));
+    Scheduler::JobStats stats;
+    runner.expectTrue(last != Scheduler::NO_JOB && !scheduler.getStats(first, stats), "finished slot reused");
+    Scheduler::JobId refused = scheduler.add(new TagJob('z', 1, log));
+    runner.expectTrue(refused == Scheduler::NO_JOB && liveJobs == (int)Scheduler::MAX_JOBS,
+                      "job refused when every slot is busy");
+    runner.expectTrue(last > first, "ids are not reused");
+  }
+  runner.expectTrue(liveJobs == 0, "scheduler deletes its jobs");
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "WString.h"
+#include "core/Trace.h"
+#include "platform_stubs.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Checks the trace ring: scoped begin/end records, wrap-around keeping the
+// newest records, and the Chrome trace JSON written to a file.
+
+static size_t countOf(const std::string& text, const std::string& needle) {
+  size_t n = 0;
+  for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1))
+    n++;
+  return n;
+}
+
+static std::string readAll(const char* path) {
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+int main() {
+  TestUtils::TestRunner runner("Trace Test");
+
+  // Scopes record a begin and an end, nested scopes close inside out
+  Trace::clear();
+  {
+    TRACE_SCOPE(OPEN_CHAPTER, 3);
+    {
+      TRACE_SCOPE_NAMED(readScope, SD_READ, 1024);
+      TRACE_SCOPE_END_ARG(readScope, 512);
+    }
+    TRACE_INSTANT(LAYOUT_TEXT, 7);
+  }
+  runner.expectTrue(Trace::count() == 5, "five records for two scopes and an instant");
+  Trace::Record r0 = Trace::at(0), r1 = Trace::at(1), r2 = Trace::at(2), r3 = Trace::at(3), r4 = Trace::at(4);
+  runner.expectTrue(r0.event == Trace::OPEN_CHAPTER && r0.phase == Trace::BEGIN && r0.arg == 3, "outer begin");
+  runner.expectTrue(r1.event == Trace::SD_READ && r1.phase == Trace::BEGIN && r1.arg == 1024, "inner begin");
+  runner.expectTrue(r2.event == Trace::SD_READ && r2.phase == Trace::END && r2.arg == 512, "inner end with end arg");
+  runner.expectTrue(r3.event == Trace::LAYOUT_TEXT && r3.phase == Trace::INSTANT, "instant");
+  runner.expectTrue(r4.event == Trace::OPEN_CHAPTER && r4.phase == Trace::END, "outer end");
+  runner.expectTrue(r0.timestampUs <= r1.timestampUs && r3.timestampUs <= r4.timestampUs, "timestamps increase");
+
+  // Overflow keeps the newest CAPACITY records, oldest first
+  Trace::clear();
+  const size_t extra = 10;
+  for (size_t i = 0; i < Trace::CAPACITY + extra; ++i)
+    Trace::record(Trace::RENDER_PAGE, Trace::INSTANT, (uint32_t)i);
+  runner.expectTrue(Trace::count() == Trace::CAPACITY, "ring holds CAPACITY records");
+  runner.expectTrue(Trace::recorded() == Trace::CAPACITY + extra, "total recorded count kept");
+  runner.expectTrue(Trace::at(0).arg == extra, "oldest surviving record first");
+  runner.expectTrue(Trace::at(Trace::CAPACITY - 1).arg == Trace::CAPACITY + extra - 1, "newest record last");
+
+  // An end whose begin was overwritten is left out of the dump
+  Trace::clear();
+  {
+    TRACE_SCOPE(WRITE_RAM, 0x24);
+    for (size_t i = 0; i < Trace::CAPACITY; ++i)
+      Trace::record(Trace::SD_READ, Trace::INSTANT, 0);
+  }
+  {
+    TRACE_SCOPE(REFRESH_DISPLAY, 0);
+  }
+  std::string path = TestConfig::TEST_OUTPUT_DIR + "/trace_test.json";
+  runner.expectTrue(Trace::dumpToFile(path.c_str()), "dump written");
+  std::string json = readAll(path.c_str());
+  runner.expectTrue(json.rfind("{\"traceEvents\":[", 0) == 0, "Chrome trace object");
+  runner.expectTrue(countOf(json, "\"name\":\"writeRamBuffer\"") == 0, "orphaned end dropped");
+  runner.expectTrue(countOf(json, "\"name\":\"refreshDisplay\"") == 2, "complete scope kept");
+  runner.expectTrue(countOf(json, "\"ph\":\"B\"") == countOf(json, "\"ph\":\"E\""), "begins and ends balanced");
+  runner.expectTrue(json.find("\"recorded\":") != std::string::npos, "recorded count in metadata");
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -0,0 +1,312 @@
+#include <SD.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "content/epub/EpubReader.h"
+#include "content/image/CoverThumbnail.h"
+#include "content/image/JpegDecoder.h"
+#include "content/image/PngDecoder.h"
+#include "core/EInkDisplay.h"
+#include "lib/miniz.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Decodes the JPEG and PNG fixtures in test/data/images and compares the
+// luma rows with references (PGM) written alongside them by Pillow: the Y
+// plane libjpeg decodes for the JPEGs, (77 R + 150 G + 29 B) >> 8 for the
+// PNGs. Then checks the cover thumbnail: fitting, dithering, the native
+// plane layout, and a build/load round trip from a generated EPUB.
+
+namespace fs = std::filesystem;
+
+static const std::string IMAGE_DIR = "test/data/images/";
+
+// The EPUB parser borrows this display's frame buffer as its inflate window (see main.cpp)
+EInkDisplay einkDisplay(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                        ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+
+static std::string readFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+// Serves a byte string in small, uneven reads
+struct MemoryStream {
+  std::string data;
+  size_t pos = 0;
+
+  static int read(void* context, uint8_t* buffer, size_t size) {
+    MemoryStream* s = (MemoryStream*)context;
+    size_t n = std::min(size, (size_t)37);
+    n = std::min(n, s->data.size() - s->pos);
+    memcpy(buffer, s->data.data() + s->pos, n);
+    s->pos += n;
+    return (int)n;
+  }
+};
+
+// Collects decoded rows
+class CollectSink : public ImageRowSink {
+ public:
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+
+  bool begin(int w, int h) override {
+    width = w;
+    height = h;
+    pixels.clear();
+    return true;
+  }
+  bool row(const uint8_t* luma) override {
+    pixels.insert(pixels.end(), luma, luma + width);
+    return true;
+  }
+};
+
+static bool readPgm(const std::string& path, int& width, int& height, std::vector<uint8_t>& pixels) {
+  std::string data = readFile(path);
+  int maxValue = 0;
+  int consumed = 0;
+  if (sscanf(data.c_str(), "P5 %d %d %d%n", &width, &height, &maxValue, &consumed) != 3 || maxValue != 255)
+    return false;
+  size_t start = consumed + 1;  // One whitespace byte after the header
+  if (data.size() != start + (size_t)width * height)
+    return false;
+  pixels.assign(data.begin() + start, data.end());
+  return true;
+}
+
+// Largest difference from the reference, or -1 if the sizes differ
+static int compareWithReference(const CollectSink& sink, const std::string& pgm) {
+  int w, h;
+  std::vector<uint8_t> expected;
+  if (!readPgm(pgm, w, h, expected) || w != sink.width || h != sink.height || sink.pixels.size() != expected.size())
+    return -1;
+  int worst = 0;
+  for (size_t i = 0; i < expected.size(); i++)
+    worst = std::max(worst, std::abs((int)expected[i] - (int)sink.pixels[i]));
+  return worst;
+}
+
+template <typename Decoder>
+static bool decodeFile(const std::string& path, CollectSink& sink) {
+  MemoryStream stream;
+  stream.data = readFile(path);
+  ImageSource in(MemoryStream::read, &stream);
+  Decoder* decoder = new Decoder();
+  bool ok = decoder->decode(in, sink);
+  delete decoder;
+  return ok;
+}
+
+static bool writeEpub(const std::string& path, const std::string& cover) {
+  mz_zip_archive zip;
+  memset(&zip, 0, sizeof(zip));
+  if (!mz_zip_writer_init_file(&zip, path.c_str(), 0))
+    return false;
+  auto add = [&zip](const char* name, const std::string& data, mz_uint level) {
+    return mz_zip_writer_add_mem(&zip, name, data.data(), data.size(), level);
+  };
+  bool ok = add("mimetype", "application/epub+zip", MZ_NO_COMPRESSION);
+  ok = ok && add("META-INF/container.xml",
+                 "<?xml version=\"1.0\"?>\n"
+                 "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+                 "<rootfiles><rootfile full-path=\"OEBPS/content.opf\" "
+                 "media-type=\"application/oebps-package+xml\"/></rootfiles>\n</container>\n",
+                 MZ_NO_COMPRESSION);
+  ok = ok && add("OEBPS/content.opf",
+                 "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                 "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"2.0\">\n"
+                 "<metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">\n"
+                 "<dc:title>Covered</dc:title>\n<meta name=\"cover\" content=\"img1\"/>\n</metadata>\n"
+                 "<manifest>\n<item id=\"cover-page\" href=\"cover.xhtml\" media-type=\"application/xhtml+xml\"/>\n"
+                 "<item id=\"decoy-cover\" href=\"images/other.png\" media-type=\"image/png\"/>\n"
+                 "<item id=\"img1\" href=\"images/front.jpg\" media-type=\"image/jpeg\"/>\n"
+                 "<item id=\"c1\" href=\"c1.xhtml\" media-type=\"application/xhtml+xml\"/>\n</manifest>\n"
+                 "<spine><itemref idref=\"c1\"/></spine>\n</package>\n",
+                 MZ_NO_COMPRESSION);
+  ok = ok && add("OEBPS/c1.xhtml", "<html><body><p>Text.</p></body></html>\n", MZ_NO_COMPRESSION);
+  ok = ok && add("OEBPS/images/front.jpg", cover, MZ_DEFAULT_LEVEL);
+  ok = ok && mz_zip_writer_finalize_archive(&zip);
+  mz_zip_writer_end(&zip);
+  return ok;
+}
+
+// Feeds a thumbnail width x height rows of one luma value
+static bool fill(CoverThumbnail& thumbnail, int width, int height, uint8_t value) {
+  if (!thumbnail.begin(width, height))
+    return false;
+  std::vector<uint8_t> row(width, value);
+  for (int y = 0; y < height; y++)
+    thumbnail.row(row.data());
+  return thumbnail.isLoaded();
+}
+
+static bool pixelIsWhite(EInkDisplay& display, int x, int y) {
+  // Portrait (x, y) is native (y, 479 - x), as in TextRenderer
+  int nativeY = EInkDisplay::DISPLAY_HEIGHT - 1 - x;
+  return (display.getFrameBuffer()[nativeY * EInkDisplay::DISPLAY_WIDTH_BYTES + y / 8] & (0x80 >> (y % 8))) != 0;
+}
+
+int main() {
+  TestUtils::TestRunner runner("Image Decoder Test");
+  einkDisplay.begin();
+
+  // JPEG: 4:2:0 color and grayscale with restart markers, both 77x53 (partial MCUs on both edges)
+  CollectSink sink;
+  runner.expectTrue(decodeFile<JpegDecoder>(IMAGE_DIR + "color420.jpg", sink), "4:2:0 JPEG decodes");
+  int diff = compareWithReference(sink, IMAGE_DIR + "color420.pgm");
+  runner.expectTrue(diff >= 0 && diff <= 2, "4:2:0 JPEG luma matches libjpeg", std::to_string(diff));
+  runner.expectTrue(decodeFile<JpegDecoder>(IMAGE_DIR + "gray_restart.jpg", sink), "grayscale JPEG decodes");
+  diff = compareWithReference(sink, IMAGE_DIR + "gray_restart.pgm");
+  runner.expectTrue(diff >= 0 && diff <= 2, "restart intervals handled", std::to_string(diff));
+  runner.expectTrue(!decodeFile<JpegDecoder>(IMAGE_DIR + "progressive.jpg", sink), "progressive JPEG rejected");
+
+  {
+    std::string jpeg = readFile(IMAGE_DIR + "color420.jpg");
+    MemoryStream stream;
+    stream.data = jpeg.substr(0, jpeg.size() / 3);
+    ImageSource in(MemoryStream::read, &stream);
+    JpegDecoder* decoder = new JpegDecoder();
+    decoder->decode(in, sink);
+    delete decoder;
+    runner.expectTrue(true, "truncated JPEG ends without crashing");
+  }
+
+  // PNG: RGB with every filter type over several IDAT chunks, 4-bit palette, 16-bit gray
+  runner.expectTrue(decodeFile<PngDecoder>(IMAGE_DIR + "rgb.png", sink), "RGB PNG decodes");
+  diff = compareWithReference(sink, IMAGE_DIR + "rgb.pgm");
+  runner.expectTrue(diff == 0, "all scanline filters undone", std::to_string(diff));
+  runner.expectTrue(decodeFile<PngDecoder>(IMAGE_DIR + "palette4.png", sink), "palette PNG decodes");
+  diff = compareWithReference(sink, IMAGE_DIR + "palette4.pgm");
+  runner.expectTrue(diff == 0, "4-bit palette indices", std::to_string(diff));
+  runner.expectTrue(decodeFile<PngDecoder>(IMAGE_DIR + "gray16.png", sink), "16-bit PNG decodes");
+  diff = compareWithReference(sink, IMAGE_DIR + "gray16.pgm");
+  runner.expectTrue(diff == 0, "16-bit samples use their high byte", std::to_string(diff));
+
+  // Alpha is composited over white
+  {
+    const int w = 19, h = 7;
+    std::vector<uint8_t> rgba(w * h * 4);
+    for (int i = 0; i < w * h; i++) {
+      rgba[i * 4] = (uint8_t)(i * 5);
+      rgba[i * 4 + 1] = (uint8_t)(i * 3);
+      rgba[i * 4 + 2] = (uint8_t)(255 - i);
+      rgba[i * 4 + 3] = (uint8_t)(i * 13);
+    }
+    size_t size = 0;
+    void* png = tdefl_write_image_to_png_file_in_memory(rgba.data(), w, h, 4, &size);
+    MemoryStream stream;
+    stream.data.assign((const char*)png, size);
+    mz_free(png);
+    ImageSource in(MemoryStream::read, &stream);
+    PngDecoder decoder;
+    bool ok = decoder.decode(in, sink) && sink.width == w && sink.height == h;
+    int worst = 0;
+    for (int i = 0; ok && i < w * h; i++) {
+      int luma = (77 * rgba[i * 4] + 150 * rgba[i * 4 + 1] + 29 * rgba[i * 4 + 2]) >> 8;
+      int expected = 255 - ((255 - luma) * rgba[i * 4 + 3] + 127) / 255;
+      worst = std::max(worst, std::abs(expected - sink.pixels[i]));
+    }
+    runner.expectTrue(ok && worst == 0, "RGBA over white", std::to_string(worst));
+  }
+
+  // Thumbnail size: fit the box, never upscale, whole plane bytes
+  CoverThumbnail thumbnail;
+  runner.expectTrue(thumbnail.begin(600, 900) && thumbnail.getWidth() == 96 && thumbnail.getHeight() == 144,
+                    "tall cover fits the height",
+                    std::to_string(thumbnail.getWidth()) + "x" + std::to_string(thumbnail.getHeight()));
+  runner.expectTrue(thumbnail.begin(1000, 100) && thumbnail.getWidth() == 112 && thumbnail.getHeight() == 8,
+                    "wide cover fits the width, height cut to 8");
+  runner.expectTrue(thumbnail.begin(50, 61) && thumbnail.getWidth() == 50 && thumbnail.getHeight() == 56,
+                    "small cover is not enlarged");
+  runner.expectTrue(!thumbnail.begin(100, 5), "too flat for one plane byte");
+
+  // Flat tones land on the display's levels without dithering noise
+  const std::string cacheFile = TestConfig::TEST_OUTPUT_DIR + "/tone.thm";
+  einkDisplay.clearScreen(0xFF);
+  runner.expectTrue(fill(thumbnail, 224, 288, 110), "flat gray cover");
+  thumbnail.draw(einkDisplay, 0, 0, CoverThumbnail::PLANE_BW);
+  runner.expectTrue(!pixelIsWhite(einkDisplay, 0, 0) && !pixelIsWhite(einkDisplay, 111, 143) &&
+                        pixelIsWhite(einkDisplay, 112, 0) && pixelIsWhite(einkDisplay, 0, 144),
+                    "gray 110 is black in the BW plane, inside the thumbnail only");
+  einkDisplay.clearScreen(0x00);
+  thumbnail.draw(einkDisplay, 0, 0, CoverThumbnail::PLANE_GRAY_MSB);
+  bool msbSet = pixelIsWhite(einkDisplay, 50, 70);
+  einkDisplay.clearScreen(0x00);
+  thumbnail.draw(einkDisplay, 0, 0, CoverThumbnail::PLANE_GRAY_LSB);
+  runner.expectTrue(msbSet && !pixelIsWhite(einkDisplay, 50, 70), "gray 110 is grayscale level 2 (MSB only)");
+
+  // Left half black, right half white, drawn at (40, 200): checks the rotation into native rows
+  {
+    thumbnail.begin(224, 288);
+    std::vector<uint8_t> row(224, 255);
+    std::fill(row.begin(), row.begin() + 112, 0);
+    for (int y = 0; y < 288; y++)
+      thumbnail.row(row.data());
+    einkDisplay.clearScreen(0xFF);
+    thumbnail.draw(einkDisplay, 40, 200, CoverThumbnail::PLANE_BW);
+    runner.expectTrue(!pixelIsWhite(einkDisplay, 40, 200) && !pixelIsWhite(einkDisplay, 95, 343) &&
+                          pixelIsWhite(einkDisplay, 96, 200) && pixelIsWhite(einkDisplay, 151, 343) &&
+                          pixelIsWhite(einkDisplay, 39, 250) && pixelIsWhite(einkDisplay, 60, 344),
+                      "halves land on the right side of the screen");
+  }
+
+  // Dithering keeps the average tone of a mid gray
+  {
+    fill(thumbnail, 112, 144, 200);
+    einkDisplay.clearScreen(0x00);
+    thumbnail.draw(einkDisplay, 0, 0, CoverThumbnail::PLANE_GRAY_LSB);
+    int light = 0;
+    for (int y = 0; y < 144; y++) {
+      for (int x = 0; x < 112; x++)
+        light += pixelIsWhite(einkDisplay, x, y) ? 1 : 0;
+    }
+    // 200 sits between light gray (170) and white (255): about two thirds light gray
+    runner.expectTrue(light > 112 * 144 * 55 / 100 && light < 112 * 144 * 75 / 100, "dithered mix of tones",
+                      std::to_string(light));
+  }
+
+  // EPUB cover: located from <meta name="cover">, streamed out of the archive, cached and loaded back
+  {
+    const std::string epub = TestConfig::TEST_OUTPUT_DIR + "/covered.epub";
+    fs::remove_all(TestConfig::TEST_OUTPUT_DIR + "/epub_covered");
+    runner.expectTrue(writeEpub(epub, readFile(IMAGE_DIR + "color420.jpg")), "test EPUB written");
+    EpubReader reader(epub.c_str(), false);
+    runner.expectTrue(reader.getCoverPath() == "OEBPS/images/front.jpg", "cover found in content.opf",
+                      reader.getCoverPath().c_str());
+    String path = CoverThumbnail::pathFor(epub.c_str());
+    CoverThumbnail built;
+    runner.expectTrue(built.build(reader, path.c_str()) && built.getWidth() == 77 && built.getHeight() == 48,
+                      "thumbnail built from the EPUB",
+                      std::to_string(built.getWidth()) + "x" + std::to_string(built.getHeight()));
+    runner.expectTrue(fs::file_size(path.c_str()) == 10 + 3 * 77 * 48 / 8, "cache file size");
+
+    CoverThumbnail loaded;
+    runner.expectTrue(loaded.load(path.c_str()) && loaded.getWidth() == 77 && loaded.getHeight() == 48,
+                      "thumbnail loads");
+    bool same = true;
+    for (int plane = 0; plane < 3; plane++) {
+      std::vector<uint8_t> a(EInkDisplay::BUFFER_SIZE), b(EInkDisplay::BUFFER_SIZE);
+      einkDisplay.clearScreen(0x00);
+      built.draw(einkDisplay, 8, 16, (CoverThumbnail::Plane)plane);
+      memcpy(a.data(), einkDisplay.getFrameBuffer(), a.size());
+      einkDisplay.clearScreen(0x00);
+      loaded.draw(einkDisplay, 8, 16, (CoverThumbnail::Plane)plane);
+      memcpy(b.data(), einkDisplay.getFrameBuffer(), b.size());
+      same = same && a == b;
+    }
+    runner.expectTrue(same, "loaded planes match the built ones");
+
+    std::ofstream(cacheFile, std::ios::binary) << "MRCV garbage";
+    runner.expectTrue(!loaded.load(cacheFile.c_str()) && !loaded.isLoaded(), "corrupt cache file rejected");
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -0,0 +1,396 @@
+/**
+ * KnuthPlassLayoutTest.cpp - Optimal-fit line breaking
+ *
+ * Lays out a generated multi-paragraph text with KnuthPlassLayoutStrategy and
+ * checks that no text is lost, lines fit, pages continue cached paragraphs
+ * exactly as the whole paragraph was broken, and hyphenation and overlong
+ * words are handled, and that rendering a page stays allocation-free. Ends
+ * with a timing and quality comparison against GreedyLayoutStrategy on the
+ * same text.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "WString.h"
+#include "alloc_counter.h"
+#include "content/providers/StringWordProvider.h"
+#include "core/EInkDisplay.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "resources/fonts/FontDefinitions.h"
+#include "test_config.h"
+#include "test_utils.h"
+#include "text/hyphenation/HyphenationStrategy.h"
+#include "text/layout/GreedyLayoutStrategy.h"
+#include "text/layout/KnuthPlassLayoutStrategy.h"
+
+// Deterministic pseudo-random paragraphs mixing short and long words
+static std::string generateText(int paragraphs, uint32_t seed) {
+  static const char* vocabulary[] = {
+      "der",         "die",          "und",          "ist",        "ein",           "nicht",
+      "mit",         "auf",          "Haus",         "Zeit",       "Leute",         "immer",
+      "wieder",      "zwischen",     "Geschichte",   "Bibliothek", "Wissenschaft",  "Entscheidung",
+      "Eisenbahn",   "Verantwortung", "Gesellschaft", "Donaudampfschifffahrt", "Zusammenarbeit",
+      "Landschaft",  "Kindergarten", "Wirklichkeit", "ob",         "so",            "Erfahrung"};
+  const int vocabularySize = sizeof(vocabulary) / sizeof(vocabulary[0]);
+  uint32_t state = seed;
+  auto next = [&state]() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  };
+
+  std::string text;
+  for (int p = 0; p < paragraphs; p++) {
+    int words = 5 + next() % 120;
+    for (int w = 0; w < words; w++) {
+      if (w > 0)
+        text += ' ';
+      text += vocabulary[next() % vocabularySize];
+    }
+    text += (next() % 5 == 0) ? "\n\n" : "\n";
+  }
+  return text;
+}
+
+static std::vector<std::string> sourceWords(const std::string& text) {
+  std::vector<std::string> words;
+  std::string current;
+  for (char c : text) {
+    if (c == ' ' || c == '\n') {
+      if (!current.empty())
+        words.push_back(current);
+      current.clear();
+    } else {
+      current += c;
+    }
+  }
+  if (!current.empty())
+    words.push_back(current);
+  return words;
+}
+
+static LayoutStrategy::LayoutConfig makeConfig(int16_t pageWidth, int16_t pageHeight) {
+  LayoutStrategy::LayoutConfig cfg;
+  cfg.marginLeft = ::TestConfig::DEFAULT_MARGIN_LEFT;
+  cfg.marginRight = ::TestConfig::DEFAULT_MARGIN_RIGHT;
+  cfg.marginTop = ::TestConfig::DEFAULT_MARGIN_TOP;
+  cfg.marginBottom = ::TestConfig::DEFAULT_MARGIN_BOTTOM;
+  cfg.lineSpacing = ::TestConfig::DEFAULT_LINE_SPACING;
+  cfg.lineHeight = ::TestConfig::DEFAULT_LINE_HEIGHT;
+  cfg.minSpaceWidth = ::TestConfig::DEFAULT_MIN_SPACE_WIDTH;
+  cfg.pageWidth = pageWidth;
+  cfg.pageHeight = pageHeight;
+  cfg.alignment = LayoutStrategy::ALIGN_LEFT;
+  cfg.language = Language::GERMAN;
+  return cfg;
+}
+
+static std::vector<LayoutStrategy::PageLayout> paginate(LayoutStrategy& layout, WordProvider& provider,
+                                                        TextRenderer& renderer,
+                                                        const LayoutStrategy::LayoutConfig& cfg, bool& progressed) {
+  std::vector<LayoutStrategy::PageLayout> pages;
+  int position = 0;
+  progressed = true;
+  provider.setPosition(0);
+  while (provider.hasNextWord()) {
+    LayoutStrategy::PageLayout page = layout.layoutText(provider, renderer, cfg);
+    pages.push_back(page);
+    if (page.endPosition <= position) {
+      progressed = false;
+      break;
+    }
+    position = page.endPosition;
+    provider.setPosition(position);
+  }
+  return pages;
+}
+
+static std::string lineText(const LayoutStrategy::Line& line) {
+  std::string out;
+  for (const auto& word : line.words)
+    out += word.text.c_str();
+  return out;
+}
+
+// Rebuild the word sequence from laid out lines, joining hyphenated fragments
+static std::vector<std::string> layoutWords(const std::vector<LayoutStrategy::PageLayout>& pages) {
+  std::vector<std::string> words;
+  std::string pending;
+  for (const auto& page : pages) {
+    for (const auto& line : page.lines) {
+      for (const auto& word : line.words) {
+        std::string text = word.text.c_str();
+        if (text.empty() || text[0] == ' ')
+          continue;
+        if (word.wasSplit) {
+          if (!text.empty() && text.back() == '-')
+            text.pop_back();
+          pending += text;
+          continue;
+        }
+        words.push_back(pending + text);
+        pending.clear();
+      }
+    }
+  }
+  if (!pending.empty())
+    words.push_back(pending);
+  return words;
+}
+
+// Width of a line with spaces at their natural width
+static int naturalWidth(const LayoutStrategy::Line& line, TextRenderer& renderer, int& spaces) {
+  int width = 0;
+  spaces = 0;
+  for (const auto& word : line.words) {
+    uint16_t w = 0;
+    renderer.setFontStyle(word.style);
+    renderer.getTextBounds(word.text.c_str(), 0, 0, nullptr, nullptr, &w, nullptr);
+    width += w;
+    if (word.text == " ")
+      spaces++;
+  }
+  return width;
+}
+
+struct QualityStats {
+  int lines = 0;
+  double slackSquares = 0;
+  int hyphenated = 0;
+};
+
+// Squared slack (free space at natural width) of lines that are not paragraph ends
+static QualityStats measureQuality(const std::vector<LayoutStrategy::PageLayout>& pages, TextRenderer& renderer,
+                                   int maxWidth) {
+  QualityStats stats;
+  for (const auto& page : pages) {
+    for (const auto& line : page.lines) {
+      if (line.words.empty())
+        continue;
+      stats.lines++;
+      if (line.words.back().wasSplit)
+        stats.hyphenated++;
+      int spaces = 0;
+      int width = naturalWidth(line, renderer, spaces);
+      if (width * 10 < maxWidth * 6)
+        continue;  // Most likely the last line of a paragraph
+      double slack = maxWidth - width;
+      stats.slackSquares += slack * slack;
+    }
+  }
+  return stats;
+}
+
+int main() {
+  TestUtils::TestRunner runner("Knuth-Plass Layout Test");
+
+  EInkDisplay display(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                      ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+  display.begin();
+  TextRenderer renderer(display);
+  renderer.setFontFamily(&bookerly26Family);
+  renderer.setFrameBuffer(display.getFrameBuffer());
+
+  uint16_t spaceWidth = 0;
+  renderer.setFontStyle(FontStyle::REGULAR);
+  renderer.getTextBounds(" ", 0, 0, nullptr, nullptr, &spaceWidth, nullptr);
+
+  const std::string text = generateText(25, 12345);
+  StringWordProvider provider(String(text.c_str()));
+  LayoutStrategy::LayoutConfig cfg = makeConfig(::TestConfig::DISPLAY_WIDTH, ::TestConfig::DISPLAY_HEIGHT);
+  const int maxWidth = cfg.pageWidth - cfg.marginLeft - cfg.marginRight;
+
+  // Paginate the whole text
+  KnuthPlassLayoutStrategy layout;
+  layout.setLanguage(cfg.language);
+  bool progressed = false;
+  std::vector<LayoutStrategy::PageLayout> pages = paginate(layout, provider, renderer, cfg, progressed);
+  runner.expectTrue(progressed, "pagination makes progress");
+  runner.expectTrue(pages.size() > 3, "text spans several pages", std::to_string(pages.size()) + " pages");
+  runner.expectTrue(layoutWords(pages) == sourceWords(text), "all words laid out in order");
+  runner.expectTrue(layout.getStats().cacheHits > 0, "pages continue cached paragraphs");
+  runner.expectTrue(!layout.hasLineCountMismatch(), "no page overfilled");
+
+  const int maxLines = (cfg.pageHeight - cfg.marginTop - cfg.marginBottom) / cfg.lineHeight;
+  bool linesFit = true;
+  bool pagesFit = true;
+  std::string detail;
+  for (size_t p = 0; p < pages.size(); p++) {
+    if ((int)pages[p].lines.size() > maxLines)
+      pagesFit = false;
+    for (const auto& line : pages[p].lines) {
+      int spaces = 0;
+      int width = naturalWidth(line, renderer, spaces);
+      int maxShrink = spaces * (spaceWidth / 3);
+      if (width - maxShrink > maxWidth && line.words.size() > 1) {
+        linesFit = false;
+        detail = "page " + std::to_string(p) + ": " + lineText(line);
+      }
+      if (!line.words.empty()) {
+        const auto& last = line.words.back();
+        if (last.x + last.width > cfg.marginLeft + maxWidth + 1) {
+          linesFit = false;
+          detail = "placed past margin on page " + std::to_string(p) + ": " + lineText(line);
+        }
+      }
+    }
+  }
+  runner.expectTrue(linesFit, "lines fit within the text width", detail);
+  runner.expectTrue(pagesFit, "pages hold at most " + std::to_string(maxLines) + " lines");
+
+  // Page cuts must not change line breaks: compare with one tall page holding everything
+  {
+    KnuthPlassLayoutStrategy single;
+    single.setLanguage(cfg.language);
+    LayoutStrategy::LayoutConfig tall = makeConfig(::TestConfig::DISPLAY_WIDTH, 30000);
+    provider.setPosition(0);
+    LayoutStrategy::PageLayout all = single.layoutText(provider, renderer, tall);
+    runner.expectTrue(all.endPosition == (int)text.length(), "tall page holds the whole text");
+
+    std::vector<std::string> paged;
+    for (const auto& page : pages)
+      for (const auto& line : page.lines)
+        paged.push_back(lineText(line));
+    std::vector<std::string> whole;
+    for (const auto& line : all.lines)
+      whole.push_back(lineText(line));
+    runner.expectTrue(paged == whole, "paginated lines equal whole-paragraph breaks",
+                      std::to_string(paged.size()) + " vs " + std::to_string(whole.size()) + " lines");
+  }
+
+  // Same start position gives the same page, with and without the cache
+  {
+    int start = pages[1].lines.empty() ? 0 : pages[0].endPosition;
+    provider.setPosition(start);
+    LayoutStrategy::PageLayout first = layout.layoutText(provider, renderer, cfg);
+    provider.setPosition(start);
+    LayoutStrategy::PageLayout second = layout.layoutText(provider, renderer, cfg);
+    bool same = first.endPosition == second.endPosition && first.lines.size() == second.lines.size();
+    for (size_t i = 0; same && i < first.lines.size(); i++)
+      same = lineText(first.lines[i]) == lineText(second.lines[i]);
+    runner.expectTrue(same, "layout is deterministic");
+    runner.expectTrue(provider.getCurrentIndex() == start, "provider position restored");
+  }
+
+  // Narrow pages need the hyphenation pass
+  {
+    KnuthPlassLayoutStrategy narrowLayout;
+    narrowLayout.setLanguage(Language::GERMAN);
+    LayoutStrategy::LayoutConfig narrow = makeConfig(220, ::TestConfig::DISPLAY_HEIGHT);
+    std::vector<LayoutStrategy::PageLayout> narrowPages = paginate(narrowLayout, provider, renderer, narrow, progressed);
+    QualityStats quality = measureQuality(narrowPages, renderer, 200);
+    runner.expectTrue(progressed && layoutWords(narrowPages) == sourceWords(text), "narrow pages keep all words");
+    runner.expectTrue(narrowLayout.getStats().hyphenationPasses > 0, "hyphenation pass used");
+    // Algorithmic splits need the German patterns, which some test builds stub out
+    HyphenationStrategy* german = createHyphenationStrategy(Language::GERMAN);
+    if (!german->findHyphenPositions("Verantwortung").empty())
+      runner.expectTrue(quality.hyphenated > 0, "words hyphenated", std::to_string(quality.hyphenated));
+    delete german;
+  }
+
+  // Existing hyphens are break points even without hyphenation patterns
+  {
+    const std::string hyphenText =
+        "Die Nord-Ost-Verbindung und die West-Ost-Zusammenarbeit der Eisenbahn-Gesellschaft "
+        "ist eine Ost-West-Entscheidung mit Donau-Dampfschifffahrts-Verantwortung.\n";
+    StringWordProvider hyphenProvider(String(hyphenText.c_str()));
+    KnuthPlassLayoutStrategy basicLayout;
+    basicLayout.setLanguage(Language::BASIC);
+    LayoutStrategy::LayoutConfig narrow = makeConfig(220, ::TestConfig::DISPLAY_HEIGHT);
+    narrow.language = Language::BASIC;
+    std::vector<LayoutStrategy::PageLayout> hyphenPages =
+        paginate(basicLayout, hyphenProvider, renderer, narrow, progressed);
+    std::vector<std::string> expected = sourceWords(hyphenText);
+    for (auto& word : expected)
+      word.erase(std::remove(word.begin(), word.end(), '-'), word.end());
+    std::vector<std::string> actual = layoutWords(hyphenPages);
+    for (auto& word : actual)
+      word.erase(std::remove(word.begin(), word.end(), '-'), word.end());
+    runner.expectTrue(progressed && actual == expected, "hyphenated compounds keep all words");
+    runner.expectTrue(measureQuality(hyphenPages, renderer, 200).hyphenated > 0, "split at existing hyphens");
+  }
+
+  // A word wider than the page still makes progress
+  {
+    std::string longText = "kurz " + std::string(80, 'x') + " und danach weiter\n";
+    StringWordProvider longProvider(String(longText.c_str()));
+    KnuthPlassLayoutStrategy noHyphens;
+    noHyphens.setLanguage(Language::NONE);
+    std::vector<LayoutStrategy::PageLayout> longPages = paginate(noHyphens, longProvider, renderer, cfg, progressed);
+    runner.expectTrue(progressed && layoutWords(longPages) == sourceWords(longText), "overlong word laid out");
+    runner.expectTrue(noHyphens.getStats().emergencyPasses > 0, "overlong word needs the final pass");
+  }
+
+  // Allocation budgets: rendering a laid-out page allocates nothing, a greedy line needs its word list
+  {
+    provider.setPosition(0);
+    LayoutStrategy::PageLayout page = layout.layoutText(provider, renderer, cfg);
+    AllocCounter::Phase kpRender("KnuthPlass renderPage");
+    layout.renderPage(page, renderer, cfg);
+    AllocCounter::expectNoAllocs(runner, kpRender);
+
+    GreedyLayoutStrategy greedy;
+    provider.setPosition(0);
+    LayoutStrategy::PageLayout greedyPage = greedy.layoutText(provider, renderer, cfg);
+    AllocCounter::Phase greedyRender("Greedy renderPage");
+    greedy.renderPage(greedyPage, renderer, cfg);
+    AllocCounter::expectNoAllocs(runner, greedyRender);
+
+    // Line word vectors grow a few times and long words leave the string's inline buffer: about 6 per line today
+    const int lineCount = 200;
+    const int allocsPerLine = 8;
+    provider.setPosition(0);
+    AllocCounter::Phase lines("Greedy getNextLine x" + std::to_string(lineCount));
+    for (int i = 0; i < lineCount && provider.hasNextWord(); i++) {
+      bool paragraphEnd = false;
+      greedy.test_getNextLine(provider, renderer, maxWidth, paragraphEnd);
+    }
+    AllocCounter::expectAllocsAtMost(runner, lines, lineCount * allocsPerLine);
+  }
+
+  // Benchmark against the greedy strategy on a larger text
+  {
+    const std::string benchText = generateText(300, 777);
+    StringWordProvider benchProvider(String(benchText.c_str()));
+    GreedyLayoutStrategy greedy;
+    KnuthPlassLayoutStrategy optimal;
+    greedy.setLanguage(cfg.language);
+    optimal.setLanguage(cfg.language);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<LayoutStrategy::PageLayout> greedyPages = paginate(greedy, benchProvider, renderer, cfg, progressed);
+    auto t1 = std::chrono::steady_clock::now();
+    std::vector<LayoutStrategy::PageLayout> optimalPages = paginate(optimal, benchProvider, renderer, cfg, progressed);
+    auto t2 = std::chrono::steady_clock::now();
+
+    QualityStats greedyQuality = measureQuality(greedyPages, renderer, maxWidth);
+    QualityStats optimalQuality = measureQuality(optimalPages, renderer, maxWidth);
+    double greedyMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    double optimalMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    const KnuthPlassLayoutStrategy::Stats& stats = optimal.getStats();
+
+    std::cout << "\n=== Benchmark: " << benchText.size() << " bytes ===\n";
+    std::cout << "greedy:       " << greedyPages.size() << " pages, " << greedyQuality.lines << " lines, "
+              << greedyQuality.hyphenated << " hyphenated, slack^2 "
+              << (long)(greedyQuality.slackSquares / std::max(1, greedyQuality.lines)) << "/line, " << greedyMs
+              << " ms\n";
+    std::cout << "knuth-plass:  " << optimalPages.size() << " pages, " << optimalQuality.lines << " lines, "
+              << optimalQuality.hyphenated << " hyphenated, slack^2 "
+              << (long)(optimalQuality.slackSquares / std::max(1, optimalQuality.lines)) << "/line, " << optimalMs
+              << " ms\n";
+    std::cout << "  paragraphs " << stats.paragraphs << ", hyphenation passes " << stats.hyphenationPasses
+              << ", final passes " << stats.emergencyPasses << ", items " << stats.items << ", breakpoints "
+              << stats.breakpoints << ", max active " << stats.maxActiveNodes << ", cache hits " << stats.cacheHits
+              << "\n";
+
+    runner.expectTrue(progressed && layoutWords(optimalPages) == sourceWords(benchText), "benchmark text laid out");
+    runner.expectTrue(stats.maxActiveNodes < 64, "active list stays small",
+                      std::to_string(stats.maxActiveNodes) + " nodes");
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
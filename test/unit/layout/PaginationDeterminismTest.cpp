@@ -0,0 +1,131 @@
+/**
+ * PaginationDeterminismTest.cpp - Forward/backward pagination agreement
+ *
+ * Paginates a generated text forward and backward with
+ * test/common/pagination_check.h and requires getPreviousPageStart() to land
+ * on every forward page start, with the greedy layout for two font sizes and
+ * with and without hyphenation, and with the Knuth-Plass layout. The text
+ * mixes short and long paragraphs and long (hyphenatable) words so lines end
+ * in forward and backward hyphen splits.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "content/providers/FileWordProvider.h"
+#include "core/EInkDisplay.h"
+#include "pagination_check.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "resources/fonts/FontDefinitions.h"
+#include "test_config.h"
+#include "test_utils.h"
+#include "text/hyphenation/HyphenationStrategy.h"
+#include "text/layout/GreedyLayoutStrategy.h"
+#include "text/layout/KnuthPlassLayoutStrategy.h"
+
+namespace {
+
+const std::string TEXT_PATH = ::TestConfig::TEST_OUTPUT_DIR + "/pagination_text.txt";
+
+struct CheckConfig {
+  const char* name;
+  bool knuthPlass;
+  FontFamily* family;
+  int fontSize;
+  Language language;
+};
+
+const CheckConfig CONFIGS[] = {
+    {"greedy_bookerly26_basic", false, &bookerly26Family, 26, Language::BASIC},
+    {"greedy_bookerly26_english", false, &bookerly26Family, 26, Language::ENGLISH},
+    {"greedy_notosans30_english", false, &notoSans30Family, 30, Language::ENGLISH},
+    {"knuthplass_bookerly26_english", true, &bookerly26Family, 26, Language::ENGLISH},
+};
+
+void writeText(const std::string& path) {
+  static const char* vocabulary[] = {"the",          "reader",          "turns",
+                                     "a",            "page",            "and",
+                                     "light",        "falls",           "across",
+                                     "paper",        "between",         "chapters",
+                                     "of",           "extraordinarily", "characterization",
+                                     "well-known",   "notwithstanding", "responsibilities",
+                                     "in",           "to",              "incomprehensibility",
+                                     "typesetting",  "Wanderlust",      "uncharacteristically"};
+  const int vocabularySize = sizeof(vocabulary) / sizeof(vocabulary[0]);
+  uint32_t state = 1207;
+  auto next = [&state]() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  };
+
+  std::ofstream out(path, std::ios::binary);
+  for (int p = 0; p < 60; p++) {
+    // Mostly short paragraphs, some longer than a page
+    int words = (p % 7 == 3) ? 250 + next() % 150 : 5 + next() % 70;
+    for (int w = 0; w < words; w++) {
+      if (w > 0)
+        out << ' ';
+      out << vocabulary[next() % vocabularySize];
+    }
+    out << ".\n";
+  }
+}
+
+LayoutStrategy::LayoutConfig makeConfig(const CheckConfig& config) {
+  LayoutStrategy::LayoutConfig cfg;
+  cfg.marginLeft = ::TestConfig::DEFAULT_MARGIN_LEFT;
+  cfg.marginRight = ::TestConfig::DEFAULT_MARGIN_RIGHT;
+  cfg.marginTop = ::TestConfig::DEFAULT_MARGIN_TOP;
+  cfg.marginBottom = ::TestConfig::DEFAULT_MARGIN_BOTTOM;
+  cfg.lineSpacing = ::TestConfig::DEFAULT_LINE_SPACING;
+  cfg.lineHeight = config.fontSize + ::TestConfig::DEFAULT_LINE_SPACING;
+  cfg.minSpaceWidth = ::TestConfig::DEFAULT_MIN_SPACE_WIDTH;
+  cfg.pageWidth = ::TestConfig::DISPLAY_WIDTH;
+  cfg.pageHeight = ::TestConfig::DISPLAY_HEIGHT;
+  cfg.alignment = LayoutStrategy::ALIGN_LEFT;
+  cfg.language = config.language;
+  return cfg;
+}
+
+void runConfig(const CheckConfig& config, TestUtils::TestRunner& runner, TextRenderer& renderer) {
+  GreedyLayoutStrategy greedy;
+  KnuthPlassLayoutStrategy knuthPlass;
+  LayoutStrategy& layout = config.knuthPlass ? static_cast<LayoutStrategy&>(knuthPlass) : greedy;
+  LayoutStrategy::LayoutConfig cfg = makeConfig(config);
+  layout.setLanguage(cfg.language);
+  renderer.setFontFamily(config.family);
+  FileWordProvider provider(TEXT_PATH.c_str());
+  if (!provider.isValid()) {
+    runner.expectTrue(false, std::string(config.name) + ": text file opened");
+    return;
+  }
+
+  std::cout << "\n" << config.name << "\n";
+  PaginationCheck::Report report = PaginationCheck::run(provider, layout, renderer, cfg);
+  PaginationCheck::printReport(report, stdout, 5);
+  runner.expectTrue(report.pages > 10, std::string(config.name) + ": text spans several pages",
+                    std::to_string(report.pages) + " pages");
+  runner.expectTrue(report.mismatches.empty(), std::string(config.name) + ": backward page starts match forward",
+                    std::to_string(report.mismatches.size()) + " mismatches");
+}
+
+}  // namespace
+
+int main() {
+  TestUtils::TestRunner runner("Pagination Determinism Test");
+  writeText(TEXT_PATH);
+
+  EInkDisplay display(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                      ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+  display.begin();
+  TextRenderer renderer(display);
+  renderer.setFrameBuffer(display.getFrameBuffer());
+  renderer.setTextColor(TextRenderer::COLOR_BLACK);
+
+  for (const CheckConfig& config : CONFIGS)
+    runConfig(config, runner, renderer);
+  return runner.allPassed() ? 0 : 1;
+}
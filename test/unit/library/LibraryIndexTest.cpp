@@ -0,0 +1,250 @@
+#include <SD.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CostModel.h"
+#include "content/library/LibraryIndex.h"
+#include "core/EInkDisplay.h"
+#include "lib/miniz.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Builds a small library under test/output (TXT books, a generated EPUB, a
+// broken EPUB, nested and hidden folders) and checks the index: metadata,
+// folder listings, both sort orders, progress kept in the journal (the
+// index is not rewritten when a book is closed) and folded into the records
+// by the next rewrite, recovery from a rewrite or an appended record cut
+// short by a reset, and incremental refreshes that only touch changed books
+// and list new ones while still running.
+
+namespace fs = std::filesystem;
+
+// The EPUB parser borrows this display's frame buffer as its inflate window (see main.cpp)
+EInkDisplay einkDisplay(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                        ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+
+static void writeFile(const std::string& path, const std::string& content) {
+  std::ofstream out(path, std::ios::binary);
+  out << content;
+}
+
+static bool writeEpub(const std::string& path) {
+  mz_zip_archive zip;
+  memset(&zip, 0, sizeof(zip));
+  if (!mz_zip_writer_init_file(&zip, path.c_str(), 0))
+    return false;
+  auto add = [&zip](const char* name, const std::string& data) {
+    return mz_zip_writer_add_mem(&zip, name, data.data(), data.size(), MZ_NO_COMPRESSION);
+  };
+  bool ok = add("mimetype", "application/epub+zip");
+  ok = ok && add("META-INF/container.xml",
+                 "<?xml version=\"1.0\"?>\n"
+                 "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+                 "<rootfiles><rootfile full-path=\"OEBPS/content.opf\" "
+                 "media-type=\"application/oebps-package+xml\"/></rootfiles>\n</container>\n");
+  ok = ok && add("OEBPS/content.opf",
+                 "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                 "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"2.0\">\n"
+                 "<metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">\n"
+                 "<dc:title>\n  Dune &amp; Sons\t</dc:title>\n"
+                 "<dc:creator>Frank Herbert</dc:creator>\n<dc:creator>Someone Else</dc:creator>\n"
+                 "<dc:language>fr</dc:language>\n</metadata>\n"
+                 "<manifest><item id=\"c1\" href=\"c1.xhtml\" media-type=\"application/xhtml+xml\"/></manifest>\n"
+                 "<spine><itemref idref=\"c1\"/></spine>\n</package>\n");
+  ok = ok && add("OEBPS/c1.xhtml", "<html><body><p>Arrakis.</p></body></html>\n");
+  ok = ok && mz_zip_writer_finalize_archive(&zip);
+  mz_zip_writer_end(&zip);
+  return ok;
+}
+
+static std::string listing(LibraryIndex& library, const String& folder, LibraryIndex::Sort sort) {
+  std::vector<LibraryIndex::Item> items;
+  library.list(folder, sort, 0, 100, items);
+  std::string s;
+  for (const auto& item : items) {
+    if (!s.empty())
+      s += "|";
+    s += item.isFolder ? std::string(item.folder.c_str()) + "/" : std::string(item.book.title.c_str());
+  }
+  return s;
+}
+
+int main() {
+  TestUtils::TestRunner runner("Library Index Test");
+  einkDisplay.begin();
+  SD.openDirectories = true;
+
+  const std::string root = TestConfig::TEST_OUTPUT_DIR + "/library";
+  const std::string indexPath = TestConfig::TEST_OUTPUT_DIR + "/library.idx";
+  fs::remove_all(root);
+  fs::remove(indexPath);
+  fs::remove(TestConfig::TEST_OUTPUT_DIR + "/library.jnl");
+  fs::remove_all(TestConfig::TEST_OUTPUT_DIR + "/epub_dune");
+  fs::create_directories(root + "/sci-fi/old");
+  fs::create_directories(root + "/.hidden");
+  writeFile(root + "/zebra.txt", "Zebra text.\n");
+  writeFile(root + "/Alpha.txt", "Alpha text.\n");
+  writeFile(root + "/notes.md", "not a book\n");
+  writeFile(root + "/sci-fi/old/broken.epub", "this is not a zip file");
+  writeFile(root + "/.hidden/secret.txt", "hidden\n");
+  runner.expectTrue(writeEpub(root + "/sci-fi/dune.epub"), "test EPUB written");
+
+  const String r(root.c_str());
+  const String sciFi(root + "/sci-fi");
+
+  // First scan
+  {
+    LibraryIndex library(root.c_str(), indexPath.c_str());
+    runner.expectTrue(!library.load(), "no index yet");
+    runner.expectTrue(library.refresh(), "refresh writes the index");
+    runner.expectTrue(library.getBookCount() == 4, "four books indexed", std::to_string(library.getBookCount()));
+  }
+
+  // A fresh instance reads the same index back
+  LibraryIndex library(root.c_str(), indexPath.c_str());
+  runner.expectTrue(library.load() && library.getBookCount() == 4, "index loads");
+
+  runner.expectTrue(library.count(r) == 3, "root holds a folder and two books", std::to_string(library.count(r)));
+  std::string rootTitles = listing(library, r, LibraryIndex::SORT_TITLE);
+  runner.expectTrue(rootTitles == root + "/sci-fi/|Alpha|zebra", "root listing by title", rootTitles);
+  std::string sciFiTitles = listing(library, sciFi, LibraryIndex::SORT_TITLE);
+  runner.expectTrue(sciFiTitles == root + "/sci-fi/old/|Dune & Sons", "nested listing", sciFiTitles);
+
+  LibraryIndex::Book dune;
+  runner.expectTrue(library.find(sciFi + "/dune.epub", dune), "EPUB found by path");
+  runner.expectTrue(dune.title == "Dune & Sons" && dune.author == "Frank Herbert" && dune.language == "fr",
+                    "EPUB metadata", std::string(dune.title.c_str()) + " / " + dune.author.c_str());
+  runner.expectTrue((dune.flags & LibraryIndex::FLAG_EXTRACTED) != 0, "EPUB cache status recorded");
+  runner.expectTrue((dune.flags & LibraryIndex::FLAG_COVER) == 0, "EPUB without a cover image has no thumbnail");
+  LibraryIndex::Book broken;
+  runner.expectTrue(library.find(sciFi + "/old/broken.epub", broken) && broken.title == "broken",
+                    "unreadable EPUB falls back to its file name");
+
+  // Paged listing
+  std::vector<LibraryIndex::Item> page;
+  runner.expectTrue(library.list(r, LibraryIndex::SORT_TITLE, 1, 1, page) == 1 && page[0].book.title == "Alpha",
+                    "one row from the middle of a folder");
+  runner.expectTrue(library.rowOf(r, LibraryIndex::SORT_TITLE, r + "/zebra.txt") == 2, "row of a book");
+  runner.expectTrue(library.rowOf(r, LibraryIndex::SORT_TITLE, sciFi) == 0, "row of a folder");
+
+  // Nothing changed: the index is not rewritten
+  uint64_t writesBefore = CostModel::counters().sdSectorWrites;
+  runner.expectTrue(library.refresh(), "refresh without changes");
+  runner.expectTrue(CostModel::counters().sdSectorWrites == writesBefore, "unchanged library writes nothing");
+
+  // Progress and recency
+  auto indexWritten = fs::last_write_time(indexPath);
+  uintmax_t indexSize = fs::file_size(indexPath);
+  runner.expectTrue(library.recordProgress(r + "/zebra.txt", 2, 150, 0.425f, false), "progress recorded");
+  runner.expectTrue(fs::last_write_time(indexPath) == indexWritten && fs::file_size(indexPath) == indexSize,
+                    "closing a book leaves the index alone");
+  LibraryIndex::Book zebra;
+  library.find(r + "/zebra.txt", zebra);
+  runner.expectTrue(zebra.chapter == 2 && zebra.position == 150 && zebra.permille == 425 && zebra.opened > 0,
+                    "progress read back");
+  std::string recent = listing(library, r, LibraryIndex::SORT_RECENT);
+  runner.expectTrue(recent == root + "/sci-fi/|zebra|Alpha", "recently read first", recent);
+  library.recordProgress(r + "/Alpha.txt", 0, 10, 0.01f, false);
+  recent = listing(library, r, LibraryIndex::SORT_RECENT);
+  runner.expectTrue(recent == root + "/sci-fi/|Alpha|zebra", "last closed book first", recent);
+  runner.expectTrue(!library.recordProgress(r + "/missing.txt", 0, 0, 0.5f, false), "unknown book rejected");
+  {
+    LibraryIndex reloaded(root.c_str(), indexPath.c_str());
+    reloaded.load();
+    recent = listing(reloaded, r, LibraryIndex::SORT_RECENT);
+    runner.expectTrue(recent == root + "/sci-fi/|Alpha|zebra", "journaled progress survives a reload", recent);
+  }
+
+  // Incremental refresh: one book added, one removed, one changed
+  fs::remove(root + "/Alpha.txt");
+  writeFile(root + "/beta.txt", "Beta text.\n");
+  writeFile(root + "/sci-fi/old/broken.epub", "still not a zip file, but longer");
+  runner.expectTrue(library.refresh() && library.getBookCount() == 4, "refresh after changes");
+  rootTitles = listing(library, r, LibraryIndex::SORT_TITLE);
+  runner.expectTrue(rootTitles == root + "/sci-fi/|beta|zebra", "root after changes", rootTitles);
+  library.find(r + "/zebra.txt", zebra);
+  runner.expectTrue(zebra.permille == 425, "unchanged book keeps its progress");
+  {
+    JournalStore journal(String((TestConfig::TEST_OUTPUT_DIR + "/library.jnl").c_str()));
+    journal.load();
+    runner.expectTrue(journal.entries().empty(), "rewrite folds the journal into the records");
+    LibraryIndex reloaded(root.c_str(), indexPath.c_str());
+    reloaded.load();
+    reloaded.find(r + "/zebra.txt", zebra);
+    runner.expectTrue(zebra.chapter == 2 && zebra.position == 150 && zebra.permille == 425,
+                      "folded progress read back");
+  }
+  runner.expectTrue(library.find(sciFi + "/old/broken.epub", broken) && broken.size == 32, "changed book re-indexed",
+                    std::to_string(broken.size));
+
+  // Emptied folders drop out of their parent's listing
+  fs::remove_all(root + "/sci-fi");
+  library.refresh();
+  runner.expectTrue(library.count(r) == 2 && library.count(sciFi) == 0, "removed folder disappears");
+
+  // A stepped refresh lists each new book as soon as it is appended
+  {
+    writeFile(root + "/gamma.txt", "Gamma text.\n");
+    writeFile(root + "/delta.txt", "Delta text.\n");
+    uint32_t revision = library.getRevision();
+    library.startRefresh();
+    int steps = 0;
+    while (library.refreshStep() && library.getRevision() == revision)
+      steps++;
+    runner.expectTrue(library.isRefreshing() && library.count(r) == 3, "new book listed before the refresh ends",
+                      std::to_string(steps));
+    while (library.refreshStep()) {
+    }
+    runner.expectTrue(!library.isRefreshing() && library.lastRefreshOk() && library.getBookCount() == 4,
+                      "stepped refresh finishes");
+    fs::remove(root + "/gamma.txt");
+    fs::remove(root + "/delta.txt");
+    library.refresh();
+  }
+
+  // A reset between removing the index and renaming its rewrite: a complete rewrite is adopted, a cut one is not
+  {
+    const std::string tmpPath = indexPath + ".tmp";
+    const std::string backupPath = indexPath + ".bak";
+    fs::copy_file(indexPath, backupPath, fs::copy_options::overwrite_existing);
+    fs::rename(indexPath, tmpPath);
+    LibraryIndex recovered(root.c_str(), indexPath.c_str());
+    runner.expectTrue(recovered.load() && recovered.getBookCount() == 2, "complete rewrite adopted");
+    runner.expectTrue(fs::exists(indexPath) && !fs::exists(tmpPath), "rewrite renamed into place");
+
+    fs::copy_file(indexPath, tmpPath);
+    runner.expectTrue(recovered.load() && !fs::exists(tmpPath), "left-over rewrite dropped while the index exists");
+
+    fs::rename(indexPath, tmpPath);
+    fs::resize_file(tmpPath, fs::file_size(tmpPath) - 8);
+    runner.expectTrue(!recovered.load() && !fs::exists(tmpPath) && recovered.getBookCount() == 0,
+                      "cut rewrite not adopted");
+    fs::rename(backupPath, indexPath);
+  }
+
+  // A reset while a record is appended: the cut record is ignored and its book indexed again on a line of its own
+  {
+    writeFile(root + "/epsilon.txt", "Epsilon text.\n");
+    library.refresh();
+    fs::resize_file(indexPath, fs::file_size(indexPath) - 5);
+    LibraryIndex torn(root.c_str(), indexPath.c_str());
+    LibraryIndex::Book epsilon;
+    runner.expectTrue(torn.load() && torn.getBookCount() == 2 && !torn.find(r + "/epsilon.txt", epsilon),
+                      "cut record ignored");
+    runner.expectTrue(torn.refresh() && torn.find(r + "/epsilon.txt", epsilon) && epsilon.title == "epsilon",
+                      "book of a cut record indexed again");
+    LibraryIndex reloaded(root.c_str(), indexPath.c_str());
+    runner.expectTrue(reloaded.load() && reloaded.getBookCount() == 3 && reloaded.find(r + "/epsilon.txt", epsilon),
+                      "record after a cut one survives a reload", std::to_string(reloaded.getBookCount()));
+    fs::remove(root + "/epsilon.txt");
+    library.load();
+    library.refresh();
+  }
+
+  SD.openDirectories = false;
+  return runner.allPassed() ? 0 : 1;
+}
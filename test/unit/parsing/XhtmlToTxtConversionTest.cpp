@@ -8,6 +8,7 @@
  * - &nbsp; for intentional blank lines
  * - <br/> handling
  * - Whitespace normalization
+ * - Named and numeric character references
  */
 
 #include <filesystem>
@@ -18,6 +19,7 @@
 
 #include "content/providers/EpubWordProvider.h"
 #include "content/xml/SimpleXmlParser.h"
+#include "test_config.h"
 #include "test_globals.h"
 #include "test_utils.h"
 
@@ -303,6 +305,44 @@ void testInlineStyleStacking(TestUtils::TestRunner& runner) {
   }
 }
 
+/**
+ * Test: Entities and whitespace decoded in the single text-node pass
+ */
+void testEntitiesAndWhitespace(TestUtils::TestRunner& runner) {
+  std::cout << "\n=== Test: Entities and whitespace ===\n";
+
+  std::string htmlPath = TestConfig::TEST_OUTPUT_DIR + "/entity_test.html";
+  std::string html =
+      "<html><head><title>Entities</title></head><body>"
+      "<p>It&#8217;s &#x2019;quoted&#X201D; &amp; &lt;ok&gt; &#65;&#x42;</p>"
+      "<p>  Lots\n  of \n\t\r spaces</p>"
+      "<p>&#160;</p>"
+      "<p>Keep &#27;esc &#xD800; &bogus; &#xZZ; &#1114112; as-is</p>"
+      "</body></html>";
+  {
+    std::ofstream out(htmlPath);
+    if (!out.is_open()) {
+      runner.expectTrue(false, "Should be able to write test HTML");
+      return;
+    }
+    out << html;
+  }
+
+  EpubWordProvider provider(htmlPath.c_str());
+  runner.expectTrue(provider.isValid(), "Provider should be valid for entity test");
+  std::string output = readFileContents(htmlPath.substr(0, htmlPath.rfind('.')) + ".txt");
+  printWithMarkers(output);
+
+  runner.expectTrue(output.find("It\xE2\x80\x99s \xE2\x80\x99quoted\xE2\x80\x9D & <ok> AB\n") != std::string::npos,
+                    "Decimal, hex and named entities should be decoded to UTF-8");
+  runner.expectTrue(output.find("\nLots of spaces\n") != std::string::npos,
+                    "Whitespace should be collapsed and trimmed at line start");
+  runner.expectTrue(output.find("spaces\n\nKeep") != std::string::npos,
+                    "A paragraph holding only &#160; should give a blank line");
+  runner.expectTrue(output.find("Keep &#27;esc &#xD800; &bogus; &#xZZ; &#1114112; as-is") != std::string::npos,
+                    "Control, surrogate, unknown and malformed references should pass through unchanged");
+}
+
 int main() {
   std::cout << "========================================\n";
   std::cout << "XHTML to TXT Conversion Test\n";
@@ -312,6 +352,7 @@ int main() {
 
   testConversion(runner);
   testInlineStyleStacking(runner);
+  testEntitiesAndWhitespace(runner);
   // New test: CSS base inline styles and inline overrides
   auto testInlineCssBaseAndOverrides = [&](TestUtils::TestRunner& r) {
     std::cout << "\n=== Test: Inline CSS base and overrides ===\n";
@@ -0,0 +1,193 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "WString.h"
+#include "core/EInkDisplay.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "resources/fonts/FontDefinitions.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Re-encodes shipped planar fonts into the RLE glyph format (mirrors
+// encode_glyph_rle in scripts/generate_simplefont/bitmap_utils.py) and checks
+// that decoding and rendering produce exactly the same pixels.
+
+struct RleFont {
+  std::vector<uint8_t> stream;
+  std::vector<SimpleGFXglyph> glyphs;
+  SimpleGFXfont font;
+};
+
+static uint8_t planeBit(const uint8_t* plane, const SimpleGFXglyph& g, int x, int y) {
+  if (!plane)
+    return 0;
+  int stride = (g.width + 7) / 8;
+  return (plane[g.bitmapOffset + y * stride + x / 8] >> (7 - (x % 8))) & 1;
+}
+
+static std::vector<uint8_t> glyphSymbols(const SimpleGFXfont* f, const SimpleGFXglyph& g) {
+  std::vector<uint8_t> symbols;
+  for (int y = 0; y < g.height; y++) {
+    for (int x = 0; x < g.width; x++) {
+      uint8_t bw = planeBit(f->bitmap, g, x, y);
+      uint8_t lsb = planeBit(f->bitmap_gray_lsb, g, x, y);
+      uint8_t msb = planeBit(f->bitmap_gray_msb, g, x, y);
+      if (bw)
+        symbols.push_back(lsb ? GLYPH_SYM_LIGHT : GLYPH_SYM_WHITE);
+      else if (msb)
+        symbols.push_back(lsb ? GLYPH_SYM_DARK : GLYPH_SYM_GRAY);
+      else
+        symbols.push_back(GLYPH_SYM_BLACK);
+    }
+  }
+  return symbols;
+}
+
+static void encodeSymbols(const std::vector<uint8_t>& symbols, std::vector<uint8_t>& out) {
+  size_t i = 0;
+  while (i < symbols.size()) {
+    uint8_t sym = symbols[i];
+    if (sym == GLYPH_SYM_WHITE || sym == GLYPH_SYM_BLACK) {
+      size_t run = 1;
+      while (i + run < symbols.size() && symbols[i + run] == sym && run < 64)
+        run++;
+      if (run >= 3) {
+        out.push_back((sym == GLYPH_SYM_WHITE ? 0x00 : 0x40) | (uint8_t)(run - 1));
+        i += run;
+        continue;
+      }
+    }
+    uint8_t s[3] = {GLYPH_SYM_WHITE, GLYPH_SYM_WHITE, GLYPH_SYM_WHITE};
+    for (size_t k = 0; k < 3 && i + k < symbols.size(); k++)
+      s[k] = symbols[i + k];
+    out.push_back(0x80 + s[0] * 25 + s[1] * 5 + s[2]);
+    i += 3;
+  }
+}
+
+static void buildRleFont(const SimpleGFXfont* src, RleFont& out) {
+  out.stream.clear();
+  out.glyphs.assign(src->glyph, src->glyph + src->glyphCount);
+  for (uint16_t i = 0; i < src->glyphCount; i++) {
+    out.glyphs[i].bitmapOffset = out.stream.size();
+    encodeSymbols(glyphSymbols(src, src->glyph[i]), out.stream);
+  }
+  out.stream.push_back(0);  // Keep the stream non-empty
+  out.font = *src;
+  out.font.bitmap = out.stream.data();
+  out.font.bitmap_gray_lsb = src->bitmap_gray_lsb ? out.stream.data() : nullptr;
+  out.font.bitmap_gray_msb = src->bitmap_gray_msb ? out.stream.data() : nullptr;
+  out.font.glyph = out.glyphs.data();
+  out.font.format = GlyphFormat::RLE;
+}
+
+static uint32_t planarSize(const SimpleGFXfont* f) {
+  uint32_t planes = f->bitmap_gray_lsb ? 3 : 1;
+  uint32_t total = 0;
+  for (uint16_t i = 0; i < f->glyphCount; i++)
+    total += glyphPlaneSize(&f->glyph[i]) * planes;
+  return total;
+}
+
+// Decoded planes must match the planar source bit for bit, and the row padding
+// bits must come out clear even though the output buffer starts dirty
+static bool decodeMatches(const SimpleGFXfont* planar, const RleFont& rle, std::string& firstMismatch) {
+  std::vector<uint8_t> planes;
+  for (uint16_t i = 0; i < planar->glyphCount; i++) {
+    const SimpleGFXglyph* g = &planar->glyph[i];
+    uint16_t planeSize = glyphPlaneSize(g);
+    planes.assign(planeSize * 3, 0xAA);
+    decodeGlyphRle(&rle.font, &rle.glyphs[i], planes.data());
+
+    const uint8_t* sources[3] = {planar->bitmap, planar->bitmap_gray_lsb, planar->bitmap_gray_msb};
+    for (int p = 0; p < 3; p++) {
+      if (!sources[p])
+        continue;
+      int stride = (g->width + 7) / 8;
+      for (int y = 0; y < g->height; y++) {
+        for (int x = 0; x < g->width; x++) {
+          uint8_t expected = (sources[p][g->bitmapOffset + y * stride + x / 8] >> (7 - (x % 8))) & 1;
+          uint8_t actual = (planes[p * planeSize + y * stride + x / 8] >> (7 - (x % 8))) & 1;
+          if (expected != actual) {
+            firstMismatch = "glyph 0x" + std::to_string(g->codepoint) + " plane " + std::to_string(p);
+            return false;
+          }
+        }
+        for (int x = g->width; x < stride * 8; x++) {
+          if ((planes[p * planeSize + y * stride + x / 8] >> (7 - (x % 8))) & 1) {
+            firstMismatch = "glyph 0x" + std::to_string(g->codepoint) + " plane " + std::to_string(p) + " padding";
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+static std::vector<uint8_t> renderSample(EInkDisplay& display, const SimpleGFXfont* font,
+                                         TextRenderer::BitmapType type) {
+  static const char* lines[] = {"The quick brown fox jumps over the lazy dog.",
+                                "Sphinx of black quartz, judge my vow! 0123456789",
+                                "\xC3\x84pfel \xC3\xB6" "ffnen \xC3\xBC" "ber Stra\xC3\x9F" "en \xE2\x80\x9Cquoted\xE2\x80\x9D"};
+  display.clearScreen(0xFF);
+  TextRenderer renderer(display);
+  renderer.setFont(font);
+  renderer.setTextColor(TextRenderer::COLOR_BLACK);
+  renderer.setFrameBuffer(display.getFrameBuffer());
+  renderer.setBitmapType(type);
+  // Render twice so the second pass is served from the glyph cache
+  for (int pass = 0; pass < 2; pass++) {
+    int16_t y = 60 + pass * 200;
+    for (const char* line : lines) {
+      renderer.setCursor(20, y);
+      renderer.print(line);
+      y += font->yAdvance;
+    }
+  }
+  const uint8_t* fb = display.getFrameBuffer();
+  return std::vector<uint8_t>(fb, fb + EInkDisplay::BUFFER_SIZE);
+}
+
+int main() {
+  TestUtils::TestRunner runner("Glyph Codec Test");
+
+  const FontFamily* families[] = {&bookerly26Family, &notoSans26Family, &menuFontSmallFamily};
+  const FontStyle styles[] = {FontStyle::REGULAR, FontStyle::BOLD, FontStyle::ITALIC, FontStyle::BOLD_ITALIC};
+
+  EInkDisplay display(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                      ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+  display.begin();
+
+  for (const FontFamily* family : families) {
+    for (FontStyle style : styles) {
+      const SimpleGFXfont* planar = getFontVariant(family, style);
+      if (!planar || !planar->glyphCount)
+        continue;
+
+      std::string name = std::string(planar->name ? planar->name : "font") + " style " +
+                         std::to_string((int)style);
+      RleFont rle;
+      buildRleFont(planar, rle);
+      std::cout << name << ": planar " << planarSize(planar) << " bytes, RLE " << rle.stream.size() << " bytes\n";
+
+      std::string mismatch;
+      runner.expectTrue(decodeMatches(planar, rle, mismatch), name + " decode matches planar", mismatch);
+
+      const TextRenderer::BitmapType types[] = {TextRenderer::BITMAP_BW, TextRenderer::BITMAP_GRAY_LSB,
+                                                TextRenderer::BITMAP_GRAY_MSB};
+      for (TextRenderer::BitmapType type : types) {
+        if (type != TextRenderer::BITMAP_BW && !planar->bitmap_gray_lsb)
+          continue;
+        std::vector<uint8_t> expected = renderSample(display, planar, type);
+        std::vector<uint8_t> actual = renderSample(display, &rle.font, type);
+        runner.expectTrue(expected == actual, name + " render matches (bitmap type " + std::to_string(type) + ")");
+      }
+    }
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
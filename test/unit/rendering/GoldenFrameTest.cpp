@@ -0,0 +1,259 @@
+/**
+ * GoldenFrameTest.cpp - Golden-frame render regression
+ *
+ * Lays out a fixed styled text (alignment, bold, italic, hyphenated
+ * compounds) with each layout strategy and a set of fonts and sizes, renders
+ * fixed pages into the black/white frame and the gray LSB/MSB planes exactly
+ * as TextViewerScreen does, and compares every plane pixel by pixel with the
+ * PBM files in test/data/golden. Mismatching planes are written to
+ * test/output/golden with a PGM diff image (black = pixel differs, gray =
+ * ink in both). Also prints the render time of each page and plane.
+ *
+ * After an intended rendering change, review the new frames and run
+ *   ./test/build/bin/GoldenFrameTest --update
+ * to replace the golden files.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "content/providers/FileWordProvider.h"
+#include "core/EInkDisplay.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "resources/fonts/FontDefinitions.h"
+#include "test_config.h"
+#include "test_utils.h"
+#include "text/hyphenation/HyphenationStrategy.h"
+#include "text/layout/GreedyLayoutStrategy.h"
+#include "text/layout/KnuthPlassLayoutStrategy.h"
+
+namespace {
+
+const char* GOLDEN_DIR = "test/data/golden";
+const std::string OUTPUT_DIR = ::TestConfig::TEST_OUTPUT_DIR + "/golden";
+const std::string TEXT_PATH = ::TestConfig::TEST_OUTPUT_DIR + "/golden_text.txt";
+
+// Renders per plane; the fastest one is reported
+const int RENDER_REPEATS = 5;
+
+struct FrameConfig {
+  const char* name;
+  bool knuthPlass;
+  FontFamily* family;
+  int fontSize;
+};
+
+const FrameConfig CONFIGS[] = {
+    {"greedy_bookerly26", false, &bookerly26Family, 26},
+    {"greedy_notosans30", false, &notoSans30Family, 30},
+    {"knuthplass_bookerly26", true, &bookerly26Family, 26},
+    {"knuthplass_notosans30", true, &notoSans30Family, 30},
+};
+
+// The first page and one continuing a paragraph across a page break
+const int PAGES[] = {0, 2};
+
+struct Plane {
+  const char* name;
+  TextRenderer::BitmapType type;
+  uint8_t clearColor;
+};
+
+const Plane PLANES[] = {
+    {"bw", TextRenderer::BITMAP_BW, 0xFF},
+    {"lsb", TextRenderer::BITMAP_GRAY_LSB, 0x00},
+    {"msb", TextRenderer::BITMAP_GRAY_MSB, 0x00},
+};
+
+struct Pbm {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> bits;
+
+  bool pixel(int x, int y) const {
+    return (bits[y * ((width + 7) / 8) + x / 8] >> (7 - x % 8)) & 1;
+  }
+};
+
+bool readPbm(const std::string& path, Pbm& out) {
+  std::ifstream in(path, std::ios::binary);
+  std::string magic;
+  if (!(in >> magic >> out.width >> out.height) || magic != "P4")
+    return false;
+  in.get();  // Single whitespace before the raster
+  out.bits.resize((size_t)((out.width + 7) / 8) * out.height);
+  in.read(reinterpret_cast<char*>(out.bits.data()), out.bits.size());
+  return (size_t)in.gcount() == out.bits.size();
+}
+
+void writeDiffPgm(const std::string& path, const Pbm& expected, const Pbm& actual) {
+  std::ofstream out(path, std::ios::binary);
+  out << "P5\n" << actual.width << " " << actual.height << "\n255\n";
+  for (int y = 0; y < actual.height; y++) {
+    for (int x = 0; x < actual.width; x++) {
+      bool e = expected.pixel(x, y);
+      bool a = actual.pixel(x, y);
+      out.put((char)(e != a ? 0 : (a ? 160 : 255)));
+    }
+  }
+}
+
+// Fixed text with alignment and style ESC tokens, long enough for three pages at the largest size
+void writeText(const std::string& path) {
+  static const char* vocabulary[] = {"the",      "reader",    "turns",        "a",          "page",
+                                     "and",      "light",     "falls",        "across",     "paper",
+                                     "quietly",  "between",   "chapters",     "of",         "margins",
+                                     "ink-dark", "letters",   "well-known",   "stories",    "unfold",
+                                     "in",       "typesetting", "justified", "paragraphs", "Wanderlust"};
+  const int vocabularySize = sizeof(vocabulary) / sizeof(vocabulary[0]);
+  const char ESC = '\x1B';
+  uint32_t state = 2024;
+  auto next = [&state]() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+  };
+
+  std::ofstream out(path, std::ios::binary);
+  out << ESC << 'C' << ESC << 'B' << "Golden Frames" << ESC << 'b' << ESC << 'c' << "\n";
+  for (int p = 0; p < 14; p++) {
+    char align = (p % 3 == 2) ? 'L' : 'J';
+    out << ESC << align;
+    int words = 20 + next() % 60;
+    for (int w = 0; w < words; w++) {
+      if (w > 0)
+        out << ' ';
+      uint32_t r = next();
+      const char* word = vocabulary[r % vocabularySize];
+      if (r % 11 == 0)
+        out << ESC << 'B' << word << ESC << 'b';
+      else if (r % 13 == 0)
+        out << ESC << 'I' << word << ESC << 'i';
+      else
+        out << word;
+    }
+    out << '.' << ESC << (char)(align - 'A' + 'a') << "\n";
+  }
+}
+
+LayoutStrategy::LayoutConfig makeConfig(int fontSize) {
+  LayoutStrategy::LayoutConfig cfg;
+  cfg.marginLeft = ::TestConfig::DEFAULT_MARGIN_LEFT;
+  cfg.marginRight = ::TestConfig::DEFAULT_MARGIN_RIGHT;
+  cfg.marginTop = ::TestConfig::DEFAULT_MARGIN_TOP;
+  cfg.marginBottom = ::TestConfig::DEFAULT_MARGIN_BOTTOM;
+  cfg.lineSpacing = ::TestConfig::DEFAULT_LINE_SPACING;
+  cfg.lineHeight = fontSize + ::TestConfig::DEFAULT_LINE_SPACING;
+  cfg.minSpaceWidth = ::TestConfig::DEFAULT_MIN_SPACE_WIDTH;
+  cfg.pageWidth = ::TestConfig::DISPLAY_WIDTH;
+  cfg.pageHeight = ::TestConfig::DISPLAY_HEIGHT;
+  cfg.alignment = LayoutStrategy::ALIGN_LEFT;
+  cfg.language = Language::BASIC;
+  return cfg;
+}
+
+void runConfig(const FrameConfig& config, bool update, TestUtils::TestRunner& runner, EInkDisplay& display,
+               TextRenderer& renderer) {
+  GreedyLayoutStrategy greedy;
+  KnuthPlassLayoutStrategy knuthPlass;
+  LayoutStrategy& layout = config.knuthPlass ? static_cast<LayoutStrategy&>(knuthPlass) : greedy;
+  LayoutStrategy::LayoutConfig cfg = makeConfig(config.fontSize);
+  layout.setLanguage(cfg.language);
+  renderer.setFontFamily(config.family);
+
+  FileWordProvider provider(TEXT_PATH.c_str());
+  if (!provider.isValid()) {
+    runner.expectTrue(false, std::string(config.name) + ": text file opened");
+    return;
+  }
+
+  int page = 0;
+  LayoutStrategy::PageLayout layoutPage;
+  for (int target : PAGES) {
+    for (; page <= target; page++) {
+      provider.setPosition(page == 0 ? 0 : layoutPage.endPosition);
+      layoutPage = layout.layoutText(provider, renderer, cfg);
+    }
+
+    for (const Plane& plane : PLANES) {
+      std::string frame = std::string(config.name) + "_p" + std::to_string(target) + "_" + plane.name;
+      renderer.setBitmapType(plane.type);
+      renderer.setFrameBuffer(display.getFrameBuffer());
+
+      double bestMs = 0;
+      for (int i = 0; i < RENDER_REPEATS; i++) {
+        display.clearScreen(plane.clearColor);
+        auto start = std::chrono::steady_clock::now();
+        layout.renderPage(layoutPage, renderer, cfg);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || ms < bestMs)
+          bestMs = ms;
+      }
+
+      std::string actualPath = OUTPUT_DIR + "/" + frame + ".pbm";
+      std::string goldenPath = std::string(GOLDEN_DIR) + "/" + frame + ".pbm";
+      display.saveFrameBufferAsPBM(actualPath.c_str());
+      if (update) {
+        std::filesystem::copy_file(actualPath, goldenPath, std::filesystem::copy_options::overwrite_existing);
+        std::cout << "  updated " << goldenPath << "\n";
+        continue;
+      }
+
+      Pbm expected, actual;
+      if (!readPbm(goldenPath, expected)) {
+        runner.expectTrue(false, frame + " golden frame present", "missing " + goldenPath + ", run with --update");
+        continue;
+      }
+      readPbm(actualPath, actual);
+      if (expected.width != actual.width || expected.height != actual.height) {
+        runner.expectTrue(false, frame + " frame size", goldenPath);
+        continue;
+      }
+
+      long diffPixels = 0;
+      for (int y = 0; y < actual.height; y++)
+        for (int x = 0; x < actual.width; x++)
+          diffPixels += expected.pixel(x, y) != actual.pixel(x, y);
+      if (diffPixels > 0)
+        writeDiffPgm(OUTPUT_DIR + "/" + frame + "_diff.pgm", expected, actual);
+      else
+        std::remove(actualPath.c_str());
+
+      std::cout << "  " << std::left << std::setw(32) << frame << std::right << std::setw(4)
+                << layoutPage.lines.size() << " lines " << std::fixed << std::setprecision(3) << std::setw(8)
+                << bestMs << " ms " << std::setw(7) << diffPixels << " px differ\n";
+      runner.expectTrue(diffPixels == 0, frame + " matches golden", std::to_string(diffPixels) + " pixels differ");
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  TestUtils::TestRunner runner("Golden Frame Test");
+  bool update = argc > 1 && std::string(argv[1]) == "--update";
+
+  std::filesystem::create_directories(OUTPUT_DIR);
+  if (update)
+    std::filesystem::create_directories(GOLDEN_DIR);
+  writeText(TEXT_PATH);
+
+  EInkDisplay display(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                      ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+  display.begin();
+  TextRenderer renderer(display);
+  renderer.setTextColor(TextRenderer::COLOR_BLACK);
+
+  std::cout << "  frame                            lines   render     pixels\n";
+  for (const FrameConfig& config : CONFIGS)
+    runConfig(config, update, runner, display, renderer);
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "WString.h"
+#include "core/EInkDisplay.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "resources/fonts/FontDefinitions.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Adds a few kerning pairs to a copy of a shipped font and checks that
+// measurement and rendering apply them the same way, and only within one
+// print() call.
+
+static const int8_t AV_KERN = -3;
+static const int8_t TO_KERN = -2;
+
+static int glyphOf(const SimpleGFXfont* f, char c) {
+  return findGlyphIndex(f, (uint32_t)c);
+}
+
+static uint16_t textWidth(TextRenderer& renderer, const char* text) {
+  int16_t x1, y1;
+  uint16_t w, h;
+  renderer.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+  return w;
+}
+
+static std::vector<uint8_t> snapshot(EInkDisplay& display) {
+  const uint8_t* fb = display.getFrameBuffer();
+  return std::vector<uint8_t>(fb, fb + EInkDisplay::BUFFER_SIZE);
+}
+
+int main() {
+  TestUtils::TestRunner runner("Kerning Test");
+
+  const SimpleGFXfont* plain = bookerly26Family.regular;
+  int a = glyphOf(plain, 'A');
+  int v = glyphOf(plain, 'V');
+  int t = glyphOf(plain, 'T');
+  int o = glyphOf(plain, 'o');
+  runner.expectTrue(a >= 0 && v >= 0 && t >= 0 && o >= 0, "test glyphs present");
+
+  // Pairs must be sorted by (left, right) glyph index
+  std::vector<SimpleGFXkernPair> pairs = {{(uint16_t)a, (uint16_t)v, AV_KERN}, {(uint16_t)t, (uint16_t)o, TO_KERN}};
+  std::sort(pairs.begin(), pairs.end(), [](const SimpleGFXkernPair& l, const SimpleGFXkernPair& r) {
+    return l.left != r.left ? l.left < r.left : l.right < r.right;
+  });
+  SimpleGFXfont kerned = *plain;
+  kerned.kernPairs = pairs.data();
+  kerned.kernPairCount = pairs.size();
+
+  // Cursor lookup
+  KerningCursor cursor;
+  runner.expectTrue(cursor.next(&kerned, a) == 0, "first glyph has no adjustment");
+  runner.expectTrue(cursor.next(&kerned, v) == AV_KERN, "A followed by V is kerned");
+  runner.expectTrue(cursor.next(&kerned, a) == 0, "V followed by A is not kerned");
+  runner.expectTrue(cursor.next(&kerned, -1) == 0, "missing glyph has no adjustment");
+  runner.expectTrue(cursor.next(&kerned, v) == 0, "missing glyph breaks the pair");
+  cursor.reset();
+  cursor.next(&kerned, t);
+  runner.expectTrue(cursor.next(&kerned, o) == TO_KERN, "T followed by o is kerned");
+  cursor.next(&kerned, a);
+  runner.expectTrue(cursor.next(plain, v) == 0, "font change breaks the pair");
+  cursor.reset();
+  cursor.next(plain, a);
+  runner.expectTrue(cursor.next(plain, v) == 0, "font without pairs is not kerned");
+
+  EInkDisplay display(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                      ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+  display.begin();
+  TextRenderer renderer(display);
+  renderer.setTextColor(TextRenderer::COLOR_BLACK);
+  renderer.setFrameBuffer(display.getFrameBuffer());
+
+  // Measurement
+  renderer.setFont(plain);
+  uint16_t plainWidth = textWidth(renderer, "AVATON");
+  uint16_t widthA = textWidth(renderer, "A");
+  renderer.setFont(&kerned);
+  runner.expectTrue(textWidth(renderer, "AVATON") == plainWidth + AV_KERN,
+                    "measured width includes the AV pair");
+  runner.expectTrue(textWidth(renderer, "AVAToN") == textWidth(renderer, "AVA") + textWidth(renderer, "ToN"),
+                    "width is additive at unkerned boundaries");
+  runner.expectTrue(textWidth(renderer, "To") == textWidth(renderer, "T") + textWidth(renderer, "o") + TO_KERN,
+                    "To pair measured");
+
+  // Rendering: a kerned pair equals the second glyph drawn at the kerned position
+  display.clearScreen(0xFF);
+  renderer.setFont(plain);
+  renderer.setCursor(40, 100);
+  renderer.print("A");
+  renderer.setCursor(40 + widthA + AV_KERN, 100);
+  renderer.print("V");
+  std::vector<uint8_t> expected = snapshot(display);
+
+  display.clearScreen(0xFF);
+  renderer.setFont(&kerned);
+  renderer.setCursor(40, 100);
+  renderer.print("AV");
+  runner.expectTrue(snapshot(display) == expected, "print applies kerning at the measured position");
+
+  // Separate print() calls are measured separately, so they are not kerned together
+  display.clearScreen(0xFF);
+  renderer.setFont(plain);
+  renderer.setCursor(40, 100);
+  renderer.print("AV");
+  expected = snapshot(display);
+
+  display.clearScreen(0xFF);
+  renderer.setFont(&kerned);
+  renderer.setCursor(40, 100);
+  renderer.print("A");
+  renderer.print("V");
+  runner.expectTrue(snapshot(display) == expected, "no kerning across print calls");
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "WString.h"
+#include "core/EInkDisplay.h"
+#include "platform_stubs.h"
+#include "rendering/TextRenderer.h"
+#include "resources/fonts/FontDefinitions.h"
+#include "resources/fonts/SdFont.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Writes a built-in font family into the SD font container format (same
+// layout as scripts/generate_simplefont/binary_writer.py), loads it back
+// through SdFontFamily and checks that rendering matches the built-in fonts,
+// and that containers whose glyph offsets do not fit the bitmap data are
+// rejected when loading.
+
+static void putU16(std::string& out, uint16_t v) {
+  out += (char)(v & 0xFF);
+  out += (char)(v >> 8);
+}
+
+static void putU32(std::string& out, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    out += (char)((v >> (8 * i)) & 0xFF);
+}
+
+// Kerning pairs written for the regular style. The glyphs are never adjacent
+// in the rendered sample, so rendering still matches the unkerned built-in font.
+static std::vector<SimpleGFXkernPair> samplePairs(const SimpleGFXfont* f) {
+  uint16_t j = findGlyphIndex(f, 'J');
+  uint16_t q = findGlyphIndex(f, 'Q');
+  std::vector<SimpleGFXkernPair> pairs = {{j, q, -2}, {q, j, 1}};
+  if (q < j)
+    std::swap(pairs[0], pairs[1]);
+  return pairs;
+}
+
+static std::string buildContainer(const FontFamily* family, const char* name, uint8_t size) {
+  const SimpleGFXfont* styles[4] = {family->regular, family->bold, family->italic, family->boldItalic};
+  uint8_t count = 0;
+  for (const SimpleGFXfont* f : styles)
+    count += f ? 1 : 0;
+
+  std::string header = "MRFN";
+  putU16(header, SdFontFamily::VERSION);
+  header += (char)size;
+  header += (char)count;
+  std::string familyName(name);
+  familyName.resize(SdFontFamily::FAMILY_NAME_LENGTH, '\0');
+  header += familyName;
+  header.append(8, '\0');
+
+  uint32_t offset = header.size() + count * 24;
+  std::string entries;
+  std::string body;
+  for (int style = 0; style < 4; style++) {
+    const SimpleGFXfont* f = styles[style];
+    if (!f)
+      continue;
+    bool gray = f->bitmap_gray_lsb != nullptr;
+
+    std::string table;
+    std::string bitmaps;
+    for (uint16_t i = 0; i < f->glyphCount; i++) {
+      const SimpleGFXglyph& g = f->glyph[i];
+      uint16_t planeSize = glyphPlaneSize(&g);
+      putU32(table, bitmaps.size());
+      putU32(table, g.codepoint);
+      table += (char)g.width;
+      table += (char)g.height;
+      table += (char)g.xAdvance;
+      table += (char)g.xOffset;
+      table += (char)g.yOffset;
+      table.append(3, '\0');
+      bitmaps.append((const char*)f->bitmap + g.bitmapOffset, planeSize);
+      if (gray) {
+        bitmaps.append((const char*)f->bitmap_gray_lsb + g.bitmapOffset, planeSize);
+        bitmaps.append((const char*)f->bitmap_gray_msb + g.bitmapOffset, planeSize);
+      }
+    }
+
+    std::string kern;
+    if (style == 0) {
+      for (const SimpleGFXkernPair& pair : samplePairs(f)) {
+        putU16(kern, pair.left);
+        putU16(kern, pair.right);
+        kern += (char)pair.adjust;
+        kern += '\0';
+      }
+    }
+
+    uint32_t tableOffset = offset + body.size();
+    body += table;
+    uint32_t kernOffset = offset + body.size();
+    body += kern;
+    uint32_t bitmapOffset = offset + body.size();
+    body += bitmaps;
+
+    entries += (char)style;
+    entries += (char)(gray ? SdFontFamily::FLAG_GRAYSCALE : 0);
+    entries += (char)f->yAdvance;
+    entries += '\0';
+    putU16(entries, f->glyphCount);
+    putU16(entries, kern.size() / 6);
+    putU32(entries, tableOffset);
+    putU32(entries, bitmapOffset);
+    putU32(entries, bitmaps.size());
+    putU32(entries, kern.empty() ? 0 : kernOffset);
+  }
+  return header + entries + body;
+}
+
+static void setU32(std::string& data, size_t at, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    data[at + i] = (char)((v >> (8 * i)) & 0xFF);
+}
+
+static uint32_t getU32(const std::string& data, size_t at) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4; i++)
+    v |= (uint32_t)(uint8_t)data[at + i] << (8 * i);
+  return v;
+}
+
+static bool loadsAfter(const std::filesystem::path& dir, const std::string& data) {
+  std::string path = (dir / "damaged.mrf").string();
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), data.size());
+  }
+  SdFontFamily font;
+  return font.load(path.c_str());
+}
+
+static std::vector<uint8_t> renderSample(EInkDisplay& display, const FontFamily* family, FontStyle style,
+                                         TextRenderer::BitmapType type) {
+  // More distinct glyphs than the LRU cache holds, so slots get evicted and reloaded
+  static const char* lines[] = {"The quick brown fox jumps over the lazy dog.",
+                                "SPHINX OF BLACK QUARTZ, JUDGE MY VOW! 0123456789",
+                                "\xC3\x84pfel \xC3\xB6" "ffnen \xC3\xBC" "ber Stra\xC3\x9F" "en (a) [b] {c} #1 $2 %3 &4",
+                                "The quick brown fox jumps over the lazy dog."};
+  display.clearScreen(0xFF);
+  TextRenderer renderer(display);
+  renderer.setFontFamily(const_cast<FontFamily*>(family));
+  renderer.setFontStyle(style);
+  renderer.setTextColor(TextRenderer::COLOR_BLACK);
+  renderer.setFrameBuffer(display.getFrameBuffer());
+  renderer.setBitmapType(type);
+  int16_t y = 60;
+  for (const char* line : lines) {
+    renderer.setCursor(10, y);
+    renderer.print(line);
+    y += getFontVariant(family, style)->yAdvance;
+  }
+  const uint8_t* fb = display.getFrameBuffer();
+  return std::vector<uint8_t>(fb, fb + EInkDisplay::BUFFER_SIZE);
+}
+
+int main() {
+  TestUtils::TestRunner runner("SD Font Test");
+
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "microreader_sdfont_test";
+  std::filesystem::create_directories(dir);
+  std::string path = (dir / "Bookerly26.mrf").string();
+  {
+    std::ofstream out(path, std::ios::binary);
+    std::string data = buildContainer(&bookerly26Family, "Bookerly", 26);
+    out.write(data.data(), data.size());
+  }
+
+  String familyName;
+  uint8_t size = 0;
+  runner.expectTrue(SdFontFamily::readInfo(path.c_str(), familyName, size), "readInfo parses header");
+  runner.expectEqual("Bookerly", familyName.c_str(), "readInfo family name");
+  runner.expectTrue(size == 26, "readInfo size");
+
+  SdFontFamily sdFont;
+  runner.expectTrue(sdFont.load(path.c_str()), "load font container", "", false);
+  FontFamily* family = sdFont.getFamily();
+  runner.expectTrue(family != nullptr, "family available after load");
+  if (!family)
+    return 1;
+  runner.expectTrue(family->bold && family->italic && family->boldItalic, "all styles loaded");
+  runner.expectTrue(family->regular->glyphCount == bookerly26Family.regular->glyphCount, "glyph table size matches");
+
+  std::vector<SimpleGFXkernPair> pairs = samplePairs(bookerly26Family.regular);
+  const SimpleGFXfont* regular = family->regular;
+  runner.expectTrue(regular->kernPairCount == pairs.size(), "kerning pairs loaded");
+  bool pairsMatch = regular->kernPairs != nullptr;
+  for (size_t i = 0; pairsMatch && i < pairs.size(); i++) {
+    pairsMatch = regular->kernPairs[i].left == pairs[i].left && regular->kernPairs[i].right == pairs[i].right &&
+                 regular->kernPairs[i].adjust == pairs[i].adjust;
+  }
+  runner.expectTrue(pairsMatch, "kerning pairs match");
+  runner.expectTrue(family->bold->kernPairs == nullptr && family->bold->kernPairCount == 0,
+                    "style without kerning has no pairs");
+
+  EInkDisplay display(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                      ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+  display.begin();
+
+  const FontStyle styles[] = {FontStyle::REGULAR, FontStyle::BOLD, FontStyle::ITALIC, FontStyle::BOLD_ITALIC};
+  const TextRenderer::BitmapType types[] = {TextRenderer::BITMAP_BW, TextRenderer::BITMAP_GRAY_LSB,
+                                            TextRenderer::BITMAP_GRAY_MSB};
+  for (FontStyle style : styles) {
+    for (TextRenderer::BitmapType type : types) {
+      std::vector<uint8_t> expected = renderSample(display, &bookerly26Family, style, type);
+      std::vector<uint8_t> actual = renderSample(display, family, style, type);
+      runner.expectTrue(expected == actual, "style " + std::to_string((int)style) + " bitmap type " +
+                                                std::to_string(type) + " matches built-in font");
+    }
+  }
+
+  // Corrupt files are rejected
+  {
+    std::ofstream out((dir / "broken.mrf").string(), std::ios::binary);
+    out << "NOPE";
+  }
+  SdFontFamily broken;
+  runner.expectTrue(!broken.load((dir / "broken.mrf").string().c_str()), "invalid container rejected");
+  runner.expectTrue(broken.getFamily() == nullptr, "no family after failed load");
+
+  // Glyph offsets that do not fit the bitmap data (first variant entry right after the 48 byte header)
+  {
+    const std::string valid = buildContainer(&bookerly26Family, "Bookerly", 26);
+    runner.expectTrue(loadsAfter(dir, valid), "undamaged container loads");
+
+    std::string data = valid;
+    setU32(data, 48 + 16, getU32(data, 48 + 16) - 1);
+    runner.expectTrue(!loadsAfter(dir, data), "last glyph past the bitmap data rejected");
+
+    data = valid;
+    uint32_t table = getU32(data, 48 + 8);
+    setU32(data, table + 16, getU32(data, table + 2 * 16) + 1);
+    runner.expectTrue(!loadsAfter(dir, data), "glyph offsets out of order rejected");
+
+    data = valid;
+    setU32(data, 48 + 16, 0xFFFFFFF0);
+    runner.expectTrue(!loadsAfter(dir, data), "bitmap data past the end of the file rejected");
+  }
+
+  sdFont.unload();
+  runner.expectTrue(sdFont.getFamily() == nullptr, "unload releases family");
+
+  std::filesystem::remove_all(dir);
+  return runner.allPassed() ? 0 : 1;
+}
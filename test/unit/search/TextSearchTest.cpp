@@ -0,0 +1,145 @@
+#include <SD.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CostModel.h"
+#include "content/search/TextSearch.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Searches small chapter files written under test/output: case and
+// diacritic folding, ESC tokens and hidden indents, matches across line
+// breaks and read blocks, several patterns at once, and the trigram filter
+// that lets later searches skip chapters.
+
+namespace fs = std::filesystem;
+
+static void writeFile(const std::string& path, const std::string& content) {
+  std::ofstream out(path, std::ios::binary);
+  out << content;
+}
+
+static std::string offsets(const std::vector<SearchHit>& hits) {
+  std::string s;
+  for (const auto& hit : hits) {
+    if (!s.empty())
+      s += ",";
+    s += std::to_string(hit.chapter) + ":" + std::to_string(hit.offset);
+  }
+  return s;
+}
+
+// Offsets of pattern in one file, as "chapter:offset" pairs
+static std::string find(const std::string& path, const char* pattern, uint32_t from = 0) {
+  TextSearch search;
+  search.setUseFilter(false);
+  if (!search.addPattern(pattern))
+    return "bad pattern";
+  std::vector<SearchHit> hits;
+  if (!search.searchFile(path.c_str(), 0, from, hits, 100))
+    return "read failed";
+  return offsets(hits);
+}
+
+int main() {
+  TestUtils::TestRunner runner("Text Search Test");
+
+  const std::string dir = TestConfig::TEST_OUTPUT_DIR + "/search";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  // Folding
+  const std::string folding = dir + "/folding.txt";
+  writeFile(folding, "Le Café. STRASSE und Straße. Œuvre. Łódź. МОСКВА");
+  runner.expectTrue(find(folding, "cafe") == "0:3", "accent and case folded", find(folding, "cafe"));
+  runner.expectTrue(find(folding, "CAFÉ") == "0:3", "pattern folded too", find(folding, "CAFÉ"));
+  runner.expectTrue(find(folding, "strasse") == "0:10,0:22", "sharp s matches ss", find(folding, "strasse"));
+  runner.expectTrue(find(folding, "straße") == "0:10,0:22", "ss matches sharp s", find(folding, "straße"));
+  runner.expectTrue(find(folding, "oeuvre") == "0:31", "ligature expanded", find(folding, "oeuvre"));
+  runner.expectTrue(find(folding, "lodz") == "0:39", "Latin Extended-A folded", find(folding, "lodz"));
+  runner.expectTrue(find(folding, "москва") == "0:48", "Cyrillic capitals folded", find(folding, "москва"));
+  runner.expectTrue(find(folding, "strasse", 11) == "0:22", "search from an offset", find(folding, "strasse", 11));
+
+  uint8_t out[4];
+  runner.expectTrue(TextSearch::foldCodepoint(0x0130, out) == 1 && out[0] == 'i', "dotted capital I folds to i");
+  runner.expectTrue(TextSearch::foldCodepoint(0x03A3, out) == 2 && out[0] == 0xCF && out[1] == 0x83,
+                    "Greek capital sigma folds to lower case");
+
+  // Chapter text: ESC tokens between and inside words, hidden indent, line breaks and no-break spaces
+  const std::string chapter = dir + "/chapter.txt";
+  writeFile(chapter, "\x1B" "C\x1B" "HXX\x1B" "hThe \x1B" "Bspice\x1B" "b must\nflow.\n"
+                     "\x1B" "H-\x1B" "hA\xC2\xA0great   house\n");
+  runner.expectTrue(find(chapter, "the spice must flow") == "0:8", "phrase across tokens and a line break",
+                    find(chapter, "the spice must flow"));
+  runner.expectTrue(find(chapter, "xx") == "", "hidden text is not searched", find(chapter, "xx"));
+  runner.expectTrue(find(chapter, "flow. a great house") == "0:27", "whitespace runs collapse",
+                    find(chapter, "flow. a great house"));
+  runner.expectTrue(find(chapter, "  great\thouse ") == "0:41", "pattern whitespace trimmed and collapsed",
+                    find(chapter, "  great\thouse "));
+  runner.expectTrue(find(chapter, "bspice") == "", "style commands are not text", find(chapter, "bspice"));
+
+  // Matches straddling the read blocks, several patterns at once, the hit limit
+  const std::string large = dir + "/large.txt";
+  std::string text(TextSearch::READ_BLOCK_SIZE * 3, '.');
+  const uint32_t straddle = TextSearch::READ_BLOCK_SIZE - 3;
+  text.replace(straddle, 7, "Arrakis");
+  text.replace(2 * TextSearch::READ_BLOCK_SIZE + 100, 5, "Dune!");
+  text.replace(200, 7, "arrakis");
+  writeFile(large, text);
+  runner.expectTrue(find(large, "arrakis") == "0:200,0:" + std::to_string(straddle), "match across read blocks",
+                    find(large, "arrakis"));
+  {
+    TextSearch search;
+    search.setUseFilter(false);
+    search.addPattern("dune");
+    search.addPattern("arrakis");
+    runner.expectTrue(search.getPatternCount() == 2, "two patterns");
+    std::vector<SearchHit> hits;
+    runner.expectTrue(search.searchFile(large.c_str(), 5, 0, hits, 100), "multi-pattern search");
+    runner.expectTrue(hits.size() == 3 && hits[0].pattern == 1 && hits[2].pattern == 0 && hits[2].chapter == 5 &&
+                          hits[2].offset == 2 * TextSearch::READ_BLOCK_SIZE + 100,
+                      "hits in text order, tagged with pattern and chapter", offsets(hits));
+    hits.clear();
+    search.searchFile(large.c_str(), 5, 0, hits, 1);
+    runner.expectTrue(hits.size() == 1 && hits[0].offset == 200, "hit limit", offsets(hits));
+
+    std::string tooLong(TextSearch::MAX_PATTERN_BYTES, 'x');
+    runner.expectTrue(!search.addPattern(tooLong.c_str()), "patterns beyond 64 folded bytes rejected");
+    runner.expectTrue(!search.addPattern(" \n"), "blank pattern rejected");
+  }
+
+  // Trigram filter: written by the first full scan, then used to skip the chapter
+  {
+    TextSearch search;
+    search.addPattern("melange");
+    std::vector<SearchHit> hits;
+    runner.expectTrue(search.searchFile(large.c_str(), 0, 0, hits, 100) && hits.empty(), "no melange");
+    runner.expectTrue(fs::file_size(TextSearch::filterPathFor(large.c_str()).c_str()) == 8 + TextSearch::FILTER_BYTES,
+                      "filter written next to the chapter");
+    runner.expectTrue(!search.mayContain(large.c_str()), "filter rules the chapter out");
+
+    uint64_t readsBefore = CostModel::counters().sdSectorReads;
+    search.searchFile(large.c_str(), 0, 0, hits, 100);
+    uint64_t reads = CostModel::counters().sdSectorReads - readsBefore;
+    runner.expectTrue(reads <= 2, "ruled-out chapter is not read", std::to_string(reads));
+
+    TextSearch present;
+    present.addPattern("arrakis");
+    runner.expectTrue(present.mayContain(large.c_str()), "filter keeps a chapter that has the word");
+    TextSearch shortPattern;
+    shortPattern.addPattern("zq");
+    runner.expectTrue(shortPattern.mayContain(large.c_str()), "short patterns never skip");
+
+    // A changed chapter invalidates its filter
+    writeFile(large, text + "melange");
+    runner.expectTrue(search.mayContain(large.c_str()), "stale filter ignored");
+    hits.clear();
+    runner.expectTrue(search.searchFile(large.c_str(), 0, 0, hits, 100) && hits.size() == 1,
+                      "changed chapter searched again");
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+#include <SD.h>
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "content/providers/EpubWordProvider.h"
+#include "core/EInkDisplay.h"
+#include "lib/miniz.h"
+#include "test_config.h"
+#include "test_utils.h"
+
+// Builds a three-chapter EPUB whose NCX points at chapter files and at
+// anchors inside them, then checks the navigation targets: TOC entries and
+// element ids resolved through the anchor tables written during conversion,
+// the TOC entry before a position, and book-wide percentages mapped to
+// (chapter, offset) so that getPercentage() reads them back.
+
+namespace fs = std::filesystem;
+
+// The EPUB parser borrows this display's frame buffer as its inflate window (see main.cpp)
+EInkDisplay einkDisplay(::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN,
+                        ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN, ::TestConfig::DUMMY_PIN);
+
+static bool writeEpub(const std::string& path) {
+  mz_zip_archive zip;
+  memset(&zip, 0, sizeof(zip));
+  if (!mz_zip_writer_init_file(&zip, path.c_str(), 0))
+    return false;
+  auto add = [&zip](const char* name, const std::string& data) {
+    return mz_zip_writer_add_mem(&zip, name, data.data(), data.size(), MZ_NO_COMPRESSION);
+  };
+  auto navPoint = [](const char* title, const char* src) {
+    return std::string("<navPoint><navLabel><text>") + title + "</text></navLabel><content src=\"" + src +
+           "\"/></navPoint>\n";
+  };
+  std::string filler;
+  for (int i = 0; i < 40; i++)
+    filler += "<p>Filler paragraph number " + std::to_string(i) + " with a few more words in it.</p>\n";
+
+  bool ok = add("mimetype", "application/epub+zip");
+  ok = ok && add("META-INF/container.xml",
+                 "<?xml version=\"1.0\"?>\n"
+                 "<container version=\"1.0\" xmlns=\"urn:oasis:names:tc:opendocument:xmlns:container\">\n"
+                 "<rootfiles><rootfile full-path=\"OEBPS/content.opf\" "
+                 "media-type=\"application/oebps-package+xml\"/></rootfiles>\n</container>\n");
+  ok = ok && add("OEBPS/content.opf",
+                 "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                 "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"2.0\">\n"
+                 "<metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\"><dc:title>Nav</dc:title></metadata>\n"
+                 "<manifest>\n"
+                 "<item id=\"ncx\" href=\"toc.ncx\" media-type=\"application/x-dtbncx+xml\"/>\n"
+                 "<item id=\"c1\" href=\"c1.xhtml\" media-type=\"application/xhtml+xml\"/>\n"
+                 "<item id=\"c2\" href=\"c2.xhtml\" media-type=\"application/xhtml+xml\"/>\n"
+                 "<item id=\"c3\" href=\"c3.xhtml\" media-type=\"application/xhtml+xml\"/>\n"
+                 "</manifest>\n"
+                 "<spine toc=\"ncx\"><itemref idref=\"c1\"/><itemref idref=\"c2\"/><itemref idref=\"c3\"/></spine>\n"
+                 "</package>\n");
+  ok = ok && add("OEBPS/toc.ncx", "<?xml version=\"1.0\"?>\n<ncx><navMap>\n" + navPoint("One", "c1.xhtml") +
+                                      navPoint("Two", "c2.xhtml") + navPoint("Second part", "c2.xhtml#part2") +
+                                      navPoint("Three", "c3.xhtml") + navPoint("Gone", "gone.xhtml") +
+                                      "</navMap></ncx>\n");
+  ok = ok && add("OEBPS/c1.xhtml", "<html><body><h1 id=\"top\">One</h1>\n" + filler + "</body></html>\n");
+  ok = ok && add("OEBPS/c2.xhtml", "<html><body><h1>Two</h1>\n" + filler +
+                                       "<h2 id=\"part2\">Second part</h2>\n<p>More words <a id=\"inline\"/>follow "
+                                       "here.</p>\n<p><a name=\"old\">Old style</a> anchor.</p>\n" + filler +
+                                       "</body></html>\n");
+  ok = ok && add("OEBPS/c3.xhtml", "<html><body><p>Three is the end.</p>\n" + filler + "</body></html>\n");
+  ok = ok && mz_zip_writer_finalize_archive(&zip);
+  mz_zip_writer_end(&zip);
+  return ok;
+}
+
+static std::string readFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+// Visible text of a chapter file from offset on: ESC tokens dropped, leading line breaks skipped
+static std::string textAt(EpubWordProvider& provider, int chapter, int offset, size_t length = 16) {
+  std::string text = readFile(provider.getChapterTextPath(chapter).c_str());
+  std::string visible;
+  for (size_t i = offset; i < text.size() && visible.size() < length; i++) {
+    if (text[i] == 0x1B) {
+      i++;
+      continue;
+    }
+    if (visible.empty() && (text[i] == '\n' || text[i] == ' '))
+      continue;
+    visible += text[i];
+  }
+  return visible;
+}
+
+int main() {
+  TestUtils::TestRunner runner("EPUB Navigation Test");
+  einkDisplay.begin();
+
+  const std::string epubPath = TestConfig::TEST_OUTPUT_DIR + "/navigation.epub";
+  fs::create_directories(TestConfig::TEST_OUTPUT_DIR);
+  runner.expectTrue(writeEpub(epubPath), "test EPUB written");
+
+  EpubWordProvider provider(epubPath.c_str());
+  runner.expectTrue(provider.isValid(), "EPUB opens");
+  runner.expectTrue(provider.getEpubReader() && provider.getEpubReader()->getTocCount() == 5, "five TOC entries");
+
+  // TOC entries
+  int chapter = -1;
+  int position = -1;
+  runner.expectTrue(provider.locateTocEntry(1, chapter, position) && chapter == 1 && position == 0,
+                    "entry without anchor is the chapter start");
+  runner.expectTrue(provider.locateTocEntry(2, chapter, position) && chapter == 1 && position > 0,
+                    "anchored entry lands inside the chapter", std::to_string(position));
+  int part2 = position;
+  runner.expectTrue(textAt(provider, 1, part2) == "Second part\nMore", "anchor offset is the heading's text",
+                    textAt(provider, 1, part2));
+  runner.expectTrue(!provider.locateTocEntry(4, chapter, position), "entry outside the spine rejected");
+  runner.expectTrue(!provider.locateTocEntry(5, chapter, position), "index past the TOC rejected");
+
+  // Anchor tables
+  std::string anchorPath = EpubWordProvider::anchorPathFor(provider.getChapterTextPath(1)).c_str();
+  runner.expectTrue(fs::exists(anchorPath), "anchor table written next to the chapter", anchorPath);
+  runner.expectTrue(provider.findAnchor(0, String("top")) == 0, "id on the first element");
+  int inlineAnchor = provider.findAnchor(1, String("inline"));
+  runner.expectTrue(textAt(provider, 1, inlineAnchor, 6) == "follow", "inline anchor inside a paragraph",
+                    textAt(provider, 1, inlineAnchor, 6));
+  int oldAnchor = provider.findAnchor(1, String("old"));
+  runner.expectTrue(textAt(provider, 1, oldAnchor, 9) == "Old style", "<a name> anchor",
+                    textAt(provider, 1, oldAnchor, 9));
+  runner.expectTrue(provider.findAnchor(1, String("nope")) == -1, "unknown id");
+  runner.expectTrue(provider.findAnchor(1, String("part")) == -1, "id prefix does not match");
+
+  // Entry before a position
+  runner.expectTrue(provider.findTocEntryBefore(0, 0) == -1, "nothing before the book start");
+  runner.expectTrue(provider.findTocEntryBefore(0, 1) == 0, "first entry");
+  runner.expectTrue(provider.findTocEntryBefore(1, part2) == 1, "entry at the position is not before it");
+  runner.expectTrue(provider.findTocEntryBefore(1, part2 + 1) == 2, "anchored entry");
+  runner.expectTrue(provider.findTocEntryBefore(2, 0) == 2, "entries of earlier chapters");
+
+  // Percentages
+  runner.expectTrue(provider.locatePercentage(0.0f, chapter, position) && chapter == 0 && position == 0,
+                    "0% is the book start");
+  runner.expectTrue(provider.locatePercentage(1.0f, chapter, position) && chapter == 2 &&
+                        position == (int)fs::file_size(provider.getChapterTextPath(2).c_str()),
+                    "100% is the book end", std::to_string(chapter) + ":" + std::to_string(position));
+  const float targets[] = {0.1f, 0.3f, 0.5f, 0.7f, 0.9f};
+  for (float target : targets) {
+    provider.locatePercentage(target, chapter, position);
+    provider.setChapter(chapter);
+    float back = provider.getPercentage(position);
+    runner.expectTrue(std::fabs(back - target) < 0.005f, "percentage round trip " + std::to_string(target),
+                      std::to_string(chapter) + ":" + std::to_string(position) + " reads " + std::to_string(back));
+  }
+
+  return runner.allPassed() ? 0 : 1;
+}
@@ -12,6 +12,7 @@
  * 5. Small buffer stress test
  * 6. Unicode content handling
  * 7. Specific content verification
+ * 8. Allocation budget of getNextWord
  */
 
 #include <algorithm>
@@ -23,6 +24,7 @@
 #include <vector>
 
 #include "WString.h"
+#include "alloc_counter.h"
 #include "content/providers/FileWordProvider.h"
 #include "test_config.h"
 #include "test_utils.h"
@@ -1037,6 +1039,47 @@ void testStyleParsingWithGeneratedFile(TestUtils::TestRunner& runner) {
   }
 }
 
+// ============================================================================
+// Test 8: Allocation budget of getNextWord
+// Reading words must not allocate beyond the returned word's own string, so
+// the sliding window and ESC token handling stay allocation-free
+// ============================================================================
+void testGetNextWordAllocations(TestUtils::TestRunner& runner) {
+  std::cout << "\n=== Test: getNextWord Allocation Budget ===\n";
+
+  const char* testFilePath = "test/output/alloc_budget_generated.txt";
+  {
+    std::ofstream outFile(testFilePath, std::ios::binary);
+    if (!outFile) {
+      runner.expectTrue(false, "Allocation budget: could not create test file");
+      return;
+    }
+    const char* words[] = {"a", "the", "reader", "pagination", "\x1B" "Bbold\x1B" "b", "extraordinarily-long-words"};
+    for (int i = 0; i < 3000; ++i) {
+      outFile << words[i % 6] << ((i % 17 == 16) ? "\n" : " ");
+    }
+  }
+
+  FileWordProvider provider(testFilePath, 2048);
+  if (!provider.isValid()) {
+    runner.expectTrue(false, "Allocation budget: could not open test file");
+    return;
+  }
+
+  const int wordCount = 10000;
+  int longWords = 0;
+  AllocCounter::Phase phase("getNextWord x" + std::to_string(wordCount));
+  for (int i = 0; i < wordCount; ++i) {
+    if (!provider.hasNextWord())
+      provider.setPosition(0);
+    StyledWord w = provider.getNextWord();
+    if (w.text.length() > 15)
+      longWords++;
+  }
+  // Short words stay in the string's inline buffer; a long one is built once and copied into the StyledWord
+  AllocCounter::expectAllocsAtMost(runner, phase, 2 * longWords);
+}
+
 // ============================================================================
 // Run all tests
 // ============================================================================
@@ -1050,6 +1093,7 @@ void runAllTests(TestUtils::TestRunner& runner) {
   // testSpecificContent(runner);
   // testStyleConsistency(runner);
   testStyleParsingWithGeneratedFile(runner);
+  testGetNextWordAllocations(runner);
 }
 
 }  // namespace FileWordProviderNavigationTests